@@ -0,0 +1,391 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "common/Logging.h"
+#include "cpu/MOS6502.h"
+#include "mmio/Mmio.h"
+
+/// Differential fuzzing of CPU execution engines.
+///
+/// Every input is turned into an initial machine state (registers, RAM and PRG ROM, with the input bytes
+/// used as the instruction stream) that is loaded into the reference interpreter and into every candidate
+/// engine. All of them are stepped in lockstep and the first divergence in registers, cycle count or RAM is
+/// reported. The file can be linked with libFuzzer (define EMUNES_LIBFUZZER) or run offline with its own
+/// main, which either replays the files passed as arguments or generates random inputs.
+
+/// Size of the CPU RAM
+static constexpr size_t RAM_SIZE = 0x0800;
+
+/// Size of the PRG ROM loaded in the cartridge (mirrored at $8000 and $C000)
+static constexpr size_t PRG_ROM_SIZE = 0x4000;
+
+/// Number of bytes at the beginning of the input that are used for the registers
+static constexpr size_t HEADER_SIZE = 6;
+
+/// Where the instruction stream is copied when it runs from RAM
+static constexpr uint16_t RAM_PROGRAM_START = 0x0200;
+
+/// Where the instruction stream is copied when it runs from ROM
+static constexpr uint16_t ROM_PROGRAM_START = 0x8000;
+
+/// Maximum number of instructions executed per input
+static constexpr size_t MAX_INSTRUCTIONS = 2000;
+
+/// @brief Initial machine state built from a fuzzer input
+struct FuzzCase
+{
+    cpu::Registers registers;
+    std::vector<uint8_t> ram;
+    std::vector<uint8_t> prg_rom;
+};
+
+/// @brief A CPU execution engine that can be compared against the reference interpreter
+class Engine
+{
+  public:
+    virtual ~Engine() = default;
+
+    /// @brief Name used in the divergence reports
+    virtual std::string name() const = 0;
+
+    /// @brief Load the initial machine state
+    virtual void load(const FuzzCase &fuzz_case) = 0;
+
+    /// @brief Execute one instruction, or a few of them if the engine groups them
+    /// @return False if the engine refuses to continue (e.g. the CPU is jammed)
+    virtual bool step() = 0;
+
+    /// @brief Return the number of instructions executed so far
+    virtual uint64_t get_instructions() = 0;
+
+    /// @brief Return the current registers
+    virtual cpu::Registers get_registers() = 0;
+
+    /// @brief Return the number of cycles executed so far
+    virtual uint64_t get_cycles() = 0;
+
+    /// @brief Read memory without side effects
+    virtual uint8_t peek(const uint16_t address) = 0;
+};
+
+/// @brief The MOS6502 interpreter running on the NES memory map
+/// @tparam BusType The bus type the CPU is built for. The memory map is the same, but the CPU either calls it
+/// directly (mmio::Mmio) or through the abstract interface (mmio::Bus, via mmio::BusAdapter)
+template <typename BusType> class InterpreterEngine : public Engine
+{
+  public:
+    InterpreterEngine(const std::string &name, const bool instruction_fusion = false)
+        : engine_name(name), instruction_fusion(instruction_fusion)
+    {
+    }
+
+    std::string name() const override
+    {
+        return engine_name;
+    }
+
+    void load(const FuzzCase &fuzz_case) override
+    {
+        mmio = std::make_shared<mmio::Mmio>();
+        mmio->set_prg_rom(fuzz_case.prg_rom);
+        for (size_t address = 0; address < RAM_SIZE; address++)
+        {
+            mmio->set(address, fuzz_case.ram[address]);
+        }
+        if constexpr (std::is_same_v<BusType, mmio::Mmio>)
+        {
+            cpu = cpu::MOS6502<BusType>(mmio.get());
+        }
+        else
+        {
+            adapter = std::make_unique<mmio::BusAdapter<mmio::Mmio>>(mmio.get());
+            cpu = cpu::MOS6502<BusType>(adapter.get());
+        }
+        cpu.set_registers(fuzz_case.registers);
+        cpu.set_instruction_fusion(instruction_fusion);
+    }
+
+    bool step() override
+    {
+        return cpu.step();
+    }
+
+    uint64_t get_instructions() override
+    {
+        return cpu.get_instructions();
+    }
+
+    cpu::Registers get_registers() override
+    {
+        return cpu.get_registers();
+    }
+
+    uint64_t get_cycles() override
+    {
+        return cpu.get_cycles();
+    }
+
+    uint8_t peek(const uint16_t address) override
+    {
+        return mmio->peek(address);
+    }
+
+  private:
+    std::string engine_name;
+    bool instruction_fusion;
+    std::shared_ptr<mmio::Mmio> mmio;
+    std::unique_ptr<mmio::BusAdapter<mmio::Mmio>> adapter;
+    cpu::MOS6502<BusType> cpu;
+};
+
+/// @brief The reference is the interpreter built for the NES memory map
+using ReferenceEngine = InterpreterEngine<mmio::Mmio>;
+
+/// @brief Return the engines that are compared against the reference
+static std::vector<std::unique_ptr<Engine>> make_candidate_engines()
+{
+    std::vector<std::unique_ptr<Engine>> engines;
+    engines.push_back(std::make_unique<InterpreterEngine<mmio::Bus>>("MOS6502 interpreter (dynamic bus)"));
+    engines.push_back(std::make_unique<InterpreterEngine<mmio::Mmio>>("MOS6502 interpreter (fused)", true));
+    return engines;
+}
+
+/// @brief Small and fast generator used to fill the memory that the input does not cover
+static uint64_t splitmix64(uint64_t &state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/// @brief Return a random byte that is not one of the opcodes that jam the CPU, so that the random
+/// memory around the input does not cut the runs short
+static uint8_t random_filler(uint64_t &state)
+{
+    uint8_t byte = splitmix64(state);
+    // All the opcodes ending in 2 jam the CPU, except 82, A2, C2 and E2
+    if ((byte & 0x0F) == 0x02 && byte != 0x82 && byte != 0xA2 && byte != 0xC2 && byte != 0xE2)
+    {
+        byte = 0xEA;
+    }
+    return byte;
+}
+
+/// @brief Build the initial machine state from a fuzzer input
+static FuzzCase make_fuzz_case(const uint8_t *data, const size_t size)
+{
+    // Seed the generator with a hash of the complete input (FNV-1a)
+    uint64_t seed = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        seed = (seed ^ data[i]) * 0x100000001B3ULL;
+    }
+
+    FuzzCase fuzz_case;
+    fuzz_case.ram.resize(RAM_SIZE);
+    fuzz_case.prg_rom.resize(PRG_ROM_SIZE);
+    for (auto &byte : fuzz_case.ram)
+    {
+        byte = random_filler(seed);
+    }
+    for (auto &byte : fuzz_case.prg_rom)
+    {
+        byte = random_filler(seed);
+    }
+
+    uint8_t header[HEADER_SIZE] = {};
+    std::memcpy(header, data, std::min(size, HEADER_SIZE));
+    const bool run_from_ram = header[5] & 0x1;
+    fuzz_case.registers.acc = header[0];
+    fuzz_case.registers.xr = header[1];
+    fuzz_case.registers.yr = header[2];
+    fuzz_case.registers.sr = header[3];
+    fuzz_case.registers.sp = header[4];
+    fuzz_case.registers.pc = run_from_ram ? RAM_PROGRAM_START : ROM_PROGRAM_START;
+
+    // The rest of the input is the instruction stream
+    if (size > HEADER_SIZE)
+    {
+        std::vector<uint8_t> &memory = run_from_ram ? fuzz_case.ram : fuzz_case.prg_rom;
+        size_t offset = run_from_ram ? RAM_PROGRAM_START : ROM_PROGRAM_START - 0x8000;
+        size_t length = std::min(size - HEADER_SIZE, memory.size() - offset);
+        std::memcpy(memory.data() + offset, data + HEADER_SIZE, length);
+    }
+
+    return fuzz_case;
+}
+
+/// @brief Print the registers and cycles of an engine
+static void print_engine_state(Engine &engine)
+{
+    cpu::Registers registers = engine.get_registers();
+    std::cerr << "  " << engine.name() << ": PC:" << common::print_hex(registers.pc, sizeof(registers.pc))
+              << " A:" << common::print_hex(registers.acc, sizeof(registers.acc))
+              << " X:" << common::print_hex(registers.xr, sizeof(registers.xr))
+              << " Y:" << common::print_hex(registers.yr, sizeof(registers.yr))
+              << " P:" << common::print_hex(registers.sr, sizeof(registers.sr))
+              << " SP:" << common::print_hex(registers.sp, sizeof(registers.sp)) << " CYC:" << engine.get_cycles()
+              << std::endl;
+}
+
+/// @brief Compare the candidate against the reference after a step
+/// @return An empty string if they match, or a description of the first difference
+static std::string compare(Engine &reference, Engine &candidate, const bool reference_ok, const bool candidate_ok)
+{
+    if (reference_ok != candidate_ok)
+    {
+        return "step result";
+    }
+
+    cpu::Registers ref = reference.get_registers();
+    cpu::Registers out = candidate.get_registers();
+    if (ref.pc != out.pc || ref.acc != out.acc || ref.xr != out.xr || ref.yr != out.yr || ref.sr != out.sr ||
+        ref.sp != out.sp)
+    {
+        return "registers";
+    }
+    if (reference.get_cycles() != candidate.get_cycles())
+    {
+        return "cycle count";
+    }
+    if (reference.get_instructions() != candidate.get_instructions())
+    {
+        return "instruction count";
+    }
+    for (size_t address = 0; address < RAM_SIZE; address++)
+    {
+        if (reference.peek(address) != candidate.peek(address))
+        {
+            return "RAM at $" + common::print_hex(address, sizeof(uint16_t)) + " (" +
+                   common::print_hex(reference.peek(address), sizeof(uint8_t)) + " vs " +
+                   common::print_hex(candidate.peek(address), sizeof(uint8_t)) + ")";
+        }
+    }
+
+    return "";
+}
+
+/// @brief Run an input through the reference and all the candidates
+/// @return True if no divergence was found
+static bool run_fuzz_case(const uint8_t *data, const size_t size)
+{
+    const FuzzCase fuzz_case = make_fuzz_case(data, size);
+
+    // Every candidate runs against its own reference, as a candidate step can cover several instructions
+    std::vector<std::unique_ptr<Engine>> candidates = make_candidate_engines();
+    for (auto &candidate : candidates)
+    {
+        ReferenceEngine reference("MOS6502 interpreter");
+        reference.load(fuzz_case);
+        candidate->load(fuzz_case);
+
+        while (candidate->get_instructions() < MAX_INSTRUCTIONS)
+        {
+            const uint64_t instruction = candidate->get_instructions();
+            const uint16_t pc = candidate->get_registers().pc;
+            const uint8_t opcode = candidate->peek(pc);
+            const bool candidate_ok = candidate->step();
+
+            // Bring the reference to the same instruction
+            bool reference_ok = true;
+            do
+            {
+                reference_ok = reference.step();
+            } while (reference_ok && reference.get_instructions() < candidate->get_instructions());
+
+            std::string difference = compare(reference, *candidate, reference_ok, candidate_ok);
+            if (!difference.empty())
+            {
+                std::cerr << "Divergence in " << difference << " after instruction " << instruction << " at PC "
+                          << common::print_hex(pc, sizeof(pc)) << " (opcode "
+                          << common::print_hex(opcode, sizeof(opcode)) << ")" << std::endl;
+                print_engine_state(reference);
+                print_engine_state(*candidate);
+                return false;
+            }
+            if (!reference_ok)
+            {
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    common::mute();
+    if (!run_fuzz_case(data, size))
+    {
+        std::abort();
+    }
+    return 0;
+}
+
+#ifndef EMUNES_LIBFUZZER
+int main(int argc, char *argv[])
+{
+    common::mute();
+
+    // Replay the provided inputs
+    if (argc > 1 && std::string(argv[1]).rfind("-", 0) != 0)
+    {
+        int failures = 0;
+        for (int i = 1; i < argc; i++)
+        {
+            std::ifstream input_file(argv[i], std::ios_base::in | std::ios_base::binary);
+            std::vector<uint8_t> input((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>());
+            if (!run_fuzz_case(input.data(), input.size()))
+            {
+                std::cerr << "Input " << argv[i] << " diverges" << std::endl;
+                failures++;
+            }
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    // Generate random inputs: emunesfuzz [-runs=N] [-seed=S]
+    size_t runs = 100;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument.rfind("-runs=", 0) == 0)
+        {
+            runs = std::stoull(argument.substr(6));
+        }
+        else if (argument.rfind("-seed=", 0) == 0)
+        {
+            seed = std::stoull(argument.substr(6));
+        }
+    }
+
+    std::vector<uint8_t> input;
+    for (size_t run = 0; run < runs; run++)
+    {
+        input.resize(HEADER_SIZE + splitmix64(seed) % 512);
+        for (auto &byte : input)
+        {
+            byte = random_filler(seed);
+        }
+        if (!run_fuzz_case(input.data(), input.size()))
+        {
+            std::ofstream output_file("fuzz-divergence.bin", std::ios_base::out | std::ios_base::binary);
+            output_file.write(reinterpret_cast<const char *>(input.data()), input.size());
+            std::cerr << "Input written to fuzz-divergence.bin" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "No divergence in " << runs << " runs" << std::endl;
+    return 0;
+}
+#endif
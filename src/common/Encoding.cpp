@@ -0,0 +1,49 @@
+#include "Encoding.h"
+
+namespace common
+{
+
+void put_le(uint8_t *data, const uint64_t value, const size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = value >> (8 * i);
+    }
+}
+
+uint64_t get_le(const uint8_t *data, const size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        value |= (uint64_t)data[i] << (8 * i);
+    }
+    return value;
+}
+
+void put_varint(std::vector<uint8_t> &data, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        data.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+bool get_varint(const uint8_t *&data, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (size_t shift = 0; shift < 64 && data < end; shift += 7)
+    {
+        const uint8_t byte = *data++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace common
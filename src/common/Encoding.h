@@ -0,0 +1,37 @@
+#ifndef COMMON_ENCODING_H
+#define COMMON_ENCODING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace common
+{
+
+/// @brief Store a value in little endian
+/// @param data Where the value is stored
+/// @param value The value
+/// @param size Number of bytes stored
+void put_le(uint8_t *data, const uint64_t value, const size_t size);
+
+/// @brief Load a value stored in little endian
+/// @param data Where the value is stored
+/// @param size Number of bytes of the value
+uint64_t get_le(const uint8_t *data, const size_t size);
+
+/// @brief Append an unsigned value in as many bytes as needed, 7 bits per byte with the top bit set in all but the
+/// last one
+/// @param data Where the value is appended
+/// @param value The value
+void put_varint(std::vector<uint8_t> &data, uint64_t value);
+
+/// @brief Load a value stored by put_varint, advancing past it
+/// @param data Where the value is stored, moved to the next value
+/// @param end End of the stored values
+/// @param value Where the value is loaded
+/// @return True if the value could be loaded, false if it goes past the end
+bool get_varint(const uint8_t *&data, const uint8_t *end, uint64_t &value);
+
+} // namespace common
+
+#endif
@@ -9,9 +9,6 @@
 namespace common
 {
 
-/// Flag indicating if the console log should be muted
-static bool muted = false;
-
 void Log(const LogLevel level, const std::string &message)
 {
     if (muted)
@@ -69,18 +66,16 @@ void LogFile::dump()
         return;
     }
 
-    for (const auto &line : this->records)
-    {
-        output_file << line << std::endl;
-    }
+    output_file.write(this->records.data(), this->records.size());
 
     output_file.close();
     Log(LogLevel::INFO, "Log written to file " + this->filename);
 }
 
-void LogFile::add_record(const std::string &record)
+void LogFile::add_record(const std::string_view record)
 {
-    this->records.push_back(record);
+    this->records.append(record);
+    this->records.push_back('\n');
 }
 
 } // namespace common
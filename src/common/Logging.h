@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace common
@@ -26,12 +27,21 @@ void Log(const LogLevel level, const std::string &message);
 /// of size * 2 characters
 std::string print_hex(const uint16_t value, const size_t size);
 
+/// @brief Flag indicating if the console log should be muted. Use mute, unmute and is_muted to access it
+inline bool muted = false;
+
 /// @brief Mute the console log
 void mute();
 
 /// @brief Unmute the console log
 void unmute();
 
+/// @brief Return true if the console log is muted. Hot paths check this before building log messages
+inline bool is_muted()
+{
+    return muted;
+}
+
 /// @brief Class representing the official NES log file
 class LogFile
 {
@@ -39,8 +49,9 @@ class LogFile
     /// @brief Decide the filename to output
     void set_filename(const std::string &filename);
 
-    /// @brief Add a new record (a line) to the log file
-    void add_record(const std::string &record);
+    /// @brief Add a new record (a line) to the log file. Records are appended to a single buffer, so adding one
+    /// does not allocate anything most of the time
+    void add_record(const std::string_view record);
 
     /// @brief Dump all the provided records to file
     void dump();
@@ -49,8 +60,8 @@ class LogFile
     /// @brief The output log filename that has been selected
     std::string filename;
 
-    /// @brief The log records that have been added
-    std::vector<std::string> records;
+    /// @brief The log records that have been added, each one followed by a line break
+    std::string records;
 };
 
 } // namespace common
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Logging.h"
+#include "MappedFile.h"
+
+namespace common
+{
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::filesystem::path &filename)
+{
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        Log(LogLevel::ERROR, "File " + filename.string() + " could not be opened: " + std::strerror(errno));
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) < 0)
+    {
+        Log(LogLevel::ERROR, "File " + filename.string() + " could not be read: " + std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    if (status.st_size > 0)
+    {
+        void *address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            Log(LogLevel::ERROR, "File " + filename.string() + " could not be mapped: " + std::strerror(errno));
+            ::close(fd);
+            return false;
+        }
+        // The file is read from start to end
+        madvise(address, status.st_size, MADV_SEQUENTIAL);
+        mapping = static_cast<uint8_t *>(address);
+        mapping_size = status.st_size;
+    }
+    // The mapping stays valid after closing the file
+    ::close(fd);
+    return true;
+}
+
+bool MappedFile::open_writable(const std::filesystem::path &filename, const size_t size)
+{
+    close();
+    int fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        Log(LogLevel::ERROR, "File " + filename.string() + " could not be opened: " + std::strerror(errno));
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) < 0 || (static_cast<size_t>(status.st_size) < size && ftruncate(fd, size) < 0))
+    {
+        Log(LogLevel::ERROR, "File " + filename.string() + " could not be resized: " + std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    const size_t file_size = std::max<size_t>(status.st_size, size);
+    if (file_size > 0)
+    {
+        void *address = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            Log(LogLevel::ERROR, "File " + filename.string() + " could not be mapped: " + std::strerror(errno));
+            ::close(fd);
+            return false;
+        }
+        mapping = static_cast<uint8_t *>(address);
+        mapping_size = file_size;
+        writable = true;
+    }
+    ::close(fd);
+    return true;
+}
+
+bool MappedFile::flush(const bool wait)
+{
+    if (!mapping || !writable)
+    {
+        return true;
+    }
+    if (msync(mapping, mapping_size, wait ? MS_SYNC : MS_ASYNC) < 0)
+    {
+        Log(LogLevel::ERROR, std::string("Mapped file could not be written: ") + std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapping)
+    {
+        munmap(mapping, mapping_size);
+    }
+    mapping = nullptr;
+    mapping_size = 0;
+    writable = false;
+}
+
+const uint8_t *MappedFile::data() const
+{
+    return mapping;
+}
+
+uint8_t *MappedFile::get_writable_data()
+{
+    return writable ? mapping : nullptr;
+}
+
+size_t MappedFile::size() const
+{
+    return mapping_size;
+}
+
+std::string_view MappedFile::get_text() const
+{
+    return std::string_view(reinterpret_cast<const char *>(mapping), mapping_size);
+}
+
+} // namespace common
@@ -0,0 +1,69 @@
+#ifndef COMMON_MAPPED_FILE_H
+#define COMMON_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace common
+{
+
+/// @brief A whole file mapped in memory, so that it can be read without copying it, however large it is. It can also
+/// be mapped for writing, in which case the changes reach the file without any call, written back by the kernel
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+
+    /// @brief Unmap the file
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /// @brief Map a whole file for reading, unmapping the previous one if any
+    /// @return True if the operation was successful
+    bool open(const std::filesystem::path &filename);
+
+    /// @brief Map a whole file for reading and writing, creating it or extending it with zeros to the provided size
+    /// if it is shorter, and unmapping the previous one if any
+    /// @param filename The file
+    /// @param size Minimum size of the file
+    /// @return True if the operation was successful
+    bool open_writable(const std::filesystem::path &filename, const size_t size);
+
+    /// @brief Ask the kernel to write the changes back to the file
+    /// @param wait If true, wait until they are written, otherwise they are written in the background
+    /// @return True if the operation was successful
+    bool flush(const bool wait);
+
+    /// @brief Unmap the file
+    void close();
+
+    /// @brief Return the contents of the file
+    const uint8_t *data() const;
+
+    /// @brief Return the contents of the file if it was mapped for writing, null otherwise
+    uint8_t *get_writable_data();
+
+    /// @brief Return the size of the file
+    size_t size() const;
+
+    /// @brief Return the contents of the file as text
+    std::string_view get_text() const;
+
+  private:
+    /// @brief The mapping, null if there is none. Empty files are not mapped
+    uint8_t *mapping = nullptr;
+
+    /// @brief The size of the file
+    size_t mapping_size = 0;
+
+    /// @brief True if the mapping can be written
+    bool writable = false;
+};
+
+} // namespace common
+
+#endif
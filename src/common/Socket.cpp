@@ -0,0 +1,132 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Logging.h"
+#include "Socket.h"
+
+namespace common
+{
+
+/// Set by the handler of SIGINT and SIGTERM
+static volatile std::sig_atomic_t stop_requested = 0;
+
+/// Handler of SIGINT and SIGTERM
+static void request_stop(int)
+{
+    stop_requested = 1;
+}
+
+void handle_stop_signals()
+{
+    struct sigaction action = {};
+    action.sa_handler = request_stop;
+    sigemptyset(&action.sa_mask);
+    // Without SA_RESTART, so that accept and read return EINTR and the server sees the request
+    action.sa_flags = 0;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+}
+
+bool is_stop_requested()
+{
+    return stop_requested != 0;
+}
+
+int listen_unix_socket(const std::string &path, const int backlog)
+{
+    sockaddr_un socket_address = {};
+    socket_address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(socket_address.sun_path))
+    {
+        Log(LogLevel::ERROR, "Socket path too long: " + path);
+        return -1;
+    }
+    std::strcpy(socket_address.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        Log(LogLevel::ERROR, "Could not create socket: " + std::string(std::strerror(errno)));
+        return -1;
+    }
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr *>(&socket_address), sizeof(socket_address)) < 0 ||
+        listen(fd, backlog) < 0)
+    {
+        Log(LogLevel::ERROR, "Could not listen on " + path + ": " + std::string(std::strerror(errno)));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connect_unix_socket(const std::string &path)
+{
+    sockaddr_un socket_address = {};
+    socket_address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(socket_address.sun_path))
+    {
+        Log(LogLevel::ERROR, "Socket path too long: " + path);
+        return -1;
+    }
+    std::strcpy(socket_address.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        Log(LogLevel::ERROR, "Could not create socket: " + std::string(std::strerror(errno)));
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr *>(&socket_address), sizeof(socket_address)) < 0)
+    {
+        Log(LogLevel::ERROR, "Could not connect to " + path + ": " + std::string(std::strerror(errno)));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool read_all(const int fd, uint8_t *data, size_t size)
+{
+    while (size > 0 && !is_stop_requested())
+    {
+        ssize_t result = read(fd, data, size);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            return false;
+        }
+        data += result;
+        size -= result;
+    }
+    return size == 0;
+}
+
+bool write_all(const int fd, const uint8_t *data, size_t size)
+{
+    while (size > 0 && !is_stop_requested())
+    {
+        // A peer that has gone away fails the write instead of raising SIGPIPE, which would end the process
+        ssize_t result = send(fd, data, size, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            return false;
+        }
+        data += result;
+        size -= result;
+    }
+    return size == 0;
+}
+
+} // namespace common
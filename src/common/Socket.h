@@ -0,0 +1,40 @@
+#ifndef COMMON_SOCKET_H
+#define COMMON_SOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace common
+{
+
+/// @brief Create a Unix domain stream socket listening on the provided path, replacing any file there
+/// @param path Path of the socket
+/// @param backlog Number of pending connections the socket keeps
+/// @return The file descriptor of the socket, or -1 if it could not be created
+int listen_unix_socket(const std::string &path, const int backlog);
+
+/// @brief Connect to a Unix domain stream socket listening on the provided path
+/// @param path Path of the socket
+/// @return The file descriptor of the connection, or -1 if it could not be established
+int connect_unix_socket(const std::string &path);
+
+/// @brief Make SIGINT and SIGTERM request a stop instead of ending the process, so that a server can close its
+/// socket and remove its file. Blocking socket calls interrupted by them fail rather than being restarted
+void handle_stop_signals();
+
+/// @brief Return true once SIGINT or SIGTERM has been received, after handle_stop_signals
+bool is_stop_requested();
+
+/// @brief Read exactly size bytes
+/// @return True if all of them could be read, false on end of file, on error or once a stop is requested
+bool read_all(const int fd, uint8_t *data, size_t size);
+
+/// @brief Write exactly size bytes to a socket
+/// @return True if all of them could be written, false if the peer has closed the connection, on error or once a
+/// stop is requested
+bool write_all(const int fd, const uint8_t *data, size_t size);
+
+} // namespace common
+
+#endif
@@ -0,0 +1,94 @@
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+namespace common
+{
+
+ThreadPool::ThreadPool(size_t num_threads)
+{
+    if (num_threads == 0)
+    {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // The calling thread is one of them
+    for (size_t i = 1; i < num_threads; i++)
+    {
+        threads.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_condition.notify_all();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallel_for(const size_t count, const std::function<void(size_t)> &task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->count = count;
+        next_iteration = 0;
+        active_workers = threads.size();
+        generation++;
+    }
+    start_condition.notify_all();
+
+    run_iterations();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_condition.wait(lock, [this] { return active_workers == 0; });
+    this->task = nullptr;
+}
+
+size_t ThreadPool::size() const
+{
+    return threads.size() + 1;
+}
+
+void ThreadPool::worker_loop()
+{
+    uint64_t last_generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_condition.wait(lock, [&] { return stopping || generation != last_generation; });
+            if (stopping)
+            {
+                return;
+            }
+            last_generation = generation;
+        }
+
+        run_iterations();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        active_workers--;
+        if (active_workers == 0)
+        {
+            done_condition.notify_one();
+        }
+    }
+}
+
+void ThreadPool::run_iterations()
+{
+    size_t iteration;
+    while ((iteration = next_iteration.fetch_add(1)) < count)
+    {
+        (*task)(iteration);
+    }
+}
+
+} // namespace common
@@ -0,0 +1,80 @@
+#ifndef COMMON_THREAD_POOL_H
+#define COMMON_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace common
+{
+
+/// @brief Fixed set of worker threads that run the iterations of a loop in parallel. The threads are
+/// created once and reused, so that short parallel loops (e.g. one frame of many instances) do not pay
+/// for thread creation
+class ThreadPool
+{
+  public:
+    /// @brief Constructor
+    /// @param num_threads Number of threads running the loops, including the calling thread. If zero, the
+    /// number of hardware threads is used
+    ThreadPool(size_t num_threads = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /// @brief Run task(i) for every i in [0, count), distributing the iterations between the threads.
+    /// The calling thread also runs iterations, and the function returns once all of them are done
+    /// @param count Number of iterations
+    /// @param task The body of the loop
+    void parallel_for(const size_t count, const std::function<void(size_t)> &task);
+
+    /// @brief Return the number of threads running the loops, including the calling thread
+    size_t size() const;
+
+  private:
+    /// @brief The worker threads
+    std::vector<std::thread> threads;
+
+    /// @brief Protects the loop description below
+    std::mutex mutex;
+
+    /// @brief Signals the workers that a new loop has started or that they have to stop
+    std::condition_variable start_condition;
+
+    /// @brief Signals the calling thread that all the workers are done with the loop
+    std::condition_variable done_condition;
+
+    /// @brief Body of the current loop
+    const std::function<void(size_t)> *task = nullptr;
+
+    /// @brief Number of iterations of the current loop
+    size_t count = 0;
+
+    /// @brief Next iteration to be run
+    std::atomic<size_t> next_iteration{0};
+
+    /// @brief Number of workers still running the current loop
+    size_t active_workers = 0;
+
+    /// @brief Incremented for every loop, so that the workers can tell a new loop from a spurious wake up
+    uint64_t generation = 0;
+
+    /// @brief True when the workers have to stop
+    bool stopping = false;
+
+    /// @brief Main function of the workers
+    void worker_loop();
+
+    /// @brief Run iterations of the current loop until there are none left
+    void run_iterations();
+};
+
+} // namespace common
+
+#endif
@@ -2,6 +2,7 @@
 #define CPU_ADDRESSING_MODE_H
 
 #include <cstdint>
+#include <string>
 
 namespace cpu
 {
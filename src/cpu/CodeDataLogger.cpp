@@ -0,0 +1,84 @@
+#include "CodeDataLogger.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "common/Logging.h"
+
+namespace cpu
+{
+
+CodeDataLogger::CodeDataLogger(const size_t prg_rom_size, const size_t chr_rom_size)
+    : prg_log(prg_rom_size, 0), chr_log(chr_rom_size, 0)
+{
+}
+
+uint8_t CodeDataLogger::get(const size_t offset) const
+{
+    return prg_log.at(offset);
+}
+
+size_t CodeDataLogger::get_code_size() const
+{
+    return std::count_if(prg_log.begin(), prg_log.end(), [](const uint8_t entry) { return entry & CDL_CODE; });
+}
+
+size_t CodeDataLogger::get_data_size() const
+{
+    return std::count_if(prg_log.begin(), prg_log.end(), [](const uint8_t entry) { return entry & CDL_DATA; });
+}
+
+bool CodeDataLogger::load(const std::filesystem::path &filename)
+{
+    std::ifstream file(filename, std::ios_base::in | std::ios_base::binary);
+    if (!file.is_open())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be opened");
+        return false;
+    }
+
+    std::vector<uint8_t> contents(prg_log.size() + chr_log.size());
+    file.read(reinterpret_cast<char *>(contents.data()), contents.size());
+    if (!file || file.peek() != std::ifstream::traits_type::eof())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " does not match the size of the ROM");
+        return false;
+    }
+
+    for (size_t i = 0; i < prg_log.size(); i++)
+    {
+        prg_log[i] |= contents[i];
+    }
+    for (size_t i = 0; i < chr_log.size(); i++)
+    {
+        chr_log[i] |= contents[prg_log.size() + i];
+    }
+    return true;
+}
+
+bool CodeDataLogger::save(const std::filesystem::path &filename) const
+{
+    std::ofstream file(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!file.is_open())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be opened");
+        return false;
+    }
+
+    // The opcode bit is not part of the FCEUX format
+    std::vector<uint8_t> contents(prg_log);
+    for (auto &entry : contents)
+    {
+        entry &= ~CDL_OPCODE;
+    }
+    contents.insert(contents.end(), chr_log.begin(), chr_log.end());
+    file.write(reinterpret_cast<const char *>(contents.data()), contents.size());
+    if (!file)
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be written");
+        return false;
+    }
+    return true;
+}
+
+} // namespace cpu
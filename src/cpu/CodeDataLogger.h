@@ -0,0 +1,79 @@
+#ifndef CPU_CODE_DATA_LOGGER_H
+#define CPU_CODE_DATA_LOGGER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace cpu
+{
+
+/// @brief Bits of a code/data log entry, one byte per PRG ROM byte. The low seven bits follow the FCEUX CDL
+/// format, bit 7 (unused by FCEUX) marks opcodes and is left out of the saved files
+enum CodeDataFlag : uint8_t
+{
+    CDL_CODE = 0x01,          // Executed, as opcode or operand
+    CDL_DATA = 0x02,          // Read as data
+    CDL_BANK_MASK = 0x0C,     // 8 KB bank of the CPU address space it was mapped to when last accessed
+    CDL_INDIRECT_CODE = 0x10, // Target of an indirect jump
+    CDL_INDIRECT_DATA = 0x20, // Read through an indirect addressing mode
+    CDL_PCM_DATA = 0x40,      // Read as DPCM sample data
+    CDL_OPCODE = 0x80         // First byte of an executed instruction
+};
+
+/// @brief Records how every byte of the PRG ROM is accessed by the CPU (the code/data log), which tells apart
+/// code and data for disassembly and shows which regions are actually executed.
+/// The CPU only calls it when built with EMUNES_CDL, so the hooks cost nothing otherwise
+class CodeDataLogger
+{
+  public:
+    /// @brief Constructor
+    /// @param prg_rom_size Size of the PRG ROM, mirrored from $8000
+    /// @param chr_rom_size Size of the CHR ROM, only used to lay out the saved file
+    CodeDataLogger(const size_t prg_rom_size, const size_t chr_rom_size);
+
+    /// @brief Mark an access to the provided address, ignored if it is not in the PRG ROM
+    /// @param address The CPU address
+    /// @param flags The CodeDataFlag bits of the access
+    inline void mark(const uint16_t address, const uint8_t flags)
+    {
+        if (address >= PRG_ROM_START && !prg_log.empty())
+        {
+            uint8_t &entry = prg_log[(address - PRG_ROM_START) % prg_log.size()];
+            entry = (entry & ~CDL_BANK_MASK) | flags | (((address >> 13) & 0x3) << 2);
+        }
+    }
+
+    /// @brief Return the log entry of a PRG ROM byte
+    /// @param offset Offset in the PRG ROM
+    uint8_t get(const size_t offset) const;
+
+    /// @brief Return the number of PRG ROM bytes that have been executed
+    size_t get_code_size() const;
+
+    /// @brief Return the number of PRG ROM bytes that have been read as data
+    size_t get_data_size() const;
+
+    /// @brief Merge a CDL file saved before, so that the coverage accumulates across runs
+    /// @return True if the operation was successful
+    bool load(const std::filesystem::path &filename);
+
+    /// @brief Save the log in the FCEUX CDL format: the PRG ROM entries followed by the CHR ROM entries
+    /// @return True if the operation was successful
+    bool save(const std::filesystem::path &filename) const;
+
+  private:
+    /// @brief First address of the PRG ROM
+    static constexpr uint16_t PRG_ROM_START = 0x8000;
+
+    /// @brief One entry per PRG ROM byte
+    std::vector<uint8_t> prg_log;
+
+    /// @brief One entry per CHR ROM byte. There is no PPU yet, so they are always zero
+    std::vector<uint8_t> chr_log;
+};
+
+} // namespace cpu
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef CPU_FUSION_ID_H
+#define CPU_FUSION_ID_H
+
+#include <cstdint>
+
+namespace cpu
+{
+
+/// @brief Common pairs of instructions that the CPU can execute as a single superinstruction.
+/// Each value is attached to the opcode that starts the pair. The second instruction is only fused
+/// if its opcode is the expected one once it is fetched, otherwise it is executed as usual
+enum class FusionId : uint8_t
+{
+    NONE,    // The opcode does not start a fused pair
+    DEX_BNE, // DEX followed by BNE (loop counter)
+    DEY_BNE, // DEY followed by BNE (loop counter)
+    INX_BNE, // INX followed by BNE (loop counter)
+    INY_BNE, // INY followed by BNE (loop counter)
+    CMP_BXX, // CMP immediate followed by BNE or BEQ
+    LDA_STA, // LDA (immediate, zero page or absolute) followed by STA zero page or absolute
+    INC_BNE, // INC zero page followed by BNE
+    CLC_ADC  // CLC followed by ADC (immediate, zero page or absolute)
+};
+
+} // namespace cpu
+
+#endif
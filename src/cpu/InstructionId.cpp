@@ -87,6 +87,34 @@ static std::map<InstructionId, std::pair<std::string, std::string>> instruction_
     {InstructionId::BRK, {"BRK", "Force an interrupt"}},
     {InstructionId::NOP, {"NOP", "No operation"}},
     {InstructionId::RTI, {"RTI", "Return from interrupt"}},
+
+    // Unofficial combined operations
+    {InstructionId::LAX, {"LAX", "Load accumulator and X register"}},
+    {InstructionId::SAX, {"SAX", "Store accumulator AND X register"}},
+    {InstructionId::DCP, {"DCP", "Decrement a memory location and compare accumulator"}},
+    {InstructionId::ISB, {"ISB", "Increment a memory location and subtract with carry"}},
+    {InstructionId::SLO, {"SLO", "Arithmetic shift left a memory location and logical inclusive OR"}},
+    {InstructionId::RLA, {"RLA", "Rotate left a memory location and logical AND"}},
+    {InstructionId::SRE, {"SRE", "Logical shift right a memory location and exclusive OR"}},
+    {InstructionId::RRA, {"RRA", "Rotate right a memory location and add with carry"}},
+
+    // Unofficial immediate operations
+    {InstructionId::ANC, {"ANC", "Logical AND and copy the negative flag to the carry flag"}},
+    {InstructionId::ALR, {"ALR", "Logical AND and logical shift right the accumulator"}},
+    {InstructionId::ARR, {"ARR", "Logical AND and rotate right the accumulator"}},
+    {InstructionId::AXS, {"AXS", "Accumulator AND X register minus immediate into X register"}},
+    {InstructionId::XAA, {"XAA", "Transfer X register to accumulator and logical AND"}},
+    {InstructionId::LXA, {"LXA", "Logical AND and load accumulator and X register"}},
+
+    // Unofficial operations with unstable addressing
+    {InstructionId::LAS, {"LAS", "Logical AND with stack pointer into accumulator, X register and stack pointer"}},
+    {InstructionId::AHX, {"AHX", "Store accumulator AND X register AND high byte of the address"}},
+    {InstructionId::SHX, {"SHX", "Store X register AND high byte of the address"}},
+    {InstructionId::SHY, {"SHY", "Store Y register AND high byte of the address"}},
+    {InstructionId::TAS, {"TAS", "Transfer accumulator AND X register to stack pointer and store it"}},
+
+    // Unofficial system functions
+    {InstructionId::KIL, {"KIL", "Jam the processor"}},
 };
 
 std::string print_instruction_id(const InstructionId instruction_id)
@@ -86,7 +86,35 @@ enum class InstructionId : uint8_t
     // System functions
     BRK, // Force an interrupt
     NOP, // No operation
-    RTI  // Return from interrupt
+    RTI, // Return from interrupt
+
+    // Unofficial combined operations
+    LAX, // Load accumulator and X register
+    SAX, // Store accumulator AND X register
+    DCP, // Decrement a memory location and compare accumulator
+    ISB, // Increment a memory location and subtract with carry
+    SLO, // Arithmetic shift left a memory location and logical inclusive OR
+    RLA, // Rotate left a memory location and logical AND
+    SRE, // Logical shift right a memory location and exclusive OR
+    RRA, // Rotate right a memory location and add with carry
+
+    // Unofficial immediate operations
+    ANC, // Logical AND and copy the negative flag to the carry flag
+    ALR, // Logical AND and logical shift right the accumulator
+    ARR, // Logical AND and rotate right the accumulator
+    AXS, // Accumulator AND X register minus immediate into X register
+    XAA, // Transfer X register to accumulator and logical AND (unstable)
+    LXA, // Logical AND and load accumulator and X register (unstable)
+
+    // Unofficial operations with unstable addressing
+    LAS, // Logical AND with stack pointer into accumulator, X register and stack pointer
+    AHX, // Store accumulator AND X register AND high byte of the address
+    SHX, // Store X register AND high byte of the address
+    SHY, // Store Y register AND high byte of the address
+    TAS, // Transfer accumulator AND X register to stack pointer and store it AND high byte of the address
+
+    // Unofficial system functions
+    KIL  // Jam the processor
 };
 
 /// @brief Return a string with the mnemonic of the instruction
@@ -0,0 +1,543 @@
+#include "Lockstep.h"
+
+#include "OpcodeParser.h"
+#include "StatusRegisterBit.h"
+
+namespace cpu
+{
+
+/// Opcode table of the vector path
+static const OpcodeParser lockstep_opcode_parser;
+
+/// Masks of the flags in the status register
+static constexpr uint8_t CARRY_MASK = 1 << (uint8_t)StatusRegisterBit::CARRY;
+static constexpr uint8_t ZERO_MASK = 1 << (uint8_t)StatusRegisterBit::ZERO;
+static constexpr uint8_t INTERRUPT_MASK = 1 << (uint8_t)StatusRegisterBit::INTERRUPT;
+static constexpr uint8_t DECIMAL_MASK = 1 << (uint8_t)StatusRegisterBit::DECIMAL;
+static constexpr uint8_t OVERFLOW_MASK = 1 << (uint8_t)StatusRegisterBit::OVERFLOW;
+static constexpr uint8_t NEGATIVE_MASK = 1 << (uint8_t)StatusRegisterBit::NEGATIVE;
+
+/// Addresses of the CPU RAM and the PRG ROM, with the same mirroring as mmio::Mmio
+static constexpr uint16_t RAM_END = 0x2000;
+static constexpr uint16_t RAM_MASK = 0x07FF;
+static constexpr uint16_t PRG_ROM_START = 0x8000;
+
+LockstepBus::LockstepBus(uint8_t *ram, const size_t stride, const std::vector<uint8_t> *prg_rom)
+    : ram(ram), stride(stride), prg_rom(prg_rom)
+{
+}
+
+uint8_t LockstepBus::get(const uint16_t address)
+{
+    return peek(address);
+}
+
+uint8_t LockstepBus::peek(const uint16_t address) const
+{
+    if (address < RAM_END)
+    {
+        return ram[(address & RAM_MASK) * stride];
+    }
+    if (address >= PRG_ROM_START && !prg_rom->empty())
+    {
+        return (*prg_rom)[(address - PRG_ROM_START) % prg_rom->size()];
+    }
+    return 0;
+}
+
+void LockstepBus::set(const uint16_t address, const uint8_t value)
+{
+    if (address < RAM_END)
+    {
+        ram[(address & RAM_MASK) * stride] = value;
+    }
+}
+
+uint32_t LockstepBus::get_side_effect_reads() const
+{
+    // Only RAM and ROM are mapped
+    return 0;
+}
+
+template <size_t LANES> Lockstep<LANES>::Lockstep(const std::vector<uint8_t> &prg_rom) : prg_rom(prg_rom)
+{
+    static_assert(LANES == 8 || LANES == 16, "The lockstep engine runs 8 or 16 lanes");
+
+    for (size_t lane = 0; lane < LANES; lane++)
+    {
+        scalar_buses[lane] = LockstepBus(reinterpret_cast<uint8_t *>(ram.data()) + lane, LANES, &prg_rom);
+    }
+}
+
+template <size_t LANES>
+void Lockstep<LANES>::set_lane(const size_t lane, const Registers &registers, const uint8_t *lane_ram)
+{
+    pc[lane] = registers.pc;
+    acc[lane] = registers.acc;
+    xr[lane] = registers.xr;
+    yr[lane] = registers.yr;
+    sr[lane] = registers.sr;
+    sp[lane] = registers.sp;
+    cycles[lane] = 0;
+    jammed[lane] = false;
+    scalar_cpus[lane] = MOS6502<mmio::Bus>(&scalar_buses[lane]);
+    scalar_cpus[lane].set_idle_loop_skipping(false);
+    for (size_t address = 0; address < RAM_SIZE; address++)
+    {
+        ram[address][lane] = lane_ram[address];
+    }
+}
+
+template <size_t LANES>
+void Lockstep<LANES>::run_until(const uint64_t cycle)
+{
+    while (true)
+    {
+        // The lane that is furthest behind leads, and every other lane at the same pc follows it
+        size_t leader = LANES;
+        for (size_t lane = 0; lane < LANES; lane++)
+        {
+            if (!jammed[lane] && cycles[lane] < cycle && (leader == LANES || cycles[lane] < cycles[leader]))
+            {
+                leader = lane;
+            }
+        }
+        if (leader == LANES)
+        {
+            return;
+        }
+
+        std::array<bool, LANES> group = {};
+        size_t group_size = 0;
+        for (size_t lane = 0; lane < LANES; lane++)
+        {
+            group[lane] = !jammed[lane] && cycles[lane] < cycle && pc[lane] == pc[leader];
+            group_size += group[lane];
+        }
+
+        if (group_size > 1 && vector_step(pc[leader], group))
+        {
+            vector_instructions += group_size;
+            continue;
+        }
+
+        // Diverged lanes, or an instruction the vector path does not implement
+        for (size_t lane = 0; lane < LANES; lane++)
+        {
+            if (group[lane])
+            {
+                scalar_step(lane);
+            }
+        }
+    }
+}
+
+template <size_t LANES>
+Registers Lockstep<LANES>::get_registers(const size_t lane) const
+{
+    return Registers{pc[lane], acc[lane], xr[lane], yr[lane], sr[lane], sp[lane]};
+}
+
+template <size_t LANES>
+uint64_t Lockstep<LANES>::get_cycles(const size_t lane) const
+{
+    return cycles[lane];
+}
+
+template <size_t LANES>
+bool Lockstep<LANES>::is_jammed(const size_t lane) const
+{
+    return jammed[lane];
+}
+
+template <size_t LANES>
+uint8_t Lockstep<LANES>::peek(const size_t lane, const uint16_t address) const
+{
+    return scalar_buses[lane].peek(address);
+}
+
+template <size_t LANES>
+uint64_t Lockstep<LANES>::get_vector_instructions() const
+{
+    return vector_instructions;
+}
+
+template <size_t LANES>
+uint64_t Lockstep<LANES>::get_scalar_instructions() const
+{
+    return scalar_instructions;
+}
+
+template <size_t LANES>
+bool Lockstep<LANES>::vector_step(const uint16_t instruction_pc, const std::array<bool, LANES> &lanes)
+{
+    // The instruction bytes have to come from the ROM, which is the same for every lane
+    if (instruction_pc < PRG_ROM_START || instruction_pc > 0xFFFD || prg_rom.empty())
+    {
+        return false;
+    }
+    const Opcode opcode = lockstep_opcode_parser.parse(read_rom(instruction_pc));
+    const uint8_t byte_1 = read_rom(instruction_pc + 1);
+    const uint16_t absolute = ((uint16_t)read_rom(instruction_pc + 2) << 8) | byte_1;
+
+    // Resolve the operand. Only the addressing modes whose address does not depend on the lane are vectorised,
+    // and only RAM and ROM are accessed, as their reads have no side effects
+    bool in_ram = false;
+    uint16_t address = 0;
+    Vector operand = {};
+    switch (opcode.addressing_mode)
+    {
+    case AddressingMode::IMP:
+    case AddressingMode::ACC:
+    case AddressingMode::REL:
+        break;
+    case AddressingMode::IMM:
+        operand = operand + byte_1;
+        break;
+    case AddressingMode::ZP0:
+        in_ram = true;
+        address = byte_1;
+        break;
+    case AddressingMode::ABS:
+        if (opcode.instruction_id == InstructionId::JMP)
+        {
+            break;
+        }
+        if (absolute < RAM_END)
+        {
+            in_ram = true;
+            address = absolute & RAM_MASK;
+        }
+        else if (absolute >= PRG_ROM_START && opcode.memory_access == MemoryAccess::READ)
+        {
+            operand = operand + read_rom(absolute);
+        }
+        else
+        {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    if (in_ram)
+    {
+        operand = ram[address];
+    }
+
+    Vector mask = {};
+    for (size_t lane = 0; lane < LANES; lane++)
+    {
+        mask[lane] = lanes[lane] ? 0xFF : 0x00;
+    }
+
+    // New values of the registers and the memory, committed only for the lanes in the mask
+    Vector new_acc = acc, new_xr = xr, new_yr = yr, new_sr = sr, result = operand;
+    uint8_t flags = 0; // Flags written by the instruction
+    Vector flag_values = {};
+    std::array<uint16_t, LANES> new_pc;
+    new_pc.fill(instruction_pc + opcode.instruction_size);
+    std::array<uint8_t, LANES> extra_cycles = {};
+    bool write_back = false;
+
+    auto nz = [](const Vector value) {
+        return (Vector)((value & NEGATIVE_MASK) | ((Vector)(value == 0) & ZERO_MASK));
+    };
+    auto add = [&](const Vector a, const Vector m, const Vector carry_in) {
+        Vector partial = a + m;
+        Vector sum = partial + carry_in;
+        Vector carry = ((Vector)(partial < a) | (Vector)(sum < partial)) & CARRY_MASK;
+        Vector overflow = ((~(a ^ m) & (a ^ sum)) & 0x80) >> 1;
+        flags = NEGATIVE_MASK | OVERFLOW_MASK | ZERO_MASK | CARRY_MASK;
+        flag_values = nz(sum) | overflow | carry;
+        return sum;
+    };
+    auto compare = [&](const Vector reg, const Vector m) {
+        flags = NEGATIVE_MASK | ZERO_MASK | CARRY_MASK;
+        flag_values = nz(reg - m) | ((Vector)(reg >= m) & CARRY_MASK);
+    };
+    auto load = [&](Vector &reg, const Vector value) {
+        reg = value;
+        flags = NEGATIVE_MASK | ZERO_MASK;
+        flag_values = nz(value);
+    };
+    auto store = [&](const Vector value) {
+        if (!in_ram)
+        {
+            return false;
+        }
+        result = value;
+        write_back = true;
+        return true;
+    };
+    auto modify = [&](const Vector value, const Vector carry, const bool sets_carry) {
+        if (!in_ram && opcode.addressing_mode != AddressingMode::ACC)
+        {
+            return false;
+        }
+        flags = NEGATIVE_MASK | ZERO_MASK | (sets_carry ? CARRY_MASK : 0);
+        flag_values = nz(value) | (carry & CARRY_MASK);
+        if (opcode.addressing_mode == AddressingMode::ACC)
+        {
+            new_acc = value;
+        }
+        else
+        {
+            result = value;
+            write_back = true;
+        }
+        return true;
+    };
+    auto set_flag = [&](const uint8_t flag, const bool value) {
+        flags = flag;
+        const uint8_t flag_value = value ? flag : 0;
+        flag_values = flag_values + flag_value;
+    };
+    auto branch = [&](const uint8_t flag, const bool value) {
+        const uint16_t next_pc = instruction_pc + opcode.instruction_size;
+        const uint16_t target = next_pc + (int8_t)byte_1;
+        for (size_t lane = 0; lane < LANES; lane++)
+        {
+            if (((sr[lane] & flag) != 0) == value)
+            {
+                new_pc[lane] = target;
+                extra_cycles[lane] = 1 + ((next_pc & 0xFF00) != (target & 0xFF00));
+            }
+        }
+    };
+
+    const Vector carry_in = sr & CARRY_MASK;
+    Vector source = opcode.addressing_mode == AddressingMode::ACC ? acc : operand;
+
+    switch (opcode.instruction_id)
+    {
+    case InstructionId::LDA:
+        load(new_acc, operand);
+        break;
+    case InstructionId::LDX:
+        load(new_xr, operand);
+        break;
+    case InstructionId::LDY:
+        load(new_yr, operand);
+        break;
+    case InstructionId::STA:
+        if (!store(acc))
+        {
+            return false;
+        }
+        break;
+    case InstructionId::STX:
+        if (!store(xr))
+        {
+            return false;
+        }
+        break;
+    case InstructionId::STY:
+        if (!store(yr))
+        {
+            return false;
+        }
+        break;
+    case InstructionId::TAX:
+        load(new_xr, acc);
+        break;
+    case InstructionId::TAY:
+        load(new_yr, acc);
+        break;
+    case InstructionId::TXA:
+        load(new_acc, xr);
+        break;
+    case InstructionId::TYA:
+        load(new_acc, yr);
+        break;
+    case InstructionId::AND:
+        load(new_acc, acc & operand);
+        break;
+    case InstructionId::ORA:
+        load(new_acc, acc | operand);
+        break;
+    case InstructionId::EOR:
+        load(new_acc, acc ^ operand);
+        break;
+    case InstructionId::BIT:
+        flags = NEGATIVE_MASK | OVERFLOW_MASK | ZERO_MASK;
+        flag_values = (operand & (NEGATIVE_MASK | OVERFLOW_MASK)) | ((Vector)((acc & operand) == 0) & ZERO_MASK);
+        break;
+    case InstructionId::ADC:
+        new_acc = add(acc, operand, carry_in);
+        break;
+    case InstructionId::SBC:
+        new_acc = add(acc, ~operand, carry_in);
+        break;
+    case InstructionId::CMP:
+        compare(acc, operand);
+        break;
+    case InstructionId::CPX:
+        compare(xr, operand);
+        break;
+    case InstructionId::CPY:
+        compare(yr, operand);
+        break;
+    case InstructionId::INC:
+        if (!modify(operand + 1, carry_in, false))
+        {
+            return false;
+        }
+        break;
+    case InstructionId::DEC:
+        if (!modify(operand - 1, carry_in, false))
+        {
+            return false;
+        }
+        break;
+    case InstructionId::INX:
+        load(new_xr, xr + 1);
+        break;
+    case InstructionId::INY:
+        load(new_yr, yr + 1);
+        break;
+    case InstructionId::DEX:
+        load(new_xr, xr - 1);
+        break;
+    case InstructionId::DEY:
+        load(new_yr, yr - 1);
+        break;
+    case InstructionId::ASL:
+        if (!modify(source << 1, source >> 7, true))
+        {
+            return false;
+        }
+        break;
+    case InstructionId::LSR:
+        if (!modify(source >> 1, source & 1, true))
+        {
+            return false;
+        }
+        break;
+    case InstructionId::ROL:
+        if (!modify((source << 1) | carry_in, source >> 7, true))
+        {
+            return false;
+        }
+        break;
+    case InstructionId::ROR:
+        if (!modify((source >> 1) | (carry_in << 7), source & 1, true))
+        {
+            return false;
+        }
+        break;
+    case InstructionId::JMP:
+        if (opcode.addressing_mode != AddressingMode::ABS)
+        {
+            return false;
+        }
+        new_pc.fill(absolute);
+        break;
+    case InstructionId::BCC:
+        branch(CARRY_MASK, false);
+        break;
+    case InstructionId::BCS:
+        branch(CARRY_MASK, true);
+        break;
+    case InstructionId::BNE:
+        branch(ZERO_MASK, false);
+        break;
+    case InstructionId::BEQ:
+        branch(ZERO_MASK, true);
+        break;
+    case InstructionId::BPL:
+        branch(NEGATIVE_MASK, false);
+        break;
+    case InstructionId::BMI:
+        branch(NEGATIVE_MASK, true);
+        break;
+    case InstructionId::BVC:
+        branch(OVERFLOW_MASK, false);
+        break;
+    case InstructionId::BVS:
+        branch(OVERFLOW_MASK, true);
+        break;
+    case InstructionId::CLC:
+        set_flag(CARRY_MASK, false);
+        break;
+    case InstructionId::SEC:
+        set_flag(CARRY_MASK, true);
+        break;
+    case InstructionId::CLI:
+        set_flag(INTERRUPT_MASK, false);
+        break;
+    case InstructionId::SEI:
+        set_flag(INTERRUPT_MASK, true);
+        break;
+    case InstructionId::CLD:
+        set_flag(DECIMAL_MASK, false);
+        break;
+    case InstructionId::SED:
+        set_flag(DECIMAL_MASK, true);
+        break;
+    case InstructionId::CLV:
+        set_flag(OVERFLOW_MASK, false);
+        break;
+    case InstructionId::NOP:
+        if (opcode.addressing_mode != AddressingMode::IMP)
+        {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    new_sr = (sr & (uint8_t)~flags) | (flag_values & flags);
+
+    // Commit the lanes in the mask
+    acc = (new_acc & mask) | (acc & ~mask);
+    xr = (new_xr & mask) | (xr & ~mask);
+    yr = (new_yr & mask) | (yr & ~mask);
+    sr = (new_sr & mask) | (sr & ~mask);
+    if (write_back)
+    {
+        ram[address] = (result & mask) | (ram[address] & ~mask);
+    }
+    for (size_t lane = 0; lane < LANES; lane++)
+    {
+        if (lanes[lane])
+        {
+            pc[lane] = new_pc[lane];
+            cycles[lane] += opcode.base_cycles + extra_cycles[lane];
+        }
+    }
+    return true;
+}
+
+template <size_t LANES>
+void Lockstep<LANES>::scalar_step(const size_t lane)
+{
+    MOS6502<mmio::Bus> &cpu = scalar_cpus[lane];
+    cpu.set_registers(get_registers(lane));
+    const uint64_t start = cpu.get_cycles();
+    if (!cpu.step())
+    {
+        jammed[lane] = true;
+    }
+    cycles[lane] += cpu.get_cycles() - start;
+    scalar_instructions++;
+
+    const Registers registers = cpu.get_registers();
+    pc[lane] = registers.pc;
+    acc[lane] = registers.acc;
+    xr[lane] = registers.xr;
+    yr[lane] = registers.yr;
+    sr[lane] = registers.sr;
+    sp[lane] = registers.sp;
+}
+
+template <size_t LANES>
+uint8_t Lockstep<LANES>::read_rom(const uint16_t address) const
+{
+    return prg_rom[(address - PRG_ROM_START) % prg_rom.size()];
+}
+
+template class Lockstep<8>;
+template class Lockstep<16>;
+
+} // namespace cpu
@@ -0,0 +1,154 @@
+#ifndef CPU_LOCKSTEP_H
+#define CPU_LOCKSTEP_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MOS6502.h"
+#include "Registers.h"
+#include "mmio/Bus.h"
+
+namespace cpu
+{
+
+/// @brief View of the memory of one lane of the lockstep engine: the 2 KB of CPU RAM (mirrored up to $2000)
+/// stored with a stride, and the PRG ROM (mirrored from $8000 like in mmio::Mmio). The rest of the address
+/// space reads as zero and ignores writes
+class LockstepBus final : public mmio::Bus
+{
+  public:
+    LockstepBus() = default;
+
+    /// @brief Constructor
+    /// @param ram First byte of the RAM of the lane
+    /// @param stride Distance in bytes between consecutive RAM addresses
+    /// @param prg_rom The PRG ROM, shared by all the lanes
+    LockstepBus(uint8_t *ram, const size_t stride, const std::vector<uint8_t> *prg_rom);
+
+    uint8_t get(const uint16_t address) override;
+
+    uint8_t peek(const uint16_t address) const override;
+
+    void set(const uint16_t address, const uint8_t value) override;
+
+    uint32_t get_side_effect_reads() const override;
+
+  private:
+    /// @brief First byte of the RAM of the lane
+    uint8_t *ram = nullptr;
+
+    /// @brief Distance in bytes between consecutive RAM addresses
+    size_t stride = 1;
+
+    /// @brief The PRG ROM
+    const std::vector<uint8_t> *prg_rom = nullptr;
+};
+
+/// @brief Vector with a byte per lane, using the GCC vector extensions. The vector size has to be a constant
+/// expression when the typedef is parsed, hence one specialisation per supported width
+template <size_t LANES> struct LaneVector;
+template <> struct LaneVector<8>
+{
+    typedef uint8_t type __attribute__((vector_size(8)));
+};
+template <> struct LaneVector<16>
+{
+    typedef uint8_t type __attribute__((vector_size(16)));
+};
+
+/// @brief Experimental engine that runs LANES instances of the CPU in lockstep, one per vector lane.
+/// The registers are stored as vectors (structure of arrays) and the RAM is interleaved, so that the same
+/// address of all the lanes is a single vector. The lanes that share their pc execute the instruction
+/// together with vector operations, masking the lanes that are somewhere else. Instructions that the vector
+/// path does not implement (stack, indexed addressing, accesses outside RAM and ROM...) and lanes that are
+/// alone at their pc are peeled off to the scalar MOS6502 interpreter, one lane at a time.
+/// The vector width is chosen by the compiler from LANES and the target (SSE, AVX2, AVX-512)
+/// @tparam LANES Number of instances, 8 or 16
+template <size_t LANES> class Lockstep
+{
+  public:
+    /// @brief Constructor
+    /// @param prg_rom The PRG ROM all the lanes run, referenced and not copied
+    Lockstep(const std::vector<uint8_t> &prg_rom);
+
+    Lockstep(const Lockstep &) = delete;
+    Lockstep &operator=(const Lockstep &) = delete;
+
+    /// @brief Set the initial state of a lane
+    /// @param lane The lane index
+    /// @param registers The registers
+    /// @param ram The 2 KB of CPU RAM
+    void set_lane(const size_t lane, const Registers &registers, const uint8_t *ram);
+
+    /// @brief Run every lane until its cycle count reaches the provided one or its CPU jams
+    void run_until(const uint64_t cycle);
+
+    /// @brief Return the registers of a lane
+    Registers get_registers(const size_t lane) const;
+
+    /// @brief Return the number of cycles executed by a lane
+    uint64_t get_cycles(const size_t lane) const;
+
+    /// @brief Return true if the CPU of a lane is jammed
+    bool is_jammed(const size_t lane) const;
+
+    /// @brief Read the memory of a lane
+    uint8_t peek(const size_t lane, const uint16_t address) const;
+
+    /// @brief Return the number of instructions executed by the vector path, counting each lane
+    uint64_t get_vector_instructions() const;
+
+    /// @brief Return the number of instructions executed by the scalar interpreter
+    uint64_t get_scalar_instructions() const;
+
+  private:
+    /// @brief A byte per lane
+    typedef typename LaneVector<LANES>::type Vector;
+
+    /// @brief Size of the CPU RAM
+    static constexpr size_t RAM_SIZE = 0x0800;
+
+    /// @brief The registers of all the lanes
+    Vector acc = {}, xr = {}, yr = {}, sr = {}, sp = {};
+
+    /// @brief Program counters of all the lanes
+    std::array<uint16_t, LANES> pc = {};
+
+    /// @brief Cycles executed by every lane
+    std::array<uint64_t, LANES> cycles = {};
+
+    /// @brief Jammed lanes
+    std::array<bool, LANES> jammed = {};
+
+    /// @brief Interleaved RAM: ram[address] holds that address for all the lanes
+    std::array<Vector, RAM_SIZE> ram = {};
+
+    /// @brief The PRG ROM
+    const std::vector<uint8_t> &prg_rom;
+
+    /// @brief Bus and interpreter used to execute a lane on its own
+    std::array<LockstepBus, LANES> scalar_buses;
+    std::array<MOS6502<mmio::Bus>, LANES> scalar_cpus;
+
+    /// @brief Statistics
+    uint64_t vector_instructions = 0;
+    uint64_t scalar_instructions = 0;
+
+    /// @brief Execute the instruction at pc for the lanes in the mask with vector operations
+    /// @param instruction_pc The pc shared by the lanes
+    /// @param lanes The lanes that execute the instruction
+    /// @return False if the vector path does not implement the instruction, in which case nothing changed
+    bool vector_step(const uint16_t instruction_pc, const std::array<bool, LANES> &lanes);
+
+    /// @brief Execute the instruction at the pc of a lane with the scalar interpreter
+    void scalar_step(const size_t lane);
+
+    /// @brief Read the ROM, which is the same for all the lanes
+    uint8_t read_rom(const uint16_t address) const;
+};
+
+} // namespace cpu
+
+#endif
@@ -5,7 +5,10 @@
 #include <type_traits>
 
 #include "MOS6502.h"
+#include "TraceFormatter.h"
 #include "common/Logging.h"
+#include "mmio/FlatBus.h"
+#include "mmio/Mmio.h"
 
 namespace cpu
 {
@@ -18,39 +21,118 @@ static constexpr uint16_t RESET_VECTOR = 0xFFFC;
 /// First byte of the IRQ vector
 static constexpr uint16_t IRQ_VECTOR = 0xFFFE;
 
-MOS6502::MOS6502(const std::shared_ptr<mmio::Mmio> &mmio)
+/// Constant ORed with the accumulator by the unstable XAA and LXA instructions
+static constexpr uint8_t UNSTABLE_CONSTANT = 0xEE;
+
+/// Bits of the status register that are not stored in sr but evaluated lazily (N, V, Z and C)
+static constexpr uint8_t LAZY_FLAGS_MASK = 0xC3;
+
+/// The opcode parser that decodes bytes into opcodes. It is constant and shared by all the CPUs, so that
+/// the CPU state stays small and trivially copyable
+static const OpcodeParser opcode_parser;
+
+/// Maximum distance in bytes of a backward jump for its loop to be considered as an idle loop
+static constexpr uint16_t MAX_IDLE_LOOP_SIZE = 16;
+
+/// Maximum number of instructions in an iteration of an idle loop
+static constexpr uint64_t MAX_IDLE_LOOP_INSTRUCTIONS = 8;
+
+template <typename BusType>
+MOS6502<BusType>::MOS6502(BusType *bus)
 {
-    this->mmio = mmio;
+    this->bus = bus;
 }
 
-void MOS6502::override_reset_vector(const uint16_t address)
+template <typename BusType>
+void MOS6502<BusType>::override_reset_vector(const uint16_t address)
 {
     rv_overriden = true;
     rv_value = address;
 }
 
-void MOS6502::set_max_instructions(const size_t num_instructions)
+template <typename BusType>
+void MOS6502<BusType>::set_max_instructions(const size_t num_instructions)
 {
     this->max_instructions = num_instructions;
 }
 
-void MOS6502::set_log_file(const std::shared_ptr<common::LogFile> &log_file)
+template <typename BusType>
+void MOS6502<BusType>::set_log_file(common::LogFile *log_file)
 {
     this->log_file = log_file;
 }
 
-bool MOS6502::reset()
+template <typename BusType>
+void MOS6502<BusType>::set_trace_control(debug::TraceControl *trace_control)
+{
+    this->trace_control = trace_control;
+}
+
+template <typename BusType>
+void MOS6502<BusType>::set_trace_store(debug::TraceStoreWriter *trace_store)
+{
+    this->trace_store = trace_store;
+}
+
+template <typename BusType>
+void MOS6502<BusType>::set_bus_recorder(debug::BusRecorder *bus_recorder)
+{
+    this->bus_recorder = bus_recorder;
+}
+
+template <typename BusType>
+void MOS6502<BusType>::set_heatmap(debug::AccessHeatmap *heatmap)
+{
+    this->heatmap = heatmap;
+}
+
+template <typename BusType>
+void MOS6502<BusType>::set_code_data_logger(CodeDataLogger *code_data_logger)
+{
+#ifdef EMUNES_CDL
+    this->code_data_logger = code_data_logger;
+#else
+    (void)code_data_logger;
+#endif
+}
+
+template <typename BusType>
+void MOS6502<BusType>::set_breakpoints(debug::Breakpoints *breakpoints)
+{
+    this->breakpoints = breakpoints;
+}
+
+template <typename BusType>
+void MOS6502<BusType>::set_bus(BusType *bus)
+{
+    this->bus = bus;
+}
+
+template <typename BusType>
+bool MOS6502<BusType>::reset()
+{
+    power_on();
+    return this->run();
+}
+
+template <typename BusType>
+void MOS6502<BusType>::power_on()
 {
     // Initialise the internal variables
     pc = 0;
     acc = 0;
     xr = 0;
     yr = 0;
-    sr = 0x24;
+    set_sr(0x24);
     // The stack grows downwards, so at reset the stack needs to point
     // to 0xFF (which is in reality 0x01FF) and grows downwards from there
     sp = 0xFD; // TODO: why?
     opcode = Opcode();
+    jammed = false;
+    // The reset sequence takes 7 cycles
+    cycles = 7;
+    instructions = 0;
+    skipped_instructions = 0;
 
     if (rv_overriden)
     {
@@ -60,73 +142,389 @@ bool MOS6502::reset()
     else
     {
         // The program counter is set to the address read at the reset vector
-        pc = (static_cast<uint16_t>(mmio->get(RESET_VECTOR + 1)) << 8) + static_cast<uint16_t>(mmio->get(RESET_VECTOR));
+        pc = (static_cast<uint16_t>(bus->get(RESET_VECTOR + 1)) << 8) + static_cast<uint16_t>(bus->get(RESET_VECTOR));
     }
-
-    return this->run();
 }
 
-bool MOS6502::run()
+template <typename BusType>
+bool MOS6502<BusType>::run()
 {
-    // Loop through the instructions
-    uint8_t opcode_raw;
-    size_t count_instructions = 0;
+    // Loop through the instructions. A step can execute two instructions if they are fused
     while (true)
     {
-        // Update the current opcode
-        opcode_raw = mmio->get(pc);
-        common::Log(common::LogLevel::DEBUG, "-> Raw opcode: " + common::print_hex(opcode_raw, sizeof(opcode_raw)));
-        opcode = opcode_parser.parse(opcode_raw);
+        if (breakpoints && breakpoints->check_pc(pc))
+        {
+            return true;
+        }
+        if (!step())
+        {
+            return false;
+        }
+        if (max_instructions != 0 && instructions >= max_instructions)
+        {
+            if (log_file)
+            {
+                log_file->dump();
+            }
+            return true;
+        }
+    }
+}
+
+template <typename BusType>
+bool MOS6502<BusType>::run_until(const uint64_t cycle)
+{
+    while (cycles < cycle)
+    {
+        if (breakpoints && breakpoints->check_pc(pc))
+        {
+            return true;
+        }
+        const uint16_t instruction_pc = pc;
+        if (!step())
+        {
+            return false;
+        }
+
+        // A short jump backwards closes a loop that could be idle. Skipping is disabled while tracing, as
+        // the trace has to contain every instruction, and while debugging, as every instruction can stop
+        if (idle_loop_skipping && !log_file && !trace_store && !bus_recorder && !heatmap && !breakpoints &&
+            pc <= instruction_pc && instruction_pc - pc < MAX_IDLE_LOOP_SIZE)
+        {
+            if (!skip_idle_loop(cycle))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
 
-        // Get the next bytes of the instruction, if necessary
-        if (opcode.instruction_size >= 2)
+template <typename BusType>
+bool MOS6502<BusType>::skip_idle_loop(const uint64_t cycle)
+{
+    // Run one iteration of the loop, stepping normally
+    const Registers head = get_registers();
+    const uint64_t head_cycles = cycles;
+    const uint64_t head_instructions = instructions;
+    const uint64_t head_writes = writes;
+    const uint32_t head_side_effect_reads = bus->get_side_effect_reads();
+    do
+    {
+        // A fused pair advances the instruction count by two, so the count can step over the limit
+        if (cycles >= cycle || instructions - head_instructions >= MAX_IDLE_LOOP_INSTRUCTIONS)
         {
-            instruction_byte_1 = mmio->get(pc + 1);
+            return true;
         }
-        if (opcode.instruction_size >= 3)
+        if (!step())
         {
-            instruction_byte_2 = mmio->get(pc + 2);
+            return false;
         }
+    } while (pc != head.pc);
+    // The iteration can end past the cycle, leaving nothing to skip
+    if (cycles >= cycle)
+    {
+        return true;
+    }
 
-        // Resolve the instruction (memory addresses and intermediate values)
-        resolve();
+    // If the iteration did not write anything, only read memory and ended in the state it started, every iteration
+    // until the next event will do exactly the same, so they can be accounted for without executing them. Reads
+    // from I/O registers, such as a controller port, can return something else each time
+    const Registers tail = get_registers();
+    if (writes != head_writes || bus->get_side_effect_reads() != head_side_effect_reads || tail.acc != head.acc ||
+        tail.xr != head.xr || tail.yr != head.yr || tail.sr != head.sr || tail.sp != head.sp)
+    {
+        return true;
+    }
+    const uint64_t iteration_cycles = cycles - head_cycles;
+    const uint64_t iteration_instructions = instructions - head_instructions;
+    const uint64_t iterations = (cycle - cycles) / iteration_cycles;
+    cycles += iterations * iteration_cycles;
+    instructions += iterations * iteration_instructions;
+    skipped_instructions += iterations * iteration_instructions;
+    return true;
+}
 
-        // TODO: consider fetching only when it is absolutely necessary
-        fetch();
+template <typename BusType>
+bool MOS6502<BusType>::step()
+{
+    // A jammed CPU does not fetch anything else
+    if (jammed)
+    {
+        return false;
+    }
+
+    instructions++;
+
+    // The bus recorder stamps the accesses of the instruction from its first cycle and flags the opcode fetch, the
+    // heatmap counts the execution
+    if (bus_recorder)
+    {
+        bus_recorder->start_instruction(cycles);
+    }
+    if (heatmap)
+    {
+        heatmap->add(pc, debug::AccessKind::EXECUTE);
+    }
+
+    // Update the current opcode
+    uint8_t opcode_raw = bus->get(pc);
+    // The debug messages are only built when they can be seen, as building them costs more than tracing
+    if (!common::is_muted())
+    {
+        common::Log(common::LogLevel::DEBUG, "-> Raw opcode: " + common::print_hex(opcode_raw, sizeof(opcode_raw)));
+    }
+    opcode = opcode_parser.parse(opcode_raw);
+    // Resolving the address can add cycles, so the trace and the trace store take the count from here
+    const uint64_t instruction_cycles = cycles;
+    cycles += opcode.base_cycles;
+
+    // Fused pairs skip the trace, the debug log, the code/data log and the breakpoints, so they are only used
+    // when nothing observes them. They are not used either when the instruction limit leaves room for only this
+    // instruction, as run checks the limit after the step
+    if (opcode.fusion != FusionId::NONE && instruction_fusion && !log_file && !trace_store && !bus_recorder &&
+        !heatmap && !code_data_logger && !breakpoints && common::is_muted() &&
+        (max_instructions == 0 || instructions < max_instructions))
+    {
+        return step_fused();
+    }
+
+    // Read the rest of the instruction and resolve the addressing mode (memory addresses and
+    // intermediate values)
+    resolve();
 
-        // Add record to log file
-        log_file->add_record(disassemble());
+    // Read the value at the resolved address, only if the instruction needs it
+    fetch();
+
+#ifdef EMUNES_CDL
+    if (code_data_logger)
+    {
+        log_code_data();
+    }
+#endif
 
-        // Execute the current instruction
-        if (!execute())
+    // Record the instruction and its operand read in the trace store, the writes are recorded as they happen
+    if (trace_store)
+    {
+        trace_store->add_instruction(pc, opcode.raw, instruction_cycles);
+        if (opcode.memory_access == MemoryAccess::READ || opcode.memory_access == MemoryAccess::READ_MODIFY_WRITE)
         {
-            return false;
+            trace_store->add_access(address, value, debug::AccessKind::READ);
         }
-        count_instructions++;
-        if (count_instructions == max_instructions)
+    }
+
+    // Add record to log file, if the instruction is inside the trace window
+    if (log_file && (!trace_control || trace_control->check_instruction(pc, instruction_cycles)))
+    {
+        char line[TRACE_LINE_LENGTH];
+        log_file->add_record(std::string_view(line, disassemble(line, instruction_cycles)));
+    }
+
+    // Execute the current instruction
+    return execute();
+}
+
+template <typename BusType>
+bool MOS6502<BusType>::step_fused()
+{
+    // First instruction of the pair, its opcode has already been fetched and decoded
+    const FusionId fusion = opcode.fusion;
+    switch (fusion)
+    {
+    case FusionId::DEX_BNE:
+        bus->get(pc + 1);
+        xr--;
+        set_nz(xr);
+        break;
+    case FusionId::DEY_BNE:
+        bus->get(pc + 1);
+        yr--;
+        set_nz(yr);
+        break;
+    case FusionId::INX_BNE:
+        bus->get(pc + 1);
+        xr++;
+        set_nz(xr);
+        break;
+    case FusionId::INY_BNE:
+        bus->get(pc + 1);
+        yr++;
+        set_nz(yr);
+        break;
+    case FusionId::CMP_BXX:
+        value = bus->get(pc + 1);
+        carry = acc >= value;
+        set_nz(acc - value);
+        break;
+    case FusionId::LDA_STA:
+        resolve();
+        fetch();
+        acc = value;
+        set_nz(acc);
+        break;
+    case FusionId::INC_BNE:
+        address = bus->get(pc + 1);
+        value = bus->get(address);
+        modify(value + 1);
+        set_nz(value + 1);
+        break;
+    case FusionId::CLC_ADC:
+        bus->get(pc + 1);
+        carry = 0;
+        break;
+    case FusionId::NONE:
+        break;
+    }
+    pc += opcode.instruction_size;
+
+    // Second instruction of the pair. Its opcode is fetched in the same cycle as if it was not fused
+    instructions++;
+    const uint8_t opcode_raw = bus->get(pc);
+    opcode = opcode_parser.parse(opcode_raw);
+    cycles += opcode.base_cycles;
+    switch (fusion)
+    {
+    case FusionId::DEX_BNE:
+    case FusionId::DEY_BNE:
+    case FusionId::INX_BNE:
+    case FusionId::INY_BNE:
+    case FusionId::INC_BNE:
+        if (opcode.instruction_id == InstructionId::BNE)
+        {
+            fused_branch(z_result != 0);
+            return true;
+        }
+        break;
+    case FusionId::CMP_BXX:
+        if (opcode.instruction_id == InstructionId::BNE || opcode.instruction_id == InstructionId::BEQ)
+        {
+            fused_branch((z_result != 0) == (opcode.instruction_id == InstructionId::BNE));
+            return true;
+        }
+        break;
+    case FusionId::LDA_STA:
+        if (opcode.instruction_id == InstructionId::STA &&
+            (opcode.addressing_mode == AddressingMode::ZP0 || opcode.addressing_mode == AddressingMode::ABS))
+        {
+            resolve();
+            write(address, acc);
+            pc += opcode.instruction_size;
+            return true;
+        }
+        break;
+    case FusionId::CLC_ADC:
+        if (opcode.instruction_id == InstructionId::ADC &&
+            (opcode.addressing_mode == AddressingMode::IMM || opcode.addressing_mode == AddressingMode::ZP0 ||
+             opcode.addressing_mode == AddressingMode::ABS))
         {
-            this->log_file->dump();
+            resolve();
+            fetch();
+            adc(value);
+            pc += opcode.instruction_size;
             return true;
         }
+        break;
+    case FusionId::NONE:
+        break;
+    }
+
+    // The second opcode does not complete the pair, execute it as usual
+    resolve();
+    fetch();
+    return execute();
+}
+
+template <typename BusType>
+void MOS6502<BusType>::fused_branch(const bool condition)
+{
+    instruction_byte_1 = bus->get(pc + 1);
+    address = pc + (int8_t)instruction_byte_1 + opcode.instruction_size;
+    advance_pc = true;
+    branch(condition);
+    if (advance_pc)
+    {
+        pc += opcode.instruction_size;
     }
 }
 
-void MOS6502::resolve()
+template <typename BusType>
+Registers MOS6502<BusType>::get_registers()
 {
-    common::Log(common::LogLevel::DEBUG, "Addressing mode: " + print_addressing_mode(opcode.addressing_mode));
+    return Registers{pc, acc, xr, yr, get_sr(), sp};
+}
+
+template <typename BusType>
+void MOS6502<BusType>::set_registers(const Registers &registers)
+{
+    pc = registers.pc;
+    acc = registers.acc;
+    xr = registers.xr;
+    yr = registers.yr;
+    set_sr(registers.sr);
+    sp = registers.sp;
+}
+
+template <typename BusType>
+uint64_t MOS6502<BusType>::get_cycles() const
+{
+    return cycles;
+}
+
+template <typename BusType>
+bool MOS6502<BusType>::is_jammed() const
+{
+    return jammed;
+}
+
+template <typename BusType>
+uint64_t MOS6502<BusType>::get_instructions() const
+{
+    return instructions;
+}
+
+template <typename BusType>
+uint64_t MOS6502<BusType>::get_skipped_instructions() const
+{
+    return skipped_instructions;
+}
+
+template <typename BusType>
+void MOS6502<BusType>::set_idle_loop_skipping(const bool enabled)
+{
+    idle_loop_skipping = enabled;
+}
+
+template <typename BusType>
+void MOS6502<BusType>::set_instruction_fusion(const bool enabled)
+{
+    instruction_fusion = enabled;
+}
+
+template <typename BusType>
+void MOS6502<BusType>::resolve()
+{
+    if (!common::is_muted())
+    {
+        common::Log(common::LogLevel::DEBUG, "Addressing mode: " + print_addressing_mode(opcode.addressing_mode));
+    }
+    page_crossed = false;
     switch (opcode.addressing_mode)
     {
     case AddressingMode::IMP:
-        // The instruction does not need to access anything
+        // The instruction does not need to access anything, but the chip still reads the next byte
+        // and throws it away
+        bus->get(pc + 1);
         break;
     case AddressingMode::ACC:
         // It does not make sense to set an address for this instruction, so set only the value,
-        // which is the accumulator
+        // which is the accumulator. As with implicit instructions, the next byte is read and ignored
+        bus->get(pc + 1);
         value = acc;
         break;
     case AddressingMode::IMM:
         // Immediate addressing allows the programmer to directly specify
         // an 8 bit constant within the instruction
+        instruction_byte_1 = bus->get(pc + 1);
         value = instruction_byte_1;
         break;
     case AddressingMode::ZP0:
@@ -135,6 +533,7 @@ void MOS6502::resolve()
         // where the most significant byte of the address is always zero.
         // In zero page mode only the least significant byte of the address is held in the instruction making it shorter
         // by one byte (important for space saving) and one less memory fetch during execution (important for speed).
+        instruction_byte_1 = bus->get(pc + 1);
         address = instruction_byte_1;
         break;
     case AddressingMode::ZPX:
@@ -142,12 +541,18 @@ void MOS6502::resolve()
         // by taking the 8 bit zero page address from the instruction and adding the current value of the X register to
         // it. For example if the X register contains $0F and the instruction LDA $80,X is executed then the accumulator
         // will be loaded from $008F (e.g. $80 + $0F => $8F).
+        // The chip reads the unindexed address while it is adding the index
+        instruction_byte_1 = bus->get(pc + 1);
+        bus->get(instruction_byte_1);
         address = (instruction_byte_1 + xr) & 0xFF;
         break;
     case AddressingMode::ZPY:
         // The address to be accessed by an instruction using indexed zero page addressing is calculated
         // by taking the 8 bit zero page address from the instruction and adding the current value of the Y register to
         // it. This mode can only be used with the LDX and STX instructions.
+        // The chip reads the unindexed address while it is adding the index
+        instruction_byte_1 = bus->get(pc + 1);
+        bus->get(instruction_byte_1);
         address = (instruction_byte_1 + yr) & 0xFF;
         break;
     case AddressingMode::REL:
@@ -155,23 +560,35 @@ void MOS6502::resolve()
         // relative offset (e.g. -128 to +127) which is added to program counter if the condition is true. As the
         // program counter itself is incremented during instruction execution by two the effective address range for the
         // target instruction must be with -126 to +129 bytes of the branch.
+        instruction_byte_1 = bus->get(pc + 1);
         address = pc + (int8_t)instruction_byte_1 + opcode.instruction_size;
         break;
     case AddressingMode::ABS:
         // Instructions using absolute addressing contain a full 16 bit address to identify the target location.
-        address = ((uint16_t)instruction_byte_2 << 8) + (uint16_t)instruction_byte_1;
+        // Note: JSR pushes the return address before reading the last byte of the instruction, so it
+        // resolves its own address
+        instruction_byte_1 = bus->get(pc + 1);
+        if (opcode.instruction_id != InstructionId::JSR)
+        {
+            instruction_byte_2 = bus->get(pc + 2);
+            address = ((uint16_t)instruction_byte_2 << 8) + (uint16_t)instruction_byte_1;
+        }
         break;
     case AddressingMode::ABX:
         // The address to be accessed by an instruction using X register indexed absolute addressing is computed
         // by taking the 16 bit address from the instruction and added the contents of the X register.
         // For example if X contains $92 then an STA $2000,X instruction will store the accumulator at $2092 (e.g. $2000
         // + $92).
-        address = ((uint16_t)instruction_byte_2 << 8) + (uint16_t)instruction_byte_1 + (uint16_t)xr;
+        instruction_byte_1 = bus->get(pc + 1);
+        instruction_byte_2 = bus->get(pc + 2);
+        resolve_indexed(((uint16_t)instruction_byte_2 << 8) + (uint16_t)instruction_byte_1, xr);
         break;
     case AddressingMode::ABY:
         // The Y register indexed absolute addressing mode is the same as the previous mode only with the contents
         // of the Y register added to the 16 bit address from the instruction.
-        address = ((uint16_t)instruction_byte_2 << 8) + (uint16_t)instruction_byte_1 + (uint16_t)yr;
+        instruction_byte_1 = bus->get(pc + 1);
+        instruction_byte_2 = bus->get(pc + 2);
+        resolve_indexed(((uint16_t)instruction_byte_2 << 8) + (uint16_t)instruction_byte_1, yr);
         break;
     case AddressingMode::IND: {
         // JMP is the only 6502 instruction to support indirection. The instruction contains a 16 bit address which
@@ -179,47 +596,79 @@ void MOS6502::resolve()
         // target of the instruction. For example if location $0120 contains $FC and location $0121 contains $BA then
         // the instruction JMP ($0120) will cause the next instruction execution to occur at $BAFC (e.g. the contents of
         // $0120 and $0121).
+        instruction_byte_1 = bus->get(pc + 1);
+        instruction_byte_2 = bus->get(pc + 2);
         // Find the address given by the instruction
         intermediate_address = ((uint16_t)instruction_byte_2 << 8) + (uint16_t)instruction_byte_1;
-        // Find the address that is stored at the location
-        address = ((uint16_t)mmio->get((intermediate_address & 0xFF00) + ((intermediate_address + 1) & 0xFF)) << 8) +
-                  (uint16_t)mmio->get(intermediate_address);
+        // Find the address that is stored at the location (the chip does not carry into the high byte)
+        uint16_t address_lsb = bus->get(intermediate_address);
+        uint16_t address_msb = bus->get((intermediate_address & 0xFF00) + ((intermediate_address + 1) & 0xFF));
+        address = (address_msb << 8) + address_lsb;
         break;
     }
-    case AddressingMode::IXI:
+    case AddressingMode::IXI: {
         // Indexed indirect addressing is normally used in conjunction with a table of address held on zero page. The
         // address of the table is taken from the instruction and the X register added to it (with zero page wrap
         // around) to give the location of the least significant byte of the target address.
-        // Perform indexing
+        instruction_byte_1 = bus->get(pc + 1);
+        // Perform indexing, while the chip reads the unindexed address
+        bus->get(instruction_byte_1);
         intermediate_address = (instruction_byte_1 + xr) & 0xFF;
         // Find the address stored there
-        address = ((uint16_t)mmio->get((uint16_t)((intermediate_address + 1) & 0xFF)) << 8) +
-                  (uint16_t)mmio->get(intermediate_address);
+        uint16_t address_lsb = bus->get(intermediate_address);
+        uint16_t address_msb = bus->get((uint16_t)((intermediate_address + 1) & 0xFF));
+        address = (address_msb << 8) + address_lsb;
         break;
-    case AddressingMode::IIX:
+    }
+    case AddressingMode::IIX: {
         // Indirect indexed addressing is the most common indirection mode used on the 6502. The instruction contains
         // the zero page location of the least significant byte of 16 bit address. The Y register is dynamically added
         // to this value to generate the actual target address for operation.
+        instruction_byte_1 = bus->get(pc + 1);
         // Perform indirection
-        intermediate_address =
-            (mmio->get((uint16_t)((instruction_byte_1 + 1) & 0xFF)) << 8) + mmio->get((uint16_t)instruction_byte_1);
+        uint16_t address_lsb = bus->get((uint16_t)instruction_byte_1);
+        uint16_t address_msb = bus->get((uint16_t)((instruction_byte_1 + 1) & 0xFF));
+        intermediate_address = (address_msb << 8) + address_lsb;
         // Perform indexing
-        address = intermediate_address + (uint16_t)yr;
+        resolve_indexed(intermediate_address, yr);
         break;
+    }
     default:
         break;
     }
 }
 
-bool MOS6502::execute()
+template <typename BusType>
+void MOS6502<BusType>::resolve_indexed(const uint16_t base_address, const uint8_t index)
+{
+    address = base_address + (uint16_t)index;
+    page_crossed = (base_address & 0xFF00) != (address & 0xFF00);
+
+    // The chip adds the index to the low byte first and reads from there before fixing the high byte.
+    // Reads only pay for this extra cycle when the page is crossed, writes always do
+    if (page_crossed || opcode.memory_access != MemoryAccess::READ)
+    {
+        bus->get((base_address & 0xFF00) | (address & 0x00FF));
+    }
+    if (page_crossed && opcode.memory_access == MemoryAccess::READ)
+    {
+        cycles++;
+    }
+}
+
+template <typename BusType>
+bool MOS6502<BusType>::execute()
 {
     // By default, the PC will advance, at the end of the execution, by as many
     // bytes as the instruction size
     advance_pc = true;
 
     // Decide depending on the instruction id
-    common::Log(common::LogLevel::DEBUG, "Execute instruction " + print_instruction_id(opcode.instruction_id) + ": " +
-                                             print_instruction_description(opcode.instruction_id));
+    if (!common::is_muted())
+    {
+        common::Log(common::LogLevel::DEBUG, "Execute instruction " + print_instruction_id(opcode.instruction_id) +
+                                                 ": " + print_instruction_description(opcode.instruction_id));
+    }
     switch (opcode.instruction_id)
     {
         // ***************************
@@ -231,39 +680,36 @@ bool MOS6502::execute()
         // Loads a byte of memory into the accumulator
         // setting the zero and negative flags as appropriate.
         acc = value;
-        set_sr_bit(StatusRegisterBit::ZERO, acc == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, acc >> 7);
+        set_nz(acc);
         break;
     case InstructionId::LDX:
         // Load X register
         // Loads a byte of memory into the X register
         // setting the zero and negative flags as appropriate.
         xr = value;
-        set_sr_bit(StatusRegisterBit::ZERO, xr == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, xr >> 7);
+        set_nz(xr);
         break;
     case InstructionId::LDY:
         // Load Y register
         // Loads a byte of memory into the Y register
         // setting the zero and negative flags as appropriate.
         yr = value;
-        set_sr_bit(StatusRegisterBit::ZERO, yr == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, yr >> 7);
+        set_nz(yr);
         break;
     case InstructionId::STA:
         // Store accumulator
         // Stores the contents of the accumulator into memory.
-        mmio->set(address, acc);
+        write(address, acc);
         break;
     case InstructionId::STX:
         // Store X register
         // Stores the contents of the X register into memory.
-        mmio->set(address, xr);
+        write(address, xr);
         break;
     case InstructionId::STY:
         // Store Y register
         // Stores the contents of the Y register into memory.
-        mmio->set(address, yr);
+        write(address, yr);
         break;
 
         // ***************************
@@ -275,32 +721,28 @@ bool MOS6502::execute()
         // Copies the current contents of the accumulator into the X register
         // and sets the zero and negative flags as appropriate.
         xr = acc;
-        set_sr_bit(StatusRegisterBit::ZERO, xr == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, xr >> 7);
+        set_nz(xr);
         break;
     case InstructionId::TAY:
         // Transfer accumulator to Y
         // Copies the current contents of the accumulator into the Y register
         // and sets the zero and negative flags as appropriate.
         yr = acc;
-        set_sr_bit(StatusRegisterBit::ZERO, yr == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, yr >> 7);
+        set_nz(yr);
         break;
     case InstructionId::TXA:
         // Transfer X to accumulator
         // Copies the current contents of the X register into the accumulator
         // and sets the zero and negative flags as appropriate.
         acc = xr;
-        set_sr_bit(StatusRegisterBit::ZERO, acc == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, acc >> 7);
+        set_nz(acc);
         break;
     case InstructionId::TYA:
         // Transfer Y to accumulator
         // Copies the current contents of the Y register into the accumulator
         // and sets the zero and negative flags as appropriate.
         acc = yr;
-        set_sr_bit(StatusRegisterBit::ZERO, acc == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, acc >> 7);
+        set_nz(acc);
         break;
 
         // ***************************
@@ -312,8 +754,7 @@ bool MOS6502::execute()
         // Copies the current contents of the stack register into the X register
         // and sets the zero and negative flags as appropriate.
         xr = sp;
-        set_sr_bit(StatusRegisterBit::ZERO, xr == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, xr >> 7);
+        set_nz(xr);
         break;
     case InstructionId::TXS:
         // Transfer X to stack pointer
@@ -330,23 +771,24 @@ bool MOS6502::execute()
         // Pushes a copy of the status flags on to the stack.
         // Note: PHP will push the sr with the B flag set
         // Note: the ignored flag is always pushed as 1
-        push_to_stack(sr | (1 << (uint8_t)StatusRegisterBit::BREAK) | (1 << (uint8_t)StatusRegisterBit::IGNORED));
+        push_to_stack(get_sr() | (1 << (uint8_t)StatusRegisterBit::BREAK) | (1 << (uint8_t)StatusRegisterBit::IGNORED));
         break;
     case InstructionId::PLA:
         // Pull accumulator
         // Pulls an 8 bit value from the stack and into the accumulator.
         // The zero and negative flags are set as appropriate.
+        bus->get(STACK_OFFSET + (uint16_t)sp);
         acc = pull_from_stack();
-        set_sr_bit(StatusRegisterBit::ZERO, acc == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, acc >> 7);
+        set_nz(acc);
         break;
     case InstructionId::PLP:
         // Pull processor status
         // Pulls an 8 bit value from the stack and into the processor flags.
         // The flags will take on new states as determined by the value pulled.
         // Note: the B flag is cleared and the I flag is set before storing the value in the status register
-        sr = ((pull_from_stack() & ~(1 << (uint8_t)StatusRegisterBit::BREAK)) |
-              (1 << (uint8_t)StatusRegisterBit::IGNORED));
+        bus->get(STACK_OFFSET + (uint16_t)sp);
+        set_sr((pull_from_stack() & ~(1 << (uint8_t)StatusRegisterBit::BREAK)) |
+               (1 << (uint8_t)StatusRegisterBit::IGNORED));
         break;
 
         // ***************************
@@ -358,33 +800,29 @@ bool MOS6502::execute()
         // A logical AND is performed, bit by bit, on the accumulator contents
         // using the contents of a byte of memory.
         acc &= value;
-        set_sr_bit(StatusRegisterBit::ZERO, acc == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, acc >> 7);
+        set_nz(acc);
         break;
     case InstructionId::EOR:
         // Exclusive OR
         // An exclusive OR is performed, bit by bit, on the accumulator contents
         // using the contents of a byte of memory.
         acc ^= value;
-        set_sr_bit(StatusRegisterBit::ZERO, acc == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, acc >> 7);
+        set_nz(acc);
         break;
     case InstructionId::ORA:
         // Logical inclusive OR
         // An inclusive OR is performed, bit by bit, on the accumulator contents
         // using the contents of a byte of memory.
         acc |= value;
-        set_sr_bit(StatusRegisterBit::ZERO, acc == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, acc >> 7);
+        set_nz(acc);
         break;
     case InstructionId::BIT: {
         // Bit test
         // This instruction is used to test if one or more bits are set in a target memory location.
         // The mask pattern in A is ANDed with the value in memory to set or clear the zero flag, but the result is not
         // kept. Bits 7 and 6 of the value from memory are copied into the N and V flags.
-        uint8_t result = acc & value;
-        set_sr_bit(StatusRegisterBit::ZERO, result == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, value & 0x80);
+        z_result = acc & value;
+        n_result = value;
         set_sr_bit(StatusRegisterBit::OVERFLOW, value & 0x40);
         break;
     }
@@ -409,30 +847,24 @@ bool MOS6502::execute()
         // Compare accumulator
         // This instruction compares the contents of the accumulator with another memory held value
         // and sets the zero and carry flags as appropriate.
-        uint8_t result = acc - value;
-        set_sr_bit(StatusRegisterBit::CARRY, acc >= value);
-        set_sr_bit(StatusRegisterBit::ZERO, acc == value);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, result >> 7);
+        carry = acc >= value;
+        set_nz(acc - value);
         break;
     }
     case InstructionId::CPX: {
         // Compare X register
         // This instruction compares the contents of the X register with another memory held value
         // and sets the zero and carry flags as appropriate.
-        uint8_t result = xr - value;
-        set_sr_bit(StatusRegisterBit::CARRY, xr >= value);
-        set_sr_bit(StatusRegisterBit::ZERO, xr == value);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, result >> 7);
+        carry = xr >= value;
+        set_nz(xr - value);
         break;
     }
     case InstructionId::CPY: {
         // Compare Y register
         // This instruction compares the contents of the Y register with another memory held value
         // and sets the zero and carry flags as appropriate.
-        uint8_t result = yr - value;
-        set_sr_bit(StatusRegisterBit::CARRY, yr >= value);
-        set_sr_bit(StatusRegisterBit::ZERO, yr == value);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, result >> 7);
+        carry = yr >= value;
+        set_nz(yr - value);
         break;
     }
 
@@ -445,48 +877,42 @@ bool MOS6502::execute()
         // Adds one to the value held at a specified memory location
         // setting the zero and negative flags as appropriate.
         uint8_t result = value + 1;
-        mmio->set(address, result);
-        set_sr_bit(StatusRegisterBit::ZERO, result == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, result >> 7);
+        modify(result);
+        set_nz(result);
         break;
     }
     case InstructionId::INX:
         // Increment the X register
         // Adds one to the X register setting the zero and negative flags as appropriate.
         xr++;
-        set_sr_bit(StatusRegisterBit::ZERO, xr == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, xr >> 7);
+        set_nz(xr);
         break;
     case InstructionId::INY:
         // Increment the Y register
         // Adds one to the Y register setting the zero and negative flags as appropriate.
         yr++;
-        set_sr_bit(StatusRegisterBit::ZERO, yr == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, yr >> 7);
+        set_nz(yr);
         break;
     case InstructionId::DEC: {
         // Decrement a memory location
         // Subtracts one from the value held at a specified memory location
         // setting the zero and negative flags as appropriate.
         uint8_t result = value - 1;
-        mmio->set(address, result);
-        set_sr_bit(StatusRegisterBit::ZERO, result == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, result >> 7);
+        modify(result);
+        set_nz(result);
         break;
     }
     case InstructionId::DEX:
         // Decrement the X register
         // Subtracts one from the X register setting the zero and negative flags as appropriate.
         xr--;
-        set_sr_bit(StatusRegisterBit::ZERO, xr == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, xr >> 7);
+        set_nz(xr);
         break;
     case InstructionId::DEY:
         // Decrement the Y register
         // Subtracts one from the Y register setting the zero and negative flags as appropriate.
         yr--;
-        set_sr_bit(StatusRegisterBit::ZERO, yr == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, yr >> 7);
+        set_nz(yr);
         break;
 
         // ***************************
@@ -500,7 +926,7 @@ bool MOS6502::execute()
         // The effect of this operation is to multiply the memory contents by 2 (ignoring 2's complement
         // considerations), setting the carry if the result will not fit in 8 bits. Carry flag: store the bit that is
         // going to be displaced
-        set_sr_bit(StatusRegisterBit::CARRY, value & 0x80);
+        carry = value >> 7;
         uint8_t result = value << 1;
         if (opcode.addressing_mode == AddressingMode::ACC)
         {
@@ -508,17 +934,16 @@ bool MOS6502::execute()
         }
         else
         {
-            mmio->set(address, result);
+            modify(result);
         }
-        set_sr_bit(StatusRegisterBit::ZERO, result == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, result >> 7);
+        set_nz(result);
         break;
     }
     case InstructionId::LSR: {
         // Logical shift right
         // Each of the bits in A or M is shift one place to the right.
         // The bit that was in bit 0 is shifted into the carry flag. Bit 7 is set to zero.
-        set_sr_bit(StatusRegisterBit::CARRY, value & 0x1);
+        carry = value & 0x1;
         uint8_t result = value >> 1;
         if (opcode.addressing_mode == AddressingMode::ACC)
         {
@@ -526,10 +951,9 @@ bool MOS6502::execute()
         }
         else
         {
-            mmio->set(address, result);
+            modify(result);
         }
-        set_sr_bit(StatusRegisterBit::ZERO, result == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, result >> 7);
+        set_nz(result);
         break;
     }
     case InstructionId::ROL: {
@@ -537,10 +961,8 @@ bool MOS6502::execute()
         // Move each of the bits in either A or M one place to the left.
         // Bit 0 is filled with the current value of the carry flag whilst the old bit 7 becomes the new carry flag
         // value.
-        uint8_t new_carry = value & 0x80;
-        uint8_t result = value << 1;
-        result = get_sr_bit(StatusRegisterBit::CARRY) ? (result | 1) : (result & ~1);
-        set_sr_bit(StatusRegisterBit::CARRY, new_carry);
+        uint8_t result = (value << 1) | carry;
+        carry = value >> 7;
         // Finally assign
         if (opcode.addressing_mode == AddressingMode::ACC)
         {
@@ -548,10 +970,9 @@ bool MOS6502::execute()
         }
         else
         {
-            mmio->set(address, result);
+            modify(result);
         }
-        set_sr_bit(StatusRegisterBit::ZERO, result == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, result >> 7);
+        set_nz(result);
         break;
     }
     case InstructionId::ROR: {
@@ -559,10 +980,8 @@ bool MOS6502::execute()
         // Move each of the bits in either A or M one place to the right.
         // Bit 7 is filled with the current value of the carry flag whilst the old bit 0 becomes the new carry flag
         // value.
-        uint8_t new_carry = value & 0x1;
-        uint8_t result = value >> 1;
-        result = get_sr_bit(StatusRegisterBit::CARRY) ? (result | (1 << 7)) : (result & ~(1 << 7));
-        set_sr_bit(StatusRegisterBit::CARRY, new_carry);
+        uint8_t result = (value >> 1) | (carry << 7);
+        carry = value & 0x1;
         // Finally assign
         if (opcode.addressing_mode == AddressingMode::ACC)
         {
@@ -570,10 +989,9 @@ bool MOS6502::execute()
         }
         else
         {
-            mmio->set(address, result);
+            modify(result);
         }
-        set_sr_bit(StatusRegisterBit::ZERO, result == 0);
-        set_sr_bit(StatusRegisterBit::NEGATIVE, result >> 7);
+        set_nz(result);
         break;
     }
 
@@ -597,9 +1015,14 @@ bool MOS6502::execute()
         // address +3, but it will put the current address +2, and RTS will pop this address from the stack
         // and perform +1 before jumping. This is to prevent the creation of additional registers in the chip.
         uint16_t address_to_stack = pc + 2;
+        // The chip reads the top of the stack while it stores the LSB of the target internally
+        bus->get(STACK_OFFSET + (uint16_t)sp);
         // The LSB will end up at the top of the stack
         push_to_stack((uint8_t)(address_to_stack >> 8));
         push_to_stack((uint8_t)(address_to_stack & 0xFF));
+        // Only now the MSB of the target is read
+        instruction_byte_2 = bus->get(pc + 2);
+        address = ((uint16_t)instruction_byte_2 << 8) + (uint16_t)instruction_byte_1;
         pc = address;
         advance_pc = false;
         break;
@@ -609,8 +1032,11 @@ bool MOS6502::execute()
         // The RTS instruction is used at the end of a subroutine to return to the calling routine.
         // It pulls the program counter (minus one) from the stack.
         // The LSB is available at the top of the stack
+        bus->get(STACK_OFFSET + (uint16_t)sp);
         uint16_t address_in_stack = (uint16_t)pull_from_stack();
         address_in_stack += (uint16_t)pull_from_stack() << 8;
+        // The chip reads the pulled address before incrementing it
+        bus->get(address_in_stack);
         pc = address_in_stack + 1;
         advance_pc = false;
         break;
@@ -624,81 +1050,49 @@ bool MOS6502::execute()
         // Branch if carry flag clear
         // If the carry flag is clear then add the relative displacement
         // to the program counter to cause a branch to a new location.
-        if (!get_sr_bit(StatusRegisterBit::CARRY))
-        {
-            pc = address;
-            advance_pc = false;
-        }
+        branch(!get_sr_bit(StatusRegisterBit::CARRY));
         break;
     case InstructionId::BCS:
         // Branch if carry flag set
         // If the carry flag is set then add the relative displacement to the program counter
         // to cause a branch to a new location.
-        if (get_sr_bit(StatusRegisterBit::CARRY))
-        {
-            pc = address;
-            advance_pc = false;
-        }
+        branch(get_sr_bit(StatusRegisterBit::CARRY));
         break;
     case InstructionId::BEQ:
         // Branch if zero flag set
         // If the zero flag is set then add the relative displacement to the program counter
         // to cause a branch to a new location.
-        if (get_sr_bit(StatusRegisterBit::ZERO))
-        {
-            pc = address;
-            advance_pc = false;
-        }
+        branch(get_sr_bit(StatusRegisterBit::ZERO));
         break;
     case InstructionId::BMI:
         // Branch if negative flag set
         // If the negative flag is set then add the relative displacement to the program counter
         // to cause a branch to a new location.
-        if (get_sr_bit(StatusRegisterBit::NEGATIVE))
-        {
-            pc = address;
-            advance_pc = false;
-        }
+        branch(get_sr_bit(StatusRegisterBit::NEGATIVE));
         break;
     case InstructionId::BNE:
         // Branch if zero flag clear
         // If the zero flag is clear then add the relative displacement to the program counter
         // to cause a branch to a new location.
-        if (!get_sr_bit(StatusRegisterBit::ZERO))
-        {
-            pc = address;
-            advance_pc = false;
-        }
+        branch(!get_sr_bit(StatusRegisterBit::ZERO));
         break;
     case InstructionId::BPL:
         // Branch if negative flag clear
         // If the negative flag is clear then add the relative displacement to the program counter
         // to cause a branch to a new location.
-        if (!get_sr_bit(StatusRegisterBit::NEGATIVE))
-        {
-            pc = address;
-            advance_pc = false;
-        }
+        branch(!get_sr_bit(StatusRegisterBit::NEGATIVE));
         break;
     case InstructionId::BVC:
         // Branch if overflow flag clear
         // If the overflow flag is clear then add the relative displacement to the program counter
         // to cause a branch to a new location.
-        if (!get_sr_bit(StatusRegisterBit::OVERFLOW))
-        {
-            pc = address;
-            advance_pc = false;
-        }
+        branch(!get_sr_bit(StatusRegisterBit::OVERFLOW));
         break;
     case InstructionId::BVS:
         // Branch if overflow flag set
         // If the overflow flag is set then add the relative displacement to the program counter
         // to cause a branch to a new location.
-        if (get_sr_bit(StatusRegisterBit::OVERFLOW))
-        {
-            pc = address;
-            advance_pc = false;
-        }
+        branch(get_sr_bit(StatusRegisterBit::OVERFLOW));
         break;
 
         // ***************************
@@ -743,12 +1137,14 @@ bool MOS6502::execute()
         // The BRK instruction forces the generation of an interrupt request.
         // The program counter and processor status are pushed on the stack then the IRQ interrupt vector at $FFFE/F
         // is loaded into the PC and the break flag in the status set to one.
-        push_to_stack((uint8_t)(pc >> 8));
-        push_to_stack((uint8_t)(pc & 0xFF));
+        // Note: BRK is followed by a padding byte that the chip skips, so the return address is pc + 2
+        push_to_stack((uint8_t)((pc + 2) >> 8));
+        push_to_stack((uint8_t)((pc + 2) & 0xFF));
         // Note: BRK will push the sr with the B flag set
         // Note: the ignored flag is always pushed as 1
-        push_to_stack(sr | (1 << (uint8_t)StatusRegisterBit::BREAK) | (1 << (uint8_t)StatusRegisterBit::IGNORED));
-        pc = (static_cast<uint16_t>(mmio->get(IRQ_VECTOR + 1)) << 8) + static_cast<uint16_t>(mmio->get(IRQ_VECTOR));
+        push_to_stack(get_sr() | (1 << (uint8_t)StatusRegisterBit::BREAK) | (1 << (uint8_t)StatusRegisterBit::IGNORED));
+        set_sr_bit(StatusRegisterBit::INTERRUPT, 1);
+        pc = (static_cast<uint16_t>(bus->get(IRQ_VECTOR + 1)) << 8) + static_cast<uint16_t>(bus->get(IRQ_VECTOR));
         advance_pc = false;
         break;
     case InstructionId::NOP:
@@ -760,8 +1156,9 @@ bool MOS6502::execute()
         // Return from interrupt
         // The RTI instruction is used at the end of an interrupt processing routine.
         // It pulls the processor flags from the stack followed by the program counter.
-        sr = ((pull_from_stack() & ~(1 << (uint8_t)StatusRegisterBit::BREAK)) |
-              (1 << (uint8_t)StatusRegisterBit::IGNORED));
+        bus->get(STACK_OFFSET + (uint16_t)sp);
+        set_sr((pull_from_stack() & ~(1 << (uint8_t)StatusRegisterBit::BREAK)) |
+               (1 << (uint8_t)StatusRegisterBit::IGNORED));
         uint8_t pc_lsb = pull_from_stack();
         uint8_t pc_msb = pull_from_stack();
         pc = ((uint16_t)pc_msb << 8) + (uint16_t)pc_lsb;
@@ -769,84 +1166,406 @@ bool MOS6502::execute()
         break;
     }
 
-    default:
-        // TODO: exception
+        // ***************************
+        // Unofficial combined operations
+        // ***************************
+
+    case InstructionId::LAX:
+        // Load accumulator and X register
+        // Loads a byte of memory into the accumulator and the X register
+        // setting the zero and negative flags as appropriate.
+        acc = value;
+        xr = value;
+        set_nz(acc);
+        break;
+    case InstructionId::SAX:
+        // Store accumulator AND X register
+        // Stores the bitwise AND of the accumulator and the X register into memory. No flags are affected.
+        write(address, acc & xr);
+        break;
+    case InstructionId::DCP: {
+        // Decrement a memory location and compare accumulator
+        // Equivalent to DEC followed by CMP with the decremented value.
+        uint8_t result = value - 1;
+        modify(result);
+        carry = acc >= result;
+        set_nz(acc - result);
+        break;
+    }
+    case InstructionId::ISB: {
+        // Increment a memory location and subtract with carry
+        // Equivalent to INC followed by SBC with the incremented value.
+        uint8_t result = value + 1;
+        modify(result);
+        adc(~result);
+        break;
+    }
+    case InstructionId::SLO: {
+        // Arithmetic shift left a memory location and logical inclusive OR
+        // Equivalent to ASL followed by ORA with the shifted value.
+        carry = value >> 7;
+        uint8_t result = value << 1;
+        modify(result);
+        acc |= result;
+        set_nz(acc);
+        break;
+    }
+    case InstructionId::RLA: {
+        // Rotate left a memory location and logical AND
+        // Equivalent to ROL followed by AND with the rotated value.
+        uint8_t result = (value << 1) | carry;
+        carry = value >> 7;
+        modify(result);
+        acc &= result;
+        set_nz(acc);
+        break;
+    }
+    case InstructionId::SRE: {
+        // Logical shift right a memory location and exclusive OR
+        // Equivalent to LSR followed by EOR with the shifted value.
+        carry = value & 0x1;
+        uint8_t result = value >> 1;
+        modify(result);
+        acc ^= result;
+        set_nz(acc);
+        break;
+    }
+    case InstructionId::RRA: {
+        // Rotate right a memory location and add with carry
+        // Equivalent to ROR followed by ADC with the rotated value, using the carry left by the rotation.
+        uint8_t result = (value >> 1) | (carry << 7);
+        carry = value & 0x1;
+        modify(result);
+        adc(result);
+        break;
+    }
+
+        // ***************************
+        // Unofficial immediate operations
+        // ***************************
+
+    case InstructionId::ANC:
+        // Logical AND and copy the negative flag to the carry flag
+        acc &= value;
+        set_nz(acc);
+        carry = acc >> 7;
+        break;
+    case InstructionId::ALR:
+        // Logical AND and logical shift right the accumulator
+        acc &= value;
+        carry = acc & 0x1;
+        acc >>= 1;
+        set_nz(acc);
+        break;
+    case InstructionId::ARR:
+        // Logical AND and rotate right the accumulator
+        // The carry flag takes bit 6 of the result and the overflow flag is bit 6 XOR bit 5.
+        acc = ((acc & value) >> 1) | (carry << 7);
+        set_nz(acc);
+        carry = (acc >> 6) & 0x1;
+        set_sr_bit(StatusRegisterBit::OVERFLOW, ((acc >> 6) ^ (acc >> 5)) & 0x1);
+        break;
+    case InstructionId::AXS: {
+        // Accumulator AND X register minus immediate into X register
+        // The subtraction is done like CMP, without borrow, and sets the carry flag in the same way.
+        uint8_t result = acc & xr;
+        carry = result >= value;
+        xr = result - value;
+        set_nz(xr);
+        break;
+    }
+    case InstructionId::XAA:
+        // Transfer X register to accumulator and logical AND
+        // Note: unstable in the real chip, the constant that is ORed with the accumulator depends on the chip
+        acc = (acc | UNSTABLE_CONSTANT) & xr & value;
+        set_nz(acc);
+        break;
+    case InstructionId::LXA:
+        // Logical AND and load accumulator and X register
+        // Note: unstable in the real chip, the constant that is ORed with the accumulator depends on the chip
+        acc = (acc | UNSTABLE_CONSTANT) & value;
+        xr = acc;
+        set_nz(acc);
+        break;
+
+        // ***************************
+        // Unofficial operations with unstable addressing
+        // ***************************
+
+    case InstructionId::LAS:
+        // Logical AND with stack pointer into accumulator, X register and stack pointer
+        sp &= value;
+        acc = sp;
+        xr = sp;
+        set_nz(acc);
+        break;
+    case InstructionId::AHX:
+        // Store accumulator AND X register AND high byte of the address
+        store_and_high(acc & xr);
+        break;
+    case InstructionId::SHX:
+        // Store X register AND high byte of the address
+        store_and_high(xr);
+        break;
+    case InstructionId::SHY:
+        // Store Y register AND high byte of the address
+        store_and_high(yr);
+        break;
+    case InstructionId::TAS:
+        // Transfer accumulator AND X register to stack pointer and store it AND high byte of the address
+        sp = acc & xr;
+        store_and_high(sp);
         break;
+
+        // ***************************
+        // Unofficial system functions
+        // ***************************
+
+    case InstructionId::KIL:
+        // Jam the processor
+        // The real chip stops fetching instructions until it is reset. The pc is not advanced
+        // and the CPU refuses to execute anything else.
+        jammed = true;
+        common::Log(common::LogLevel::ERROR, "CPU jammed by opcode " + common::print_hex(opcode.raw, sizeof(uint8_t)) +
+                                                 " at " + common::print_hex(pc, sizeof(pc)));
+        return false;
     }
 
     // Jump as many bytes as indicated by the opcode
     if (advance_pc)
     {
-        common::Log(common::LogLevel::DEBUG, "Increase PC " + std::to_string(+opcode.instruction_size) + " bytes");
         pc += opcode.instruction_size;
     }
-    else
+    if (!common::is_muted())
     {
-        common::Log(common::LogLevel::DEBUG, "PC not increased");
+        common::Log(common::LogLevel::DEBUG, advance_pc ? "Increase PC " + std::to_string(+opcode.instruction_size) +
+                                                              " bytes"
+                                                        : std::string("PC not increased"));
+        common::Log(common::LogLevel::DEBUG, "CPU status: " + print_status());
     }
-    common::Log(common::LogLevel::DEBUG, "CPU status: " + print_status());
 
     return true;
 }
 
-void MOS6502::fetch()
+template <typename BusType>
+void MOS6502<BusType>::fetch()
+{
+    switch (opcode.memory_access)
+    {
+    case MemoryAccess::READ:
+    case MemoryAccess::READ_MODIFY_WRITE:
+        value = bus->get(address);
+        break;
+    case MemoryAccess::NONE:
+    case MemoryAccess::WRITE:
+        // Stores, jumps and implied instructions do not read the resolved address
+        break;
+    }
+}
+
+template <typename BusType>
+void MOS6502<BusType>::log_code_data()
 {
+    code_data_logger->mark(pc, CDL_CODE | CDL_OPCODE);
+    for (size_t i = 1; i < opcode.instruction_size; i++)
+    {
+        code_data_logger->mark(pc + i, CDL_CODE);
+    }
+
+    const bool reads = opcode.memory_access == MemoryAccess::READ ||
+                       opcode.memory_access == MemoryAccess::READ_MODIFY_WRITE;
     switch (opcode.addressing_mode)
     {
+    case AddressingMode::IND:
+        // The pointer is data, the address it holds is code
+        code_data_logger->mark(intermediate_address, CDL_DATA);
+        code_data_logger->mark((intermediate_address & 0xFF00) + ((intermediate_address + 1) & 0xFF), CDL_DATA);
+        code_data_logger->mark(address, CDL_INDIRECT_CODE);
+        break;
+    case AddressingMode::IXI:
+    case AddressingMode::IIX:
+        if (reads)
+        {
+            code_data_logger->mark(address, CDL_DATA | CDL_INDIRECT_DATA);
+        }
+        break;
     case AddressingMode::IMP:
     case AddressingMode::ACC:
     case AddressingMode::IMM:
     case AddressingMode::REL:
         break;
-    case AddressingMode::ZP0:
-    case AddressingMode::ZPX:
-    case AddressingMode::ZPY:
-    case AddressingMode::ABS:
-    case AddressingMode::ABX:
-    case AddressingMode::ABY:
-    case AddressingMode::IND:
-    case AddressingMode::IXI:
-    case AddressingMode::IIX:
-        value = mmio->get(address);
+    default:
+        if (reads)
+        {
+            code_data_logger->mark(address, CDL_DATA);
+        }
         break;
     }
 }
 
-uint8_t MOS6502::get_sr_bit(StatusRegisterBit bit)
+template <typename BusType>
+uint8_t MOS6502<BusType>::get_sr_bit(StatusRegisterBit bit)
 {
-    return (sr >> (uint8_t)bit) & 0x1;
+    switch (bit)
+    {
+    case StatusRegisterBit::CARRY:
+        return carry;
+    case StatusRegisterBit::ZERO:
+        return z_result == 0;
+    case StatusRegisterBit::OVERFLOW:
+        // Same condition that ADC used to evaluate eagerly: operands with the same sign
+        // and a result with a different one
+        return ((~(v_acc ^ v_operand) & (v_acc ^ v_result)) >> 7) & 0x1;
+    case StatusRegisterBit::NEGATIVE:
+        return n_result >> 7;
+    default:
+        return (sr >> (uint8_t)bit) & 0x1;
+    }
 }
 
-void MOS6502::set_sr_bit(StatusRegisterBit bit, const uint8_t value)
+template <typename BusType>
+void MOS6502<BusType>::set_sr_bit(StatusRegisterBit bit, const uint8_t value)
 {
-    if (value)
-    {
-        sr |= 1 << static_cast<typename std::underlying_type<StatusRegisterBit>::type>(bit);
-    }
-    else
+    switch (bit)
     {
-        sr &= ~(1 << static_cast<typename std::underlying_type<StatusRegisterBit>::type>(bit));
+    case StatusRegisterBit::CARRY:
+        carry = value ? 1 : 0;
+        break;
+    case StatusRegisterBit::ZERO:
+        z_result = value ? 0 : 1;
+        break;
+    case StatusRegisterBit::OVERFLOW:
+        // Fake operands of the same sign so that the result alone decides the flag
+        v_acc = 0;
+        v_operand = 0;
+        v_result = value ? 0x80 : 0;
+        break;
+    case StatusRegisterBit::NEGATIVE:
+        n_result = value ? 0x80 : 0;
+        break;
+    default:
+        if (value)
+        {
+            sr |= 1 << static_cast<typename std::underlying_type<StatusRegisterBit>::type>(bit);
+        }
+        else
+        {
+            sr &= ~(1 << static_cast<typename std::underlying_type<StatusRegisterBit>::type>(bit));
+        }
+        break;
     }
 }
 
-void MOS6502::push_to_stack(uint8_t value)
+template <typename BusType>
+uint8_t MOS6502<BusType>::get_sr()
+{
+    uint8_t result = sr & ~LAZY_FLAGS_MASK;
+    result |= get_sr_bit(StatusRegisterBit::CARRY) << (uint8_t)StatusRegisterBit::CARRY;
+    result |= get_sr_bit(StatusRegisterBit::ZERO) << (uint8_t)StatusRegisterBit::ZERO;
+    result |= get_sr_bit(StatusRegisterBit::OVERFLOW) << (uint8_t)StatusRegisterBit::OVERFLOW;
+    result |= get_sr_bit(StatusRegisterBit::NEGATIVE) << (uint8_t)StatusRegisterBit::NEGATIVE;
+    return result;
+}
+
+template <typename BusType>
+void MOS6502<BusType>::set_sr(const uint8_t value)
+{
+    sr = value & ~LAZY_FLAGS_MASK;
+    set_sr_bit(StatusRegisterBit::CARRY, (value >> (uint8_t)StatusRegisterBit::CARRY) & 0x1);
+    set_sr_bit(StatusRegisterBit::ZERO, (value >> (uint8_t)StatusRegisterBit::ZERO) & 0x1);
+    set_sr_bit(StatusRegisterBit::OVERFLOW, (value >> (uint8_t)StatusRegisterBit::OVERFLOW) & 0x1);
+    set_sr_bit(StatusRegisterBit::NEGATIVE, (value >> (uint8_t)StatusRegisterBit::NEGATIVE) & 0x1);
+}
+
+template <typename BusType>
+void MOS6502<BusType>::set_nz(const uint8_t result)
+{
+    z_result = result;
+    n_result = result;
+}
+
+template <typename BusType>
+void MOS6502<BusType>::push_to_stack(uint8_t value)
 {
-    mmio->set(STACK_OFFSET + (uint16_t)sp, value);
+    write(STACK_OFFSET + (uint16_t)sp, value);
     sp--;
 }
 
-uint8_t MOS6502::pull_from_stack()
+template <typename BusType>
+void MOS6502<BusType>::write(const uint16_t address, const uint8_t value)
+{
+    bus->set(address, value);
+    writes++;
+    if (trace_control)
+    {
+        trace_control->check_write(address);
+    }
+    if (trace_store)
+    {
+        trace_store->add_access(address, value, debug::AccessKind::WRITE);
+    }
+}
+
+template <typename BusType>
+uint8_t MOS6502<BusType>::pull_from_stack()
 {
     sp++;
-    return mmio->get(STACK_OFFSET + (uint16_t)sp);
+    return bus->get(STACK_OFFSET + (uint16_t)sp);
+}
+
+template <typename BusType>
+void MOS6502<BusType>::modify(const uint8_t result)
+{
+    // The chip writes the unmodified value back while it computes the result
+    write(address, value);
+    write(address, result);
+}
+
+template <typename BusType>
+void MOS6502<BusType>::branch(const bool condition)
+{
+    if (!condition)
+    {
+        return;
+    }
+
+    // A taken branch reads the next opcode and throws it away while it adds the offset to the low byte of
+    // the pc. If the target is on another page, the wrong address is read while the high byte is fixed
+    uint16_t next_pc = pc + opcode.instruction_size;
+    bus->get(next_pc);
+    cycles++;
+    if ((next_pc & 0xFF00) != (address & 0xFF00))
+    {
+        bus->get((next_pc & 0xFF00) | (address & 0x00FF));
+        cycles++;
+    }
+
+    pc = address;
+    advance_pc = false;
+}
+
+template <typename BusType>
+void MOS6502<BusType>::store_and_high(const uint8_t data)
+{
+    // The value is ANDed with the high byte of the unindexed address plus one. When the index crosses
+    // a page, the chip also uses the stored value as the high byte of the address
+    uint8_t index = opcode.addressing_mode == AddressingMode::ABX ? xr : yr;
+    uint16_t base_address = address - index;
+    uint8_t result = data & (uint8_t)((base_address >> 8) + 1);
+    if (page_crossed)
+    {
+        address = ((uint16_t)result << 8) | (address & 0x00FF);
+    }
+    write(address, result);
 }
 
-void MOS6502::adc(uint8_t value)
+template <typename BusType>
+void MOS6502<BusType>::adc(uint8_t value)
 {
-    uint16_t result = acc + value + get_sr_bit(StatusRegisterBit::CARRY);
+    uint16_t result = acc + value + carry;
     // Set the carry flag if the result has overflowed the byte
-    set_sr_bit(StatusRegisterBit::CARRY, result > 0xFF);
-    // Set the overflow flag if the result has the "wrong" sign.
+    carry = result >> 8;
+    // The overflow flag is set if the result has the "wrong" sign.
     // * If acc and value have different sign, one of them is negative and the other is positive.
     //   Starting from a negative number and adding a positive number we would never get a wrong sign.
     //   Even if the carry bit is set, a 1 will not change this condition
@@ -854,176 +1573,58 @@ void MOS6502::adc(uint8_t value)
     //   - Both negative and the result is positive
     //   - Both positive and the result is negative
     // * This condition is converted to both with the same sign and the result with different sign
-    set_sr_bit(StatusRegisterBit::OVERFLOW, ~(acc ^ value) & (acc ^ result) & 0x80);
+    // Only the operands are kept here, the flag is computed by get_sr_bit if somebody asks for it
+    v_acc = acc;
+    v_operand = value;
+    v_result = result & 0xFF;
     // Assign
     acc = result & 0xFF;
-    set_sr_bit(StatusRegisterBit::ZERO, acc == 0);
-    set_sr_bit(StatusRegisterBit::NEGATIVE, acc >> 7);
+    set_nz(acc);
 }
 
-std::string MOS6502::print_status()
+template <typename BusType>
+std::string MOS6502<BusType>::print_status()
 {
-    std::stringstream status;
-
-    // Status register
-    status << "SR[";
-    status << "N" << (get_sr_bit(StatusRegisterBit::NEGATIVE) ? "1" : "0") << " ";
-    status << "V" << (get_sr_bit(StatusRegisterBit::OVERFLOW) ? "1" : "0") << " ";
-    status << "I" << (get_sr_bit(StatusRegisterBit::IGNORED) ? "1" : "0") << " ";
-    status << "B" << (get_sr_bit(StatusRegisterBit::BREAK) ? "1" : "0") << " ";
-    status << "D" << (get_sr_bit(StatusRegisterBit::DECIMAL) ? "1" : "0") << " ";
-    status << "I" << (get_sr_bit(StatusRegisterBit::INTERRUPT) ? "1" : "0") << " ";
-    status << "Z" << (get_sr_bit(StatusRegisterBit::ZERO) ? "1" : "0") << " ";
-    status << "C" << (get_sr_bit(StatusRegisterBit::CARRY) ? "1" : "0");
-    status << "] ";
-
-    // Accumulator
-    status << "ACC[" << common::print_hex(acc, sizeof(acc)) << "] ";
-
-    // X register
-    status << "X[" << common::print_hex(xr, sizeof(xr)) << "] ";
-
-    // Y register
-    status << "Y[" << common::print_hex(yr, sizeof(yr)) << "] ";
-
-    // Stack pointer
-    status << "SP[" << common::print_hex(sp, sizeof(sp)) << "] ";
-
-    return status.str();
+    char status[STATUS_LENGTH];
+    return std::string(status, format_status(get_sr(), acc, xr, yr, sp, status));
 }
 
-std::string MOS6502::disassemble()
+template <typename BusType>
+size_t MOS6502<BusType>::disassemble(char *line, const uint64_t instruction_cycles)
 {
-    std::stringstream result;
-
-    // Program counter
-    result << common::print_hex(pc, sizeof(pc)) << "  ";
-
-    // Bulk of bytes of the current instruction
-    std::string instruction_bytes;
-    instruction_bytes += common::print_hex(opcode.raw, sizeof(uint8_t)) + " ";
-    if (opcode.instruction_size >= 2)
+    // The record is added before execution, so the last byte of JSR and the value at the address of
+    // instructions that do not read it are still unknown. Peek them, as peeking has no side effects
+    if (opcode.instruction_id == InstructionId::JSR)
     {
-        instruction_bytes += common::print_hex(instruction_byte_1, sizeof(instruction_byte_1)) + " ";
+        instruction_byte_2 = bus->peek(pc + 2);
     }
-    if (opcode.instruction_size >= 3)
+    uint8_t address_value = value;
+    if (opcode.memory_access == MemoryAccess::WRITE)
     {
-        instruction_bytes += common::print_hex(instruction_byte_2, sizeof(instruction_byte_2)) + " ";
+        address_value = bus->peek(address);
     }
-    result << std::left << std::setw(10) << instruction_bytes;
-
-    // Name of the instruction
-    result << print_instruction_id(opcode.instruction_id) << " ";
 
-    // Addressing
-    std::string details;
-    switch (opcode.addressing_mode)
-    {
-    case AddressingMode::IMP:
-        // Implicit
-        break;
-    case AddressingMode::ACC:
-        // Accumulator
-        // example "LSR A"
-        details += "A";
-        break;
-    case AddressingMode::IMM:
-        // Immediate
-        // example "LDA #$66"
-        details += "#$" + common::print_hex(instruction_byte_1, sizeof(instruction_byte_1));
-        break;
-    case AddressingMode::ZP0:
-        // Zero page
-        // example "LDA $33 = 44"
-        details += "$" + common::print_hex(instruction_byte_1, sizeof(instruction_byte_1)) + " = " +
-                   common::print_hex(value, sizeof(value));
-        break;
-    case AddressingMode::ZPX:
-        // Zero page X
-        // example "LDX $00,Y @ 78 = 33"
-        details += "$" + common::print_hex(instruction_byte_1, sizeof(instruction_byte_1)) + ",X @ " +
-                   common::print_hex((uint8_t)address, 1) + " = " + common::print_hex(value, sizeof(value));
-        break;
-    case AddressingMode::ZPY:
-        // Zero page Y
-        // example "LDY $33,Y @ 33 = AA"
-        details += "$" + common::print_hex(instruction_byte_1, sizeof(instruction_byte_1)) + ",Y @ " +
-                   common::print_hex((uint8_t)address, 1) + " = " + common::print_hex(value, sizeof(value));
-        break;
-    case AddressingMode::REL:
-        // Relative
-        details += "$" + common::print_hex(address, sizeof(address));
-        break;
-    case AddressingMode::ABS:
-        // Absolute
-        details += "$" + common::print_hex(address, sizeof(address));
-        switch (opcode.instruction_id)
-        {
-        case InstructionId::JMP:
-        case InstructionId::JSR:
-            break;
-        default:
-            details += " = " + common::print_hex(value, sizeof(value));
-            break;
-        }
-        break;
-    case AddressingMode::ABX:
-        // Absolute X
-        // example "LDA $0300,X @ 0300 = 89"
-        details +=
-            "$" +
-            common::print_hex(((uint16_t)instruction_byte_2 << 8) + (uint16_t)instruction_byte_1, sizeof(uint16_t)) +
-            ",X @ " + common::print_hex(address, sizeof(address)) + " = " + common::print_hex(value, sizeof(value));
-        break;
-    case AddressingMode::ABY:
-        // Absolute Y
-        // example "LDA $0300,Y @ 0300 = 89"
-        details +=
-            "$" +
-            common::print_hex(((uint16_t)instruction_byte_2 << 8) + (uint16_t)instruction_byte_1, sizeof(uint16_t)) +
-            ",Y @ " + common::print_hex(address, sizeof(address)) + " = " + common::print_hex(value, sizeof(value));
-        break;
-    case AddressingMode::IND:
-        // Indirect
-        // example "JMP ($0200) = DB7E"
-        details +=
-            "($" +
-            common::print_hex(((uint16_t)instruction_byte_2 << 8) + (uint16_t)instruction_byte_1, sizeof(uint16_t)) +
-            ") = " + common::print_hex(address, sizeof(address));
-        break;
-    case AddressingMode::IXI:
-        // Indexed indirect
-        // example "LDA ($80,X) @ 80 = 0200 = 5A"
-        details += "($" + common::print_hex(instruction_byte_1, sizeof(instruction_byte_1)) + ",X) @ " +
-                   common::print_hex((uint8_t)intermediate_address, sizeof(uint8_t)) + " = " +
-                   common::print_hex(address, sizeof(address)) + " = " + common::print_hex(value, sizeof(value));
-        break;
-    case AddressingMode::IIX:
-        // Indirect indexed
-        // example "LDA ($89),Y = 0300 @ 0300 = 89"
-        details += "($" + common::print_hex(instruction_byte_1, sizeof(instruction_byte_1)) +
-                   "),Y = " + common::print_hex(intermediate_address, sizeof(intermediate_address)) + " @ " +
-                   common::print_hex(address, sizeof(address)) + " = " + common::print_hex(value, sizeof(value));
-        break;
-    }
-    result << std::left << std::setw(28) << details;
-
-    // Accumulator
-    result << "A:" << common::print_hex(acc, sizeof(acc)) << " ";
-
-    // X
-    result << "X:" << common::print_hex(xr, sizeof(xr)) << " ";
-
-    // Y
-    result << "Y:" << common::print_hex(yr, sizeof(yr)) << " ";
-
-    // P
-    result << "P:" << common::print_hex(sr, sizeof(sr)) << " ";
-
-    // Stack pointer
-    result << "SP:" << common::print_hex(sp, sizeof(sp));
-
-    return result.str();
+    TraceRecord record;
+    record.pc = pc;
+    record.opcode = opcode.raw;
+    record.byte_1 = instruction_byte_1;
+    record.byte_2 = instruction_byte_2;
+    record.address = address;
+    record.intermediate_address = intermediate_address;
+    record.value = address_value;
+    record.acc = acc;
+    record.xr = xr;
+    record.yr = yr;
+    record.sr = get_sr();
+    record.sp = sp;
+    record.cycles = instruction_cycles;
+    return format_trace_line(record, line);
 }
 
-} // namespace cpu
\ No newline at end of file
+/// The CPU is built for the dynamic bus interface, usable with any bus at the cost of a virtual call per access,
+/// and for the concrete buses, whose accesses are inlined into the instruction handlers
+template class MOS6502<mmio::Bus>;
+template class MOS6502<mmio::Mmio>;
+template class MOS6502<mmio::FlatBus>;
+
+} // namespace cpu
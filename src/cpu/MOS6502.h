@@ -3,25 +3,37 @@
 
 #include <cstdint>
 #include <map>
-#include <memory>
 
+#include "CodeDataLogger.h"
 #include "OpcodeParser.h"
+#include "Registers.h"
 #include "StatusRegisterBit.h"
 #include "common/Logging.h"
-#include "mmio/Mmio.h"
+#include "debug/AccessHeatmap.h"
+#include "debug/Breakpoints.h"
+#include "debug/BusRecorder.h"
+#include "debug/TraceControl.h"
+#include "debug/TraceStore.h"
+#include "mmio/Bus.h"
 
 namespace cpu
 {
 
 /// @brief MOS technologies 6502 chip without decimal mode, as this mode
-/// was not implemented in the chip included with the NES
-class MOS6502
+/// was not implemented in the chip included with the NES.
+/// The chip is a template over the bus it is connected to. With a concrete bus (mmio::Mmio, mmio::FlatBus)
+/// the memory accesses are resolved at compile time and inlined, with the abstract mmio::Bus any
+/// implementation can be connected at the cost of a virtual call per access
+/// @tparam BusType The address bus type, it has to provide get, peek and set like mmio::Bus
+template <typename BusType = mmio::Bus> class MOS6502
 {
   public:
     MOS6502() = default;
 
     /// @brief Constructor
-    MOS6502(const std::shared_ptr<mmio::Mmio> &mmio);
+    /// @param bus The address bus the CPU will be connected to. It is not owned by the CPU and has
+    /// to outlive it
+    MOS6502(BusType *bus);
 
     /// @brief Override the default reset vector with the provided pc.
     /// This function has to be called before reset
@@ -32,13 +44,93 @@ class MOS6502
     /// @param num_instructions Max number of instructions to execute
     void set_max_instructions(const size_t num_instructions);
 
-    /// @brief Sets the log file object such that the CPU can add records to it
-    void set_log_file(const std::shared_ptr<common::LogFile> &log_file);
+    /// @brief Sets the log file object such that the CPU can add records to it. The log file is not owned
+    /// by the CPU and has to outlive it, a null pointer disables the trace
+    void set_log_file(common::LogFile *log_file);
+
+    /// @brief Connect a trace control that decides which instructions go to the log file, which is not owned by
+    /// the CPU and has to outlive it. It is told about every write while connected. A null pointer traces every
+    /// instruction
+    void set_trace_control(debug::TraceControl *trace_control);
+
+    /// @brief Record every executed instruction, its operand read and its writes in the provided trace store, which
+    /// is not owned by the CPU and has to outlive it. A null pointer disables the recording
+    void set_trace_store(debug::TraceStoreWriter *trace_store);
+
+    /// @brief Tell the provided bus recorder where every instruction starts, so that it can stamp the accesses
+    /// recorded by the bus with their cycles. It is not owned by the CPU and has to outlive it, a null pointer
+    /// disconnects it. While connected, neither idle loops nor instruction pairs are fast-forwarded
+    void set_bus_recorder(debug::BusRecorder *bus_recorder);
+
+    /// @brief Count every executed instruction in the provided access heatmap, the reads and writes are counted by
+    /// the bus. It is not owned by the CPU and has to outlive it, a null pointer disconnects it. While connected,
+    /// neither idle loops nor instruction pairs are fast-forwarded
+    void set_heatmap(debug::AccessHeatmap *heatmap);
+
+    /// @brief Record how every executed instruction accesses the PRG ROM in the provided code/data logger, which is
+    /// not owned by the CPU and has to outlive it. A null pointer disables the recording. It only has an effect
+    /// when built with EMUNES_CDL, otherwise the hooks are compiled out
+    void set_code_data_logger(CodeDataLogger *code_data_logger);
+
+    /// @brief Connect the breakpoints, which are not owned by the CPU and have to outlive it. While they are
+    /// connected, run and run_until check them before every instruction and return when they stop the emulation,
+    /// and neither idle loops nor instruction pairs are fast-forwarded. A null pointer disconnects them
+    void set_breakpoints(debug::Breakpoints *breakpoints);
+
+    /// @brief Connect the CPU to another bus, e.g. after the machine state has been copied
+    /// @param bus The address bus the CPU will be connected to. It is not owned by the CPU and has
+    /// to outlive it
+    void set_bus(BusType *bus);
 
     /// @brief Reset the chip. This kickstarts execution
     /// @return True if the operation was successful
     bool reset();
 
+    /// @brief Put the chip in the state that follows the reset sequence, without executing anything.
+    /// Execution can then be driven with step or run_until
+    void power_on();
+
+    /// @brief Execute a single instruction, or a pair of them if instruction fusion is enabled, adding a
+    /// record to the log file if there is one
+    /// @return True if the operation was successful, false if the instruction failed or the CPU is jammed
+    bool step();
+
+    /// @brief Execute instructions until the cycle count reaches the provided one, which is normally the
+    /// next scheduled device event. Idle loops (short loops that do not write anything and end each iteration
+    /// in the state they started) are fast-forwarded, charging the cycles and instructions of the skipped
+    /// iterations, so the final state is the same as if every instruction had been stepped. This relies on the
+    /// bus reads returning the same values until the next event
+    /// @param cycle The cycle count to reach. The last instruction may end a few cycles past it
+    /// @return True if the operation was successful, false if an instruction failed or the CPU is jammed
+    bool run_until(const uint64_t cycle);
+
+    /// @brief Enable or disable the idle loop fast-forward of run_until (enabled by default)
+    void set_idle_loop_skipping(const bool enabled);
+
+    /// @brief Enable or disable the execution of common pairs of instructions as superinstructions (disabled
+    /// by default). When enabled, a step executes both instructions of a pair, with exactly the same bus
+    /// accesses and cycles. Pairs are never fused while tracing or logging, so the trace stays per instruction
+    void set_instruction_fusion(const bool enabled);
+
+    /// @brief Return the current value of the registers
+    Registers get_registers();
+
+    /// @brief Overwrite the registers. Together with step, this allows running the CPU from any state
+    /// without going through reset
+    void set_registers(const Registers &registers);
+
+    /// @brief Return the number of cycles executed since the CPU was powered on
+    uint64_t get_cycles() const;
+
+    /// @brief Return true if a KIL opcode has jammed the CPU
+    bool is_jammed() const;
+
+    /// @brief Return the number of instructions executed since reset, including the fast-forwarded ones
+    uint64_t get_instructions() const;
+
+    /// @brief Return the number of instructions that were fast-forwarded instead of executed since reset
+    uint64_t get_skipped_instructions() const;
+
   private:
     /// @brief Program counter
     uint16_t pc;
@@ -61,8 +153,28 @@ class MOS6502
     /// bit 2: I Interrupt
     /// bit 1: Zero
     /// bit 0: Carry
+    /// Only I, D, B and the ignored bit are stored here. N, V, Z and C are evaluated lazily
+    /// from the variables below, use get_sr / get_sr_bit to read the complete register
     uint8_t sr;
 
+    /// @brief Last result that decides the zero flag (Z is set if this is zero)
+    uint8_t z_result;
+
+    /// @brief Last result that decides the negative flag (N is its bit 7)
+    uint8_t n_result;
+
+    /// @brief The carry flag (always a 0 or a 1)
+    uint8_t carry;
+
+    /// @brief Accumulator before the last operation that decided the overflow flag
+    uint8_t v_acc;
+
+    /// @brief Operand of the last operation that decided the overflow flag
+    uint8_t v_operand;
+
+    /// @brief Result of the last operation that decided the overflow flag
+    uint8_t v_result;
+
     /// @brief Stack pointer (from the stack offset)
     uint8_t sp;
 
@@ -86,6 +198,30 @@ class MOS6502
     /// This variable is only set if it makes sense to do so
     uint16_t address;
 
+    /// @brief True if an indexed addressing mode has crossed a page when resolving the address
+    bool page_crossed = false;
+
+    /// @brief Number of cycles executed since the CPU was powered on
+    uint64_t cycles = 0;
+
+    /// @brief Number of instructions executed since reset
+    uint64_t instructions = 0;
+
+    /// @brief Number of instructions fast-forwarded by the idle loop detection since reset
+    uint64_t skipped_instructions = 0;
+
+    /// @brief Number of bus writes performed, used to tell idle loops apart
+    uint64_t writes = 0;
+
+    /// @brief If true, run_until fast-forwards idle loops
+    bool idle_loop_skipping = true;
+
+    /// @brief If true, common pairs of instructions are executed as superinstructions
+    bool instruction_fusion = false;
+
+    /// @brief True if a KIL opcode has jammed the CPU. Only a reset recovers from this state
+    bool jammed = false;
+
     /// @brief Flag indicating if the reset vector has been overriden
     bool rv_overriden = false;
 
@@ -97,14 +233,29 @@ class MOS6502
     /// If zero, the CPU will execute indefinitely
     size_t max_instructions = 0;
 
-    /// @brief Link to mmio for all calls to the bus
-    std::shared_ptr<mmio::Mmio> mmio;
+    /// @brief Link to the address bus for all the memory accesses
+    BusType *bus = nullptr;
 
     /// @brief Link to the official log file, to add records to it
-    std::shared_ptr<common::LogFile> log_file;
+    common::LogFile *log_file = nullptr;
+
+    /// @brief Link to the trace control, if the trace is limited to a window
+    debug::TraceControl *trace_control = nullptr;
 
-    /// @brief The opcode parser that will decode bytes into opcodes
-    OpcodeParser opcode_parser;
+    /// @brief Link to the trace store, if the instructions are being recorded
+    debug::TraceStoreWriter *trace_store = nullptr;
+
+    /// @brief Link to the bus recorder, if the bus accesses are being recorded
+    debug::BusRecorder *bus_recorder = nullptr;
+
+    /// @brief Link to the access heatmap, if the accesses are being counted
+    debug::AccessHeatmap *heatmap = nullptr;
+
+    /// @brief Link to the breakpoints, if connected
+    debug::Breakpoints *breakpoints = nullptr;
+
+    /// @brief Link to the code/data logger, if the accesses to the PRG ROM are being recorded
+    CodeDataLogger *code_data_logger = nullptr;
 
     /// @brief If true, the PC will advance, after the instruction execution, by as many
     /// bytes as the instruction size
@@ -114,12 +265,37 @@ class MOS6502
     /// @return True if the operation was successful
     bool run();
 
+    /// @brief Called when a loop has just jumped back to its head. Run one more iteration and, if it was idle,
+    /// fast-forward the iterations that fit before the provided cycle
+    /// @param cycle The cycle count run_until has to reach
+    /// @return True if the operation was successful
+    bool skip_idle_loop(const uint64_t cycle);
+
+    /// @brief Execute the pair of instructions started by the current opcode as a single superinstruction.
+    /// If the second opcode turns out not to complete the pair, it is executed as usual
+    /// @return True if the operation was successful
+    bool step_fused();
+
+    /// @brief Read the offset of the current branch opcode and take the branch if the condition is true,
+    /// advancing the pc past the instruction otherwise
+    /// @param condition The condition of the branch instruction
+    void fused_branch(const bool condition);
+
     /// @brief Resolve the current addressing mode
     void resolve();
 
-    /// @brief With the address resolved, fetch the required value from memory
+    /// @brief Finish resolving an indexed address, performing the dummy read the chip does while it fixes the
+    /// high byte of the address
+    /// @param base_address The address before indexing
+    /// @param index The value of the index register
+    void resolve_indexed(const uint16_t base_address, const uint8_t index);
+
+    /// @brief With the address resolved, fetch the required value from memory, if the instruction reads it
     void fetch();
 
+    /// @brief With the address resolved, mark the bytes the current instruction accesses in the code/data logger
+    void log_code_data();
+
     /// @brief Execute the instruction indicated by the current opcode
     /// @return True if the operation was successful
     bool execute();
@@ -134,14 +310,43 @@ class MOS6502
     /// @param value The value (a 0 or a 1)
     void set_sr_bit(StatusRegisterBit bit, const uint8_t value);
 
+    /// @brief Return the complete status register, evaluating the lazy flags
+    uint8_t get_sr();
+
+    /// @brief Set the complete status register, including the lazy flags
+    /// @param value The new value of the status register
+    void set_sr(const uint8_t value);
+
+    /// @brief Set the zero and negative flags from the provided result
+    /// @param result The result of the last operation
+    void set_nz(const uint8_t result);
+
     /// @brief Push a value to the stack
     /// @param value The value to push
     void push_to_stack(uint8_t value);
 
+    /// @brief Write a value to the bus, counting the write
+    /// @param address The address selection
+    /// @param value The value to store
+    void write(const uint16_t address, const uint8_t value);
+
     /// @brief Pull a value from the stack
     /// @return The value that was on top of the stack
     uint8_t pull_from_stack();
 
+    /// @brief Write the result of a read-modify-write instruction to the resolved address
+    /// @param result The modified value
+    void modify(const uint8_t result);
+
+    /// @brief Store the data ANDed with the high byte of the address plus one, as done by the unofficial
+    /// instructions with unstable addressing (AHX, SHX, SHY and TAS)
+    /// @param data The value to be ANDed and stored
+    void store_and_high(const uint8_t data);
+
+    /// @brief Take the branch to the resolved address if the condition is true
+    /// @param condition The condition of the branch instruction
+    void branch(const bool condition);
+
     /// @brief Perform add with carry
     /// @param value Value on which to perform the operation
     void adc(uint8_t value);
@@ -152,8 +357,11 @@ class MOS6502
     /// @brief Disassemble the current status of the CPU. This operation should
     /// happen after the addressing has been resolved and the needed values have
     /// been fetched
-    /// @return A complete CPU entry in the official NES log file
-    std::string disassemble();
+    /// @param line Where the complete CPU entry in the official NES log file is written, at least
+    /// TRACE_LINE_LENGTH characters
+    /// @param instruction_cycles Cycles run before the instruction
+    /// @return The length of the entry
+    size_t disassemble(char *line, const uint64_t instruction_cycles);
 };
 } // namespace cpu
 
@@ -0,0 +1,22 @@
+#ifndef CPU_MEMORY_ACCESS_H
+#define CPU_MEMORY_ACCESS_H
+
+#include <cstdint>
+
+namespace cpu
+{
+
+/// @brief How an instruction accesses the memory location resolved by its addressing mode.
+/// This drives the bus accesses the CPU performs, which have to be exactly the ones of the
+/// real hardware, as reads and writes to some registers have side effects
+enum class MemoryAccess : uint8_t
+{
+    NONE,             // The resolved address is not accessed (implied, immediate, jumps, branches...)
+    READ,             // The value at the resolved address is read
+    WRITE,            // The resolved address is written without reading it first
+    READ_MODIFY_WRITE // The value is read, written back unmodified and then written with the result
+};
+
+} // namespace cpu
+
+#endif
@@ -1,7 +1,4 @@
-#include <stdexcept>
-
 #include "OpcodeParser.h"
-#include "common/Logging.h"
 
 namespace cpu
 {
@@ -246,24 +243,250 @@ OpcodeParser::OpcodeParser()
     add(0xEA, InstructionId::NOP, AddressingMode::IMP, 1, 2);
     // RTI - Return from Interrupt
     add(0x40, InstructionId::RTI, AddressingMode::IMP, 1, 6);
-}
 
-void OpcodeParser::add(const uint8_t raw, const InstructionId instruction_id, const AddressingMode addressing_mode,
-                       const size_t instruction_size, const size_t base_cycles)
-{
-    opcodes.emplace(raw, Opcode{raw, instruction_id, addressing_mode, instruction_size, base_cycles});
+    // Unofficial combined operations
+
+    // LAX - Load Accumulator and X Register
+    add_unofficial(0xA7, InstructionId::LAX, AddressingMode::ZP0, 2, 3);
+    add_unofficial(0xB7, InstructionId::LAX, AddressingMode::ZPY, 2, 4);
+    add_unofficial(0xAF, InstructionId::LAX, AddressingMode::ABS, 3, 4);
+    add_unofficial(0xBF, InstructionId::LAX, AddressingMode::ABY, 3, 4);
+    add_unofficial(0xA3, InstructionId::LAX, AddressingMode::IXI, 2, 6);
+    add_unofficial(0xB3, InstructionId::LAX, AddressingMode::IIX, 2, 5);
+    // SAX - Store Accumulator AND X Register
+    add_unofficial(0x87, InstructionId::SAX, AddressingMode::ZP0, 2, 3);
+    add_unofficial(0x97, InstructionId::SAX, AddressingMode::ZPY, 2, 4);
+    add_unofficial(0x8F, InstructionId::SAX, AddressingMode::ABS, 3, 4);
+    add_unofficial(0x83, InstructionId::SAX, AddressingMode::IXI, 2, 6);
+    // DCP - Decrement Memory and Compare
+    add_unofficial(0xC7, InstructionId::DCP, AddressingMode::ZP0, 2, 5);
+    add_unofficial(0xD7, InstructionId::DCP, AddressingMode::ZPX, 2, 6);
+    add_unofficial(0xCF, InstructionId::DCP, AddressingMode::ABS, 3, 6);
+    add_unofficial(0xDF, InstructionId::DCP, AddressingMode::ABX, 3, 7);
+    add_unofficial(0xDB, InstructionId::DCP, AddressingMode::ABY, 3, 7);
+    add_unofficial(0xC3, InstructionId::DCP, AddressingMode::IXI, 2, 8);
+    add_unofficial(0xD3, InstructionId::DCP, AddressingMode::IIX, 2, 8);
+    // ISB - Increment Memory and Subtract with Carry
+    add_unofficial(0xE7, InstructionId::ISB, AddressingMode::ZP0, 2, 5);
+    add_unofficial(0xF7, InstructionId::ISB, AddressingMode::ZPX, 2, 6);
+    add_unofficial(0xEF, InstructionId::ISB, AddressingMode::ABS, 3, 6);
+    add_unofficial(0xFF, InstructionId::ISB, AddressingMode::ABX, 3, 7);
+    add_unofficial(0xFB, InstructionId::ISB, AddressingMode::ABY, 3, 7);
+    add_unofficial(0xE3, InstructionId::ISB, AddressingMode::IXI, 2, 8);
+    add_unofficial(0xF3, InstructionId::ISB, AddressingMode::IIX, 2, 8);
+    // SLO - Arithmetic Shift Left Memory and Logical Inclusive OR
+    add_unofficial(0x07, InstructionId::SLO, AddressingMode::ZP0, 2, 5);
+    add_unofficial(0x17, InstructionId::SLO, AddressingMode::ZPX, 2, 6);
+    add_unofficial(0x0F, InstructionId::SLO, AddressingMode::ABS, 3, 6);
+    add_unofficial(0x1F, InstructionId::SLO, AddressingMode::ABX, 3, 7);
+    add_unofficial(0x1B, InstructionId::SLO, AddressingMode::ABY, 3, 7);
+    add_unofficial(0x03, InstructionId::SLO, AddressingMode::IXI, 2, 8);
+    add_unofficial(0x13, InstructionId::SLO, AddressingMode::IIX, 2, 8);
+    // RLA - Rotate Left Memory and Logical AND
+    add_unofficial(0x27, InstructionId::RLA, AddressingMode::ZP0, 2, 5);
+    add_unofficial(0x37, InstructionId::RLA, AddressingMode::ZPX, 2, 6);
+    add_unofficial(0x2F, InstructionId::RLA, AddressingMode::ABS, 3, 6);
+    add_unofficial(0x3F, InstructionId::RLA, AddressingMode::ABX, 3, 7);
+    add_unofficial(0x3B, InstructionId::RLA, AddressingMode::ABY, 3, 7);
+    add_unofficial(0x23, InstructionId::RLA, AddressingMode::IXI, 2, 8);
+    add_unofficial(0x33, InstructionId::RLA, AddressingMode::IIX, 2, 8);
+    // SRE - Logical Shift Right Memory and Exclusive OR
+    add_unofficial(0x47, InstructionId::SRE, AddressingMode::ZP0, 2, 5);
+    add_unofficial(0x57, InstructionId::SRE, AddressingMode::ZPX, 2, 6);
+    add_unofficial(0x4F, InstructionId::SRE, AddressingMode::ABS, 3, 6);
+    add_unofficial(0x5F, InstructionId::SRE, AddressingMode::ABX, 3, 7);
+    add_unofficial(0x5B, InstructionId::SRE, AddressingMode::ABY, 3, 7);
+    add_unofficial(0x43, InstructionId::SRE, AddressingMode::IXI, 2, 8);
+    add_unofficial(0x53, InstructionId::SRE, AddressingMode::IIX, 2, 8);
+    // RRA - Rotate Right Memory and Add with Carry
+    add_unofficial(0x67, InstructionId::RRA, AddressingMode::ZP0, 2, 5);
+    add_unofficial(0x77, InstructionId::RRA, AddressingMode::ZPX, 2, 6);
+    add_unofficial(0x6F, InstructionId::RRA, AddressingMode::ABS, 3, 6);
+    add_unofficial(0x7F, InstructionId::RRA, AddressingMode::ABX, 3, 7);
+    add_unofficial(0x7B, InstructionId::RRA, AddressingMode::ABY, 3, 7);
+    add_unofficial(0x63, InstructionId::RRA, AddressingMode::IXI, 2, 8);
+    add_unofficial(0x73, InstructionId::RRA, AddressingMode::IIX, 2, 8);
+
+    // Unofficial immediate operations
+
+    // ANC - Logical AND and Copy Negative to Carry
+    add_unofficial(0x0B, InstructionId::ANC, AddressingMode::IMM, 2, 2);
+    add_unofficial(0x2B, InstructionId::ANC, AddressingMode::IMM, 2, 2);
+    // ALR - Logical AND and Logical Shift Right
+    add_unofficial(0x4B, InstructionId::ALR, AddressingMode::IMM, 2, 2);
+    // ARR - Logical AND and Rotate Right
+    add_unofficial(0x6B, InstructionId::ARR, AddressingMode::IMM, 2, 2);
+    // AXS - Accumulator AND X Register minus Immediate
+    add_unofficial(0xCB, InstructionId::AXS, AddressingMode::IMM, 2, 2);
+    // SBC - Subtract with Carry (same as the official 0xE9)
+    add_unofficial(0xEB, InstructionId::SBC, AddressingMode::IMM, 2, 2);
+    // XAA - Transfer X Register to Accumulator and Logical AND
+    add_unofficial(0x8B, InstructionId::XAA, AddressingMode::IMM, 2, 2);
+    // LXA - Logical AND and Load Accumulator and X Register
+    add_unofficial(0xAB, InstructionId::LXA, AddressingMode::IMM, 2, 2);
+
+    // Unofficial operations with unstable addressing
+
+    // LAS - Logical AND with Stack Pointer
+    add_unofficial(0xBB, InstructionId::LAS, AddressingMode::ABY, 3, 4);
+    // AHX - Store Accumulator AND X Register AND High Byte
+    add_unofficial(0x9F, InstructionId::AHX, AddressingMode::ABY, 3, 5);
+    add_unofficial(0x93, InstructionId::AHX, AddressingMode::IIX, 2, 6);
+    // SHX - Store X Register AND High Byte
+    add_unofficial(0x9E, InstructionId::SHX, AddressingMode::ABY, 3, 5);
+    // SHY - Store Y Register AND High Byte
+    add_unofficial(0x9C, InstructionId::SHY, AddressingMode::ABX, 3, 5);
+    // TAS - Transfer Accumulator AND X Register to Stack Pointer
+    add_unofficial(0x9B, InstructionId::TAS, AddressingMode::ABY, 3, 5);
+
+    // Unofficial no operations
+
+    // NOP - No Operation (implied)
+    add_unofficial(0x1A, InstructionId::NOP, AddressingMode::IMP, 1, 2);
+    add_unofficial(0x3A, InstructionId::NOP, AddressingMode::IMP, 1, 2);
+    add_unofficial(0x5A, InstructionId::NOP, AddressingMode::IMP, 1, 2);
+    add_unofficial(0x7A, InstructionId::NOP, AddressingMode::IMP, 1, 2);
+    add_unofficial(0xDA, InstructionId::NOP, AddressingMode::IMP, 1, 2);
+    add_unofficial(0xFA, InstructionId::NOP, AddressingMode::IMP, 1, 2);
+    // NOP - No Operation (immediate)
+    add_unofficial(0x80, InstructionId::NOP, AddressingMode::IMM, 2, 2);
+    add_unofficial(0x82, InstructionId::NOP, AddressingMode::IMM, 2, 2);
+    add_unofficial(0x89, InstructionId::NOP, AddressingMode::IMM, 2, 2);
+    add_unofficial(0xC2, InstructionId::NOP, AddressingMode::IMM, 2, 2);
+    add_unofficial(0xE2, InstructionId::NOP, AddressingMode::IMM, 2, 2);
+    // NOP - No Operation (reads memory and ignores the value)
+    add_unofficial(0x04, InstructionId::NOP, AddressingMode::ZP0, 2, 3);
+    add_unofficial(0x44, InstructionId::NOP, AddressingMode::ZP0, 2, 3);
+    add_unofficial(0x64, InstructionId::NOP, AddressingMode::ZP0, 2, 3);
+    add_unofficial(0x14, InstructionId::NOP, AddressingMode::ZPX, 2, 4);
+    add_unofficial(0x34, InstructionId::NOP, AddressingMode::ZPX, 2, 4);
+    add_unofficial(0x54, InstructionId::NOP, AddressingMode::ZPX, 2, 4);
+    add_unofficial(0x74, InstructionId::NOP, AddressingMode::ZPX, 2, 4);
+    add_unofficial(0xD4, InstructionId::NOP, AddressingMode::ZPX, 2, 4);
+    add_unofficial(0xF4, InstructionId::NOP, AddressingMode::ZPX, 2, 4);
+    add_unofficial(0x0C, InstructionId::NOP, AddressingMode::ABS, 3, 4);
+    add_unofficial(0x1C, InstructionId::NOP, AddressingMode::ABX, 3, 4);
+    add_unofficial(0x3C, InstructionId::NOP, AddressingMode::ABX, 3, 4);
+    add_unofficial(0x5C, InstructionId::NOP, AddressingMode::ABX, 3, 4);
+    add_unofficial(0x7C, InstructionId::NOP, AddressingMode::ABX, 3, 4);
+    add_unofficial(0xDC, InstructionId::NOP, AddressingMode::ABX, 3, 4);
+    add_unofficial(0xFC, InstructionId::NOP, AddressingMode::ABX, 3, 4);
+
+    // Unofficial system functions
+
+    // KIL - Jam the processor
+    add_unofficial(0x02, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+    add_unofficial(0x12, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+    add_unofficial(0x22, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+    add_unofficial(0x32, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+    add_unofficial(0x42, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+    add_unofficial(0x52, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+    add_unofficial(0x62, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+    add_unofficial(0x72, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+    add_unofficial(0x92, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+    add_unofficial(0xB2, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+    add_unofficial(0xD2, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+    add_unofficial(0xF2, InstructionId::KIL, AddressingMode::IMP, 1, 2);
+
+    // Pairs of instructions executed as superinstructions, attached to the first opcode of the pair
+    opcodes[0xCA].fusion = FusionId::DEX_BNE;
+    opcodes[0x88].fusion = FusionId::DEY_BNE;
+    opcodes[0xE8].fusion = FusionId::INX_BNE;
+    opcodes[0xC8].fusion = FusionId::INY_BNE;
+    opcodes[0xC9].fusion = FusionId::CMP_BXX;
+    opcodes[0xA9].fusion = FusionId::LDA_STA;
+    opcodes[0xA5].fusion = FusionId::LDA_STA;
+    opcodes[0xAD].fusion = FusionId::LDA_STA;
+    opcodes[0xE6].fusion = FusionId::INC_BNE;
+    opcodes[0x18].fusion = FusionId::CLC_ADC;
 }
 
-Opcode OpcodeParser::parse(const uint8_t raw)
+/// Classify how an instruction accesses the address resolved by its addressing mode
+static MemoryAccess classify_memory_access(const InstructionId instruction_id, const AddressingMode addressing_mode)
 {
-    auto element = opcodes.find(raw);
-    if (element != opcodes.end())
+    switch (addressing_mode)
     {
-        return element->second;
+    case AddressingMode::IMP:
+    case AddressingMode::ACC:
+    case AddressingMode::IMM:
+    case AddressingMode::REL:
+    case AddressingMode::IND:
+        // The operand is the instruction itself, or the address is only used as a jump target
+        return MemoryAccess::NONE;
+    default:
+        break;
     }
-    else
+
+    switch (instruction_id)
     {
-        throw std::out_of_range(std::string("Cannot parse instruction ") + common::print_hex(raw, sizeof(raw)));
+    case InstructionId::LDA:
+    case InstructionId::LDX:
+    case InstructionId::LDY:
+    case InstructionId::AND:
+    case InstructionId::EOR:
+    case InstructionId::ORA:
+    case InstructionId::BIT:
+    case InstructionId::ADC:
+    case InstructionId::SBC:
+    case InstructionId::CMP:
+    case InstructionId::CPX:
+    case InstructionId::CPY:
+    case InstructionId::LAX:
+    case InstructionId::LAS:
+    case InstructionId::NOP:
+        // Note: the unofficial NOPs with an address read it and ignore the value
+        return MemoryAccess::READ;
+    case InstructionId::STA:
+    case InstructionId::STX:
+    case InstructionId::STY:
+    case InstructionId::SAX:
+    case InstructionId::AHX:
+    case InstructionId::SHX:
+    case InstructionId::SHY:
+    case InstructionId::TAS:
+        return MemoryAccess::WRITE;
+    case InstructionId::ASL:
+    case InstructionId::LSR:
+    case InstructionId::ROL:
+    case InstructionId::ROR:
+    case InstructionId::INC:
+    case InstructionId::DEC:
+    case InstructionId::DCP:
+    case InstructionId::ISB:
+    case InstructionId::SLO:
+    case InstructionId::RLA:
+    case InstructionId::SRE:
+    case InstructionId::RRA:
+        return MemoryAccess::READ_MODIFY_WRITE;
+    default:
+        // Jumps use the address as the new pc
+        return MemoryAccess::NONE;
     }
 }
+
+void OpcodeParser::add(const uint8_t raw, const InstructionId instruction_id, const AddressingMode addressing_mode,
+                       const size_t instruction_size, const size_t base_cycles)
+{
+    opcodes[raw] = Opcode{raw,
+                          instruction_id,
+                          addressing_mode,
+                          instruction_size,
+                          base_cycles,
+                          classify_memory_access(instruction_id, addressing_mode),
+                          false,
+                          FusionId::NONE};
+}
+
+void OpcodeParser::add_unofficial(const uint8_t raw, const InstructionId instruction_id,
+                                  const AddressingMode addressing_mode, const size_t instruction_size,
+                                  const size_t base_cycles)
+{
+    add(raw, instruction_id, addressing_mode, instruction_size, base_cycles);
+    opcodes[raw].unofficial = true;
+}
+
+Opcode OpcodeParser::parse(const uint8_t raw) const
+{
+    return opcodes[raw];
+}
 } // namespace cpu
\ No newline at end of file
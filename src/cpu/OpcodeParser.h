@@ -1,11 +1,13 @@
 #ifndef CPU_OPCODE_PARSER_H
 #define CPU_OPCODE_PARSER_H
 
+#include <array>
 #include <cstdint>
-#include <map>
 
 #include "AddressingMode.h"
+#include "FusionId.h"
 #include "InstructionId.h"
+#include "MemoryAccess.h"
 #include "StatusRegisterBit.h"
 
 namespace cpu
@@ -19,6 +21,9 @@ struct Opcode
     AddressingMode addressing_mode; // The addressing mode in the opcode
     size_t instruction_size;        // Number of bytes of the complete instruction, including the opcode
     size_t base_cycles;             // Base number of cycles that this instruction consumes
+    MemoryAccess memory_access;     // How the instruction accesses the resolved address
+    bool unofficial;                // True if the opcode is not documented by the manufacturer
+    FusionId fusion;                // The pair of instructions this opcode starts, if any
 };
 
 /// @brief This model receives a raw byte and returns an opcode
@@ -27,15 +32,19 @@ class OpcodeParser
   public:
     OpcodeParser();
 
-    /// @brief Return the opcode provided the raw byte
-    Opcode parse(const uint8_t raw);
+    /// @brief Return the opcode provided the raw byte. All the 256 values are valid opcodes,
+    /// the ones that hang the real chip are decoded as KIL
+    Opcode parse(const uint8_t raw) const;
 
-    /// @brief Internal mapping of raw bytes to opcodes
-    std::map<uint8_t, Opcode> opcodes;
+    /// @brief Internal mapping of raw bytes to opcodes, indexed by the raw byte
+    std::array<Opcode, 256> opcodes;
 
   private:
     void add(const uint8_t raw, const InstructionId instruction_id, const AddressingMode addressing_mode,
              const size_t instruction_size, const size_t base_cycles);
+
+    void add_unofficial(const uint8_t raw, const InstructionId instruction_id, const AddressingMode addressing_mode,
+                        const size_t instruction_size, const size_t base_cycles);
 };
 } // namespace cpu
 
@@ -0,0 +1,22 @@
+#ifndef CPU_REGISTERS_H
+#define CPU_REGISTERS_H
+
+#include <cstdint>
+
+namespace cpu
+{
+
+/// @brief Programmer visible registers of the MOS6502
+struct Registers
+{
+    uint16_t pc; // Program counter
+    uint8_t acc; // Accumulator
+    uint8_t xr;  // X register
+    uint8_t yr;  // Y register
+    uint8_t sr;  // Status register, with all the flags evaluated
+    uint8_t sp;  // Stack pointer (from the stack offset)
+};
+
+} // namespace cpu
+
+#endif
@@ -0,0 +1,325 @@
+#include <array>
+#include <cstring>
+#include <string>
+
+#include "OpcodeParser.h"
+#include "TraceFormatter.h"
+
+namespace cpu
+{
+
+/// Uppercase hexadecimal digits, indexed by value
+static constexpr char HEX_DIGITS[] = "0123456789ABCDEF";
+
+/// Offsets of the fixed columns of a trace line
+static constexpr size_t PC_OFFSET = 0;
+static constexpr size_t BYTES_OFFSET = 6;
+static constexpr size_t MNEMONIC_OFFSET = 15;
+static constexpr size_t OPERAND_OFFSET = 20;
+static constexpr size_t REGISTERS_OFFSET = 48;
+
+/// Registers at the end of the line, their values are at offsets 2, 7, 12, 17 and 23
+static constexpr char REGISTERS_TEMPLATE[] = "A:   X:   Y:   P:   SP:  ";
+
+/// Label of the cycle count, its value follows it
+static constexpr char CYCLES_LABEL[] = "CYC:";
+
+/// Length of a line up to the value of the cycle count
+static constexpr size_t CYCLES_VALUE_OFFSET = TRACE_CYCLES_OFFSET + sizeof(CYCLES_LABEL) - 1;
+
+/// Variable fields of a trace line
+enum class TraceField : uint8_t
+{
+    BYTE_1,               // Second byte of the instruction
+    BYTE_2,               // Third byte of the instruction
+    OPERAND,              // Second and third bytes of the instruction, as a 16 bit address
+    ADDRESS,              // Resolved address
+    ADDRESS_LOW,          // Low byte of the resolved address
+    INTERMEDIATE,         // Pointer of the indirect addressing modes
+    INTERMEDIATE_LOW,     // Low byte of that pointer
+    VALUE                 // Value at the resolved address
+};
+
+/// A variable field and where it goes in the line
+struct TracePatch
+{
+    uint8_t offset;
+    TraceField field;
+};
+
+/// Maximum number of variable fields of an instruction, without the registers
+static constexpr size_t MAX_PATCHES = 6;
+
+/// The line of an opcode with the fixed parts filled in, and the variable fields to fill in
+struct TraceTemplate
+{
+    char line[CYCLES_VALUE_OFFSET];
+    uint8_t num_patches;
+    TracePatch patches[MAX_PATCHES];
+};
+
+/// Write a byte in hexadecimal
+static inline void write_hex_8(char *text, const uint8_t value)
+{
+    text[0] = HEX_DIGITS[value >> 4];
+    text[1] = HEX_DIGITS[value & 0xF];
+}
+
+/// Write a 16 bit value in hexadecimal
+static inline void write_hex_16(char *text, const uint16_t value)
+{
+    write_hex_8(text, value >> 8);
+    write_hex_8(text + 2, value & 0xFF);
+}
+
+/// Write a value in decimal, without leading zeros, and return its number of digits
+static inline size_t write_decimal(char *text, uint64_t value)
+{
+    // The digits come out from the last one
+    char digits[20];
+    size_t num_digits = 0;
+    do
+    {
+        digits[sizeof(digits) - ++num_digits] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    std::memcpy(text, digits + sizeof(digits) - num_digits, num_digits);
+    return num_digits;
+}
+
+/// Builds the template of an opcode, writing text and leaving room for the variable fields
+class TemplateBuilder
+{
+  public:
+    explicit TemplateBuilder(TraceTemplate &trace_template) : trace_template(trace_template)
+    {
+    }
+
+    /// Place the next writes at an offset of the line
+    void seek(const size_t offset)
+    {
+        position = offset;
+    }
+
+    /// Write fixed text
+    void text(const std::string &text)
+    {
+        std::memcpy(trace_template.line + position, text.data(), text.size());
+        position += text.size();
+    }
+
+    /// Leave room for a variable field
+    void field(const TraceField field)
+    {
+        trace_template.patches[trace_template.num_patches++] = TracePatch{static_cast<uint8_t>(position), field};
+        const bool wide =
+            field == TraceField::OPERAND || field == TraceField::ADDRESS || field == TraceField::INTERMEDIATE;
+        position += wide ? 4 : 2;
+    }
+
+  private:
+    TraceTemplate &trace_template;
+    size_t position = 0;
+};
+
+/// Build the template of an opcode
+static TraceTemplate build_template(const Opcode &opcode)
+{
+    TraceTemplate trace_template;
+    std::memset(trace_template.line, ' ', sizeof(trace_template.line));
+    trace_template.num_patches = 0;
+    TemplateBuilder builder(trace_template);
+
+    // Bytes of the instruction
+    builder.seek(BYTES_OFFSET);
+    write_hex_8(trace_template.line + BYTES_OFFSET, opcode.raw);
+    if (opcode.instruction_size >= 2)
+    {
+        builder.seek(BYTES_OFFSET + 3);
+        builder.field(TraceField::BYTE_1);
+    }
+    if (opcode.instruction_size >= 3)
+    {
+        builder.seek(BYTES_OFFSET + 6);
+        builder.field(TraceField::BYTE_2);
+    }
+
+    // Unofficial opcodes are marked with an asterisk
+    builder.seek(MNEMONIC_OFFSET);
+    builder.text((opcode.unofficial ? "*" : " ") + print_instruction_id(opcode.instruction_id));
+
+    // Operand, with the examples of each addressing mode
+    builder.seek(OPERAND_OFFSET);
+    switch (opcode.addressing_mode)
+    {
+    case AddressingMode::IMP:
+        break;
+    case AddressingMode::ACC:
+        // "LSR A"
+        builder.text("A");
+        break;
+    case AddressingMode::IMM:
+        // "LDA #$66"
+        builder.text("#$");
+        builder.field(TraceField::BYTE_1);
+        break;
+    case AddressingMode::ZP0:
+        // "LDA $33 = 44"
+        builder.text("$");
+        builder.field(TraceField::BYTE_1);
+        builder.text(" = ");
+        builder.field(TraceField::VALUE);
+        break;
+    case AddressingMode::ZPX:
+    case AddressingMode::ZPY:
+        // "LDA $00,X @ 78 = 33"
+        builder.text("$");
+        builder.field(TraceField::BYTE_1);
+        builder.text(opcode.addressing_mode == AddressingMode::ZPX ? ",X @ " : ",Y @ ");
+        builder.field(TraceField::ADDRESS_LOW);
+        builder.text(" = ");
+        builder.field(TraceField::VALUE);
+        break;
+    case AddressingMode::REL:
+        // "BNE $C72A"
+        builder.text("$");
+        builder.field(TraceField::ADDRESS);
+        break;
+    case AddressingMode::ABS:
+        // "LDA $0300 = 89", jumps do not show the value
+        builder.text("$");
+        builder.field(TraceField::OPERAND);
+        if (opcode.instruction_id != InstructionId::JMP && opcode.instruction_id != InstructionId::JSR)
+        {
+            builder.text(" = ");
+            builder.field(TraceField::VALUE);
+        }
+        break;
+    case AddressingMode::ABX:
+    case AddressingMode::ABY:
+        // "LDA $0300,X @ 0300 = 89"
+        builder.text("$");
+        builder.field(TraceField::OPERAND);
+        builder.text(opcode.addressing_mode == AddressingMode::ABX ? ",X @ " : ",Y @ ");
+        builder.field(TraceField::ADDRESS);
+        builder.text(" = ");
+        builder.field(TraceField::VALUE);
+        break;
+    case AddressingMode::IND:
+        // "JMP ($0200) = DB7E"
+        builder.text("($");
+        builder.field(TraceField::OPERAND);
+        builder.text(") = ");
+        builder.field(TraceField::ADDRESS);
+        break;
+    case AddressingMode::IXI:
+        // "LDA ($80,X) @ 80 = 0200 = 5A"
+        builder.text("($");
+        builder.field(TraceField::BYTE_1);
+        builder.text(",X) @ ");
+        builder.field(TraceField::INTERMEDIATE_LOW);
+        builder.text(" = ");
+        builder.field(TraceField::ADDRESS);
+        builder.text(" = ");
+        builder.field(TraceField::VALUE);
+        break;
+    case AddressingMode::IIX:
+        // "LDA ($89),Y = 0300 @ 0300 = 89"
+        builder.text("($");
+        builder.field(TraceField::BYTE_1);
+        builder.text("),Y = ");
+        builder.field(TraceField::INTERMEDIATE);
+        builder.text(" @ ");
+        builder.field(TraceField::ADDRESS);
+        builder.text(" = ");
+        builder.field(TraceField::VALUE);
+        break;
+    }
+
+    builder.seek(REGISTERS_OFFSET);
+    builder.text(REGISTERS_TEMPLATE);
+    builder.seek(TRACE_CYCLES_OFFSET);
+    builder.text(CYCLES_LABEL);
+    return trace_template;
+}
+
+/// Return the templates of all the opcodes, built on first use
+static const std::array<TraceTemplate, 256> &get_templates()
+{
+    static const std::array<TraceTemplate, 256> templates = [] {
+        const OpcodeParser opcode_parser;
+        std::array<TraceTemplate, 256> result;
+        for (size_t raw = 0; raw < result.size(); raw++)
+        {
+            result[raw] = build_template(opcode_parser.parse(raw));
+        }
+        return result;
+    }();
+    return templates;
+}
+
+size_t format_trace_line(const TraceRecord &record, char *line)
+{
+    const TraceTemplate &trace_template = get_templates()[record.opcode];
+    std::memcpy(line, trace_template.line, CYCLES_VALUE_OFFSET);
+
+    write_hex_16(line + PC_OFFSET, record.pc);
+    for (size_t patch = 0; patch < trace_template.num_patches; patch++)
+    {
+        char *text = line + trace_template.patches[patch].offset;
+        switch (trace_template.patches[patch].field)
+        {
+        case TraceField::BYTE_1:
+            write_hex_8(text, record.byte_1);
+            break;
+        case TraceField::BYTE_2:
+            write_hex_8(text, record.byte_2);
+            break;
+        case TraceField::OPERAND:
+            write_hex_16(text, (record.byte_2 << 8) | record.byte_1);
+            break;
+        case TraceField::ADDRESS:
+            write_hex_16(text, record.address);
+            break;
+        case TraceField::ADDRESS_LOW:
+            write_hex_8(text, record.address & 0xFF);
+            break;
+        case TraceField::INTERMEDIATE:
+            write_hex_16(text, record.intermediate_address);
+            break;
+        case TraceField::INTERMEDIATE_LOW:
+            write_hex_8(text, record.intermediate_address & 0xFF);
+            break;
+        case TraceField::VALUE:
+            write_hex_8(text, record.value);
+            break;
+        }
+    }
+
+    write_hex_8(line + REGISTERS_OFFSET + 2, record.acc);
+    write_hex_8(line + REGISTERS_OFFSET + 7, record.xr);
+    write_hex_8(line + REGISTERS_OFFSET + 12, record.yr);
+    write_hex_8(line + REGISTERS_OFFSET + 17, record.sr);
+    write_hex_8(line + REGISTERS_OFFSET + 23, record.sp);
+    return CYCLES_VALUE_OFFSET + write_decimal(line + CYCLES_VALUE_OFFSET, record.cycles);
+}
+
+size_t format_status(const uint8_t sr, const uint8_t acc, const uint8_t xr, const uint8_t yr, const uint8_t sp,
+                     char *status)
+{
+    // Flags from bit 7 to bit 0, bit 5 is the ignored one
+    static constexpr char TEMPLATE[] = "SR[N  V  I  B  D  I  Z  C ] ACC[  ] X[  ] Y[  ] SP[  ] ";
+    static_assert(sizeof(TEMPLATE) - 1 == STATUS_LENGTH, "The status template does not match its length");
+    std::memcpy(status, TEMPLATE, STATUS_LENGTH);
+    for (size_t bit = 0; bit < 8; bit++)
+    {
+        status[4 + 3 * bit] = '0' + ((sr >> (7 - bit)) & 0x1);
+    }
+    write_hex_8(status + 32, acc);
+    write_hex_8(status + 38, xr);
+    write_hex_8(status + 44, yr);
+    write_hex_8(status + 51, sp);
+    return STATUS_LENGTH;
+}
+
+} // namespace cpu
@@ -0,0 +1,57 @@
+#ifndef CPU_TRACE_FORMATTER_H
+#define CPU_TRACE_FORMATTER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cpu
+{
+
+/// @brief Offset of the cycle count in a trace line. nestest.log has the PPU position before it, which is left
+/// blank so that the cycle count lines up
+static constexpr size_t TRACE_CYCLES_OFFSET = 86;
+
+/// @brief Maximum length of a trace line, in the format of nestest.log with a cycle count of up to 20 digits
+static constexpr size_t TRACE_LINE_LENGTH = TRACE_CYCLES_OFFSET + 4 + 20;
+
+/// @brief Length of the status written by format_status
+static constexpr size_t STATUS_LENGTH = 55;
+
+/// @brief What the trace shows of an instruction, captured after its addressing has been resolved and before it
+/// is executed
+struct TraceRecord
+{
+    uint16_t pc;                   // Address of the opcode
+    uint8_t opcode;                // Raw opcode
+    uint8_t byte_1;                // Second byte of the instruction, if it has it
+    uint8_t byte_2;                // Third byte of the instruction, if it has it
+    uint16_t address;              // Resolved address
+    uint16_t intermediate_address; // Pointer of the indirect addressing modes
+    uint8_t value;                 // Value at the resolved address
+    uint8_t acc;                   // Accumulator
+    uint8_t xr;                    // X register
+    uint8_t yr;                    // Y register
+    uint8_t sr;                    // Status register
+    uint8_t sp;                    // Stack pointer
+    uint64_t cycles;               // Cycles run before the instruction
+};
+
+/// @brief Write the trace line of an instruction, such as
+/// "C5F7  86 00     STX $00 = 00                    A:00 X:00 Y:00 P:26 SP:FD             CYC:12", without
+/// allocating anything. The line of every opcode is precomputed with its bytes, mnemonic and operand punctuation,
+/// so only the variable fields are converted to hexadecimal, with a table, and the cycle count to decimal
+/// @param record The instruction
+/// @param line Where the line is written, at least TRACE_LINE_LENGTH characters. It is not null terminated
+/// @return The length of the line
+size_t format_trace_line(const TraceRecord &record, char *line);
+
+/// @brief Write the status of the registers, such as "SR[N0 V0 I1 B0 D0 I1 Z0 C0] ACC[00] X[00] Y[00] SP[FD] ",
+/// without allocating anything
+/// @param status Where the status is written, at least STATUS_LENGTH characters. It is not null terminated
+/// @return The length of the status
+size_t format_status(const uint8_t sr, const uint8_t acc, const uint8_t xr, const uint8_t yr, const uint8_t sp,
+                     char *status);
+
+} // namespace cpu
+
+#endif
@@ -0,0 +1,169 @@
+#include "AccessHeatmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+#include "common/Encoding.h"
+#include "common/Logging.h"
+
+namespace debug
+{
+
+/// Side of the image, a row per page and a pixel per address of the page
+static constexpr size_t IMAGE_SIDE = 0x100;
+
+/// Color channel of every kind of access in the image, in the order of AccessKind: executions blue, reads green
+/// and writes red
+static constexpr size_t IMAGE_CHANNELS[AccessHeatmap::NUM_KINDS] = {2, 1, 0};
+
+AccessHeatmap::AccessHeatmap() : counts(NUM_KINDS * NUM_ADDRESSES), total_counts(NUM_KINDS * NUM_ADDRESSES)
+{
+}
+
+void AccessHeatmap::end_frame(const uint64_t frame)
+{
+    // Every kind is stored as the number of addresses accessed followed by, for each of them, the gap since the
+    // previous one and the count
+    snapshot_offsets.push_back(snapshots.size());
+    frame_numbers.push_back(frame);
+    for (size_t kind = 0; kind < NUM_KINDS; kind++)
+    {
+        uint32_t *kind_counts = counts.data() + kind * NUM_ADDRESSES;
+        const size_t accessed = NUM_ADDRESSES - std::count(kind_counts, kind_counts + NUM_ADDRESSES, 0u);
+        common::put_varint(snapshots, accessed);
+        size_t expected = 0;
+        for (size_t address = 0; address < NUM_ADDRESSES; address++)
+        {
+            if (kind_counts[address] > 0)
+            {
+                common::put_varint(snapshots, address - expected);
+                common::put_varint(snapshots, kind_counts[address]);
+                total_counts[kind * NUM_ADDRESSES + address] += kind_counts[address];
+                kind_counts[address] = 0;
+                expected = address + 1;
+            }
+        }
+    }
+}
+
+size_t AccessHeatmap::get_frame_count() const
+{
+    return frame_numbers.size();
+}
+
+uint64_t AccessHeatmap::get_frame_number(const size_t index) const
+{
+    return frame_numbers[index];
+}
+
+void AccessHeatmap::get_frame_counts(const size_t index, std::vector<uint32_t> &frame_counts) const
+{
+    frame_counts.assign(NUM_KINDS * NUM_ADDRESSES, 0);
+    const uint8_t *data = snapshots.data() + snapshot_offsets[index];
+    const uint8_t *end = snapshots.data() + snapshots.size();
+    for (size_t kind = 0; kind < NUM_KINDS; kind++)
+    {
+        uint64_t accessed = 0;
+        common::get_varint(data, end, accessed);
+        uint64_t address = 0;
+        for (uint64_t entry = 0; entry < accessed; entry++)
+        {
+            uint64_t gap = 0;
+            uint64_t count = 0;
+            common::get_varint(data, end, gap);
+            common::get_varint(data, end, count);
+            address += gap;
+            frame_counts[kind * NUM_ADDRESSES + address] = count;
+            address++;
+        }
+    }
+}
+
+const std::vector<uint64_t> &AccessHeatmap::get_total_counts() const
+{
+    return total_counts;
+}
+
+size_t AccessHeatmap::get_snapshot_size() const
+{
+    return snapshots.size();
+}
+
+bool AccessHeatmap::save_csv(const std::filesystem::path &filename) const
+{
+    std::ofstream file(filename, std::ios_base::out | std::ios_base::trunc);
+    if (!file.is_open())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be opened");
+        return false;
+    }
+
+    file << "frame,address,reads,writes,executions\n";
+    std::vector<uint32_t> frame_counts;
+    for (size_t index = 0; index < get_frame_count(); index++)
+    {
+        get_frame_counts(index, frame_counts);
+        const uint32_t *executions = frame_counts.data() + static_cast<size_t>(AccessKind::EXECUTE) * NUM_ADDRESSES;
+        const uint32_t *reads = frame_counts.data() + static_cast<size_t>(AccessKind::READ) * NUM_ADDRESSES;
+        const uint32_t *writes = frame_counts.data() + static_cast<size_t>(AccessKind::WRITE) * NUM_ADDRESSES;
+        for (size_t address = 0; address < NUM_ADDRESSES; address++)
+        {
+            if (executions[address] > 0 || reads[address] > 0 || writes[address] > 0)
+            {
+                char line[64];
+                std::snprintf(line, sizeof(line), "%llu,$%04zX,%u,%u,%u\n",
+                              static_cast<unsigned long long>(frame_numbers[index]), address, reads[address],
+                              writes[address], executions[address]);
+                file << line;
+            }
+        }
+    }
+
+    if (!file.good())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be written");
+        return false;
+    }
+    return true;
+}
+
+bool AccessHeatmap::save_image(const std::filesystem::path &filename) const
+{
+    std::ofstream file(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!file.is_open())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be opened");
+        return false;
+    }
+
+    // Every channel is scaled to its own maximum, so that the few hot addresses do not hide the rest
+    std::vector<uint8_t> pixels(IMAGE_SIDE * IMAGE_SIDE * 3);
+    for (size_t kind = 0; kind < NUM_KINDS; kind++)
+    {
+        const uint64_t *kind_counts = total_counts.data() + kind * NUM_ADDRESSES;
+        const uint64_t max_count = *std::max_element(kind_counts, kind_counts + NUM_ADDRESSES);
+        if (max_count == 0)
+        {
+            continue;
+        }
+        const double scale = 255.0 / std::log1p(static_cast<double>(max_count));
+        for (size_t address = 0; address < NUM_ADDRESSES; address++)
+        {
+            pixels[address * 3 + IMAGE_CHANNELS[kind]] =
+                static_cast<uint8_t>(std::lround(std::log1p(static_cast<double>(kind_counts[address])) * scale));
+        }
+    }
+    file << "P6\n" << IMAGE_SIDE << " " << IMAGE_SIDE << "\n255\n";
+    file.write(reinterpret_cast<const char *>(pixels.data()), pixels.size());
+
+    if (!file.good())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be written");
+        return false;
+    }
+    return true;
+}
+
+} // namespace debug
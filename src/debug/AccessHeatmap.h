@@ -0,0 +1,91 @@
+#ifndef DEBUG_ACCESSHEATMAP_H
+#define DEBUG_ACCESSHEATMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "TraceStore.h"
+
+namespace debug
+{
+
+/// @brief Counts the reads, writes and executed instructions of every address of the CPU address space, frame by
+/// frame. The reads are all the bus reads, opcode fetches and dummy reads included, and the executions are the
+/// opcode fetches. At the end of every frame the counters are kept in a compact snapshot, with only the addresses
+/// accessed and their counts as variable length integers, and cleared. The snapshots can be exported as CSV or as
+/// an image of the address space
+class AccessHeatmap
+{
+  public:
+    /// @brief Number of addresses of the CPU address space
+    static constexpr size_t NUM_ADDRESSES = 0x10000;
+
+    /// @brief Number of kinds of accesses counted, one per AccessKind
+    static constexpr size_t NUM_KINDS = 3;
+
+    /// @brief Constructor
+    AccessHeatmap();
+
+    /// @brief Count an access in the current frame, called by the memory map and the CPU
+    /// @param address The address accessed
+    /// @param kind The kind of access
+    void add(const uint16_t address, const AccessKind kind)
+    {
+        counts[static_cast<size_t>(kind) * NUM_ADDRESSES + address]++;
+    }
+
+    /// @brief Take the snapshot of the current frame and start a new one
+    /// @param frame The number of the frame that ends
+    void end_frame(const uint64_t frame);
+
+    /// @brief Return the number of snapshots taken
+    size_t get_frame_count() const;
+
+    /// @brief Return the number of the frame of a snapshot
+    /// @param index From 0 for the first snapshot to get_frame_count() - 1 for the last one
+    uint64_t get_frame_number(const size_t index) const;
+
+    /// @brief Decode the counters of a snapshot
+    /// @param index From 0 for the first snapshot to get_frame_count() - 1 for the last one
+    /// @param frame_counts Where the counters are stored, NUM_KINDS blocks of NUM_ADDRESSES counters in the order
+    /// of AccessKind
+    void get_frame_counts(const size_t index, std::vector<uint32_t> &frame_counts) const;
+
+    /// @brief Return the counters of all the snapshots added up, in the layout of get_frame_counts
+    const std::vector<uint64_t> &get_total_counts() const;
+
+    /// @brief Return the size of the snapshots in memory, in bytes
+    size_t get_snapshot_size() const;
+
+    /// @brief Save the snapshots as CSV, with a row per address accessed in a frame: frame, address, reads, writes
+    /// and executions
+    /// @return True if the operation was successful
+    bool save_csv(const std::filesystem::path &filename) const;
+
+    /// @brief Save the total counters as a 256x256 PPM image, a row per page and a pixel per address. The writes
+    /// are red, the reads green and the executions blue, on a logarithmic scale so the cold addresses still show
+    /// @return True if the operation was successful
+    bool save_image(const std::filesystem::path &filename) const;
+
+  private:
+    /// @brief The counters of the current frame, in the layout of get_frame_counts
+    std::vector<uint32_t> counts;
+
+    /// @brief The counters of all the snapshots added up
+    std::vector<uint64_t> total_counts;
+
+    /// @brief The snapshots, one after the other
+    std::vector<uint8_t> snapshots;
+
+    /// @brief Where every snapshot starts in snapshots
+    std::vector<size_t> snapshot_offsets;
+
+    /// @brief The number of the frame of every snapshot
+    std::vector<uint64_t> frame_numbers;
+};
+
+} // namespace debug
+
+#endif
@@ -0,0 +1,144 @@
+#include "Breakpoints.h"
+
+#include <algorithm>
+
+namespace debug
+{
+
+void Breakpoints::add_breakpoint(const uint16_t pc)
+{
+    pc_breakpoints.set(pc);
+}
+
+void Breakpoints::remove_breakpoint(const uint16_t pc)
+{
+    pc_breakpoints.reset(pc);
+}
+
+bool Breakpoints::has_breakpoint(const uint16_t pc) const
+{
+    return pc_breakpoints.test(pc);
+}
+
+uint32_t Breakpoints::add_watchpoint(const Watchpoint &watchpoint)
+{
+    watchpoints.emplace_back(next_watchpoint_id, watchpoint);
+    return next_watchpoint_id++;
+}
+
+bool Breakpoints::remove_watchpoint(const uint32_t id)
+{
+    auto it = std::find_if(watchpoints.begin(), watchpoints.end(),
+                           [id](const std::pair<uint32_t, Watchpoint> &entry) { return entry.first == id; });
+    if (it == watchpoints.end())
+    {
+        return false;
+    }
+    watchpoints.erase(it);
+    return true;
+}
+
+void Breakpoints::clear()
+{
+    pc_breakpoints.reset();
+    watchpoints.clear();
+}
+
+std::array<uint8_t, Breakpoints::NUM_PAGES> Breakpoints::get_watched_pages() const
+{
+    std::array<uint8_t, NUM_PAGES> pages = {};
+    for (const auto &entry : watchpoints)
+    {
+        const Watchpoint &watchpoint = entry.second;
+        for (uint32_t page = fold(watchpoint.first) >> 8; page <= (uint32_t)(fold(watchpoint.last) >> 8); page++)
+        {
+            pages[page] |= watchpoint.access;
+            // The RAM is also reached through its mirrors
+            for (uint32_t mirror = page + RAM_PAGES; page < RAM_PAGES && mirror < (CPU_RAM_END >> 8);
+                 mirror += RAM_PAGES)
+            {
+                pages[mirror] |= watchpoint.access;
+            }
+        }
+    }
+    return pages;
+}
+
+bool Breakpoints::check_pc(const uint16_t pc)
+{
+    if (stop.reason != StopReason::NONE)
+    {
+        return true;
+    }
+    if (resuming)
+    {
+        resuming = false;
+        if (pc == stop.pc)
+        {
+            return false;
+        }
+    }
+    if (pc_breakpoints.test(pc))
+    {
+        stop = Stop();
+        stop.reason = StopReason::BREAKPOINT;
+        stop.pc = pc;
+        return true;
+    }
+    return false;
+}
+
+void Breakpoints::check_access(const uint16_t address, const uint8_t value, const bool write)
+{
+    // The first match is reported
+    if (stop.reason != StopReason::NONE)
+    {
+        return;
+    }
+
+    const uint8_t access = write ? WATCH_WRITE : WATCH_READ;
+    const uint16_t folded = fold(address);
+    for (const auto &entry : watchpoints)
+    {
+        const Watchpoint &watchpoint = entry.second;
+        if (folded >= fold(watchpoint.first) && folded <= fold(watchpoint.last) && (watchpoint.access & access) &&
+            (!watchpoint.has_value || watchpoint.value == value))
+        {
+            stop.reason = StopReason::WATCHPOINT;
+            stop.watchpoint = entry.first;
+            stop.address = address;
+            stop.value = value;
+            stop.write = write;
+            return;
+        }
+    }
+}
+
+bool Breakpoints::is_stopped() const
+{
+    return stop.reason != StopReason::NONE;
+}
+
+const Stop &Breakpoints::get_stop() const
+{
+    return stop;
+}
+
+uint16_t Breakpoints::fold(const uint16_t address)
+{
+    return address < CPU_RAM_END ? address & CPU_RAM_MASK : address;
+}
+
+void Breakpoints::set_stop(const Stop &stop)
+{
+    this->stop = stop;
+    resuming = false;
+}
+
+void Breakpoints::resume()
+{
+    resuming = stop.reason == StopReason::BREAKPOINT;
+    stop.reason = StopReason::NONE;
+}
+
+} // namespace debug
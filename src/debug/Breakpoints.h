@@ -0,0 +1,136 @@
+#ifndef DEBUG_BREAKPOINTS_H
+#define DEBUG_BREAKPOINTS_H
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace debug
+{
+
+/// @brief Accesses a watchpoint reacts to
+enum WatchAccess : uint8_t
+{
+    WATCH_READ = 0x1,
+    WATCH_WRITE = 0x2,
+    WATCH_ACCESS = WATCH_READ | WATCH_WRITE
+};
+
+/// @brief A range of addresses whose accesses stop the emulation. The CPU RAM addresses, of both the range and
+/// the accesses, are folded into $0000-$07FF, so a RAM range matches all its mirrors (and cannot span two of them)
+struct Watchpoint
+{
+    uint16_t first; // First address of the range
+    uint16_t last;  // Last address of the range, included
+    uint8_t access; // WatchAccess bits
+    bool has_value; // If true, only accesses that read or write value match
+    uint8_t value;  // Value to match, if has_value is set
+};
+
+/// @brief Why the emulation stopped
+enum class StopReason : uint8_t
+{
+    NONE,       // It did not stop
+    BREAKPOINT, // The pc reached a breakpoint, the instruction there has not been executed
+    WATCHPOINT  // An access matched a watchpoint, the instruction that made it has been completed
+};
+
+/// @brief Description of the last stop
+struct Stop
+{
+    StopReason reason = StopReason::NONE;
+    uint16_t pc = 0;         // The pc of the breakpoint
+    uint32_t watchpoint = 0; // The identifier of the watchpoint
+    uint16_t address = 0;    // The address of the access that matched the watchpoint
+    uint8_t value = 0;       // The value read or written by that access
+    bool write = false;      // True if that access was a write
+};
+
+/// @brief PC breakpoints and memory watchpoints. The CPU and the memory map only look at them while they are
+/// connected, and even then the memory map only takes the slow path for the pages tagged by get_watched_pages,
+/// so the emulation keeps running at full speed outside the watched areas
+class Breakpoints
+{
+  public:
+    /// @brief Number of pages in the CPU address space
+    static constexpr size_t NUM_PAGES = 0x100;
+
+    /// @brief Stop before executing the instruction at the provided pc
+    void add_breakpoint(const uint16_t pc);
+
+    /// @brief Remove the breakpoint at the provided pc, if any
+    void remove_breakpoint(const uint16_t pc);
+
+    /// @brief Return true if there is a breakpoint at the provided pc
+    bool has_breakpoint(const uint16_t pc) const;
+
+    /// @brief Add a watchpoint. The memory map has to be connected again to tag its pages
+    /// @return The identifier of the watchpoint
+    uint32_t add_watchpoint(const Watchpoint &watchpoint);
+
+    /// @brief Remove the watchpoint with the provided identifier
+    /// @return True if the watchpoint existed
+    bool remove_watchpoint(const uint32_t id);
+
+    /// @brief Remove all the breakpoints and watchpoints
+    void clear();
+
+    /// @brief Return the WatchAccess bits watched in every page of the CPU address space
+    std::array<uint8_t, NUM_PAGES> get_watched_pages() const;
+
+    /// @brief Called by the CPU before executing an instruction
+    /// @param pc The pc of the instruction
+    /// @return True if the emulation has to stop before the instruction
+    bool check_pc(const uint16_t pc);
+
+    /// @brief Called by the memory map for the accesses to watched pages. A match stops the emulation
+    /// after the current instruction
+    /// @param address The address of the access
+    /// @param value The value read or written
+    /// @param write True for writes
+    void check_access(const uint16_t address, const uint8_t value, const bool write);
+
+    /// @brief Return true if the emulation has stopped and not been resumed
+    bool is_stopped() const;
+
+    /// @brief Return the description of the last stop
+    const Stop &get_stop() const;
+
+    /// @brief Record a stop found without running into it, such as one reached by a reverse execution, so that
+    /// it is reported and resumed like any other
+    void set_stop(const Stop &stop);
+
+    /// @brief Clear the stop so that the emulation can continue. A breakpoint does not stop again at its pc
+    /// until another instruction has been executed
+    void resume();
+
+  private:
+    /// @brief Size of the CPU RAM, mirrored up to $2000
+    static constexpr uint16_t CPU_RAM_END = 0x2000;
+    static constexpr uint16_t CPU_RAM_MASK = 0x07FF;
+    static constexpr uint32_t RAM_PAGES = (CPU_RAM_MASK + 1) >> 8;
+
+    /// @brief Fold a CPU RAM address into its first mirror, other addresses are returned as they are
+    static uint16_t fold(const uint16_t address);
+
+    /// @brief One bit per address with a breakpoint
+    std::bitset<0x10000> pc_breakpoints;
+
+    /// @brief The watchpoints, with their identifiers
+    std::vector<std::pair<uint32_t, Watchpoint>> watchpoints;
+
+    /// @brief Identifier of the next watchpoint
+    uint32_t next_watchpoint_id = 0;
+
+    /// @brief The last stop
+    Stop stop;
+
+    /// @brief True right after resume, until the next instruction starts
+    bool resuming = false;
+};
+
+} // namespace debug
+
+#endif
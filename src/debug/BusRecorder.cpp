@@ -0,0 +1,219 @@
+#include "BusRecorder.h"
+
+#include <fstream>
+#include <string>
+
+#include "common/Encoding.h"
+#include "common/Logging.h"
+#include "common/MappedFile.h"
+
+namespace debug
+{
+
+/// Identifies a binary bus recording at the start of the file
+static constexpr char FILE_MAGIC[4] = {'E', 'B', 'U', 'S'};
+
+/// Size of the header and of an access in the binary format
+static constexpr size_t HEADER_SIZE = sizeof(FILE_MAGIC) + 8;
+static constexpr size_t RECORD_SIZE = 8 + 2 + 1 + 1;
+
+/// The NTSC CPU clock, the VCD timestamps are in nanoseconds
+static constexpr long double CPU_CLOCK_HZ = 1789773.0L;
+
+/// Identifiers of the signals of the VCD waveform
+static constexpr char VCD_ADDRESS = '!';
+static constexpr char VCD_DATA = '"';
+static constexpr char VCD_RW = '#';
+static constexpr char VCD_SYNC = '$';
+static constexpr char VCD_CYCLE = '%';
+
+/// Number of accesses converted before they are written to a file
+static constexpr size_t CHUNK_SIZE = 0x1000;
+
+/// Append a VCD value change of a vector signal, in binary without the leading zeros
+static void put_vcd_vector(std::string &text, const uint64_t value, const char identifier)
+{
+    text.push_back('b');
+    int bit = 63;
+    while (bit > 0 && !((value >> bit) & 0x1))
+    {
+        bit--;
+    }
+    for (; bit >= 0; bit--)
+    {
+        text.push_back((value >> bit) & 0x1 ? '1' : '0');
+    }
+    text.push_back(' ');
+    text.push_back(identifier);
+    text.push_back('\n');
+}
+
+/// Append a VCD value change of a single bit signal
+static void put_vcd_bit(std::string &text, const bool value, const char identifier)
+{
+    text.push_back(value ? '1' : '0');
+    text.push_back(identifier);
+    text.push_back('\n');
+}
+
+BusRecorder::BusRecorder(const size_t capacity) : buffer(std::max<size_t>(capacity, 1))
+{
+}
+
+void BusRecorder::clear()
+{
+    next = 0;
+    recorded = 0;
+    next_cycle = 0;
+    sync = false;
+}
+
+size_t BusRecorder::get_size() const
+{
+    return std::min<uint64_t>(recorded, buffer.size());
+}
+
+uint64_t BusRecorder::get_recorded_count() const
+{
+    return recorded;
+}
+
+const BusCycle &BusRecorder::get_cycle(const size_t index) const
+{
+    // Once the ring is full, the oldest access is the one to be overwritten next
+    const size_t oldest = recorded > buffer.size() ? next : 0;
+    return buffer[(oldest + index) % buffer.size()];
+}
+
+bool BusRecorder::save_vcd(const std::filesystem::path &filename) const
+{
+    std::ofstream file(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!file.is_open())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be opened");
+        return false;
+    }
+
+    std::string text = "$version emunes $end\n"
+                       "$timescale 1 ns $end\n"
+                       "$scope module cpu $end\n"
+                       "$var wire 16 ! address [15:0] $end\n"
+                       "$var wire 8 \" data [7:0] $end\n"
+                       "$var wire 1 # rw $end\n"
+                       "$var wire 1 $ sync $end\n"
+                       "$var integer 64 % cycle $end\n"
+                       "$upscope $end\n"
+                       "$enddefinitions $end\n";
+
+    // Only the signals that change are written, except for the first access, which sets all of them
+    const size_t size = get_size();
+    for (size_t index = 0; index < size; index++)
+    {
+        const BusCycle &access = get_cycle(index);
+        const BusCycle *previous = index > 0 ? &get_cycle(index - 1) : nullptr;
+        text.push_back('#');
+        text += std::to_string(static_cast<uint64_t>(access.cycle * 1000000000.0L / CPU_CLOCK_HZ));
+        text.push_back('\n');
+        if (!previous || previous->address != access.address)
+        {
+            put_vcd_vector(text, access.address, VCD_ADDRESS);
+        }
+        if (!previous || previous->data != access.data)
+        {
+            put_vcd_vector(text, access.data, VCD_DATA);
+        }
+        // The R/W pin of the 6502 is high for reads
+        if (!previous || (previous->flags & BUS_WRITE) != (access.flags & BUS_WRITE))
+        {
+            put_vcd_bit(text, !(access.flags & BUS_WRITE), VCD_RW);
+        }
+        if (!previous || (previous->flags & BUS_SYNC) != (access.flags & BUS_SYNC))
+        {
+            put_vcd_bit(text, access.flags & BUS_SYNC, VCD_SYNC);
+        }
+        put_vcd_vector(text, access.cycle, VCD_CYCLE);
+        if (index % CHUNK_SIZE == CHUNK_SIZE - 1)
+        {
+            file.write(text.data(), text.size());
+            text.clear();
+        }
+    }
+    file.write(text.data(), text.size());
+
+    if (!file.good())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be written");
+        return false;
+    }
+    return true;
+}
+
+bool BusRecorder::save_binary(const std::filesystem::path &filename) const
+{
+    std::ofstream file(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!file.is_open())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be opened");
+        return false;
+    }
+
+    const size_t size = get_size();
+    uint8_t header[HEADER_SIZE];
+    std::copy(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC), header);
+    common::put_le(header + sizeof(FILE_MAGIC), size, 8);
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+    std::vector<uint8_t> chunk(CHUNK_SIZE * RECORD_SIZE);
+    for (size_t first = 0; first < size; first += CHUNK_SIZE)
+    {
+        const size_t count = std::min(CHUNK_SIZE, size - first);
+        for (size_t index = 0; index < count; index++)
+        {
+            const BusCycle &access = get_cycle(first + index);
+            uint8_t *data = chunk.data() + index * RECORD_SIZE;
+            common::put_le(data, access.cycle, 8);
+            common::put_le(data + 8, access.address, 2);
+            data[10] = access.data;
+            data[11] = access.flags;
+        }
+        file.write(reinterpret_cast<const char *>(chunk.data()), count * RECORD_SIZE);
+    }
+
+    if (!file.good())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be written");
+        return false;
+    }
+    return true;
+}
+
+bool BusRecorder::load_binary(const std::filesystem::path &filename, std::vector<BusCycle> &cycles)
+{
+    common::MappedFile file;
+    if (!file.open(filename))
+    {
+        return false;
+    }
+    const uint8_t *data = file.data();
+    const size_t size = file.size();
+    if (size < HEADER_SIZE || !std::equal(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC), data) ||
+        (size - HEADER_SIZE) / RECORD_SIZE != common::get_le(data + sizeof(FILE_MAGIC), 8) ||
+        (size - HEADER_SIZE) % RECORD_SIZE != 0)
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " is not a complete bus recording");
+        return false;
+    }
+
+    cycles.resize((size - HEADER_SIZE) / RECORD_SIZE);
+    for (size_t index = 0; index < cycles.size(); index++)
+    {
+        const uint8_t *record = data + HEADER_SIZE + index * RECORD_SIZE;
+        cycles[index].cycle = common::get_le(record, 8);
+        cycles[index].address = common::get_le(record + 8, 2);
+        cycles[index].data = record[10];
+        cycles[index].flags = record[11];
+    }
+    return true;
+}
+
+} // namespace debug
@@ -0,0 +1,119 @@
+#ifndef DEBUG_BUSRECORDER_H
+#define DEBUG_BUSRECORDER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace debug
+{
+
+/// @brief Bits of the flags of a bus cycle
+enum BusFlag : uint8_t
+{
+    BUS_WRITE = 0x1, // The CPU wrote the data, otherwise it read it (the R/W pin is low)
+    BUS_SYNC = 0x2   // The CPU fetched an opcode (the SYNC pin is high)
+};
+
+/// @brief An access of the CPU to the bus
+struct BusCycle
+{
+    uint64_t cycle;   // The CPU cycle of the access
+    uint16_t address; // The address selection
+    uint8_t data;     // The value read or written
+    uint8_t flags;    // BusFlag bits
+};
+
+/// @brief Records every access the CPU makes to the memory map, dummy reads included, in a buffer allocated up
+/// front, so recording costs a few stores per access. Once the buffer is full the oldest accesses are overwritten,
+/// as in a logic analyser, so it always holds the last accesses before the emulation stopped. The CPU only knows the
+/// cycle an instruction starts at, and the 6502 accesses the bus once per cycle, so the n-th access of an
+/// instruction is stamped with its first cycle plus n. The records can be exported as a VCD waveform, e.g. for
+/// GTKWave, or in a compact binary format for scripts
+class BusRecorder
+{
+  public:
+    /// @brief Default number of accesses kept
+    static constexpr size_t DEFAULT_CAPACITY = 0x100000;
+
+    /// @brief Constructor
+    /// @param capacity Number of accesses kept, allocated at once. It is at least one
+    explicit BusRecorder(const size_t capacity = DEFAULT_CAPACITY);
+
+    /// @brief Called by the CPU before it fetches an opcode, so that the accesses of the instruction are stamped from
+    /// its first cycle and the fetch is flagged with BUS_SYNC
+    /// @param cycle The cycle count before the instruction
+    void start_instruction(const uint64_t cycle)
+    {
+        // An instruction never starts before the last access of the previous one
+        next_cycle = std::max(next_cycle, cycle);
+        sync = true;
+    }
+
+    /// @brief Record an access, called by the memory map
+    /// @param address The address selection
+    /// @param data The value read or written
+    /// @param write True for a write
+    void record(const uint16_t address, const uint8_t data, const bool write)
+    {
+        BusCycle &entry = buffer[next];
+        entry.cycle = next_cycle++;
+        entry.address = address;
+        entry.data = data;
+        entry.flags = (write ? BUS_WRITE : 0) | (sync ? BUS_SYNC : 0);
+        sync = false;
+        next = next + 1 == buffer.size() ? 0 : next + 1;
+        recorded++;
+    }
+
+    /// @brief Forget all the accesses recorded
+    void clear();
+
+    /// @brief Return the number of accesses kept, at most the capacity
+    size_t get_size() const;
+
+    /// @brief Return the number of accesses recorded since the last clear, including the overwritten ones
+    uint64_t get_recorded_count() const;
+
+    /// @brief Return an access kept in the buffer
+    /// @param index From 0 for the oldest one to get_size() - 1 for the last one
+    const BusCycle &get_cycle(const size_t index) const;
+
+    /// @brief Save the accesses as a VCD waveform with the signals address, data, rw and sync, at the NTSC CPU
+    /// clock. The cycle count is also a signal, so that consecutive identical accesses can be told apart
+    /// @return True if the operation was successful
+    bool save_vcd(const std::filesystem::path &filename) const;
+
+    /// @brief Save the accesses in the binary format: the magic EBUS, the number of accesses as a 64 bit value and
+    /// 12 bytes per access, cycle (8), address (2), data (1) and flags (1), all of them little endian
+    /// @return True if the operation was successful
+    bool save_binary(const std::filesystem::path &filename) const;
+
+    /// @brief Load the accesses saved by save_binary
+    /// @param filename The binary file
+    /// @param cycles Where the accesses are stored, oldest first
+    /// @return True if the operation was successful
+    static bool load_binary(const std::filesystem::path &filename, std::vector<BusCycle> &cycles);
+
+  private:
+    /// @brief The ring of accesses
+    std::vector<BusCycle> buffer;
+
+    /// @brief Where the next access is stored
+    size_t next = 0;
+
+    /// @brief Number of accesses recorded since the last clear
+    uint64_t recorded = 0;
+
+    /// @brief Cycle of the next access
+    uint64_t next_cycle = 0;
+
+    /// @brief True if the next access is an opcode fetch
+    bool sync = false;
+};
+
+} // namespace debug
+
+#endif
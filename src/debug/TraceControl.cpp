@@ -0,0 +1,63 @@
+#include "TraceControl.h"
+
+namespace debug
+{
+
+/// Start of the PRG ROM in the CPU address space
+static constexpr uint32_t PRG_ROM_START = 0x8000;
+
+void TraceControl::set_window(const TraceTrigger &start, const TraceTrigger &stop, const bool repeat)
+{
+    this->start = start;
+    this->stop = stop;
+    this->repeat = repeat && (stop.event == TraceEvent::PC || stop.event == TraceEvent::WRITE);
+    rewind();
+}
+
+void TraceControl::add_pc_range(const uint16_t first, const uint16_t last)
+{
+    for (uint32_t pc = first; pc <= last; pc++)
+    {
+        pc_filter.set(pc);
+    }
+    filtered = true;
+}
+
+void TraceControl::add_bank(const size_t bank, const size_t prg_rom_size)
+{
+    filtered = true;
+    if (prg_rom_size == 0)
+    {
+        return;
+    }
+    for (uint32_t pc = PRG_ROM_START; pc <= 0xFFFF; pc++)
+    {
+        if ((pc - PRG_ROM_START) % prg_rom_size / BANK_SIZE == bank)
+        {
+            pc_filter.set(pc);
+        }
+    }
+}
+
+void TraceControl::clear_filters()
+{
+    pc_filter.reset();
+    filtered = false;
+}
+
+void TraceControl::rewind()
+{
+    state = start.event == TraceEvent::NONE ? WindowState::OPEN : WindowState::WAITING;
+}
+
+bool TraceControl::is_open() const
+{
+    return state == WindowState::OPEN || state == WindowState::CLOSING;
+}
+
+void TraceControl::set_frame(const uint64_t frame)
+{
+    this->frame = frame;
+}
+
+} // namespace debug
@@ -0,0 +1,166 @@
+#ifndef DEBUG_TRACECONTROL_H
+#define DEBUG_TRACECONTROL_H
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+namespace debug
+{
+
+/// @brief Events that open or close the trace window
+enum class TraceEvent : uint8_t
+{
+    NONE,  // Never happens. As a start, the window is open from the beginning, as a stop, it never closes
+    PC,    // The pc reaches the value. The instruction there is the first or the last one traced
+    WRITE, // An instruction writes to the address in value. It is the last one traced, or the one before the first
+    FRAME, // The frame in value starts, frames are counted from 0 since power on. The end is not included
+    CYCLE  // The cycle count reaches the value. The end is not included
+};
+
+/// @brief An event and its value: a pc, an address, a frame or a cycle
+struct TraceTrigger
+{
+    TraceEvent event = TraceEvent::NONE;
+    uint64_t value = 0;
+};
+
+/// @brief Decides which instructions go to the trace: a window opened and closed by triggers, and filters by pc
+/// range or PRG ROM bank on top of it. The CPU only looks at it while a log file is connected, so the untraced
+/// emulation pays nothing for it, and while tracing it costs a few comparisons per instruction
+class TraceControl
+{
+  public:
+    /// @brief Size of the PRG ROM banks used by the bank filter
+    static constexpr size_t BANK_SIZE = 0x4000;
+
+    /// @brief Set the events that open and close the trace window, and rewind it to wait for the start again
+    /// @param start The event that opens the window
+    /// @param stop The event that closes the window
+    /// @param repeat If true, the window waits for the start again after closing, e.g. to trace every call of a
+    /// routine from its entry to its RTS. Frames and cycles only pass once, so a window they close never repeats
+    void set_window(const TraceTrigger &start, const TraceTrigger &stop, const bool repeat = false);
+
+    /// @brief Only trace the instructions with a pc in the range. Without any pc range or bank, all are traced
+    /// @param first First pc of the range
+    /// @param last Last pc of the range, included
+    void add_pc_range(const uint16_t first, const uint16_t last);
+
+    /// @brief Only trace the instructions in a bank of the PRG ROM, which is mirrored from $8000 as in the code/data
+    /// log. Without any pc range or bank, all are traced
+    /// @param bank Index of the bank of BANK_SIZE bytes
+    /// @param prg_rom_size Size of the PRG ROM
+    void add_bank(const size_t bank, const size_t prg_rom_size);
+
+    /// @brief Remove the pc ranges and banks, so every instruction in the window is traced
+    void clear_filters();
+
+    /// @brief Rewind the window to wait for the start again
+    void rewind();
+
+    /// @brief Return true while the window is open
+    bool is_open() const;
+
+    /// @brief Called by the CPU before tracing an instruction
+    /// @param pc The pc of the instruction
+    /// @param cycles The cycle count before the instruction
+    /// @return True if the instruction has to be traced
+    bool check_instruction(const uint16_t pc, const uint64_t cycles)
+    {
+        // The window is closed by the instruction that matches the stop, after tracing it
+        if (state == WindowState::CLOSING)
+        {
+            state = repeat ? WindowState::WAITING : WindowState::CLOSED;
+        }
+        if (state == WindowState::WAITING && matches(start, pc, cycles))
+        {
+            state = WindowState::OPEN;
+        }
+        if (state != WindowState::OPEN)
+        {
+            return false;
+        }
+        if (matches(stop, pc, cycles))
+        {
+            // The instruction at the stop pc is traced, a frame or a cycle is where the window already ended
+            if (stop.event != TraceEvent::PC)
+            {
+                state = WindowState::CLOSED;
+                return false;
+            }
+            state = WindowState::CLOSING;
+        }
+        return !filtered || pc_filter.test(pc);
+    }
+
+    /// @brief Called by the CPU for every write while the trace control is connected
+    /// @param address The address of the write
+    void check_write(const uint16_t address)
+    {
+        if (state == WindowState::WAITING && start.event == TraceEvent::WRITE && address == start.value)
+        {
+            state = WindowState::OPEN;
+        }
+        else if (state == WindowState::OPEN && stop.event == TraceEvent::WRITE && address == stop.value)
+        {
+            state = WindowState::CLOSING;
+        }
+    }
+
+    /// @brief Called when a frame starts, as the CPU does not know about frames
+    /// @param frame The number of the frame, counted from 0 since power on
+    void set_frame(const uint64_t frame);
+
+  private:
+    /// @brief Where the window is
+    enum class WindowState : uint8_t
+    {
+        WAITING, // Waiting for the start
+        OPEN,    // Tracing
+        CLOSING, // The stop has been met, the window closes before the next instruction
+        CLOSED   // Done, until rewound
+    };
+
+    /// @brief Return true if an instruction matches a trigger. The writes are reported by check_write
+    bool matches(const TraceTrigger &trigger, const uint16_t pc, const uint64_t cycles) const
+    {
+        switch (trigger.event)
+        {
+        case TraceEvent::PC:
+            return pc == trigger.value;
+        case TraceEvent::FRAME:
+            return frame >= trigger.value;
+        case TraceEvent::CYCLE:
+            return cycles >= trigger.value;
+        case TraceEvent::NONE:
+        case TraceEvent::WRITE:
+            break;
+        }
+        return false;
+    }
+
+    /// @brief The event that opens the window
+    TraceTrigger start;
+
+    /// @brief The event that closes the window
+    TraceTrigger stop;
+
+    /// @brief If true, the window waits for the start again after closing
+    bool repeat = false;
+
+    /// @brief Where the window is. Without a start, it is open from the beginning
+    WindowState state = WindowState::OPEN;
+
+    /// @brief The current frame
+    uint64_t frame = 0;
+
+    /// @brief True if there is any pc range or bank
+    bool filtered = false;
+
+    /// @brief One bit per pc that passes the filters
+    std::bitset<0x10000> pc_filter;
+};
+
+} // namespace debug
+
+#endif
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstring>
+
+#include "TraceDiff.h"
+
+namespace debug
+{
+
+TraceDiff::TraceDiff(const std::vector<ColumnRange> &columns) : columns(columns)
+{
+}
+
+TraceDiffResult TraceDiff::compare(const std::string_view a, const std::string_view b,
+                                   const size_t max_divergences) const
+{
+    TraceDiffResult result;
+    size_t offset_a = 0;
+    size_t offset_b = 0;
+    while ((offset_a < a.size() || offset_b < b.size()) && result.divergences.size() < max_divergences)
+    {
+        result.lines++;
+        // One of the traces is shorter than the other, nothing else can be compared
+        if (offset_a >= a.size() || offset_b >= b.size())
+        {
+            result.divergences.push_back(TraceDivergence{result.lines, {offset_a, offset_b}});
+            break;
+        }
+
+        // Every line is only searched once
+        const size_t next_a = get_next_line(a, offset_a);
+        const size_t next_b = get_next_line(b, offset_b);
+        if (!matches(trim_line_ending(a.substr(offset_a, next_a - offset_a)),
+                     trim_line_ending(b.substr(offset_b, next_b - offset_b))))
+        {
+            result.divergences.push_back(TraceDivergence{result.lines, {offset_a, offset_b}});
+        }
+        offset_a = next_a;
+        offset_b = next_b;
+    }
+    return result;
+}
+
+bool TraceDiff::matches(const std::string_view a, const std::string_view b) const
+{
+    if (columns.empty())
+    {
+        return a == b;
+    }
+    for (const ColumnRange &range : columns)
+    {
+        // substr clips the ranges to the end of the lines
+        const std::string_view column_a = range.begin < a.size() ? a.substr(range.begin, range.end - range.begin)
+                                                                 : std::string_view();
+        const std::string_view column_b = range.begin < b.size() ? b.substr(range.begin, range.end - range.begin)
+                                                                 : std::string_view();
+        if (column_a != column_b)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view TraceDiff::get_line(const std::string_view trace, const size_t offset)
+{
+    return trim_line_ending(trace.substr(offset, get_next_line(trace, offset) - offset));
+}
+
+size_t TraceDiff::get_next_line(const std::string_view trace, const size_t offset)
+{
+    if (offset >= trace.size())
+    {
+        return trace.size();
+    }
+    const void *end = std::memchr(trace.data() + offset, '\n', trace.size() - offset);
+    return end ? static_cast<const char *>(end) - trace.data() + 1 : trace.size();
+}
+
+size_t TraceDiff::get_previous_line(const std::string_view trace, const size_t offset)
+{
+    // Skip the line ending of the previous line, then look for the one before it
+    size_t end = std::min(offset, trace.size());
+    if (end > 0 && trace[end - 1] == '\n')
+    {
+        end--;
+    }
+    if (end == 0)
+    {
+        return 0;
+    }
+    const size_t newline = trace.rfind('\n', end - 1);
+    return newline == std::string_view::npos ? 0 : newline + 1;
+}
+
+std::string_view TraceDiff::trim_line_ending(std::string_view line)
+{
+    if (!line.empty() && line.back() == '\n')
+    {
+        line.remove_suffix(1);
+    }
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+} // namespace debug
@@ -0,0 +1,72 @@
+#ifndef DEBUG_TRACE_DIFF_H
+#define DEBUG_TRACE_DIFF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+namespace debug
+{
+
+/// @brief A range of characters of every line, from begin (included) to end (excluded)
+struct ColumnRange
+{
+    size_t begin;
+    size_t end = std::numeric_limits<size_t>::max();
+};
+
+/// @brief A line that differs between two traces
+struct TraceDivergence
+{
+    uint64_t line;     // Line number, starting at 1
+    size_t offsets[2]; // Offset of the line in each trace, the size of the trace if it has already ended
+};
+
+/// @brief The outcome of comparing two traces
+struct TraceDiffResult
+{
+    std::vector<TraceDivergence> divergences; // The first divergences, in order
+    uint64_t lines = 0;                       // Number of lines compared
+};
+
+/// @brief Compares two traces line by line, such as nestest.log and the trace of the emulator, looking only at
+/// some columns of each line so that those an emulator does not produce (or produces differently) are ignored.
+/// The traces are views, normally of common::MappedFile, so they are never copied, and lines are found and
+/// compared with memchr and memcmp, which the C library vectorises, so gigabyte traces take seconds
+class TraceDiff
+{
+  public:
+    /// @brief Constructor
+    /// @param columns The ranges of characters compared, all of them if empty. Characters beyond the end of a
+    /// line compare as missing, so a line that is shorter than a range only matches an equally short one
+    explicit TraceDiff(const std::vector<ColumnRange> &columns = {});
+
+    /// @brief Compare two traces. Line endings ("\n" or "\r\n") are not compared
+    /// @param max_divergences The comparison stops after finding this number of divergences
+    TraceDiffResult compare(const std::string_view a, const std::string_view b, const size_t max_divergences) const;
+
+    /// @brief Return true if two lines match in the compared columns
+    bool matches(const std::string_view a, const std::string_view b) const;
+
+    /// @brief Return the line starting at an offset of a trace, without its line ending
+    static std::string_view get_line(const std::string_view trace, const size_t offset);
+
+    /// @brief Return the offset of the line after the one starting at an offset, the size of the trace at its end
+    static size_t get_next_line(const std::string_view trace, const size_t offset);
+
+    /// @brief Return the offset of the line before the one starting at an offset, 0 at the first line
+    static size_t get_previous_line(const std::string_view trace, const size_t offset);
+
+  private:
+    /// @brief Return a line without its line ending
+    static std::string_view trim_line_ending(std::string_view line);
+
+    /// @brief The ranges of characters compared
+    std::vector<ColumnRange> columns;
+};
+
+} // namespace debug
+
+#endif
@@ -0,0 +1,389 @@
+#include "TraceStore.h"
+
+#include <algorithm>
+
+#include "common/Encoding.h"
+#include "common/Logging.h"
+
+namespace debug
+{
+
+/// Identifies a trace store at the start of the file, and its index at the end
+static constexpr char FILE_MAGIC[4] = {'E', 'T', 'S', '1'};
+static constexpr char INDEX_MAGIC[4] = {'E', 'T', 'S', 'I'};
+
+/// The index is followed by its offset, the number of blocks and the magic
+static constexpr size_t TRAILER_SIZE = 8 + 8 + sizeof(INDEX_MAGIC);
+
+/// Size of an entry of the index in the file
+static constexpr size_t INDEX_ENTRY_SIZE = 8 + 4 + 8 + 8 + 2 * 4 + 8 * 4 + 4 * TraceBlockIndex::NUM_COLUMNS;
+
+/// The columns of a block, in the order they are stored
+enum Column : size_t
+{
+    CYCLES,    // Difference with the cycle of the previous instruction, one per instruction
+    PCS,       // Difference with the pc of the previous instruction, one per instruction
+    OPCODES,   // One byte per instruction
+    ADDRESSES, // Difference with the address of the previous access, one per access
+    VALUES,    // One byte per access
+    KINDS      // Two bits per row, four rows per byte
+};
+
+/// Map the difference of two 16 bit values to a small unsigned value, whatever its sign
+static uint64_t zigzag(const uint16_t value, const uint16_t previous)
+{
+    const int16_t delta = static_cast<int16_t>(value - previous);
+    return static_cast<uint16_t>((delta << 1) ^ (delta >> 15));
+}
+
+/// Undo zigzag
+static uint16_t unzigzag(const uint64_t encoded, const uint16_t previous)
+{
+    const uint16_t delta = static_cast<uint16_t>((encoded >> 1) ^ -(encoded & 0x1));
+    return previous + delta;
+}
+
+TraceStoreWriter::TraceStoreWriter(const size_t block_rows) : block_rows(std::max<size_t>(block_rows, 1))
+{
+}
+
+TraceStoreWriter::~TraceStoreWriter()
+{
+    close();
+}
+
+bool TraceStoreWriter::open(const std::filesystem::path &filename)
+{
+    close();
+    file.open(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!file.is_open())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be opened");
+        return false;
+    }
+    this->filename = filename;
+    file.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    index.clear();
+    block = TraceBlockIndex();
+    rows = 0;
+    return true;
+}
+
+bool TraceStoreWriter::close()
+{
+    if (!file.is_open())
+    {
+        return true;
+    }
+    if (block.rows > 0)
+    {
+        write_block();
+    }
+
+    const uint64_t index_offset = file.tellp();
+    std::vector<uint8_t> entry(INDEX_ENTRY_SIZE);
+    for (const TraceBlockIndex &summary : index)
+    {
+        uint8_t *data = entry.data();
+        common::put_le(data, summary.offset, 8);
+        common::put_le(data + 8, summary.rows, 4);
+        common::put_le(data + 12, summary.first_cycle, 8);
+        common::put_le(data + 20, summary.last_cycle, 8);
+        common::put_le(data + 28, summary.min_pc, 2);
+        common::put_le(data + 30, summary.max_pc, 2);
+        common::put_le(data + 32, summary.min_address, 2);
+        common::put_le(data + 34, summary.max_address, 2);
+        for (size_t word = 0; word < summary.pages.size(); word++)
+        {
+            common::put_le(data + 36 + 8 * word, summary.pages[word], 8);
+        }
+        for (size_t column = 0; column < TraceBlockIndex::NUM_COLUMNS; column++)
+        {
+            common::put_le(data + 68 + 4 * column, summary.column_sizes[column], 4);
+        }
+        file.write(reinterpret_cast<const char *>(entry.data()), entry.size());
+    }
+    uint8_t trailer[TRAILER_SIZE];
+    common::put_le(trailer, index_offset, 8);
+    common::put_le(trailer + 8, index.size(), 8);
+    std::copy(INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC), trailer + 16);
+    file.write(reinterpret_cast<const char *>(trailer), sizeof(trailer));
+
+    file.close();
+    if (file.fail())
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " could not be written");
+        return false;
+    }
+    return true;
+}
+
+void TraceStoreWriter::add_instruction(const uint16_t pc, const uint8_t opcode, const uint64_t cycle)
+{
+    // Blocks end between instructions, so that the accesses of a block always follow their instruction
+    if (block.rows >= block_rows)
+    {
+        write_block();
+    }
+    if (block.rows == 0)
+    {
+        block.first_cycle = cycle;
+        last_cycle = cycle;
+        last_pc = 0;
+        last_address = 0;
+    }
+
+    common::put_varint(columns[CYCLES], cycle - last_cycle);
+    common::put_varint(columns[PCS], zigzag(pc, last_pc));
+    columns[OPCODES].push_back(opcode);
+    last_cycle = cycle;
+    last_pc = pc;
+    block.last_cycle = cycle;
+    block.min_pc = std::min(block.min_pc, pc);
+    block.max_pc = std::max(block.max_pc, pc);
+
+    if (block.rows % 4 == 0)
+    {
+        columns[KINDS].push_back(0);
+    }
+    columns[KINDS].back() |= static_cast<uint8_t>(AccessKind::EXECUTE) << (2 * (block.rows % 4));
+    block.rows++;
+}
+
+void TraceStoreWriter::add_access(const uint16_t address, const uint8_t value, const AccessKind kind)
+{
+    // The store only opens with an instruction
+    if (block.rows == 0)
+    {
+        return;
+    }
+    common::put_varint(columns[ADDRESSES], zigzag(address, last_address));
+    columns[VALUES].push_back(value);
+    last_address = address;
+    block.min_address = std::min(block.min_address, address);
+    block.max_address = std::max(block.max_address, address);
+    block.pages[address >> 14] |= 1ULL << ((address >> 8) & 0x3F);
+
+    if (block.rows % 4 == 0)
+    {
+        columns[KINDS].push_back(0);
+    }
+    columns[KINDS].back() |= static_cast<uint8_t>(kind) << (2 * (block.rows % 4));
+    block.rows++;
+}
+
+uint64_t TraceStoreWriter::get_row_count() const
+{
+    return rows + block.rows;
+}
+
+void TraceStoreWriter::write_block()
+{
+    block.offset = file.tellp();
+    for (size_t column = 0; column < TraceBlockIndex::NUM_COLUMNS; column++)
+    {
+        block.column_sizes[column] = columns[column].size();
+        file.write(reinterpret_cast<const char *>(columns[column].data()), columns[column].size());
+        columns[column].clear();
+    }
+    index.push_back(block);
+    rows += block.rows;
+    block = TraceBlockIndex();
+}
+
+bool TraceStoreReader::open(const std::filesystem::path &filename)
+{
+    index.clear();
+    if (!file.open(filename))
+    {
+        return false;
+    }
+    const uint8_t *data = file.data();
+    const size_t size = file.size();
+    if (size < sizeof(FILE_MAGIC) + TRAILER_SIZE || !std::equal(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC), data) ||
+        !std::equal(INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC), data + size - sizeof(INDEX_MAGIC)))
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " is not a complete trace store");
+        return false;
+    }
+
+    const uint64_t index_offset = common::get_le(data + size - TRAILER_SIZE, 8);
+    const uint64_t num_blocks = common::get_le(data + size - TRAILER_SIZE + 8, 8);
+    if (index_offset > size - TRAILER_SIZE || (size - TRAILER_SIZE - index_offset) / INDEX_ENTRY_SIZE != num_blocks)
+    {
+        common::Log(common::LogLevel::ERROR, "The index of " + filename.string() + " is corrupted");
+        return false;
+    }
+    for (uint64_t entry = 0; entry < num_blocks; entry++)
+    {
+        const uint8_t *summary_data = data + index_offset + entry * INDEX_ENTRY_SIZE;
+        TraceBlockIndex summary;
+        summary.offset = common::get_le(summary_data, 8);
+        summary.rows = common::get_le(summary_data + 8, 4);
+        summary.first_cycle = common::get_le(summary_data + 12, 8);
+        summary.last_cycle = common::get_le(summary_data + 20, 8);
+        summary.min_pc = common::get_le(summary_data + 28, 2);
+        summary.max_pc = common::get_le(summary_data + 30, 2);
+        summary.min_address = common::get_le(summary_data + 32, 2);
+        summary.max_address = common::get_le(summary_data + 34, 2);
+        uint64_t block_size = 0;
+        for (size_t word = 0; word < summary.pages.size(); word++)
+        {
+            summary.pages[word] = common::get_le(summary_data + 36 + 8 * word, 8);
+        }
+        for (size_t column = 0; column < TraceBlockIndex::NUM_COLUMNS; column++)
+        {
+            summary.column_sizes[column] = common::get_le(summary_data + 68 + 4 * column, 4);
+            block_size += summary.column_sizes[column];
+        }
+        if (summary.offset + block_size > index_offset)
+        {
+            common::Log(common::LogLevel::ERROR, "The index of " + filename.string() + " is corrupted");
+            return false;
+        }
+        index.push_back(summary);
+    }
+    return true;
+}
+
+size_t TraceStoreReader::get_block_count() const
+{
+    return index.size();
+}
+
+uint64_t TraceStoreReader::get_row_count() const
+{
+    uint64_t rows = 0;
+    for (const TraceBlockIndex &block : index)
+    {
+        rows += block.rows;
+    }
+    return rows;
+}
+
+bool TraceStoreReader::query(const TraceQuery &query, const std::function<bool(const TraceRow &)> &visit,
+                             TraceQueryStats *stats) const
+{
+    TraceQueryStats totals;
+    std::vector<TraceRow> rows;
+    for (const TraceBlockIndex &block : index)
+    {
+        if (!may_match(block, query))
+        {
+            continue;
+        }
+        if (!decode_block(block, rows))
+        {
+            return false;
+        }
+        totals.blocks++;
+
+        bool done = false;
+        for (const TraceRow &row : rows)
+        {
+            if (((query.kinds >> static_cast<uint8_t>(row.kind)) & 0x1) && row.pc >= query.first_pc &&
+                row.pc <= query.last_pc && row.address >= query.first_address && row.address <= query.last_address &&
+                row.cycle >= query.first_cycle && row.cycle <= query.last_cycle)
+            {
+                totals.rows++;
+                if (!visit(row))
+                {
+                    done = true;
+                    break;
+                }
+            }
+        }
+        if (done)
+        {
+            break;
+        }
+    }
+    if (stats)
+    {
+        *stats = totals;
+    }
+    return true;
+}
+
+bool TraceStoreReader::may_match(const TraceBlockIndex &block, const TraceQuery &query)
+{
+    if (block.first_cycle > query.last_cycle || block.last_cycle < query.first_cycle ||
+        block.min_pc > query.last_pc || block.max_pc < query.first_pc)
+    {
+        return false;
+    }
+
+    // The instructions are at their pc, the accesses at one of the pages tagged in the block
+    const uint8_t execute = 1 << static_cast<uint8_t>(AccessKind::EXECUTE);
+    if ((query.kinds & execute) && block.min_pc <= query.last_address && block.max_pc >= query.first_address)
+    {
+        return true;
+    }
+    if (!(query.kinds & ~execute) || block.min_address > query.last_address || block.max_address < query.first_address)
+    {
+        return false;
+    }
+    for (uint32_t page = query.first_address >> 8; page <= static_cast<uint32_t>(query.last_address >> 8); page++)
+    {
+        if ((block.pages[page >> 6] >> (page & 0x3F)) & 0x1)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TraceStoreReader::decode_block(const TraceBlockIndex &block, std::vector<TraceRow> &rows) const
+{
+    std::array<const uint8_t *, TraceBlockIndex::NUM_COLUMNS> data;
+    std::array<const uint8_t *, TraceBlockIndex::NUM_COLUMNS> ends;
+    const uint8_t *position = file.data() + block.offset;
+    for (size_t column = 0; column < TraceBlockIndex::NUM_COLUMNS; column++)
+    {
+        data[column] = position;
+        position += block.column_sizes[column];
+        ends[column] = position;
+    }
+
+    rows.resize(block.rows);
+    TraceRow instruction = {block.first_cycle, 0, 0, 0, 0, AccessKind::EXECUTE};
+    uint16_t address = 0;
+    for (uint32_t row = 0; row < block.rows; row++)
+    {
+        if (data[KINDS] + row / 4 >= ends[KINDS])
+        {
+            common::Log(common::LogLevel::ERROR, "A block of the trace store is corrupted");
+            return false;
+        }
+        const AccessKind kind = static_cast<AccessKind>((data[KINDS][row / 4] >> (2 * (row % 4))) & 0x3);
+        uint64_t encoded = 0;
+        if (kind == AccessKind::EXECUTE)
+        {
+            uint64_t delta = 0;
+            if (!common::get_varint(data[CYCLES], ends[CYCLES], delta) ||
+                !common::get_varint(data[PCS], ends[PCS], encoded) || data[OPCODES] >= ends[OPCODES])
+            {
+                common::Log(common::LogLevel::ERROR, "A block of the trace store is corrupted");
+                return false;
+            }
+            instruction.cycle += delta;
+            instruction.pc = unzigzag(encoded, instruction.pc);
+            instruction.opcode = *data[OPCODES]++;
+            instruction.address = instruction.pc;
+            instruction.value = instruction.opcode;
+            rows[row] = instruction;
+            continue;
+        }
+
+        if (!common::get_varint(data[ADDRESSES], ends[ADDRESSES], encoded) || data[VALUES] >= ends[VALUES])
+        {
+            common::Log(common::LogLevel::ERROR, "A block of the trace store is corrupted");
+            return false;
+        }
+        address = unzigzag(encoded, address);
+        rows[row] = TraceRow{instruction.cycle, instruction.pc, address, instruction.opcode, *data[VALUES]++, kind};
+    }
+    return true;
+}
+
+} // namespace debug
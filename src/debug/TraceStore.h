@@ -0,0 +1,190 @@
+#ifndef DEBUG_TRACESTORE_H
+#define DEBUG_TRACESTORE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+#include "common/MappedFile.h"
+
+namespace debug
+{
+
+/// @brief Kinds of the rows of a trace store
+enum class AccessKind : uint8_t
+{
+    EXECUTE, // An instruction, its address is the pc and its value the opcode
+    READ,    // The instruction read its operand from the resolved address
+    WRITE    // The instruction wrote to the address, including the stack pushes
+};
+
+/// @brief A row of a trace store. The accesses share the pc, opcode and cycle of the instruction that made them
+struct TraceRow
+{
+    uint64_t cycle;   // Cycle count at the start of the instruction
+    uint16_t pc;      // The pc of the instruction
+    uint16_t address; // The address accessed
+    uint8_t opcode;   // The opcode of the instruction
+    uint8_t value;    // The value read or written
+    AccessKind kind;
+};
+
+/// @brief Summary of a block of rows, kept in the index at the end of the file so that the queries only decode
+/// the blocks that can contain matching rows. The accesses of a block usually span most of the address space, from
+/// the zero page to the PRG ROM, so their pages are tagged on top of the minimum and maximum addresses
+struct TraceBlockIndex
+{
+    /// @brief Number of compressed columns of a block
+    static constexpr size_t NUM_COLUMNS = 6;
+
+    uint64_t offset = 0;                                 // Offset of the block in the file
+    uint32_t rows = 0;                                   // Number of rows, instructions and accesses
+    uint64_t first_cycle = 0;                            // Cycle of the first instruction
+    uint64_t last_cycle = 0;                             // Cycle of the last instruction
+    uint16_t min_pc = 0xFFFF;                            // Lowest pc of the instructions
+    uint16_t max_pc = 0;                                 // Highest pc of the instructions
+    uint16_t min_address = 0xFFFF;                       // Lowest address read or written
+    uint16_t max_address = 0;                            // Highest address read or written
+    std::array<uint64_t, 4> pages = {};                  // One bit per page read or written
+    std::array<uint32_t, NUM_COLUMNS> column_sizes = {}; // Size of every compressed column, in order
+};
+
+/// @brief Which rows a query returns. All the conditions have to match, ranges include both ends
+struct TraceQuery
+{
+    uint16_t first_pc = 0;
+    uint16_t last_pc = 0xFFFF;
+    uint16_t first_address = 0; // The address of an instruction is its pc
+    uint16_t last_address = 0xFFFF;
+    uint64_t first_cycle = 0;
+    uint64_t last_cycle = UINT64_MAX;
+    uint8_t kinds = 0x7; // One bit per AccessKind
+};
+
+/// @brief What a query went through
+struct TraceQueryStats
+{
+    uint64_t rows = 0; // Number of rows that matched
+    size_t blocks = 0; // Number of blocks decoded, the rest were ruled out by the index
+};
+
+/// @brief Records the executed instructions and their accesses in a trace store file. The rows are grouped in
+/// blocks, stored column by column (cycles, pcs, opcodes, addresses, values and kinds) and compressed with
+/// deltas and variable length integers, about a quarter of the raw size. Every block is written as soon as it is
+/// full, so the trace can be much larger than the memory, and the index of the blocks is written by close
+class TraceStoreWriter
+{
+  public:
+    /// @brief Default number of rows of a block
+    static constexpr size_t BLOCK_ROWS = 0x10000;
+
+    /// @brief Constructor
+    /// @param block_rows Number of rows of a block. Blocks only end between instructions, so they can be a few rows
+    /// longer. Smaller blocks let the index rule out more rows, at the cost of a larger index
+    explicit TraceStoreWriter(const size_t block_rows = BLOCK_ROWS);
+
+    /// @brief Close the file, see close
+    ~TraceStoreWriter();
+
+    TraceStoreWriter(const TraceStoreWriter &) = delete;
+    TraceStoreWriter &operator=(const TraceStoreWriter &) = delete;
+
+    /// @brief Create the file, closing the previous one if any
+    /// @return True if the operation was successful
+    bool open(const std::filesystem::path &filename);
+
+    /// @brief Write the last block and the index. Nothing can be queried until then
+    /// @return True if the operation was successful
+    bool close();
+
+    /// @brief Record an instruction, called by the CPU before executing it
+    /// @param pc The pc of the instruction
+    /// @param opcode The opcode of the instruction
+    /// @param cycle The cycle count before the instruction
+    void add_instruction(const uint16_t pc, const uint8_t opcode, const uint64_t cycle);
+
+    /// @brief Record an access of the last instruction
+    /// @param address The address accessed
+    /// @param value The value read or written
+    /// @param kind READ or WRITE
+    void add_access(const uint16_t address, const uint8_t value, const AccessKind kind);
+
+    /// @brief Return the number of rows recorded
+    uint64_t get_row_count() const;
+
+  private:
+    /// @brief Compress the current block into the file and start a new one
+    void write_block();
+
+    /// @brief Number of rows of a block
+    size_t block_rows;
+
+    /// @brief The file being written
+    std::ofstream file;
+
+    /// @brief Where the file is
+    std::filesystem::path filename;
+
+    /// @brief The index of the blocks written so far
+    std::vector<TraceBlockIndex> index;
+
+    /// @brief The summary of the current block
+    TraceBlockIndex block;
+
+    /// @brief The compressed columns of the current block
+    std::array<std::vector<uint8_t>, TraceBlockIndex::NUM_COLUMNS> columns;
+
+    /// @brief The previous pc, cycle and address of the current block, the columns store the differences
+    uint16_t last_pc = 0;
+    uint64_t last_cycle = 0;
+    uint16_t last_address = 0;
+
+    /// @brief Number of rows written in previous blocks
+    uint64_t rows = 0;
+};
+
+/// @brief Reads a trace store file written by TraceStoreWriter, mapping it in memory
+class TraceStoreReader
+{
+  public:
+    /// @brief Map the file and read its index
+    /// @return True if the operation was successful
+    bool open(const std::filesystem::path &filename);
+
+    /// @brief Return the number of blocks
+    size_t get_block_count() const;
+
+    /// @brief Return the number of rows of all the blocks
+    uint64_t get_row_count() const;
+
+    /// @brief Visit the rows that match a query, in the order they were recorded. The blocks that the index rules
+    /// out are not decoded
+    /// @param query The conditions of the rows
+    /// @param visit Called for every matching row, returns false to end the query
+    /// @param stats Where the statistics of the query are stored, if not null
+    /// @return True if the operation was successful, false if the file is corrupted
+    bool query(const TraceQuery &query, const std::function<bool(const TraceRow &)> &visit,
+               TraceQueryStats *stats = nullptr) const;
+
+  private:
+    /// @brief Return true if a block can contain rows that match a query
+    static bool may_match(const TraceBlockIndex &block, const TraceQuery &query);
+
+    /// @brief Decode the rows of a block
+    /// @return True if the operation was successful
+    bool decode_block(const TraceBlockIndex &block, std::vector<TraceRow> &rows) const;
+
+    /// @brief The file
+    common::MappedFile file;
+
+    /// @brief The index of the blocks
+    std::vector<TraceBlockIndex> index;
+};
+
+} // namespace debug
+
+#endif
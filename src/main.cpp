@@ -1,18 +1,222 @@
+#include <cctype>
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "common/Logging.h"
+#include "nes/DebugServer.h"
+#include "nes/ForkServer.h"
 #include "nes/Nes.h"
 
+/// Number of frames run before serving clients, if not provided
+static constexpr size_t DEFAULT_BOOT_FRAMES = 60;
+
+/// Parse a whole number no larger than a maximum, in decimal or, with base 0, also in hexadecimal with 0x
+static bool parse_number(const std::string &text, const int base, const uint64_t max, uint64_t &value)
+{
+    // std::stoull accepts a sign and leading spaces, and wraps negative numbers around
+    if (text.empty() || !std::isxdigit(static_cast<unsigned char>(text[0])))
+    {
+        return false;
+    }
+    try
+    {
+        size_t parsed = 0;
+        value = std::stoull(text, &parsed, base);
+        return parsed == text.size() && value <= max;
+    }
+    catch (const std::logic_error &)
+    {
+        return false;
+    }
+}
+
+/// Run the fork server: boot the ROM for some frames and serve explorations from that state
+/// ./emunes --fork-server <socket_path> <rom_filename> [boot_frames] [reward_address]
+static int run_fork_server(int argc, char *argv[])
+{
+    static constexpr const char *USAGE =
+        "Usage: ./emunes --fork-server <socket_path> <rom_filename> [boot_frames] [reward_address]";
+    uint64_t boot_frames = DEFAULT_BOOT_FRAMES;
+    uint64_t reward_address = 0;
+    if (argc < 4 || argc > 6 || (argc > 4 && !parse_number(argv[4], 10, SIZE_MAX, boot_frames)) ||
+        (argc > 5 && !parse_number(argv[5], 0, 0xFFFF, reward_address)))
+    {
+        common::Log(common::LogLevel::ERROR, USAGE);
+        return -1;
+    }
+    const std::string socket_path = argv[2];
+    const std::filesystem::path rom_filename = argv[3];
+
+    nes::Nes nes;
+    if (!nes.insert_cartridge(rom_filename))
+    {
+        common::Log(common::LogLevel::ERROR, "ROM cartridge loading failed");
+        return -1;
+    }
+    // Logging every instruction of every worker would flood the console and disable the fast paths
+    common::mute();
+    nes.power_on();
+    for (size_t frame = 0; frame < boot_frames; frame++)
+    {
+        if (!nes.run_frame())
+        {
+            return -1;
+        }
+    }
+
+    nes::ForkServer server(nes, socket_path, reward_address);
+    return server.serve() ? 0 : -1;
+}
+
+/// Run the debug server: power on the ROM and let a client drive its execution
+/// ./emunes --debug-server <socket_path> <rom_filename>
+static int run_debug_server(int argc, char *argv[])
+{
+    if (argc != 4)
+    {
+        common::Log(common::LogLevel::ERROR, "Usage: ./emunes --debug-server <socket_path> <rom_filename>");
+        return -1;
+    }
+    const std::string socket_path = argv[2];
+    const std::filesystem::path rom_filename = argv[3];
+
+    nes::Nes nes;
+    if (!nes.insert_cartridge(rom_filename))
+    {
+        common::Log(common::LogLevel::ERROR, "ROM cartridge loading failed");
+        return -1;
+    }
+    // The client reads the state through the protocol, the console log would only slow the emulation down
+    common::mute();
+    nes.power_on();
+
+    nes::DebugServer server(nes, socket_path);
+    return server.serve() ? 0 : -1;
+}
+
+/// Parse a trace trigger such as pc:0xC000, write:0x0300 or cycle:100000. Frames are not available, as this mode
+/// runs the CPU without counting them
+static bool parse_trace_trigger(const std::string &text, debug::TraceTrigger &trigger)
+{
+    const size_t colon = text.find(':');
+    if (colon == std::string::npos || colon + 1 == text.size())
+    {
+        return false;
+    }
+    const std::string event = text.substr(0, colon);
+    if (event == "pc" || event == "write")
+    {
+        trigger.event = event == "pc" ? debug::TraceEvent::PC : debug::TraceEvent::WRITE;
+        return parse_number(text.substr(colon + 1), 0, 0xFFFF, trigger.value);
+    }
+    trigger.event = debug::TraceEvent::CYCLE;
+    return event == "cycle" && parse_number(text.substr(colon + 1), 0, UINT64_MAX, trigger.value);
+}
+
+/// Parse a pc range such as 0xC000:0xC0FF
+static bool parse_pc_range(const std::string &text, uint16_t &first, uint16_t &last)
+{
+    const size_t colon = text.find(':');
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    if (colon == std::string::npos || !parse_number(text.substr(0, colon), 0, 0xFFFF, begin) ||
+        !parse_number(text.substr(colon + 1), 0, 0xFFFF, end))
+    {
+        return false;
+    }
+    first = begin;
+    last = end;
+    return begin <= end;
+}
+
 int main(int argc, char *argv[])
 {
-    // The ROM filename is the only argument to this program
-    if (argc != 2)
+    if (argc > 1 && std::string(argv[1]) == "--fork-server")
     {
-        common::Log(common::LogLevel::ERROR, "Provide a ROM filename: ./emunes <rom_filename>");
+        return run_fork_server(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--debug-server")
+    {
+        return run_debug_server(argc, argv);
+    }
+
+    // The ROM filename is the only required argument to this program, optionally followed by a file where the
+    // code/data log is recorded. The trace options come first
+    static constexpr const char *USAGE =
+        "Provide a ROM filename: ./emunes [--trace-start <event>:<value>] [--trace-stop <event>:<value>] "
+        "[--trace-repeat] [--trace-pc <first>:<last>]... [--trace-bank <bank>]... [--trace-store <store_filename>] "
+        "[--trace-bus <vcd_or_binary_filename>] [--trace-heatmap <csv_or_ppm_filename>] <rom_filename> "
+        "[cdl_filename]. The events are pc, write and cycle";
+    debug::TraceTrigger start;
+    debug::TraceTrigger stop;
+    bool repeat = false;
+    std::vector<std::pair<uint16_t, uint16_t>> pc_ranges;
+    std::vector<size_t> banks;
+    std::string store_filename;
+    std::filesystem::path bus_filename;
+    std::filesystem::path heatmap_filename;
+    int first_argument = 1;
+    for (; first_argument < argc && std::string(argv[first_argument]).rfind("--trace-", 0) == 0; first_argument++)
+    {
+        const std::string option = argv[first_argument];
+        const bool has_value = first_argument + 1 < argc;
+        bool valid = true;
+        if (option == "--trace-repeat")
+        {
+            repeat = true;
+        }
+        else if (option == "--trace-start" && has_value)
+        {
+            valid = parse_trace_trigger(argv[++first_argument], start);
+        }
+        else if (option == "--trace-stop" && has_value)
+        {
+            valid = parse_trace_trigger(argv[++first_argument], stop);
+        }
+        else if (option == "--trace-pc" && has_value)
+        {
+            pc_ranges.emplace_back();
+            valid = parse_pc_range(argv[++first_argument], pc_ranges.back().first, pc_ranges.back().second);
+        }
+        else if (option == "--trace-bank" && has_value)
+        {
+            uint64_t bank = 0;
+            valid = parse_number(argv[++first_argument], 0, SIZE_MAX, bank);
+            banks.push_back(bank);
+        }
+        else if (option == "--trace-store" && has_value)
+        {
+            store_filename = argv[++first_argument];
+        }
+        else if (option == "--trace-bus" && has_value)
+        {
+            bus_filename = argv[++first_argument];
+        }
+        else if (option == "--trace-heatmap" && has_value)
+        {
+            heatmap_filename = argv[++first_argument];
+        }
+        else
+        {
+            valid = false;
+        }
+        if (!valid)
+        {
+            common::Log(common::LogLevel::ERROR, "Invalid trace option " + option + ". " + USAGE);
+            return -1;
+        }
+    }
+    const int num_arguments = argc - first_argument;
+    if (num_arguments != 1 && num_arguments != 2)
+    {
+        common::Log(common::LogLevel::ERROR, USAGE);
         return -1;
     }
-    std::filesystem::path rom_filename = argv[1];
+    std::filesystem::path rom_filename = argv[first_argument];
 
     // Create a NES emulator
     nes::Nes nes;
@@ -26,6 +230,77 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    // A battery keeps the PRG RAM in a save file next to the ROM
+    if (nes.has_battery() && !nes.set_save_filename(std::filesystem::path(rom_filename).replace_extension(".sav")))
+    {
+        return -1;
+    }
+
+    // Without any trace option, every instruction is traced
+    if (start.event != debug::TraceEvent::NONE || stop.event != debug::TraceEvent::NONE || !pc_ranges.empty() ||
+        !banks.empty())
+    {
+        debug::TraceControl &trace_control = nes.get_trace_control();
+        trace_control.set_window(start, stop, repeat);
+        for (const auto &range : pc_ranges)
+        {
+            trace_control.add_pc_range(range.first, range.second);
+        }
+        for (const size_t bank : banks)
+        {
+            trace_control.add_bank(bank, nes.get_prg_rom_size());
+        }
+    }
+
+    // The trace store records every instruction, whatever the window of the text trace
+    if (!store_filename.empty() && !nes.set_trace_store_filename(store_filename))
+    {
+        return -1;
+    }
+
+    // The bus recorder keeps the last accesses before the emulation ends
+    if (!bus_filename.empty())
+    {
+        nes.start_bus_recording();
+    }
+    if (!heatmap_filename.empty())
+    {
+        nes.start_heatmap();
+    }
+
+    const bool code_data_log = num_arguments == 2;
+    if (code_data_log && !nes.set_code_data_log_filename(argv[first_argument + 1]))
+    {
+        return -1;
+    }
+
     // Execute
-    return nes.init();
-}
\ No newline at end of file
+    const bool result = nes.init();
+    if (!store_filename.empty() && !nes.close_trace_store())
+    {
+        return -1;
+    }
+    if (!bus_filename.empty())
+    {
+        const std::unique_ptr<debug::BusRecorder> bus_recorder = nes.stop_bus_recording();
+        if (!(bus_filename.extension() == ".vcd" ? bus_recorder->save_vcd(bus_filename)
+                                                 : bus_recorder->save_binary(bus_filename)))
+        {
+            return -1;
+        }
+    }
+    if (!heatmap_filename.empty())
+    {
+        const std::unique_ptr<debug::AccessHeatmap> heatmap = nes.stop_heatmap();
+        if (!(heatmap_filename.extension() == ".csv" ? heatmap->save_csv(heatmap_filename)
+                                                     : heatmap->save_image(heatmap_filename)))
+        {
+            return -1;
+        }
+    }
+    if (code_data_log && !nes.save_code_data_log())
+    {
+        return -1;
+    }
+    return result;
+}
@@ -0,0 +1,76 @@
+#ifndef MMIO_BUS_H
+#define MMIO_BUS_H
+
+#include <cstdint>
+
+namespace mmio
+{
+
+/// @brief Interface of the address bus as seen by the CPU. Tests and benchmarks can provide their own
+/// implementations, the NES memory map (Mmio) is connected through BusAdapter
+class Bus
+{
+  public:
+    virtual ~Bus() = default;
+
+    /// @brief Get a value from the bus
+    /// @param address The address selection
+    /// @return The value read by the bus at the specified address
+    virtual uint8_t get(const uint16_t address) = 0;
+
+    /// @brief Return the value the bus would provide at the address, without any of the side
+    /// effects of a real read. Meant for the trace and for debugging tools
+    /// @param address The address selection
+    /// @return The value at the specified address, or zero if it cannot be known without a real read
+    virtual uint8_t peek(const uint16_t address) const = 0;
+
+    /// @brief Set a value in the bus
+    /// @param address The address selection
+    /// @param value The value to store
+    virtual void set(const uint16_t address, const uint8_t value) = 0;
+
+    /// @brief Return the number of reads so far that had side effects, e.g. on I/O registers. The CPU compares it
+    /// before and after a loop to tell whether the loop only polls memory
+    virtual uint32_t get_side_effect_reads() const = 0;
+};
+
+/// @brief Connects a concrete bus to the abstract interface. Buses that are part of the machine state (like
+/// Mmio) do not derive from Bus, so that they stay trivially copyable, and use this adapter when needed
+/// @tparam BusType The concrete bus type, it has to provide get, peek, set and get_side_effect_reads like Bus
+template <typename BusType> class BusAdapter final : public Bus
+{
+  public:
+    /// @brief Constructor
+    /// @param bus The concrete bus. It is not owned by the adapter and has to outlive it
+    BusAdapter(BusType *bus) : bus(bus)
+    {
+    }
+
+    uint8_t get(const uint16_t address) override
+    {
+        return bus->get(address);
+    }
+
+    uint8_t peek(const uint16_t address) const override
+    {
+        return bus->peek(address);
+    }
+
+    void set(const uint16_t address, const uint8_t value) override
+    {
+        bus->set(address, value);
+    }
+
+    uint32_t get_side_effect_reads() const override
+    {
+        return bus->get_side_effect_reads();
+    }
+
+  private:
+    /// @brief The concrete bus all the accesses are forwarded to
+    BusType *bus;
+};
+
+} // namespace mmio
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef MMIO_FLATBUS_H
+#define MMIO_FLATBUS_H
+
+#include <array>
+#include <cstdint>
+
+#include "Bus.h"
+
+namespace mmio
+{
+
+/// @brief A flat 64 KB memory without any mapping or side effects. Meant for tests and benchmarks that
+/// exercise the CPU in isolation from the NES memory map
+class FlatBus final : public Bus
+{
+  public:
+    /// @brief Get a value from the bus
+    /// @param address The address selection
+    /// @return The value stored at the specified address
+    uint8_t get(const uint16_t address) override
+    {
+        return memory[address];
+    }
+
+    /// @brief Return the value stored at the address
+    /// @param address The address selection
+    /// @return The value stored at the specified address
+    uint8_t peek(const uint16_t address) const override
+    {
+        return memory[address];
+    }
+
+    /// @brief Set a value in the bus
+    /// @param address The address selection
+    /// @param value The value to store
+    void set(const uint16_t address, const uint8_t value) override
+    {
+        memory[address] = value;
+    }
+
+    /// @brief Return zero, reading memory has no side effects
+    uint32_t get_side_effect_reads() const override
+    {
+        return 0;
+    }
+
+  private:
+    /// @brief The complete address space
+    std::array<uint8_t, 0x10000> memory = {};
+};
+
+} // namespace mmio
+
+#endif
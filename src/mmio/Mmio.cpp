@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <stdexcept>
 
@@ -25,6 +27,9 @@ static constexpr uint16_t PPU_START = 0x2000;
 static constexpr uint16_t PPU_SIZE = 0x0008;
 static constexpr uint16_t PPU_MIRRORS = 1024;
 
+/// PPU status register, in the lower bits of the address
+static constexpr uint16_t PPU_STATUS = 0x0002;
+
 /// *********************************
 /// APU and IO registers (24 bytes)
 /// *********************************
@@ -32,6 +37,12 @@ static constexpr uint16_t PPU_MIRRORS = 1024;
 static constexpr uint16_t APU_IO_START = 0x4000;
 static constexpr uint16_t APU_IO_SIZE = 0x0018;
 
+/// Controller ports. Writing bit 0 of the first one strobes both controllers, reading a port shifts out
+/// one button of its controller in bit 0. The upper bits of the reads come from the open bus
+static constexpr uint16_t CONTROLLER_1 = 0x4016;
+static constexpr uint16_t CONTROLLER_2 = 0x4017;
+static constexpr uint8_t CONTROLLER_OPEN_BUS = 0x40;
+
 /// *********************************
 /// Normally disabled (8 bytes)
 /// *********************************
@@ -57,25 +68,131 @@ static constexpr uint16_t CARTRIDGE_ROM_START = 0x8000;
 static constexpr uint16_t CARTRIDGE_ROM_SIZE = 0x4000;
 static constexpr uint16_t CARTRIDGE_ROM_MIRRORS = 2;
 
-Mmio::Mmio()
+void Mmio::set_prg_rom(const std::vector<uint8_t> &prg_rom)
 {
-    cpu_ram.resize(CPU_RAM_SIZE);
+    this->prg_rom = prg_rom.data();
+    this->prg_rom_size = prg_rom.size();
 }
 
-void Mmio::set_prg_rom(const std::vector<uint8_t> &prg_rom)
+void Mmio::set_prg_ram_size(const size_t size)
+{
+    prg_ram_size = std::min<size_t>(size, PRG_RAM_SIZE);
+    prg_ram.fill(0);
+    prg_ram_dirty = false;
+}
+
+size_t Mmio::get_prg_ram_size() const
+{
+    return prg_ram_size;
+}
+
+uint8_t *Mmio::get_prg_ram()
+{
+    return prg_ram.data();
+}
+
+bool Mmio::is_prg_ram_dirty() const
+{
+    return prg_ram_dirty;
+}
+
+void Mmio::set_prg_ram_dirty(const bool dirty)
 {
-    this->prg_rom = prg_rom;
+    prg_ram_dirty = dirty;
 }
 
-uint8_t Mmio::get(const uint16_t address)
+uint32_t Mmio::get_side_effect_reads() const
+{
+    return side_effect_reads;
+}
+
+void Mmio::set_controller(const uint8_t buttons)
+{
+    controller_buttons = buttons;
+    if (controller_strobe)
+    {
+        controller_shift = controller_buttons;
+    }
+}
+
+void Mmio::set_breakpoints(debug::Breakpoints *breakpoints)
+{
+    this->breakpoints = breakpoints;
+    update_page_flags();
+}
+
+void Mmio::set_bus_recorder(debug::BusRecorder *bus_recorder)
+{
+    this->bus_recorder = bus_recorder;
+    update_page_flags();
+}
+
+void Mmio::set_heatmap(debug::AccessHeatmap *heatmap)
+{
+    this->heatmap = heatmap;
+    update_page_flags();
+}
+
+void Mmio::update_page_flags()
+{
+    page_flags = make_page_flags();
+    const std::array<uint8_t, debug::Breakpoints::NUM_PAGES> watched_pages =
+        breakpoints ? breakpoints->get_watched_pages() : std::array<uint8_t, debug::Breakpoints::NUM_PAGES>{};
+    for (size_t page = 0; page < page_flags.size(); page++)
+    {
+        page_flags[page] |= (watched_pages[page] & debug::WATCH_READ ? PAGE_READ_WATCH : 0) |
+                            (watched_pages[page] & debug::WATCH_WRITE ? PAGE_WRITE_WATCH : 0) |
+                            (bus_recorder || heatmap ? PAGE_RECORD : 0);
+    }
+}
+
+uint8_t Mmio::get_observed(const uint16_t address)
+{
+    const uint8_t value = get_mapped(address);
+    if (bus_recorder)
+    {
+        bus_recorder->record(address, value, false);
+    }
+    if (heatmap)
+    {
+        heatmap->add(address, debug::AccessKind::READ);
+    }
+    if (page_flags[address >> 8] & PAGE_READ_WATCH)
+    {
+        breakpoints->check_access(address, value, false);
+    }
+    return value;
+}
+
+void Mmio::set_observed(const uint16_t address, const uint8_t value)
+{
+    if (bus_recorder)
+    {
+        bus_recorder->record(address, value, true);
+    }
+    if (heatmap)
+    {
+        heatmap->add(address, debug::AccessKind::WRITE);
+    }
+    if (page_flags[address >> 8] & PAGE_WRITE_WATCH)
+    {
+        breakpoints->check_access(address, value, true);
+    }
+    set_mapped(address, value);
+}
+
+uint8_t Mmio::get_mapped(const uint16_t address)
 {
     // CPU RAM
     if (address >= CPU_RAM_START && address < CPU_RAM_SIZE * CPU_RAM_MIRRORS)
     {
         uint8_t value = cpu_ram[address % CPU_RAM_SIZE];
-        common::Log(common::LogLevel::DEBUG, "Read from CPU RAM, address " +
-                                                 common::print_hex(address, sizeof(address)) + ", value " +
-                                                 common::print_hex(value, sizeof(value)));
+        if (!common::is_muted())
+        {
+            common::Log(common::LogLevel::DEBUG, "Read from CPU RAM, address " +
+                                                     common::print_hex(address, sizeof(address)) + ", value " +
+                                                     common::print_hex(value, sizeof(value)));
+        }
         return value;
     }
     // PPU registers
@@ -83,6 +200,31 @@ uint8_t Mmio::get(const uint16_t address)
     {
         common::Log(common::LogLevel::WARNING,
                     "Cannot read from PPU registers, address " + common::print_hex(address, sizeof(address)));
+        // The status register only changes at the events the CPU runs until, such as the vertical blank, and the
+        // flag cleared by reading it stays clear until then. Every read of a loop waiting for the event returns
+        // the same value, so reading it does not keep the loop from being fast-forwarded
+        if ((address & (PPU_SIZE - 1)) == PPU_STATUS)
+        {
+            return 0;
+        }
+    }
+    // Controllers
+    else if (address == CONTROLLER_1)
+    {
+        side_effect_reads++;
+        uint8_t value = CONTROLLER_OPEN_BUS | (controller_shift & 0x1);
+        if (!controller_strobe)
+        {
+            // Once all the buttons have been read, an official controller returns ones
+            controller_shift = (controller_shift >> 1) | 0x80;
+        }
+        return value;
+    }
+    else if (address == CONTROLLER_2)
+    {
+        // No controller connected
+        side_effect_reads++;
+        return CONTROLLER_OPEN_BUS;
     }
     // APU/IO area
     else if (address >= APU_IO_START && address < APU_IO_START + APU_IO_SIZE)
@@ -99,29 +241,125 @@ uint8_t Mmio::get(const uint16_t address)
     // Unmapped area (available for cartridge use)
     else if (address >= UNMAPPED_START && address < UNMAPPED_START + UNMAPPED_SIZE)
     {
-        // For the moment, this goes directly to PRG ROM
+        // Cartridge RAM, mirrored if smaller than the area
+        if (address >= CARTRIDGE_RAM_START && address < CARTRIDGE_RAM_START + CARTRIDGE_RAM_SIZE && prg_ram_size > 0)
+        {
+            uint8_t value = prg_ram[(address - CARTRIDGE_RAM_START) & (prg_ram_size - 1)];
+            if (!common::is_muted())
+            {
+                common::Log(common::LogLevel::DEBUG, "Read from cartridge RAM, address " +
+                                                         common::print_hex(address, sizeof(address)) + ", value " +
+                                                         common::print_hex(value, sizeof(value)));
+            }
+            return value;
+        }
+        // For the moment, the rest goes directly to PRG ROM
         if (address >= CARTRIDGE_ROM_START &&
-            address < CARTRIDGE_ROM_START + CARTRIDGE_ROM_SIZE * CARTRIDGE_ROM_MIRRORS)
+            address < CARTRIDGE_ROM_START + CARTRIDGE_ROM_SIZE * CARTRIDGE_ROM_MIRRORS && prg_rom_size > 0)
         {
             uint8_t value = prg_rom[(address - CARTRIDGE_ROM_START) % CARTRIDGE_ROM_SIZE];
-            common::Log(common::LogLevel::DEBUG, "Read from cartridge ROM, address " +
-                                                     common::print_hex(address, sizeof(address)) + ", value " +
-                                                     common::print_hex(value, sizeof(value)));
+            if (!common::is_muted())
+            {
+                common::Log(common::LogLevel::DEBUG, "Read from cartridge ROM, address " +
+                                                         common::print_hex(address, sizeof(address)) + ", value " +
+                                                         common::print_hex(value, sizeof(value)));
+            }
             return value;
         }
     }
 
+    // The registers and the unmapped areas end here, they are not plain memory
+    side_effect_reads++;
     return 0;
 }
 
-void Mmio::set(const uint16_t address, const uint8_t value)
+uint8_t Mmio::peek(const uint16_t address) const
 {
     // CPU RAM
     if (address >= CPU_RAM_START && address < CPU_RAM_SIZE * CPU_RAM_MIRRORS)
     {
-        common::Log(common::LogLevel::DEBUG, "Write to CPU RAM, address " +
-                                                 common::print_hex(address, sizeof(address)) + ", value " +
-                                                 common::print_hex(value, sizeof(value)));
+        return cpu_ram[address % CPU_RAM_SIZE];
+    }
+    // Controllers
+    else if (address == CONTROLLER_1)
+    {
+        return CONTROLLER_OPEN_BUS | (controller_shift & 0x1);
+    }
+    // APU/IO area
+    else if (address >= APU_IO_START && address < APU_IO_START + APU_IO_SIZE)
+    {
+        // Most of these registers are write only, reading them returns the open bus, so do as
+        // reference traces do and report all bits set
+        return 0xFF;
+    }
+    // Cartridge RAM
+    else if (address >= CARTRIDGE_RAM_START && address < CARTRIDGE_RAM_START + CARTRIDGE_RAM_SIZE &&
+             prg_ram_size > 0)
+    {
+        return prg_ram[(address - CARTRIDGE_RAM_START) & (prg_ram_size - 1)];
+    }
+    // Cartridge ROM
+    else if (address >= CARTRIDGE_ROM_START &&
+             address < CARTRIDGE_ROM_START + CARTRIDGE_ROM_SIZE * CARTRIDGE_ROM_MIRRORS && prg_rom_size > 0)
+    {
+        return prg_rom[(address - CARTRIDGE_ROM_START) % CARTRIDGE_ROM_SIZE];
+    }
+
+    return 0;
+}
+
+void Mmio::peek_range(const uint16_t address, uint8_t *data, const size_t size) const
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        const uint16_t current = address + done;
+        size_t length = 1;
+        if (current < CPU_RAM_SIZE * CPU_RAM_MIRRORS)
+        {
+            // Up to the end of the current mirror
+            const uint16_t offset = current % CPU_RAM_SIZE;
+            length = std::min<size_t>(size - done, CPU_RAM_SIZE - offset);
+            std::memcpy(data + done, cpu_ram.data() + offset, length);
+        }
+        else if (current >= CARTRIDGE_ROM_START && prg_rom_size > 0)
+        {
+            // Up to the end of the current mirror of the ROM
+            const size_t offset = (current - CARTRIDGE_ROM_START) % CARTRIDGE_ROM_SIZE;
+            length = std::min<size_t>({size - done, CARTRIDGE_ROM_SIZE - offset, 0x10000u - current});
+            std::memcpy(data + done, prg_rom + offset, length);
+        }
+        else
+        {
+            data[done] = peek(current);
+        }
+        done += length;
+    }
+}
+
+void Mmio::poke_range(const uint16_t address, const uint8_t *data, const size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        const uint16_t current = address + i;
+        if (current < CPU_RAM_SIZE * CPU_RAM_MIRRORS)
+        {
+            cpu_ram[current % CPU_RAM_SIZE] = data[i];
+        }
+    }
+}
+
+void Mmio::set_mapped(const uint16_t address, const uint8_t value)
+{
+    // CPU RAM
+    if (address >= CPU_RAM_START && address < CPU_RAM_SIZE * CPU_RAM_MIRRORS)
+    {
+        if (!common::is_muted())
+        {
+            common::Log(common::LogLevel::DEBUG, "Write to CPU RAM, address " +
+                                                     common::print_hex(address, sizeof(address)) + ", value " +
+                                                     common::print_hex(value, sizeof(value)));
+        }
         cpu_ram[address % CPU_RAM_SIZE] = value;
     }
     // PPU registers
@@ -130,6 +368,16 @@ void Mmio::set(const uint16_t address, const uint8_t value)
         common::Log(common::LogLevel::WARNING,
                     "Cannot write to PPU registers, address " + common::print_hex(address, sizeof(address)));
     }
+    // Controllers strobe
+    else if (address == CONTROLLER_1)
+    {
+        // While the strobe is high, the controllers keep reloading the state of their buttons
+        controller_strobe = value & 0x1;
+        if (controller_strobe)
+        {
+            controller_shift = controller_buttons;
+        }
+    }
     // APU/IO area
     else if (address >= APU_IO_START && address < APU_IO_START + APU_IO_SIZE)
     {
@@ -145,9 +393,21 @@ void Mmio::set(const uint16_t address, const uint8_t value)
     // Unmapped area (available for cartridge use)
     else if (address >= UNMAPPED_START && address < UNMAPPED_START + UNMAPPED_SIZE)
     {
-        // For the moment, this goes directly to PRG ROM
-        if (address >= CARTRIDGE_ROM_START &&
-            address < CARTRIDGE_ROM_START + CARTRIDGE_ROM_SIZE * CARTRIDGE_ROM_MIRRORS)
+        // Cartridge RAM, the dirty flag is all a battery save needs to know
+        if (address >= CARTRIDGE_RAM_START && address < CARTRIDGE_RAM_START + CARTRIDGE_RAM_SIZE && prg_ram_size > 0)
+        {
+            if (!common::is_muted())
+            {
+                common::Log(common::LogLevel::DEBUG, "Write to cartridge RAM, address " +
+                                                         common::print_hex(address, sizeof(address)) + ", value " +
+                                                         common::print_hex(value, sizeof(value)));
+            }
+            prg_ram[(address - CARTRIDGE_RAM_START) & (prg_ram_size - 1)] = value;
+            prg_ram_dirty = true;
+        }
+        // For the moment, the rest goes directly to PRG ROM
+        else if (address >= CARTRIDGE_ROM_START &&
+                 address < CARTRIDGE_ROM_START + CARTRIDGE_ROM_SIZE * CARTRIDGE_ROM_MIRRORS)
         {
             common::Log(common::LogLevel::WARNING,
                         "Write to cartridge ROM, address " + common::print_hex(address, sizeof(address)));
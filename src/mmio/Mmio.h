@@ -1,37 +1,223 @@
 #ifndef MMIO_MMIO_H
 #define MMIO_MMIO_H
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
+#include "common/Logging.h"
+#include "debug/AccessHeatmap.h"
+#include "debug/Breakpoints.h"
+#include "debug/BusRecorder.h"
+
 namespace mmio
 {
+/// @brief The NES memory map. It provides the same interface as mmio::Bus without deriving from it, so that
+/// it is trivially copyable and can be part of a machine state that is cloned with a memcpy
 class Mmio
 {
   public:
-    Mmio();
-
-    /// @brief Provide the program ROM to be stored by MMIO.
+    /// @brief Provide the program ROM to be used by MMIO. The ROM is referenced, not copied, so it
+    /// has to outlive MMIO and all its copies.
     /// TODO: this needs to be removed in the future
     /// @param prg_rom the PRG ROM as read from the cartridge
     void set_prg_rom(const std::vector<uint8_t> &prg_rom);
 
+    /// @brief Set the size of the PRG RAM of the cartridge at $6000-$7FFF, clearing it. It is mirrored if smaller than
+    /// the 8 KB of the area, and without a mapper to switch banks only the first 8 KB of a larger one are visible
+    /// @param size The size in bytes, a power of two. Zero removes it
+    void set_prg_ram_size(const size_t size);
+
+    /// @brief Return the size of the visible PRG RAM, zero if there is none
+    size_t get_prg_ram_size() const;
+
+    /// @brief Return the PRG RAM, e.g. to copy a battery save in or out of it
+    uint8_t *get_prg_ram();
+
+    /// @brief Return true if the PRG RAM has been written since the dirty flag was last cleared
+    bool is_prg_ram_dirty() const;
+
+    /// @brief Set or clear the dirty flag of the PRG RAM, e.g. once it has been saved
+    void set_prg_ram_dirty(const bool dirty);
+
+    /// @brief Set the buttons pressed in the controller connected to the first port
+    /// @param buttons One bit per button, from bit 0 to bit 7: A, B, Select, Start, Up, Down, Left, Right
+    void set_controller(const uint8_t buttons);
+
+    /// @brief Connect the watchpoints, which are not owned by the memory map and have to outlive it, and tag the
+    /// pages they watch. Call it again after changing the watchpoints. A null pointer disconnects them
+    void set_breakpoints(debug::Breakpoints *breakpoints);
+
+    /// @brief Connect a bus recorder, which is not owned by the memory map and has to outlive it. While it is
+    /// connected, every access takes the slow path and is recorded. A null pointer disconnects it
+    void set_bus_recorder(debug::BusRecorder *bus_recorder);
+
+    /// @brief Connect an access heatmap, which is not owned by the memory map and has to outlive it. While it is
+    /// connected, every access takes the slow path and is counted. A null pointer disconnects it
+    void set_heatmap(debug::AccessHeatmap *heatmap);
+
     /// @brief Get a value from the bus
     /// @param address The address selection
-    /// @return The value read by teh bus at the specified address
-    uint8_t get(const uint16_t address);
+    /// @return The value read by the bus at the specified address
+    uint8_t get(const uint16_t address)
+    {
+        // The CPU RAM is by far the most accessed area, read it inline unless the accesses are being logged,
+        // recorded or the page is watched
+        const uint8_t flags = page_flags[address >> 8];
+        if ((flags & (PAGE_RAM | PAGE_READ_WATCH | PAGE_RECORD)) == PAGE_RAM && common::is_muted())
+        {
+            return cpu_ram[address & CPU_RAM_MASK];
+        }
+        if (flags & (PAGE_READ_WATCH | PAGE_RECORD))
+        {
+            return get_observed(address);
+        }
+        return get_mapped(address);
+    }
+
+    /// @brief Return the value the bus would provide at the address, without any of the side
+    /// effects of a real read. Meant for the trace and for debugging tools
+    /// @param address The address selection
+    /// @return The value at the specified address, or zero if it cannot be known without a real read
+    uint8_t peek(const uint16_t address) const;
+
+    /// @brief Copy a block of memory without side effects, straight from the backing arrays where possible.
+    /// Meant for debugging tools that read large areas, e.g. the whole RAM every frame
+    /// @param address First address of the block, the block wraps around at the end of the address space
+    /// @param data Where the block is copied
+    /// @param size Size of the block
+    void peek_range(const uint16_t address, uint8_t *data, const size_t size) const;
+
+    /// @brief Overwrite a block of the CPU RAM without side effects, as a debugging tool would. The addresses
+    /// outside the CPU RAM and its mirrors are left unchanged
+    /// @param address First address of the block, the block wraps around at the end of the address space
+    /// @param data The new contents of the block
+    /// @param size Size of the block
+    void poke_range(const uint16_t address, const uint8_t *data, const size_t size);
+
+    /// @brief Return the number of reads so far that had side effects, or could have them: the reads from the PPU,
+    /// APU and controller registers and from the cartridge area outside its RAM and ROM. The PPU status register
+    /// is not counted, as it reads the same until the next event the CPU runs until
+    uint32_t get_side_effect_reads() const;
 
     /// @brief Set a value in the bus
     /// @param address The address selection
     /// @param value The value to store
-    void set(const uint16_t address, const uint8_t value);
+    void set(const uint16_t address, const uint8_t value)
+    {
+        const uint8_t flags = page_flags[address >> 8];
+        if ((flags & (PAGE_RAM | PAGE_WRITE_WATCH | PAGE_RECORD)) == PAGE_RAM && common::is_muted())
+        {
+            cpu_ram[address & CPU_RAM_MASK] = value;
+            return;
+        }
+        if (flags & (PAGE_WRITE_WATCH | PAGE_RECORD))
+        {
+            set_observed(address, value);
+            return;
+        }
+        set_mapped(address, value);
+    }
 
   private:
+    /// @brief End of the CPU RAM area, including its mirrors
+    static constexpr uint16_t CPU_RAM_END = 0x2000;
+
+    /// @brief Mask that removes the CPU RAM mirroring from an address
+    static constexpr uint16_t CPU_RAM_MASK = 0x07FF;
+
+    /// @brief Bits of the page tags
+    enum PageFlag : uint8_t
+    {
+        PAGE_RAM = 0x01,         // The page is CPU RAM
+        PAGE_READ_WATCH = 0x02,  // The reads from the page are checked against the watchpoints
+        PAGE_WRITE_WATCH = 0x04, // The writes to the page are checked against the watchpoints
+        PAGE_RECORD = 0x08,      // The accesses to the page are recorded by the bus recorder or the heatmap
+    };
+
+    /// @brief Return the page tags of the memory map without watchpoints
+    static constexpr std::array<uint8_t, debug::Breakpoints::NUM_PAGES> make_page_flags()
+    {
+        std::array<uint8_t, debug::Breakpoints::NUM_PAGES> flags = {};
+        for (size_t page = 0; page < (CPU_RAM_END >> 8); page++)
+        {
+            flags[page] = PAGE_RAM;
+        }
+        return flags;
+    }
+
+    /// @brief Tag the pages for the connected watchpoints, bus recorder and heatmap
+    void update_page_flags();
+
+    /// @brief Get a value from a watched or recorded page, checking the access against the watchpoints, recording
+    /// it and counting it
+    /// @param address The address selection
+    /// @return The value read by the bus at the specified address
+    uint8_t get_observed(const uint16_t address);
+
+    /// @brief Set a value in a watched or recorded page, checking the access against the watchpoints, recording
+    /// it and counting it
+    /// @param address The address selection
+    /// @param value The value to store
+    void set_observed(const uint16_t address, const uint8_t value);
+
+    /// @brief Get a value from any area of the memory map, logging the access
+    /// @param address The address selection
+    /// @return The value read by the bus at the specified address
+    uint8_t get_mapped(const uint16_t address);
+
+    /// @brief Set a value in any area of the memory map, logging the access
+    /// @param address The address selection
+    /// @param value The value to store
+    void set_mapped(const uint16_t address, const uint8_t value);
+
+    /// @brief One PageFlag set per page of the address space, so that the accesses only look at the watchpoints
+    /// for the tagged pages
+    std::array<uint8_t, debug::Breakpoints::NUM_PAGES> page_flags = make_page_flags();
+
+    /// @brief The watchpoints, if connected
+    debug::Breakpoints *breakpoints = nullptr;
+
+    /// @brief The bus recorder, if connected
+    debug::BusRecorder *bus_recorder = nullptr;
+
+    /// @brief The access heatmap, if connected
+    debug::AccessHeatmap *heatmap = nullptr;
+
     /// @brief Internal CPU RAM memory (8 pages)
-    std::vector<uint8_t> cpu_ram;
+    std::array<uint8_t, CPU_RAM_MASK + 1> cpu_ram = {};
+
+    /// @brief Size of the PRG RAM area of the cartridge, the largest PRG RAM visible without a mapper
+    static constexpr uint16_t PRG_RAM_SIZE = 0x2000;
+
+    /// @brief PRG RAM of the cartridge, only the first prg_ram_size bytes are used
+    std::array<uint8_t, PRG_RAM_SIZE> prg_ram = {};
+
+    /// @brief Size of the PRG RAM of the cartridge, zero if there is none
+    uint16_t prg_ram_size = 0;
+
+    /// @brief True if the PRG RAM has been written since the flag was cleared, so a battery save only has to be
+    /// written when something changed
+    bool prg_ram_dirty = false;
+
+    /// @brief The PRG ROM as read from the cartridge, owned by the caller of set_prg_rom
+    const uint8_t *prg_rom = nullptr;
+
+    /// @brief Size of the PRG ROM in bytes
+    size_t prg_rom_size = 0;
+
+    /// @brief Buttons pressed in the first controller
+    uint8_t controller_buttons = 0;
+
+    /// @brief Shift register of the first controller, bit 0 is returned by the next read
+    uint8_t controller_shift = 0;
+
+    /// @brief True while the controllers are being strobed
+    bool controller_strobe = false;
 
-    /// @brief Internal copy of the PRG ROM as read fom the cartridge
-    std::vector<uint8_t> prg_rom;
+    /// @brief Number of reads that had side effects. Only the slow path counts them, the inline reads are RAM
+    uint32_t side_effect_reads = 0;
 };
 } // namespace mmio
 
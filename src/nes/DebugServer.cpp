@@ -0,0 +1,330 @@
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "DebugServer.h"
+#include "common/Encoding.h"
+#include "common/Logging.h"
+#include "common/Socket.h"
+
+namespace nes
+{
+
+/// Only one client is served at a time
+static constexpr int LISTEN_BACKLOG = 1;
+
+/// Size of the header of requests (command and payload size) and responses (status and payload size)
+static constexpr size_t HEADER_SIZE = 1 + 4;
+
+/// Largest payload accepted, enough to write the whole address space
+static constexpr uint32_t MAX_PAYLOAD_SIZE = 2 + 0x10000;
+
+/// Append a little endian value to a response
+static void put(std::vector<uint8_t> &response, const uint64_t value, const size_t size)
+{
+    response.resize(response.size() + size);
+    common::put_le(response.data() + response.size() - size, value, size);
+}
+
+/// Return true if the client has sent something, without consuming it, or if the server has to stop
+static bool has_request(const int client_fd)
+{
+    pollfd poll_fd = {client_fd, POLLIN, 0};
+    return common::is_stop_requested() || poll(&poll_fd, 1, 0) > 0;
+}
+
+DebugServer::DebugServer(Nes &nes, const std::string &socket_path)
+    : nes(nes), socket_path(socket_path), history(nes)
+{
+}
+
+bool DebugServer::serve()
+{
+    // Clients can connect as soon as the socket listens, a stop from then on removes it
+    common::handle_stop_signals();
+    int server_fd = common::listen_unix_socket(socket_path, LISTEN_BACKLOG);
+    if (server_fd < 0)
+    {
+        return false;
+    }
+    common::Log(common::LogLevel::INFO, "Debug server listening on " + socket_path);
+
+    while (!common::is_stop_requested())
+    {
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            common::Log(common::LogLevel::ERROR, "Could not accept client: " + std::string(std::strerror(errno)));
+            break;
+        }
+        serve_client(client_fd);
+        close(client_fd);
+    }
+
+    close(server_fd);
+    unlink(socket_path.c_str());
+    return common::is_stop_requested();
+}
+
+void DebugServer::serve_client(const int client_fd)
+{
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> response;
+    while (true)
+    {
+        uint8_t header[HEADER_SIZE];
+        if (!common::read_all(client_fd, header, sizeof(header)))
+        {
+            return;
+        }
+        const uint32_t size = common::get_le(header + 1, 4);
+        if (size > MAX_PAYLOAD_SIZE)
+        {
+            common::Log(common::LogLevel::ERROR, "Debug request too large: " + std::to_string(size));
+            return;
+        }
+        payload.resize(size);
+        if (!common::read_all(client_fd, payload.data(), payload.size()))
+        {
+            return;
+        }
+
+        response.assign(HEADER_SIZE, 0);
+        const bool ok = execute(client_fd, static_cast<DebugCommand>(header[0]), payload, response);
+        response[0] = ok ? 0 : 1;
+        common::put_le(response.data() + 1, response.size() - HEADER_SIZE, 4);
+        if (!common::write_all(client_fd, response.data(), response.size()))
+        {
+            return;
+        }
+    }
+}
+
+bool DebugServer::execute(const int client_fd, const DebugCommand command, const std::vector<uint8_t> &payload,
+                          std::vector<uint8_t> &response)
+{
+    const uint8_t *data = payload.data();
+    const size_t size = payload.size();
+    debug::Breakpoints &breakpoints = nes.get_breakpoints();
+
+    switch (command)
+    {
+    case DebugCommand::PAUSE:
+        return true;
+
+    case DebugCommand::CONTINUE: {
+        if (size != 4)
+        {
+            return false;
+        }
+        put_state(run(client_fd, common::get_le(data, 4)), response);
+        return true;
+    }
+
+    case DebugCommand::STEP: {
+        if (size != 4)
+        {
+            return false;
+        }
+        breakpoints.resume();
+        DebugStopReason reason = DebugStopReason::DONE;
+        for (uint32_t count = common::get_le(data, 4); count > 0; count--)
+        {
+            if (!history.step())
+            {
+                reason = DebugStopReason::ERROR;
+                break;
+            }
+            // Watchpoints still match while stepping, breakpoints do not
+            if (breakpoints.is_stopped())
+            {
+                reason = DebugStopReason::WATCHPOINT;
+                break;
+            }
+        }
+        put_state(reason, response);
+        return true;
+    }
+
+    case DebugCommand::GET_REGISTERS: {
+        const cpu::Registers registers = nes.get_registers();
+        put(response, registers.pc, 2);
+        put(response, registers.acc, 1);
+        put(response, registers.xr, 1);
+        put(response, registers.yr, 1);
+        put(response, registers.sr, 1);
+        put(response, registers.sp, 1);
+        put(response, nes.get_cycles(), 8);
+        put(response, nes.get_instructions(), 8);
+        return true;
+    }
+
+    case DebugCommand::SET_REGISTERS: {
+        if (size != 7)
+        {
+            return false;
+        }
+        const uint16_t pc = common::get_le(data, 2);
+        nes.set_registers(cpu::Registers{pc, data[2], data[3], data[4], data[5], data[6]});
+        history.restart();
+        return true;
+    }
+
+    case DebugCommand::READ_MEMORY: {
+        if (size != 6)
+        {
+            return false;
+        }
+        const uint16_t address = common::get_le(data, 2);
+        const uint32_t length = common::get_le(data + 2, 4);
+        if (length > 0x10000)
+        {
+            return false;
+        }
+        response.resize(HEADER_SIZE + length);
+        nes.peek_range(address, response.data() + HEADER_SIZE, length);
+        return true;
+    }
+
+    case DebugCommand::WRITE_MEMORY: {
+        if (size < 2)
+        {
+            return false;
+        }
+        nes.poke_range(common::get_le(data, 2), data + 2, size - 2);
+        history.restart();
+        return true;
+    }
+
+    case DebugCommand::ADD_BREAKPOINT:
+    case DebugCommand::REMOVE_BREAKPOINT: {
+        if (size != 2)
+        {
+            return false;
+        }
+        const uint16_t pc = common::get_le(data, 2);
+        if (command == DebugCommand::ADD_BREAKPOINT)
+        {
+            breakpoints.add_breakpoint(pc);
+        }
+        else
+        {
+            breakpoints.remove_breakpoint(pc);
+        }
+        nes.arm_breakpoints();
+        return true;
+    }
+
+    case DebugCommand::ADD_WATCHPOINT: {
+        if (size != 7 || (data[4] & ~debug::WATCH_ACCESS) != 0 || data[4] == 0)
+        {
+            return false;
+        }
+        const debug::Watchpoint watchpoint{static_cast<uint16_t>(common::get_le(data, 2)),
+                                           static_cast<uint16_t>(common::get_le(data + 2, 2)), data[4], data[5] != 0,
+                                           data[6]};
+        if (watchpoint.first > watchpoint.last)
+        {
+            return false;
+        }
+        put(response, breakpoints.add_watchpoint(watchpoint), 4);
+        // Tag the pages of the new watchpoint
+        nes.arm_breakpoints();
+        return true;
+    }
+
+    case DebugCommand::REMOVE_WATCHPOINT: {
+        if (size != 4 || !breakpoints.remove_watchpoint(common::get_le(data, 4)))
+        {
+            return false;
+        }
+        nes.arm_breakpoints();
+        return true;
+    }
+
+    case DebugCommand::SET_CONTROLLER: {
+        if (size != 1)
+        {
+            return false;
+        }
+        history.set_controller(data[0]);
+        return true;
+    }
+
+    case DebugCommand::STEP_BACK: {
+        if (size != 4 || !history.step_back(common::get_le(data, 4)))
+        {
+            return false;
+        }
+        put_state(DebugStopReason::DONE, response);
+        return true;
+    }
+
+    case DebugCommand::REVERSE_CONTINUE: {
+        if (size != 0)
+        {
+            return false;
+        }
+        DebugStopReason reason = DebugStopReason::DONE;
+        if (history.reverse_continue())
+        {
+            reason = breakpoints.get_stop().reason == debug::StopReason::BREAKPOINT ? DebugStopReason::BREAKPOINT
+                                                                                     : DebugStopReason::WATCHPOINT;
+        }
+        put_state(reason, response);
+        return true;
+    }
+    }
+
+    common::Log(common::LogLevel::ERROR, "Unknown debug command: " + std::to_string(static_cast<int>(command)));
+    return false;
+}
+
+DebugStopReason DebugServer::run(const int client_fd, const uint32_t max_frames)
+{
+    debug::Breakpoints &breakpoints = nes.get_breakpoints();
+    breakpoints.resume();
+    const uint64_t last_frame = nes.get_frame_count() + max_frames;
+    while (max_frames == 0 || nes.get_frame_count() < last_frame)
+    {
+        if (!history.run_frame())
+        {
+            return DebugStopReason::ERROR;
+        }
+        switch (breakpoints.get_stop().reason)
+        {
+        case debug::StopReason::BREAKPOINT:
+            return DebugStopReason::BREAKPOINT;
+        case debug::StopReason::WATCHPOINT:
+            return DebugStopReason::WATCHPOINT;
+        case debug::StopReason::NONE:
+            break;
+        }
+        if (has_request(client_fd))
+        {
+            break;
+        }
+    }
+    return DebugStopReason::DONE;
+}
+
+void DebugServer::put_state(const DebugStopReason reason, std::vector<uint8_t> &response)
+{
+    const debug::Stop &stop = nes.get_breakpoints().get_stop();
+    put(response, static_cast<uint8_t>(reason), 1);
+    put(response, nes.get_registers().pc, 2);
+    put(response, stop.watchpoint, 4);
+    put(response, stop.address, 2);
+    put(response, stop.value, 1);
+    put(response, stop.write, 1);
+    put(response, nes.get_frame_count(), 8);
+    put(response, nes.get_cycles(), 8);
+}
+
+} // namespace nes
@@ -0,0 +1,105 @@
+#ifndef NES_DEBUG_SERVER_H
+#define NES_DEBUG_SERVER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "History.h"
+#include "Nes.h"
+
+namespace nes
+{
+
+/// @brief Commands of the debug server protocol, with their request payloads
+enum class DebugCommand : uint8_t
+{
+    PAUSE = 0x00,             // Nothing. Stops a CONTINUE in progress, otherwise it does nothing
+    CONTINUE = 0x01,          // Max frames (uint32, 0 for no limit). Replies with the state once stopped
+    STEP = 0x02,              // Number of instructions (uint32). Replies with the state
+    GET_REGISTERS = 0x03,     // Nothing. Replies with the registers
+    SET_REGISTERS = 0x04,     // pc (uint16), a, x, y, p and sp (uint8)
+    READ_MEMORY = 0x05,       // Address (uint16) and size (uint32, up to 64 KB). Replies with the bytes
+    WRITE_MEMORY = 0x06,      // Address (uint16) followed by the bytes, only the CPU RAM is written
+    ADD_BREAKPOINT = 0x07,    // pc (uint16)
+    REMOVE_BREAKPOINT = 0x08, // pc (uint16)
+    ADD_WATCHPOINT = 0x09,    // First and last address (uint16), access, has value and value (uint8). Replies
+                              // with the identifier of the watchpoint (uint32)
+    REMOVE_WATCHPOINT = 0x0A, // Identifier (uint32)
+    SET_CONTROLLER = 0x0B,    // Buttons of the first controller (uint8)
+    STEP_BACK = 0x0C,         // Number of instructions (uint32). Replies with the state
+    REVERSE_CONTINUE = 0x0D   // Nothing. Replies with the state at the previous breakpoint or watchpoint hit
+};
+
+/// @brief Why CONTINUE or STEP returned, as reported in the state
+enum class DebugStopReason : uint8_t
+{
+    DONE = 0x00,       // All the frames or instructions were run, a PAUSE arrived, or the history ended
+    BREAKPOINT = 0x01, // A breakpoint was reached
+    WATCHPOINT = 0x02, // A watchpoint matched
+    ERROR = 0x03       // The CPU failed or is jammed
+};
+
+/// @brief Debugger for a NES, driven by a client through a Unix socket with a compact binary protocol.
+/// The emulation only runs when the client asks for it, at full speed and with the breakpoints and
+/// watchpoints of debug::Breakpoints. Memory reads are copied straight from the backing arrays, so a client can
+/// read the whole RAM every frame at no cost for the emulation. The execution is recorded in a nes::History, so
+/// the client can also step and continue backwards through the last second or so.
+///
+/// Protocol, all the integers are little endian. One client is served at a time:
+///  - Request: command (uint8, see DebugCommand), payload size (uint32) and payload
+///  - Response: status (uint8, 0 if the command succeeded), payload size (uint32) and payload
+///  - The state returned by CONTINUE and STEP is: reason (uint8, see DebugStopReason), pc (uint16),
+///    watchpoint identifier (uint32), address (uint16), value (uint8) and write (uint8) of the access that matched
+///    the watchpoint, frame count (uint64) and cycle count (uint64)
+///  - The registers returned by GET_REGISTERS are: pc (uint16), a, x, y, p and sp (uint8), cycle count (uint64)
+///    and instruction count (uint64)
+///  - A CONTINUE stops at the end of the frame in which any request arrives, replies, and then serves that
+///    request, so a PAUSE gets two responses: the one of the CONTINUE and its own
+class DebugServer
+{
+  public:
+    /// @brief Constructor
+    /// @param nes The NES to debug
+    /// @param socket_path Path of the Unix socket to listen on
+    DebugServer(Nes &nes, const std::string &socket_path);
+
+    /// @brief Listen on the socket and serve clients until SIGINT or SIGTERM is received or an error happens. The
+    /// socket file is removed when it returns
+    /// @return True if it was stopped by a signal, false on error
+    bool serve();
+
+  private:
+    /// @brief The NES being debugged
+    Nes &nes;
+
+    /// @brief Path of the Unix socket
+    std::string socket_path;
+
+    /// @brief The recent execution of the NES, to go backwards
+    History history;
+
+    /// @brief Serve the requests of a client until it disconnects
+    /// @param client_fd The connection with the client
+    void serve_client(const int client_fd);
+
+    /// @brief Execute a command
+    /// @param client_fd The connection with the client, polled by CONTINUE
+    /// @param command The command
+    /// @param payload The payload of the request
+    /// @param response Where the payload of the response is stored
+    /// @return True if the command succeeded
+    bool execute(const int client_fd, const DebugCommand command, const std::vector<uint8_t> &payload,
+                 std::vector<uint8_t> &response);
+
+    /// @brief Run frames until a breakpoint, a request from the client, the frame limit or an error
+    /// @return The reason of the stop
+    DebugStopReason run(const int client_fd, const uint32_t max_frames);
+
+    /// @brief Append the state after CONTINUE or STEP to a response
+    void put_state(const DebugStopReason reason, std::vector<uint8_t> &response);
+};
+
+} // namespace nes
+
+#endif
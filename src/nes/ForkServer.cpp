@@ -0,0 +1,135 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "ForkServer.h"
+#include "common/Encoding.h"
+#include "common/Logging.h"
+#include "common/Socket.h"
+
+namespace nes
+{
+
+/// Size of the CPU RAM hashed into the digest
+static constexpr uint16_t RAM_SIZE = 0x0800;
+
+/// Number of pending connections the socket keeps
+static constexpr int LISTEN_BACKLOG = 64;
+
+/// Size of the response: RAM digest, frame count, reward and status
+static constexpr size_t RESPONSE_SIZE = 8 + 8 + 1 + 1;
+
+ForkServer::ForkServer(Nes &nes, const std::string &socket_path, const uint16_t reward_address)
+    : nes(nes), socket_path(socket_path), reward_address(reward_address)
+{
+}
+
+bool ForkServer::serve()
+{
+    // Clients can connect as soon as the socket listens, a stop from then on removes it
+    common::handle_stop_signals();
+    int server_fd = common::listen_unix_socket(socket_path, LISTEN_BACKLOG);
+    if (server_fd < 0)
+    {
+        return false;
+    }
+
+    // The workers are never waited for, let the system reap them
+    std::signal(SIGCHLD, SIG_IGN);
+    common::Log(common::LogLevel::INFO, "Fork server listening on " + socket_path);
+
+    while (!common::is_stop_requested())
+    {
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            common::Log(common::LogLevel::ERROR, "Could not accept client: " + std::string(std::strerror(errno)));
+            break;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            // A worker ends right away on a signal, only the server cleans up
+            std::signal(SIGINT, SIG_DFL);
+            std::signal(SIGTERM, SIG_DFL);
+            close(server_fd);
+            serve_client(client_fd);
+            close(client_fd);
+            _exit(0);
+        }
+        if (pid < 0)
+        {
+            common::Log(common::LogLevel::ERROR, "Could not fork: " + std::string(std::strerror(errno)));
+        }
+        close(client_fd);
+    }
+
+    close(server_fd);
+    unlink(socket_path.c_str());
+    return common::is_stop_requested();
+}
+
+uint64_t ForkServer::get_ram_digest(const Nes &nes)
+{
+    uint8_t ram[RAM_SIZE];
+    nes.peek_range(0, ram, sizeof(ram));
+    uint64_t digest = 0xCBF29CE484222325ULL;
+    for (const uint8_t value : ram)
+    {
+        digest = (digest ^ value) * 0x100000001B3ULL;
+    }
+    return digest;
+}
+
+void ForkServer::serve_client(const int client_fd)
+{
+    // Request. The number of frames comes from the client, so it is checked before allocating the inputs
+    uint8_t header[4];
+    if (!common::read_all(client_fd, header, sizeof(header)))
+    {
+        return;
+    }
+    const uint32_t num_frames = common::get_le(header, sizeof(header));
+    bool ok = num_frames <= MAX_FRAMES;
+    if (ok)
+    {
+        std::vector<uint8_t> inputs(num_frames);
+        if (!common::read_all(client_fd, inputs.data(), inputs.size()))
+        {
+            return;
+        }
+
+        // The process is a copy of the server, so it runs directly on its copy of the NES
+        for (const uint8_t buttons : inputs)
+        {
+            nes.set_controller(buttons);
+            if (!nes.run_frame())
+            {
+                ok = false;
+                break;
+            }
+        }
+    }
+    else
+    {
+        common::Log(common::LogLevel::ERROR, "Request for too many frames: " + std::to_string(num_frames));
+    }
+
+    // Response
+    uint8_t response[RESPONSE_SIZE];
+    common::put_le(response, get_ram_digest(nes), 8);
+    common::put_le(response + 8, nes.get_frame_count(), 8);
+    response[16] = nes.peek(reward_address);
+    response[17] = ok;
+    common::write_all(client_fd, response, sizeof(response));
+}
+
+} // namespace nes
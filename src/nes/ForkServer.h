@@ -0,0 +1,60 @@
+#ifndef NES_FORK_SERVER_H
+#define NES_FORK_SERVER_H
+
+#include <cstdint>
+#include <string>
+
+#include "Nes.h"
+
+namespace nes
+{
+
+/// @brief Serves explorations of the game from a booted NES. Every client that connects to the Unix socket
+/// gets its own process, forked from the server, so it starts from the booted state with copy-on-write
+/// memory and without any deserialisation.
+///
+/// Protocol, all the integers are little endian:
+///  - Request: number of frames n (uint32, at most MAX_FRAMES), followed by n bytes with the controller buttons of
+///    each frame
+///  - Response: RAM digest (uint64, see get_ram_digest), frame count (uint64), reward (uint8, the value of the
+///    reward address after the last frame) and status (uint8, 1 if all the frames ran successfully). Requests for
+///    too many frames are not run and get the digest of the booted state with status 0
+class ForkServer
+{
+  public:
+    /// @brief Maximum number of frames of a request, more than a day of play
+    static constexpr uint32_t MAX_FRAMES = 1 << 23;
+
+    /// @brief Constructor
+    /// @param nes The booted NES, every client starts from this state. Only the forked processes run it,
+    /// the server process does not modify it
+    /// @param socket_path Path of the Unix socket to listen on
+    /// @param reward_address Address of the byte returned as reward
+    ForkServer(Nes &nes, const std::string &socket_path, const uint16_t reward_address);
+
+    /// @brief Listen on the socket and serve clients until SIGINT or SIGTERM is received or an error happens. The
+    /// socket file is removed when it returns
+    /// @return True if it was stopped by a signal, false on error
+    bool serve();
+
+    /// @brief Return the digest of the CPU RAM sent in the responses, its FNV-1a hash
+    static uint64_t get_ram_digest(const Nes &nes);
+
+  private:
+    /// @brief The booted NES
+    Nes &nes;
+
+    /// @brief Path of the Unix socket
+    std::string socket_path;
+
+    /// @brief Address of the byte returned as reward
+    uint16_t reward_address;
+
+    /// @brief Run the request of a client. This happens in the forked process
+    /// @param client_fd The connection with the client
+    void serve_client(const int client_fd);
+};
+
+} // namespace nes
+
+#endif
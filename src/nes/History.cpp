@@ -0,0 +1,235 @@
+#include <algorithm>
+
+#include "History.h"
+#include "common/Logging.h"
+
+namespace nes
+{
+
+History::History(Nes &nes, const uint64_t snapshot_interval, const size_t max_snapshots)
+    : nes(nes), snapshot_interval(snapshot_interval), snapshots(std::max<size_t>(max_snapshots, 1))
+{
+    take_snapshot();
+}
+
+bool History::run_frame()
+{
+    if (!nes.run_frame())
+    {
+        return false;
+    }
+    take_snapshot_if_due();
+    return true;
+}
+
+bool History::step()
+{
+    if (!nes.step())
+    {
+        return false;
+    }
+    take_snapshot_if_due();
+    return true;
+}
+
+void History::set_controller(const uint8_t buttons)
+{
+    inputs.push_back(Input{nes.get_instructions(), buttons});
+    nes.set_controller(buttons);
+}
+
+bool History::step_back(const uint64_t count)
+{
+    const uint64_t instruction = nes.get_instructions();
+    if (count > instruction)
+    {
+        common::Log(common::LogLevel::ERROR, "Cannot step back before reset");
+        return false;
+    }
+    return seek(instruction - count);
+}
+
+bool History::seek(const uint64_t instruction)
+{
+    if (instruction > nes.get_instructions())
+    {
+        common::Log(common::LogLevel::ERROR, "Cannot seek forward to instruction " + std::to_string(instruction));
+        return false;
+    }
+    if (instruction < get_oldest_instruction())
+    {
+        common::Log(common::LogLevel::ERROR,
+                    "Instruction " + std::to_string(instruction) + " is older than the oldest snapshot");
+        return false;
+    }
+    return restore(instruction);
+}
+
+bool History::reverse_continue()
+{
+    const uint64_t current = nes.get_instructions();
+    std::vector<Hit> hits;
+
+    // Replay the intervals between snapshots from the newest to the oldest, until one of them meets a stop
+    for (size_t index = num_snapshots; index-- > 0;)
+    {
+        const Machine &snapshot = get_snapshot(index);
+        const uint64_t start = snapshot.cpu.get_instructions();
+        const uint64_t end = index + 1 < num_snapshots ? get_snapshot(index + 1).cpu.get_instructions() : current;
+        if (start >= current)
+        {
+            continue;
+        }
+
+        nes.load_state(snapshot);
+        hits.clear();
+        if (!replay(end, &hits))
+        {
+            return false;
+        }
+        // The stop the emulation is at does not count
+        while (!hits.empty() && hits.back().instruction >= current)
+        {
+            hits.pop_back();
+        }
+        if (!hits.empty())
+        {
+            const Hit hit = hits.back();
+            if (!restore(hit.instruction))
+            {
+                return false;
+            }
+            nes.get_breakpoints().set_stop(hit.stop);
+            return true;
+        }
+    }
+
+    restore(get_oldest_instruction());
+    return false;
+}
+
+void History::restart()
+{
+    first_snapshot = 0;
+    num_snapshots = 0;
+    inputs.clear();
+    take_snapshot();
+}
+
+uint64_t History::get_oldest_instruction() const
+{
+    return get_snapshot(0).cpu.get_instructions();
+}
+
+size_t History::get_snapshot_count() const
+{
+    return num_snapshots;
+}
+
+const Machine &History::get_snapshot(const size_t index) const
+{
+    return snapshots[(first_snapshot + index) % snapshots.size()];
+}
+
+void History::take_snapshot_if_due()
+{
+    if (nes.get_cycles() - get_snapshot(num_snapshots - 1).cpu.get_cycles() >= snapshot_interval)
+    {
+        take_snapshot();
+    }
+}
+
+void History::take_snapshot()
+{
+    if (num_snapshots == snapshots.size())
+    {
+        first_snapshot = (first_snapshot + 1) % snapshots.size();
+        num_snapshots--;
+    }
+    nes.save_state(snapshots[(first_snapshot + num_snapshots) % snapshots.size()]);
+    num_snapshots++;
+
+    // The inputs before the oldest snapshot are never replayed again
+    const uint64_t oldest = get_oldest_instruction();
+    inputs.erase(inputs.begin(), std::find_if(inputs.begin(), inputs.end(),
+                                              [oldest](const Input &input) { return input.instruction >= oldest; }));
+}
+
+bool History::restore(const uint64_t instruction)
+{
+    size_t index = num_snapshots - 1;
+    while (get_snapshot(index).cpu.get_instructions() > instruction)
+    {
+        index--;
+    }
+    nes.load_state(get_snapshot(index));
+    if (!replay(instruction, nullptr))
+    {
+        return false;
+    }
+    truncate(instruction);
+    return true;
+}
+
+bool History::replay(const uint64_t instruction, std::vector<Hit> *hits)
+{
+    // A stop of the run being replayed would hide the ones met on the way
+    debug::Breakpoints &breakpoints = nes.get_breakpoints();
+    breakpoints.resume();
+    const bool record_hits = hits && nes.are_breakpoints_armed();
+
+    auto input = std::find_if(inputs.begin(), inputs.end(), [this](const Input &input) {
+        return input.instruction >= nes.get_instructions();
+    });
+    while (true)
+    {
+        // Inputs are applied between instructions, as they were recorded
+        const uint64_t executed = nes.get_instructions();
+        for (; input != inputs.end() && input->instruction == executed; input++)
+        {
+            nes.set_controller(input->buttons);
+        }
+        if (executed >= instruction)
+        {
+            return true;
+        }
+
+        // Nes::step ignores the breakpoints, so they are looked for here. Watchpoints are still checked by the
+        // memory map while armed
+        const uint16_t pc = nes.get_registers().pc;
+        if (record_hits && breakpoints.has_breakpoint(pc))
+        {
+            debug::Stop stop;
+            stop.reason = debug::StopReason::BREAKPOINT;
+            stop.pc = pc;
+            hits->push_back(Hit{executed, stop});
+        }
+        if (!nes.step())
+        {
+            common::Log(common::LogLevel::ERROR, "Replay failed at instruction " + std::to_string(executed));
+            return false;
+        }
+        if (breakpoints.is_stopped())
+        {
+            if (record_hits)
+            {
+                hits->push_back(Hit{nes.get_instructions(), breakpoints.get_stop()});
+            }
+            breakpoints.resume();
+        }
+    }
+}
+
+void History::truncate(const uint64_t instruction)
+{
+    while (num_snapshots > 1 && get_snapshot(num_snapshots - 1).cpu.get_instructions() > instruction)
+    {
+        num_snapshots--;
+    }
+    while (!inputs.empty() && inputs.back().instruction > instruction)
+    {
+        inputs.pop_back();
+    }
+}
+
+} // namespace nes
@@ -0,0 +1,130 @@
+#ifndef NES_HISTORY_H
+#define NES_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Nes.h"
+
+namespace nes
+{
+
+/// @brief Records the execution of a NES so that it can be run backwards. The machine state is snapshotted into
+/// a bounded ring every few thousand cycles, along with the controller inputs. Going back restores the newest
+/// snapshot before the target and replays the instructions up to it, which is exact because the emulation is
+/// deterministic given the inputs. Going back to an instruction discards the history after it.
+///
+/// The NES has to be driven through this class while it records: inputs given to the NES directly would not be
+/// replayed. A trace or code/data log attached to the NES also records the replayed instructions
+class History
+{
+  public:
+    /// @brief Default minimum number of CPU cycles between two snapshots, about a third of a frame
+    static constexpr uint64_t DEFAULT_SNAPSHOT_INTERVAL = 10000;
+
+    /// @brief Default number of snapshots kept, about a second and a half of emulation
+    static constexpr size_t DEFAULT_MAX_SNAPSHOTS = 256;
+
+    /// @brief Constructor. The history starts with a snapshot of the current state of the NES
+    /// @param nes The NES whose execution is recorded
+    /// @param snapshot_interval Minimum number of CPU cycles between two snapshots. Snapshots are only taken
+    /// between frames or steps, so at most one is taken per frame
+    /// @param max_snapshots Number of snapshots kept, the oldest ones are dropped
+    History(Nes &nes, const uint64_t snapshot_interval = DEFAULT_SNAPSHOT_INTERVAL,
+            const size_t max_snapshots = DEFAULT_MAX_SNAPSHOTS);
+
+    /// @brief Run the NES until the end of the frame, see Nes::run_frame
+    /// @return True if the operation was successful
+    bool run_frame();
+
+    /// @brief Execute a single instruction, see Nes::step
+    /// @return True if the operation was successful
+    bool step();
+
+    /// @brief Set the buttons pressed in the first controller, see Nes::set_controller
+    void set_controller(const uint8_t buttons);
+
+    /// @brief Go back the provided number of instructions
+    /// @return True if the operation was successful, false if that is before the oldest snapshot
+    bool step_back(const uint64_t count = 1);
+
+    /// @brief Go back to the point where the provided number of instructions had been executed since reset
+    /// @return True if the operation was successful, false if that is before the oldest snapshot or in the future
+    bool seek(const uint64_t instruction);
+
+    /// @brief Go back to the last point before the current one where the armed breakpoints and watchpoints of the
+    /// NES would have stopped it. The stop is then reported by debug::Breakpoints::get_stop, as if the
+    /// emulation had run into it. If there is none, go back to the oldest snapshot
+    /// @return True if a stop was found
+    bool reverse_continue();
+
+    /// @brief Drop the whole history and start again from the current state. Needed after the state is changed
+    /// by other means than running, such as writing to memory, as those changes cannot be replayed
+    void restart();
+
+    /// @brief Return the number of instructions executed at the oldest point that can be reached
+    uint64_t get_oldest_instruction() const;
+
+    /// @brief Return the number of snapshots stored
+    size_t get_snapshot_count() const;
+
+  private:
+    /// @brief A change of the controller buttons
+    struct Input
+    {
+        uint64_t instruction; // Number of instructions executed when the buttons were set
+        uint8_t buttons;      // The buttons pressed
+    };
+
+    /// @brief A point where the emulation would have stopped, found while replaying
+    struct Hit
+    {
+        uint64_t instruction; // Number of instructions executed at the stop
+        debug::Stop stop;     // The stop
+    };
+
+    /// @brief The NES whose execution is recorded
+    Nes &nes;
+
+    /// @brief Minimum number of CPU cycles between two snapshots
+    uint64_t snapshot_interval;
+
+    /// @brief Ring of snapshots, from the oldest at first_snapshot to the newest
+    std::vector<Machine> snapshots;
+
+    /// @brief Position of the oldest snapshot in the ring
+    size_t first_snapshot = 0;
+
+    /// @brief Number of snapshots in the ring
+    size_t num_snapshots = 0;
+
+    /// @brief The inputs since the oldest snapshot, in order
+    std::vector<Input> inputs;
+
+    /// @brief Return a snapshot, 0 being the oldest one
+    const Machine &get_snapshot(const size_t index) const;
+
+    /// @brief Take a snapshot if enough cycles have run since the newest one
+    void take_snapshot_if_due();
+
+    /// @brief Take a snapshot, dropping the oldest one if the ring is full
+    void take_snapshot();
+
+    /// @brief Restore the newest snapshot taken before the provided instruction and replay up to it
+    /// @return True if the operation was successful
+    bool restore(const uint64_t instruction);
+
+    /// @brief Replay the recorded inputs from the current state until the provided instruction
+    /// @param instruction The number of instructions executed where the replay ends
+    /// @param hits If not null, where the breakpoints and watchpoints met on the way are stored
+    /// @return True if the operation was successful
+    bool replay(const uint64_t instruction, std::vector<Hit> *hits);
+
+    /// @brief Drop the snapshots and the inputs after the provided instruction
+    void truncate(const uint64_t instruction);
+};
+
+} // namespace nes
+
+#endif
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -13,20 +15,282 @@ static constexpr size_t HEADER_SIZE = 16;
 static constexpr size_t TRAINER_SIZE = 512;
 static constexpr size_t PRG_ROM_UNIT_SIZE = 16384;
 static constexpr size_t CHR_ROM_UNIT_SIZE = 8192;
+static constexpr size_t PRG_RAM_UNIT_SIZE = 8192;
+
+/// An NTSC frame lasts 341 x 262 PPU dots, and the CPU runs at a third of the PPU clock
+static constexpr uint64_t PPU_DOTS_PER_FRAME = 341 * 262;
+static constexpr uint64_t PPU_DOTS_PER_CPU_CYCLE = 3;
 
 Nes::Nes()
 {
-    mmio = std::make_shared<mmio::Mmio>();
-    cpu = cpu::MOS6502(mmio);
+    machine.cpu = cpu::MOS6502<mmio::Mmio>(&machine.mmio);
+    machine.cpu.set_instruction_fusion(true);
+}
 
-    // Create a log file and pass it to all the interested components
-    this->log_file = std::make_shared<common::LogFile>();
-    cpu.set_log_file(log_file);
+Nes::Nes(const Nes &other)
+{
+    *this = other;
+}
+
+Nes::~Nes()
+{
+    flush_save_file();
+}
+
+Nes &Nes::operator=(const Nes &other)
+{
+    if (this == &other)
+    {
+        return *this;
+    }
+
+    // The battery save of this NES gets its last changes before the cartridge is replaced
+    flush_save_file();
+    save_file.reset();
+    std::memcpy(static_cast<void *>(&machine), &other.machine, sizeof(Machine));
+    rom = other.rom;
+    battery = other.battery;
+    log_file.reset();
+    trace_store.reset();
+    code_data_logger.reset();
+    code_data_log_filename.clear();
+    connect_machine();
+    return *this;
+}
+
+Nes Nes::clone() const
+{
+    return Nes(*this);
+}
+
+void Nes::save_state(Machine &state) const
+{
+    std::memcpy(static_cast<void *>(&state), &machine, sizeof(Machine));
+}
+
+void Nes::load_state(const Machine &state)
+{
+    std::memcpy(static_cast<void *>(&machine), &state, sizeof(Machine));
+    // The PRG RAM of the snapshot can differ from the battery save
+    machine.mmio.set_prg_ram_dirty(save_file != nullptr);
+    connect_machine();
+}
+
+void Nes::connect_machine()
+{
+    // The only pointer inside the block that points into the block itself
+    machine.cpu.set_bus(&machine.mmio);
+    machine.cpu.set_log_file(log_file.get());
+    connect_trace_control();
+    machine.cpu.set_trace_store(trace_store.get());
+    machine.cpu.set_code_data_logger(code_data_logger.get());
+    // The memory map was copied with the page tags of another state
+    connect_breakpoints();
+    machine.cpu.set_bus_recorder(bus_recorder.get());
+    machine.mmio.set_bus_recorder(bus_recorder.get());
+    machine.cpu.set_heatmap(heatmap.get());
+    machine.mmio.set_heatmap(heatmap.get());
 }
 
 void Nes::set_log_filename(const std::string &filename)
 {
+    // Create a log file and pass it to all the interested components
+    this->log_file = std::make_shared<common::LogFile>();
     this->log_file->set_filename(filename);
+    machine.cpu.set_log_file(log_file.get());
+    connect_trace_control();
+}
+
+debug::TraceControl &Nes::get_trace_control()
+{
+    if (!trace_control)
+    {
+        trace_control = std::make_unique<debug::TraceControl>();
+        connect_trace_control();
+    }
+    return *trace_control;
+}
+
+void Nes::connect_trace_control()
+{
+    // Without a log file, the trace control would only slow the writes down
+    machine.cpu.set_trace_control(log_file ? trace_control.get() : nullptr);
+    if (trace_control)
+    {
+        trace_control->set_frame(machine.frame_count);
+    }
+}
+
+bool Nes::set_trace_store_filename(const std::filesystem::path &filename, const size_t block_rows)
+{
+    auto store = std::make_shared<debug::TraceStoreWriter>(block_rows);
+    if (!store->open(filename))
+    {
+        return false;
+    }
+    trace_store = store;
+    machine.cpu.set_trace_store(trace_store.get());
+    return true;
+}
+
+bool Nes::close_trace_store()
+{
+    if (!trace_store)
+    {
+        common::Log(common::LogLevel::ERROR, "There is no trace store to close");
+        return false;
+    }
+    machine.cpu.set_trace_store(nullptr);
+    const bool result = trace_store->close();
+    trace_store.reset();
+    return result;
+}
+
+debug::BusRecorder &Nes::start_bus_recording(const size_t capacity)
+{
+    bus_recorder = std::make_unique<debug::BusRecorder>(capacity);
+    machine.cpu.set_bus_recorder(bus_recorder.get());
+    machine.mmio.set_bus_recorder(bus_recorder.get());
+    return *bus_recorder;
+}
+
+std::unique_ptr<debug::BusRecorder> Nes::stop_bus_recording()
+{
+    machine.cpu.set_bus_recorder(nullptr);
+    machine.mmio.set_bus_recorder(nullptr);
+    return std::move(bus_recorder);
+}
+
+debug::AccessHeatmap &Nes::start_heatmap()
+{
+    heatmap = std::make_unique<debug::AccessHeatmap>();
+    machine.cpu.set_heatmap(heatmap.get());
+    machine.mmio.set_heatmap(heatmap.get());
+    return *heatmap;
+}
+
+std::unique_ptr<debug::AccessHeatmap> Nes::stop_heatmap()
+{
+    machine.cpu.set_heatmap(nullptr);
+    machine.mmio.set_heatmap(nullptr);
+    if (heatmap && machine.cpu.get_cycles() > get_first_cycle_of_frame(machine.frame_count))
+    {
+        heatmap->end_frame(machine.frame_count);
+    }
+    return std::move(heatmap);
+}
+
+bool Nes::has_battery() const
+{
+    return battery;
+}
+
+bool Nes::set_save_filename(const std::filesystem::path &filename)
+{
+    const size_t prg_ram_size = machine.mmio.get_prg_ram_size();
+    if (!battery || prg_ram_size == 0)
+    {
+        common::Log(common::LogLevel::ERROR, "The cartridge has no battery backed PRG RAM");
+        return false;
+    }
+    auto file = std::make_unique<common::MappedFile>();
+    if (!file->open_writable(filename, prg_ram_size))
+    {
+        return false;
+    }
+    save_file = std::move(file);
+    std::memcpy(machine.mmio.get_prg_ram(), save_file->data(), prg_ram_size);
+    machine.mmio.set_prg_ram_dirty(false);
+    return true;
+}
+
+bool Nes::flush_save_file()
+{
+    if (!save_file || !machine.mmio.is_prg_ram_dirty())
+    {
+        return true;
+    }
+    std::memcpy(save_file->get_writable_data(), machine.mmio.get_prg_ram(), machine.mmio.get_prg_ram_size());
+    machine.mmio.set_prg_ram_dirty(false);
+    return save_file->flush(false);
+}
+
+size_t Nes::get_prg_rom_size() const
+{
+    return rom ? rom->prg_rom.size() : 0;
+}
+
+std::shared_ptr<const RomImage> Nes::get_rom_image() const
+{
+    return rom;
+}
+
+bool Nes::set_code_data_log_filename(const std::filesystem::path &filename)
+{
+#ifdef EMUNES_CDL
+    if (!rom)
+    {
+        common::Log(common::LogLevel::ERROR, "Insert a cartridge before enabling the code/data log");
+        return false;
+    }
+    auto logger = std::make_shared<cpu::CodeDataLogger>(rom->prg_rom.size(), rom->chr_rom.size());
+    if (std::filesystem::exists(filename) && !logger->load(filename))
+    {
+        return false;
+    }
+    code_data_logger = logger;
+    code_data_log_filename = filename;
+    machine.cpu.set_code_data_logger(code_data_logger.get());
+    return true;
+#else
+    (void)filename;
+    common::Log(common::LogLevel::ERROR, "The code/data logger is not available, build with EMUNES_CDL");
+    return false;
+#endif
+}
+
+bool Nes::save_code_data_log() const
+{
+    if (!code_data_logger)
+    {
+        common::Log(common::LogLevel::ERROR, "There is no code/data log to save");
+        return false;
+    }
+    return code_data_logger->save(code_data_log_filename);
+}
+
+debug::Breakpoints &Nes::get_breakpoints()
+{
+    if (!breakpoints)
+    {
+        breakpoints = std::make_unique<debug::Breakpoints>();
+    }
+    return *breakpoints;
+}
+
+void Nes::arm_breakpoints()
+{
+    get_breakpoints();
+    breakpoints_armed = true;
+    connect_breakpoints();
+}
+
+void Nes::disarm_breakpoints()
+{
+    breakpoints_armed = false;
+    connect_breakpoints();
+}
+
+bool Nes::are_breakpoints_armed() const
+{
+    return breakpoints_armed;
+}
+
+void Nes::connect_breakpoints()
+{
+    debug::Breakpoints *connected = breakpoints_armed ? breakpoints.get() : nullptr;
+    machine.cpu.set_breakpoints(connected);
+    machine.mmio.set_breakpoints(connected);
 }
 
 bool Nes::insert_cartridge(const std::filesystem::path &filename)
@@ -72,35 +336,175 @@ bool Nes::insert_cartridge(const std::filesystem::path &filename)
     rom_file.read(reinterpret_cast<char *>(prg_rom.data()), prg_rom.size());
 
     // CHR ROM
+    std::vector<uint8_t> chr_rom(chr_rom_size);
+    rom_file.read(reinterpret_cast<char *>(chr_rom.data()), chr_rom.size());
+    if (!rom_file)
+    {
+        common::Log(common::LogLevel::ERROR, "File " + filename.string() + " is shorter than its header says");
+        return false;
+    }
 
     // PlayChoice INST-ROM if present
 
     // PlayChoice PROM if present
 
+    // PRG RAM. NES 2.0 headers give the size of the volatile and the battery backed RAM as shifts of 64 bytes,
+    // iNES ones the size in 8 KB units, where 0 also means 8 KB
+    battery = (flags.at(6) >> 1) & 0x1;
+    size_t prg_ram_size = std::max<size_t>(flags.at(8), 1) * PRG_RAM_UNIT_SIZE;
+    if ((flags.at(7) & 0x0C) == 0x08)
+    {
+        const uint8_t volatile_shift = flags.at(10) & 0x0F;
+        const uint8_t battery_shift = flags.at(10) >> 4;
+        prg_ram_size =
+            std::max<size_t>(volatile_shift ? 64 << volatile_shift : 0, battery_shift ? 64 << battery_shift : 0);
+    }
+    // The battery save of the previous cartridge gets its last changes before its PRG RAM is cleared
+    flush_save_file();
+    save_file.reset();
+    machine.mmio.set_prg_ram_size(prg_ram_size);
+
+    // All the instances running the same cartridge share a single copy of its contents
+    rom = RomCache::get_instance().get_image(std::move(prg_rom), std::move(chr_rom));
+
     // TODO: refactor this when more mappers are developed
     // Mapper 0 will send all the PRG ROM to the unmapped memory
-    mmio->set_prg_rom(prg_rom);
+    machine.mmio.set_prg_rom(rom->prg_rom);
 
     return true;
 }
 
 void Nes::override_reset_vector(const uint16_t address)
 {
-    cpu.override_reset_vector(address);
+    machine.cpu.override_reset_vector(address);
 }
 
 void Nes::set_max_instructions(const size_t num_instructions)
 {
-    cpu.set_max_instructions(num_instructions);
+    machine.cpu.set_max_instructions(num_instructions);
 }
 
 bool Nes::init()
 {
-    if (!cpu.reset())
+    if (!machine.cpu.reset())
     {
         common::Log(common::LogLevel::ERROR, "Could not reset MOS6502 CPU");
         return false;
     }
     return true;
 }
+
+void Nes::power_on()
+{
+    machine.cpu.power_on();
+    machine.frame_count = 0;
+    connect_trace_control();
+}
+
+/// Return the CPU cycle at which a frame ends. It is computed from the frame count so that the fractional CPU
+/// cycles of each frame do not accumulate an error
+static uint64_t get_end_of_frame(const uint64_t frame_count)
+{
+    return (frame_count + 1) * PPU_DOTS_PER_FRAME / PPU_DOTS_PER_CPU_CYCLE;
+}
+
+uint64_t Nes::get_first_cycle_of_frame(const uint64_t frame)
+{
+    return frame == 0 ? 0 : get_end_of_frame(frame - 1);
+}
+
+bool Nes::run_frame()
+{
+    // The end of the frame is the next scheduled event
+    const uint64_t end_of_frame = get_end_of_frame(machine.frame_count);
+    if (!machine.cpu.run_until(end_of_frame))
+    {
+        common::Log(common::LogLevel::ERROR,
+                    "MOS6502 CPU stopped in frame " + std::to_string(machine.frame_count + 1));
+        return false;
+    }
+    // A breakpoint can stop the CPU before the end of the frame
+    if (machine.cpu.get_cycles() >= end_of_frame)
+    {
+        end_frame();
+    }
+    return true;
+}
+
+bool Nes::step()
+{
+    // The fused pairs are two instructions long
+    machine.cpu.set_instruction_fusion(false);
+    const bool result = machine.cpu.step();
+    machine.cpu.set_instruction_fusion(true);
+    // The frame ends at the same instruction as in run_frame, so stepping and running can be mixed
+    if (machine.cpu.get_cycles() >= get_end_of_frame(machine.frame_count))
+    {
+        end_frame();
+    }
+    return result;
+}
+
+void Nes::end_frame()
+{
+    // Once per frame at most, and only if the game wrote to its PRG RAM
+    if (save_file && machine.mmio.is_prg_ram_dirty())
+    {
+        flush_save_file();
+    }
+    if (heatmap)
+    {
+        heatmap->end_frame(machine.frame_count);
+    }
+    machine.frame_count++;
+    if (trace_control)
+    {
+        trace_control->set_frame(machine.frame_count);
+    }
+}
+
+uint64_t Nes::get_frame_count() const
+{
+    return machine.frame_count;
+}
+
+uint64_t Nes::get_cycles() const
+{
+    return machine.cpu.get_cycles();
+}
+
+uint64_t Nes::get_instructions() const
+{
+    return machine.cpu.get_instructions();
+}
+
+cpu::Registers Nes::get_registers()
+{
+    return machine.cpu.get_registers();
+}
+
+void Nes::set_registers(const cpu::Registers &registers)
+{
+    machine.cpu.set_registers(registers);
+}
+
+void Nes::set_controller(const uint8_t buttons)
+{
+    machine.mmio.set_controller(buttons);
+}
+
+uint8_t Nes::peek(const uint16_t address) const
+{
+    return machine.mmio.peek(address);
+}
+
+void Nes::peek_range(const uint16_t address, uint8_t *data, const size_t size) const
+{
+    machine.mmio.peek_range(address, data, size);
+}
+
+void Nes::poke_range(const uint16_t address, const uint8_t *data, const size_t size)
+{
+    machine.mmio.poke_range(address, data, size);
+}
 } // namespace nes
\ No newline at end of file
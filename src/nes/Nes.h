@@ -2,12 +2,39 @@
 #define NES_NES_H
 
 #include <filesystem>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
+#include "RomCache.h"
+#include "common/MappedFile.h"
 #include "cpu/MOS6502.h"
+#include "debug/AccessHeatmap.h"
+#include "debug/Breakpoints.h"
+#include "debug/BusRecorder.h"
+#include "debug/TraceControl.h"
+#include "debug/TraceStore.h"
+#include "mmio/Mmio.h"
 
 namespace nes
 {
 
+/// @brief All the mutable state of the emulated machine, in a single trivially copyable block so that it
+/// can be cloned with a memcpy. Everything else (ROM, log file) is referenced from here, not owned
+struct Machine
+{
+    /// @brief The address bus
+    mmio::Mmio mmio;
+
+    /// @brief The MOS6502, connected to mmio
+    cpu::MOS6502<mmio::Mmio> cpu;
+
+    /// @brief Number of frames run since power on
+    uint64_t frame_count = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<Machine>, "The machine state has to be trivially copyable");
+
 /// @brief This class holds the rest of the systems together. It is the only
 /// interface to the user
 class Nes
@@ -15,12 +42,118 @@ class Nes
   public:
     Nes();
 
-    /// @brief Set the NES log file for all the internal components
+    /// @brief Copy the machine state of another NES with a single memcpy. The cartridge is shared with the
+    /// other NES, the log file is not, so the copy does not record any trace until set_log_filename is called
+    Nes(const Nes &other);
+
+    /// @brief Write the last changes of the PRG RAM to the battery save, if any
+    ~Nes();
+
+    /// @brief Overwrite the machine state with the one of another NES, see the copy constructor
+    Nes &operator=(const Nes &other);
+
+    /// @brief Return a copy of this NES that runs independently from it, see the copy constructor
+    Nes clone() const;
+
+    /// @brief Copy the machine state into a snapshot, which can be restored with load_state
+    void save_state(Machine &state) const;
+
+    /// @brief Overwrite the machine state with a snapshot taken with save_state on a NES running the same
+    /// cartridge. Unlike the copy assignment, this NES keeps its log file, code/data log and breakpoints
+    void load_state(const Machine &state);
+
+    /// @brief Set the NES log file for all the internal components. Without it, no trace is recorded
     void set_log_filename(const std::string &filename);
 
+    /// @brief Return the trace control of this NES, created and connected on first use. It limits the trace to a
+    /// window and filters it, so it only has an effect with a log file. Like the breakpoints, copies do not get it
+    debug::TraceControl &get_trace_control();
+
+    /// @brief Record every executed instruction and its accesses in a trace store, written to the file as the
+    /// emulation runs and completed by close_trace_store. See debug::TraceStoreWriter
+    /// @param filename Where the trace store is written
+    /// @param block_rows Number of rows of a block of the trace store
+    /// @return True if the operation was successful
+    bool set_trace_store_filename(const std::filesystem::path &filename,
+                                  const size_t block_rows = debug::TraceStoreWriter::BLOCK_ROWS);
+
+    /// @brief Write the rest of the trace store and its index, and stop recording
+    /// @return True if the operation was successful
+    bool close_trace_store();
+
+    /// @brief Record every access of the CPU to the bus, replacing the previous recorder if any. Like the breakpoints,
+    /// copies do not get it. See debug::BusRecorder
+    /// @param capacity Number of accesses kept, the older ones are overwritten
+    /// @return The recorder, which stays connected until stop_bus_recording
+    debug::BusRecorder &start_bus_recording(const size_t capacity = debug::BusRecorder::DEFAULT_CAPACITY);
+
+    /// @brief Disconnect the bus recorder and hand it over, e.g. to export the accesses
+    /// @return The recorder, null if there was none
+    std::unique_ptr<debug::BusRecorder> stop_bus_recording();
+
+    /// @brief Count the reads, writes and executions of every address frame by frame, replacing the previous heatmap
+    /// if any. Like the bus recorder, copies do not get it. See debug::AccessHeatmap
+    /// @return The heatmap, which stays connected until stop_heatmap
+    debug::AccessHeatmap &start_heatmap();
+
+    /// @brief Disconnect the heatmap and hand it over, e.g. to export it. The frame in progress, if started, gets its
+    /// snapshot too
+    /// @return The heatmap, null if there was none
+    std::unique_ptr<debug::AccessHeatmap> stop_heatmap();
+
+    /// @brief Return the CPU cycle at which a frame starts, e.g. to query the trace store by frame
+    /// @param frame The number of the frame, counted from 0 since power on
+    static uint64_t get_first_cycle_of_frame(const uint64_t frame);
+
+    /// @brief Return the size of the PRG ROM of the inserted cartridge, e.g. to filter the trace by bank
+    size_t get_prg_rom_size() const;
+
+    /// @brief Return the image of the inserted cartridge, shared through the nes::RomCache with every instance that
+    /// inserted the same contents. Null if there is no cartridge
+    std::shared_ptr<const RomImage> get_rom_image() const;
+
+    /// @brief Record how the CPU accesses the PRG ROM of the inserted cartridge in a code/data log, saved with
+    /// save_code_data_log in the FCEUX CDL format. If the file exists, its contents are merged so the coverage
+    /// accumulates across runs. Only available when built with EMUNES_CDL
+    /// @return True if the operation was successful
+    bool set_code_data_log_filename(const std::filesystem::path &filename);
+
+    /// @brief Save the code/data log to the file provided to set_code_data_log_filename
+    /// @return True if the operation was successful
+    bool save_code_data_log() const;
+
+    /// @brief Return the breakpoints and watchpoints of this NES, which only have an effect while armed
+    debug::Breakpoints &get_breakpoints();
+
+    /// @brief Connect the breakpoints to the CPU and the memory map, tagging the watched pages. Call it again after
+    /// changing the watchpoints. While armed, run_frame returns early when the emulation stops, see
+    /// debug::Breakpoints::get_stop
+    void arm_breakpoints();
+
+    /// @brief Disconnect the breakpoints, so the emulation runs at full speed again
+    void disarm_breakpoints();
+
+    /// @brief Return true while the breakpoints are armed
+    bool are_breakpoints_armed() const;
+
     /// @brief Insert a cartridge in the NES and perform all the necessary housekeeping
     bool insert_cartridge(const std::filesystem::path &filename);
 
+    /// @brief Return true if the inserted cartridge keeps its PRG RAM with a battery
+    bool has_battery() const;
+
+    /// @brief Back the PRG RAM of a cartridge with a battery by a save file, e.g. the ROM filename with the .sav
+    /// extension. The file is created if it does not exist and loaded into the PRG RAM otherwise. The PRG RAM stays
+    /// in the machine state, so copies and snapshots have their own and do not write to the file. It is copied to the
+    /// file mapping at the end of the frames that wrote to it and when this NES is destroyed, and the kernel writes
+    /// the mapping back in the background. Inserting a cartridge disconnects the file
+    /// @return True if the operation was successful
+    bool set_save_filename(const std::filesystem::path &filename);
+
+    /// @brief Copy the PRG RAM to the save file now, if it changed
+    /// @return True if the operation was successful
+    bool flush_save_file();
+
     /// @brief Override the default reset vector by directly providing a starting pc
     void override_reset_vector(const uint16_t address);
 
@@ -31,15 +164,103 @@ class Nes
     /// @brief Press the power button
     bool init();
 
+    /// @brief Press the power button without starting execution, which is then driven with run_frame
+    void power_on();
+
+    /// @brief Execute until the end of the current video frame, or until an armed breakpoint stops the emulation.
+    /// In the latter case the frame is completed by the next call
+    /// @return True if the operation was successful
+    bool run_frame();
+
+    /// @brief Execute a single instruction, never a fused pair, ignoring the breakpoints. The frame count advances
+    /// when the instruction ends the frame, as in run_frame
+    /// @return True if the operation was successful
+    bool step();
+
+    /// @brief Return the number of frames run since power on
+    uint64_t get_frame_count() const;
+
+    /// @brief Return the number of CPU cycles executed since power on
+    uint64_t get_cycles() const;
+
+    /// @brief Return the number of CPU instructions executed since power on
+    uint64_t get_instructions() const;
+
+    /// @brief Return the CPU registers
+    cpu::Registers get_registers();
+
+    /// @brief Overwrite the CPU registers
+    void set_registers(const cpu::Registers &registers);
+
+    /// @brief Set the buttons pressed in the first controller
+    /// @param buttons One bit per button, from bit 0 to bit 7: A, B, Select, Start, Up, Down, Left, Right
+    void set_controller(const uint8_t buttons);
+
+    /// @brief Read memory without side effects
+    /// @param address The address selection
+    /// @return The value the bus would provide at the specified address
+    uint8_t peek(const uint16_t address) const;
+
+    /// @brief Read a block of memory without side effects, see mmio::Mmio::peek_range
+    void peek_range(const uint16_t address, uint8_t *data, const size_t size) const;
+
+    /// @brief Overwrite a block of the CPU RAM without side effects, see mmio::Mmio::poke_range
+    void poke_range(const uint16_t address, const uint8_t *data, const size_t size);
+
   private:
-    /// @brief The MOS6502
-    cpu::MOS6502 cpu;
+    /// @brief The mutable state of the machine
+    Machine machine;
 
-    /// @brief Shared pointer to the address bus
-    std::shared_ptr<mmio::Mmio> mmio;
+    /// @brief The contents of the inserted cartridge, shared through the ROM cache with all the instances
+    /// running the same cartridge
+    std::shared_ptr<const RomImage> rom;
 
-    /// @brief Shared pointer to the system NES log file
+    /// @brief Shared pointer to the system NES log file, if a filename has been provided
     std::shared_ptr<common::LogFile> log_file;
+
+    /// @brief True if the inserted cartridge keeps its PRG RAM with a battery
+    bool battery = false;
+
+    /// @brief The mapping of the battery save, if a filename has been provided. Like the log file, it is not shared
+    /// with copies
+    std::unique_ptr<common::MappedFile> save_file;
+
+    /// @brief The trace store, if a filename has been provided. Like the log file, it is not shared with copies
+    std::shared_ptr<debug::TraceStoreWriter> trace_store;
+
+    /// @brief The code/data logger, if a filename has been provided. Like the log file, it is not shared with copies
+    std::shared_ptr<cpu::CodeDataLogger> code_data_logger;
+
+    /// @brief Where the code/data log is saved
+    std::filesystem::path code_data_log_filename;
+
+    /// @brief The trace control, created on first use. It belongs to this NES, copies do not get it
+    std::unique_ptr<debug::TraceControl> trace_control;
+
+    /// @brief The bus recorder, while the accesses are being recorded. It belongs to this NES, copies do not get it
+    std::unique_ptr<debug::BusRecorder> bus_recorder;
+
+    /// @brief The access heatmap, while the accesses are being counted. It belongs to this NES, copies do not get it
+    std::unique_ptr<debug::AccessHeatmap> heatmap;
+
+    /// @brief The breakpoints, created on first use. They belong to this NES, copies do not get them
+    std::unique_ptr<debug::Breakpoints> breakpoints;
+
+    /// @brief True while the breakpoints are connected to the machine
+    bool breakpoints_armed = false;
+
+    /// @brief Point the machine, after it has been copied, to its own bus and to the log file, trace control,
+    /// trace store, code/data log, breakpoints, bus recorder and heatmap of this NES
+    void connect_machine();
+
+    /// @brief Connect the trace control to the CPU if there is a log file to trace to, and tell it the frame
+    void connect_trace_control();
+
+    /// @brief Move to the next frame, telling the trace control and the heatmap about it
+    void end_frame();
+
+    /// @brief Connect the breakpoints to the machine if they are armed, or disconnect them otherwise
+    void connect_breakpoints();
 };
 } // namespace nes
 
@@ -0,0 +1,67 @@
+#include "RomCache.h"
+#include "common/Logging.h"
+
+namespace nes
+{
+
+/// @brief Hash the ROM contents (FNV-1a)
+static uint64_t hash_contents(const std::vector<uint8_t> &prg_rom, const std::vector<uint8_t> &chr_rom)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const auto *rom : {&prg_rom, &chr_rom})
+    {
+        for (const uint8_t byte : *rom)
+        {
+            hash = (hash ^ byte) * 0x100000001B3ULL;
+        }
+    }
+    return hash;
+}
+
+RomCache &RomCache::get_instance()
+{
+    static RomCache cache;
+    return cache;
+}
+
+std::shared_ptr<const RomImage> RomCache::get_image(std::vector<uint8_t> &&prg_rom, std::vector<uint8_t> &&chr_rom)
+{
+    const uint64_t hash = hash_contents(prg_rom, chr_rom);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = images.equal_range(hash);
+    for (auto it = range.first; it != range.second;)
+    {
+        std::shared_ptr<const RomImage> image = it->second.lock();
+        if (!image)
+        {
+            // The last instance holding this image is gone
+            it = images.erase(it);
+            continue;
+        }
+        if (image->prg_rom == prg_rom && image->chr_rom == chr_rom)
+        {
+            common::Log(common::LogLevel::DEBUG, "ROM image found in cache");
+            return image;
+        }
+        ++it;
+    }
+
+    auto image = std::make_shared<const RomImage>(RomImage{hash, std::move(prg_rom), std::move(chr_rom)});
+    images.emplace(hash, image);
+    common::Log(common::LogLevel::DEBUG, "ROM image added to cache");
+    return image;
+}
+
+size_t RomCache::size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (const auto &entry : images)
+    {
+        count += !entry.second.expired();
+    }
+    return count;
+}
+
+} // namespace nes
@@ -0,0 +1,56 @@
+#ifndef NES_ROM_CACHE_H
+#define NES_ROM_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace nes
+{
+
+/// @brief Immutable contents of a cartridge, shared by all the emulator instances that use it
+struct RomImage
+{
+    /// @brief Hash of the contents, used as key in the cache
+    uint64_t hash;
+
+    /// @brief The PRG ROM
+    std::vector<uint8_t> prg_rom;
+
+    /// @brief The CHR ROM
+    std::vector<uint8_t> chr_rom;
+};
+
+/// @brief Process-wide cache of ROM images, indexed by a hash of their contents. All the instances that
+/// insert the same cartridge share one image, which is released when the last of them is destroyed
+class RomCache
+{
+  public:
+    /// @brief Return the cache shared by the whole process
+    static RomCache &get_instance();
+
+    /// @brief Return the image with the provided contents. If an instance already holds an image with the
+    /// same contents, that one is returned and the provided contents are discarded
+    /// @param prg_rom The PRG ROM as read from the cartridge
+    /// @param chr_rom The CHR ROM as read from the cartridge
+    /// @return The shared image
+    std::shared_ptr<const RomImage> get_image(std::vector<uint8_t> &&prg_rom, std::vector<uint8_t> &&chr_rom);
+
+    /// @brief Return the number of images currently alive in the cache
+    size_t size();
+
+  private:
+    RomCache() = default;
+
+    /// @brief Protects the images, as instances can be created from several threads
+    std::mutex mutex;
+
+    /// @brief The images, indexed by hash. Several images can share a hash, so the contents are compared too
+    std::unordered_multimap<uint64_t, std::weak_ptr<const RomImage>> images;
+};
+
+} // namespace nes
+
+#endif
@@ -0,0 +1,145 @@
+#include "TestRomRunner.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "Nes.h"
+
+namespace nes
+{
+
+/// Where the ROMs report their status, followed by the signature that tells the status is valid
+static constexpr uint16_t STATUS_ADDRESS = 0x6000;
+static constexpr uint8_t SIGNATURE[3] = {0xDE, 0xB0, 0x61};
+
+/// The text that describes the result, ending in a zero byte, up to the end of the PRG RAM
+static constexpr uint16_t TEXT_ADDRESS = 0x6004;
+static constexpr size_t MAX_TEXT_SIZE = 0x8000 - TEXT_ADDRESS;
+
+/// Values of the status that are not result codes
+static constexpr uint8_t STATUS_RUNNING = 0x80;
+static constexpr uint8_t STATUS_RESET = 0x81;
+
+/// The ROMs ask to wait at least 100 ms before pressing reset
+static constexpr uint64_t RESET_DELAY_FRAMES = 6;
+
+TestRomRunner::TestRomRunner(const size_t num_threads, const uint64_t max_frames)
+    : thread_pool(num_threads), max_frames(max_frames)
+{
+}
+
+std::vector<std::filesystem::path> TestRomRunner::find_roms(const std::filesystem::path &directory)
+{
+    std::vector<std::filesystem::path> roms;
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, error);
+         it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        if (it->is_regular_file() && it->path().extension() == ".nes")
+        {
+            roms.push_back(it->path());
+        }
+    }
+    std::sort(roms.begin(), roms.end());
+    return roms;
+}
+
+TestRomResult TestRomRunner::run(const std::filesystem::path &filename) const
+{
+    const auto start = std::chrono::steady_clock::now();
+    TestRomResult result;
+    result.filename = filename;
+
+    Nes nes;
+    if (!nes.insert_cartridge(filename))
+    {
+        result.text = "The ROM could not be loaded";
+        return result;
+    }
+    nes.power_on();
+
+    bool signature = false;
+    uint64_t reset_frame = 0;
+    result.status = TestRomStatus::NO_STATUS;
+    while (result.frames < max_frames)
+    {
+        const bool running = nes.run_frame();
+        result.frames++;
+
+        // Some ROMs jam the CPU once they have reported their result
+        uint8_t header[4];
+        nes.peek_range(STATUS_ADDRESS, header, sizeof(header));
+        signature = signature || std::equal(SIGNATURE, SIGNATURE + sizeof(SIGNATURE), header + 1);
+        const uint8_t status = header[0];
+        if (signature && status < STATUS_RUNNING)
+        {
+            result.status = status == 0 ? TestRomStatus::PASSED : TestRomStatus::FAILED;
+            result.code = status;
+            std::vector<uint8_t> text(MAX_TEXT_SIZE);
+            nes.peek_range(TEXT_ADDRESS, text.data(), text.size());
+            result.text.assign(text.begin(), std::find(text.begin(), text.end(), 0));
+            break;
+        }
+        if (!running)
+        {
+            result.status = TestRomStatus::ERROR;
+            result.text = "The CPU jammed";
+            break;
+        }
+
+        if (!signature || status != STATUS_RESET)
+        {
+            reset_frame = 0;
+        }
+        else if (reset_frame == 0)
+        {
+            reset_frame = result.frames + RESET_DELAY_FRAMES;
+        }
+        else if (result.frames >= reset_frame)
+        {
+            // Reset keeps the PRG RAM, where the ROM finds its state again
+            nes.power_on();
+            reset_frame = 0;
+        }
+    }
+    if (result.status == TestRomStatus::NO_STATUS && signature)
+    {
+        result.status = TestRomStatus::TIMEOUT;
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.seconds = elapsed.count();
+    return result;
+}
+
+std::vector<TestRomResult> TestRomRunner::run_all(const std::vector<std::filesystem::path> &filenames)
+{
+    std::vector<TestRomResult> results(filenames.size());
+    thread_pool.parallel_for(filenames.size(), [&](size_t index) { results[index] = run(filenames[index]); });
+    return results;
+}
+
+size_t TestRomRunner::get_num_threads() const
+{
+    return thread_pool.size();
+}
+
+const char *TestRomRunner::get_status_name(const TestRomStatus status)
+{
+    switch (status)
+    {
+    case TestRomStatus::PASSED:
+        return "PASSED";
+    case TestRomStatus::FAILED:
+        return "FAILED";
+    case TestRomStatus::TIMEOUT:
+        return "TIMEOUT";
+    case TestRomStatus::NO_STATUS:
+        return "NO STATUS";
+    case TestRomStatus::ERROR:
+        return "ERROR";
+    }
+    return "";
+}
+
+} // namespace nes
@@ -0,0 +1,76 @@
+#ifndef NES_TEST_ROM_RUNNER_H
+#define NES_TEST_ROM_RUNNER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "common/ThreadPool.h"
+
+namespace nes
+{
+
+/// @brief Outcome of a test ROM
+enum class TestRomStatus : uint8_t
+{
+    PASSED,    // The ROM reported result code 0
+    FAILED,    // The ROM reported another result code
+    TIMEOUT,   // The ROM reported that it was running, but did not finish in time
+    NO_STATUS, // The ROM never reported anything in $6000, e.g. it does not follow the protocol
+    ERROR      // The ROM could not be loaded, or jammed the CPU
+};
+
+/// @brief What a test ROM reported
+struct TestRomResult
+{
+    std::filesystem::path filename;
+    TestRomStatus status = TestRomStatus::ERROR;
+    uint8_t code = 0;    // The result code in $6000, if it finished
+    std::string text;    // The text the ROM wrote from $6004, or why it could not run
+    uint64_t frames = 0; // Number of frames run
+    double seconds = 0;  // Wall time of the run
+};
+
+/// @brief Runs test ROMs that report their status in the PRG RAM, as blargg's test ROMs do: once $6001-$6003 hold
+/// the signature DE B0 61, $6000 is $80 while the test runs, $81 when the ROM asks for a reset and the result code
+/// when it is done, with 0 meaning success, and a text ending in a zero byte starts at $6004. Every ROM runs on its
+/// own NES, several of them in parallel, and the status is checked at the end of every frame
+class TestRomRunner
+{
+  public:
+    /// @brief Default number of frames a ROM can run, a minute of emulated time
+    static constexpr uint64_t DEFAULT_MAX_FRAMES = 3600;
+
+    /// @brief Constructor
+    /// @param num_threads Number of ROMs run at the same time, zero to use all the hardware threads
+    /// @param max_frames Number of frames after which a ROM that did not finish is given up
+    TestRomRunner(const size_t num_threads = 0, const uint64_t max_frames = DEFAULT_MAX_FRAMES);
+
+    /// @brief Return the ROMs (.nes files) found in a directory and all its subdirectories, sorted by path
+    static std::vector<std::filesystem::path> find_roms(const std::filesystem::path &directory);
+
+    /// @brief Run a single ROM on the calling thread
+    TestRomResult run(const std::filesystem::path &filename) const;
+
+    /// @brief Run several ROMs in parallel
+    /// @return The result of every ROM, in the order of the filenames
+    std::vector<TestRomResult> run_all(const std::vector<std::filesystem::path> &filenames);
+
+    /// @brief Return the number of ROMs run at the same time
+    size_t get_num_threads() const;
+
+    /// @brief Return a printable name of a status
+    static const char *get_status_name(const TestRomStatus status);
+
+  private:
+    /// @brief Threads running the ROMs
+    common::ThreadPool thread_pool;
+
+    /// @brief Number of frames after which a ROM that did not finish is given up
+    uint64_t max_frames;
+};
+
+} // namespace nes
+
+#endif
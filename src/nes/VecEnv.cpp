@@ -0,0 +1,138 @@
+#include "VecEnv.h"
+#include "VecEnvC.h"
+#include "common/Logging.h"
+
+namespace nes
+{
+
+VecEnv::VecEnv(const size_t num_threads) : thread_pool(num_threads)
+{
+}
+
+bool VecEnv::load(const std::filesystem::path &rom_filename, const uint16_t reward_address)
+{
+    if (!prototype.insert_cartridge(rom_filename))
+    {
+        return false;
+    }
+    prototype.power_on();
+    this->reward_address = reward_address;
+    loaded = true;
+    envs.clear();
+    return true;
+}
+
+void VecEnv::set_buffers(uint8_t *ram, uint8_t *rewards, uint8_t *dones)
+{
+    this->ram = ram;
+    this->rewards = rewards;
+    this->dones = dones;
+}
+
+bool VecEnv::reset(const size_t num_envs)
+{
+    if (!loaded || ram == nullptr || rewards == nullptr || dones == nullptr)
+    {
+        common::Log(common::LogLevel::ERROR, "The environment needs a cartridge and buffers before reset");
+        return false;
+    }
+
+    // Every instance is a memcpy of the prototype, and they all share its ROM
+    envs.assign(num_envs, prototype);
+    thread_pool.parallel_for(num_envs, [this](const size_t index) { write_results(index, false); });
+    return true;
+}
+
+bool VecEnv::step(const uint8_t *actions)
+{
+    if (ram == nullptr || rewards == nullptr || dones == nullptr)
+    {
+        common::Log(common::LogLevel::ERROR, "The environment needs buffers before step");
+        return false;
+    }
+
+    thread_pool.parallel_for(envs.size(), [this, actions](const size_t index) {
+        Nes &env = envs[index];
+        env.set_controller(actions[index]);
+        const bool done = !env.run_frame();
+        if (done)
+        {
+            // Start a new episode, reporting the last state of the finished one
+            write_results(index, true);
+            env = prototype;
+            return;
+        }
+        write_results(index, false);
+    });
+    return true;
+}
+
+size_t VecEnv::get_num_envs() const
+{
+    return envs.size();
+}
+
+void VecEnv::write_results(const size_t index, const bool done)
+{
+    const Nes &env = envs[index];
+    env.peek_range(0, ram + index * RAM_SIZE, RAM_SIZE);
+    rewards[index] = env.peek(reward_address);
+    dones[index] = done;
+}
+
+} // namespace nes
+
+// ***************************
+// C interface
+// ***************************
+
+struct emunes_vec_env
+{
+    nes::VecEnv env;
+
+    emunes_vec_env(const size_t num_threads) : env(num_threads)
+    {
+    }
+};
+
+extern "C"
+{
+
+    emunes_vec_env *emunes_vec_env_create(const char *rom_filename, const uint16_t reward_address,
+                                          const size_t num_threads)
+    {
+        common::mute();
+        auto *vec_env = new emunes_vec_env(num_threads);
+        if (!vec_env->env.load(rom_filename, reward_address))
+        {
+            delete vec_env;
+            return nullptr;
+        }
+        return vec_env;
+    }
+
+    void emunes_vec_env_destroy(emunes_vec_env *vec_env)
+    {
+        delete vec_env;
+    }
+
+    void emunes_vec_env_set_buffers(emunes_vec_env *vec_env, uint8_t *ram, uint8_t *rewards, uint8_t *dones)
+    {
+        vec_env->env.set_buffers(ram, rewards, dones);
+    }
+
+    int emunes_vec_env_reset(emunes_vec_env *vec_env, const size_t num_envs)
+    {
+        return vec_env->env.reset(num_envs);
+    }
+
+    int emunes_vec_env_step(emunes_vec_env *vec_env, const uint8_t *actions)
+    {
+        return vec_env->env.step(actions);
+    }
+
+    size_t emunes_vec_env_ram_size(void)
+    {
+        return nes::VecEnv::RAM_SIZE;
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef NES_VEC_ENV_H
+#define NES_VEC_ENV_H
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "Nes.h"
+#include "common/ThreadPool.h"
+
+namespace nes
+{
+
+/// @brief Vectorised environment for reinforcement learning: many instances of the same game, each one
+/// advanced by one frame per step, in parallel. The observations are written directly into arrays provided
+/// by the caller, with one fixed size slot per instance, so they can be consumed without further copies.
+/// There is no PPU yet, so the observation of an instance is its CPU RAM
+class VecEnv
+{
+  public:
+    /// @brief Size of the observation of each instance
+    static constexpr size_t RAM_SIZE = 0x0800;
+
+    /// @brief Constructor
+    /// @param num_threads Number of threads stepping the instances, zero to use all the hardware threads
+    VecEnv(const size_t num_threads = 0);
+
+    /// @brief Load the cartridge all the instances run
+    /// @param rom_filename The ROM file
+    /// @param reward_address Address of the byte reported as reward after every step
+    /// @return True if the operation was successful
+    bool load(const std::filesystem::path &rom_filename, const uint16_t reward_address);
+
+    /// @brief Provide the arrays the results are written to. They have to outlive the environment, or be
+    /// replaced before the next reset or step
+    /// @param ram num_envs * RAM_SIZE bytes, the RAM of each instance after the step
+    /// @param rewards num_envs bytes, the value of the reward address of each instance after the step
+    /// @param dones num_envs bytes, 1 if the instance stopped (e.g. the CPU jammed) and was reset
+    void set_buffers(uint8_t *ram, uint8_t *rewards, uint8_t *dones);
+
+    /// @brief Create num_envs instances, all of them in the power on state, and write their observations
+    /// @return True if the operation was successful
+    bool reset(const size_t num_envs);
+
+    /// @brief Advance every instance by one frame and write the results
+    /// @param actions num_envs bytes, the controller buttons of each instance during the frame
+    /// @return True if the operation was successful
+    bool step(const uint8_t *actions);
+
+    /// @brief Return the number of instances
+    size_t get_num_envs() const;
+
+  private:
+    /// @brief The instance every other one is cloned from, in the power on state
+    Nes prototype;
+
+    /// @brief The instances
+    std::vector<Nes> envs;
+
+    /// @brief Threads stepping the instances
+    common::ThreadPool thread_pool;
+
+    /// @brief Address of the byte reported as reward
+    uint16_t reward_address = 0;
+
+    /// @brief True once a cartridge has been loaded
+    bool loaded = false;
+
+    /// @brief Caller provided results
+    uint8_t *ram = nullptr;
+    uint8_t *rewards = nullptr;
+    uint8_t *dones = nullptr;
+
+    /// @brief Write the results of an instance into the caller provided arrays
+    void write_results(const size_t index, const bool done);
+};
+
+} // namespace nes
+
+#endif
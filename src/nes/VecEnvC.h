@@ -0,0 +1,40 @@
+#ifndef NES_VEC_ENV_C_H
+#define NES_VEC_ENV_C_H
+
+/* C interface of nes::VecEnv, for bindings from other languages. See VecEnv.h for the details */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /* Opaque handle of a vectorised environment */
+    typedef struct emunes_vec_env emunes_vec_env;
+
+    /* Create an environment running the provided ROM. Returns NULL if the ROM cannot be loaded */
+    emunes_vec_env *emunes_vec_env_create(const char *rom_filename, uint16_t reward_address, size_t num_threads);
+
+    /* Destroy an environment */
+    void emunes_vec_env_destroy(emunes_vec_env *vec_env);
+
+    /* Provide the arrays the results are written to: num_envs * emunes_vec_env_ram_size() bytes of RAM,
+       num_envs rewards and num_envs done flags */
+    void emunes_vec_env_set_buffers(emunes_vec_env *vec_env, uint8_t *ram, uint8_t *rewards, uint8_t *dones);
+
+    /* Create num_envs instances in the power on state. Returns 1 on success */
+    int emunes_vec_env_reset(emunes_vec_env *vec_env, size_t num_envs);
+
+    /* Advance every instance by one frame with the provided controller buttons. Returns 1 on success */
+    int emunes_vec_env_step(emunes_vec_env *vec_env, const uint8_t *actions);
+
+    /* Size of the RAM observation of each instance */
+    size_t emunes_vec_env_ram_size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+#include <algorithm>
+#include <fstream>
+
+#include "Cartridge.h"
+
+namespace test
+{
+
+/// Sizes of the iNES header and of the PRG ROM
+static constexpr size_t HEADER_SIZE = 16;
+static constexpr size_t PRG_ROM_SIZE = 0x4000;
+
+/// Offset of the reset vector in the PRG ROM
+static constexpr size_t RESET_VECTOR_OFFSET = 0x3FFC;
+
+void write_cartridge(const std::filesystem::path &filename, const std::vector<uint8_t> &program,
+                     const uint8_t flags_6, const uint8_t flags_7, const uint8_t flags_10)
+{
+    std::vector<uint8_t> rom(HEADER_SIZE + PRG_ROM_SIZE);
+    const uint8_t header[HEADER_SIZE] = {'N', 'E', 'S', 0x1A, 1, 0, flags_6, flags_7, 0, 0, flags_10};
+    std::copy(header, header + sizeof(header), rom.begin());
+    std::copy(program.begin(), program.end(), rom.begin() + HEADER_SIZE);
+    rom[HEADER_SIZE + RESET_VECTOR_OFFSET] = CARTRIDGE_PROGRAM_START & 0xFF;
+    rom[HEADER_SIZE + RESET_VECTOR_OFFSET + 1] = CARTRIDGE_PROGRAM_START >> 8;
+    std::ofstream file(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    file.write(reinterpret_cast<const char *>(rom.data()), rom.size());
+}
+
+} // namespace test
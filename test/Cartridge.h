@@ -0,0 +1,25 @@
+#ifndef TEST_CARTRIDGE_H
+#define TEST_CARTRIDGE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace test
+{
+
+/// @brief Address the programs written by write_cartridge start at, where their reset vector points
+static constexpr uint16_t CARTRIDGE_PROGRAM_START = 0xC000;
+
+/// @brief Write an iNES cartridge with a 16 KB PRG ROM, mirrored at $8000 and $C000, and no CHR ROM
+/// @param filename Where the cartridge is written
+/// @param program Contents of the start of the PRG ROM. The reset vector points to it
+/// @param flags_6 Flags 6 of the header, bit 1 is the battery
+/// @param flags_7 Flags 7 of the header, 0x08 for NES 2.0
+/// @param flags_10 Flags 10 of the header, the PRG RAM sizes for NES 2.0
+void write_cartridge(const std::filesystem::path &filename, const std::vector<uint8_t> &program,
+                     const uint8_t flags_6 = 0, const uint8_t flags_7 = 0, const uint8_t flags_10 = 0);
+
+} // namespace test
+
+#endif
@@ -0,0 +1,124 @@
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "common/MappedFile.h"
+#include "debug/AccessHeatmap.h"
+#include "debug/BusRecorder.h"
+#include "nes/Nes.h"
+
+/// Counts the accesses of nestest in a heatmap, checks the counters against a bus recording of the same run, and
+/// checks the snapshots of several frames and the exports
+
+class TestAccessHeatmap : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestAccessHeatmap);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestAccessHeatmap);
+
+/// Number of instructions of nestest.log
+static constexpr size_t MAX_INSTRUCTIONS = 8991;
+
+/// @brief Return the index of a counter in the layout of debug::AccessHeatmap::get_frame_counts
+static size_t get_index(const uint16_t address, const debug::AccessKind kind)
+{
+    return static_cast<size_t>(kind) * debug::AccessHeatmap::NUM_ADDRESSES + address;
+}
+
+void TestAccessHeatmap::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    // nestest jams before the end of its first frame, so the heatmap gets the snapshot of that frame when stopped
+    nes::Nes nes;
+    CPPUNIT_ASSERT(nes.insert_cartridge("roms/test/nestest/nestest.nes"));
+    nes.start_heatmap();
+    nes.start_bus_recording();
+    nes.set_max_instructions(MAX_INSTRUCTIONS);
+    nes.override_reset_vector(0xC000);
+    nes.init();
+    const std::unique_ptr<debug::AccessHeatmap> heatmap = nes.stop_heatmap();
+    const std::unique_ptr<debug::BusRecorder> recorder = nes.stop_bus_recording();
+    CPPUNIT_ASSERT(heatmap);
+    CPPUNIT_ASSERT(recorder);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, heatmap->get_frame_count());
+    CPPUNIT_ASSERT_EQUAL((uint64_t)0, heatmap->get_frame_number(0));
+
+    // Every access of the recording is counted, and every opcode fetch is an execution
+    std::vector<uint64_t> expected(debug::AccessHeatmap::NUM_KINDS * debug::AccessHeatmap::NUM_ADDRESSES);
+    for (size_t index = 0; index < recorder->get_size(); index++)
+    {
+        const debug::BusCycle &access = recorder->get_cycle(index);
+        expected[get_index(access.address, access.flags & debug::BUS_WRITE ? debug::AccessKind::WRITE
+                                                                            : debug::AccessKind::READ)]++;
+        if (access.flags & debug::BUS_SYNC)
+        {
+            expected[get_index(access.address, debug::AccessKind::EXECUTE)]++;
+        }
+    }
+    CPPUNIT_ASSERT(expected == heatmap->get_total_counts());
+    std::vector<uint32_t> frame_counts;
+    heatmap->get_frame_counts(0, frame_counts);
+    CPPUNIT_ASSERT(std::equal(frame_counts.begin(), frame_counts.end(), expected.begin()));
+    CPPUNIT_ASSERT_EQUAL((uint64_t)MAX_INSTRUCTIONS,
+                         std::accumulate(expected.begin() + get_index(0, debug::AccessKind::EXECUTE),
+                                         expected.begin() + get_index(0, debug::AccessKind::READ), (uint64_t)0));
+    CPPUNIT_ASSERT_EQUAL((uint64_t)1, expected[get_index(0xC000, debug::AccessKind::EXECUTE)]);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)9, expected[get_index(0x0300, debug::AccessKind::WRITE)]);
+
+    // Snapshots of several frames decode to their own counters and add up to the totals
+    debug::AccessHeatmap frames;
+    frames.add(0x0010, debug::AccessKind::READ);
+    frames.add(0x0010, debug::AccessKind::READ);
+    frames.add(0xFFFF, debug::AccessKind::WRITE);
+    frames.end_frame(5);
+    frames.end_frame(6);
+    frames.add(0x0010, debug::AccessKind::WRITE);
+    frames.add(0x8000, debug::AccessKind::EXECUTE);
+    frames.end_frame(7);
+    CPPUNIT_ASSERT_EQUAL((size_t)3, frames.get_frame_count());
+    CPPUNIT_ASSERT_EQUAL((uint64_t)7, frames.get_frame_number(2));
+    frames.get_frame_counts(0, frame_counts);
+    CPPUNIT_ASSERT_EQUAL(2u, frame_counts[get_index(0x0010, debug::AccessKind::READ)]);
+    CPPUNIT_ASSERT_EQUAL(1u, frame_counts[get_index(0xFFFF, debug::AccessKind::WRITE)]);
+    CPPUNIT_ASSERT_EQUAL(3u, std::accumulate(frame_counts.begin(), frame_counts.end(), 0u));
+    frames.get_frame_counts(1, frame_counts);
+    CPPUNIT_ASSERT_EQUAL(0u, std::accumulate(frame_counts.begin(), frame_counts.end(), 0u));
+    frames.get_frame_counts(2, frame_counts);
+    CPPUNIT_ASSERT_EQUAL(1u, frame_counts[get_index(0x0010, debug::AccessKind::WRITE)]);
+    CPPUNIT_ASSERT_EQUAL(1u, frame_counts[get_index(0x8000, debug::AccessKind::EXECUTE)]);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)2, frames.get_total_counts()[get_index(0x0010, debug::AccessKind::READ)]);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)1, frames.get_total_counts()[get_index(0x0010, debug::AccessKind::WRITE)]);
+
+    // The CSV has a row per address accessed in a frame, the image a pixel per address
+    CPPUNIT_ASSERT(frames.save_csv("heatmap.csv"));
+    common::MappedFile csv_file;
+    CPPUNIT_ASSERT(csv_file.open("heatmap.csv"));
+    CPPUNIT_ASSERT(csv_file.get_text() == "frame,address,reads,writes,executions\n"
+                                          "5,$0010,2,0,0\n"
+                                          "5,$FFFF,0,1,0\n"
+                                          "7,$0010,0,1,0\n"
+                                          "7,$8000,0,0,1\n");
+    std::filesystem::remove("heatmap.csv");
+    CPPUNIT_ASSERT(heatmap->save_image("nestest.ppm"));
+    common::MappedFile image_file;
+    CPPUNIT_ASSERT(image_file.open("nestest.ppm"));
+    CPPUNIT_ASSERT_EQUAL((size_t)(15 + 256 * 256 * 3), image_file.size());
+    std::filesystem::remove("nestest.ppm");
+
+    std::cout << "Counted " << recorder->get_size() << " accesses in a snapshot of " << heatmap->get_snapshot_size()
+              << " bytes" << std::endl;
+}
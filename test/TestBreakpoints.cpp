@@ -0,0 +1,73 @@
+#include <iostream>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "nes/Nes.h"
+
+/// Checks that breakpoints and watchpoints stop nestest where its log says, and that a NES that stopped and
+/// resumed ends in the same state as one that ran without them
+
+class TestBreakpoints : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestBreakpoints);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestBreakpoints);
+
+void TestBreakpoints::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    nes::Nes reference;
+    CPPUNIT_ASSERT(reference.insert_cartridge("roms/test/nestest/nestest.nes"));
+    reference.override_reset_vector(0xC000);
+    nes::Nes nes = reference.clone();
+    reference.power_on();
+    nes.power_on();
+
+    // First call of the subroutine at $C72D, nothing executed there yet
+    debug::Breakpoints &breakpoints = nes.get_breakpoints();
+    breakpoints.add_breakpoint(0xC72D);
+    // nestest stores a 4 in $00 at $CFC3. The watchpoint is set on a mirror
+    const uint32_t watchpoint =
+        breakpoints.add_watchpoint(debug::Watchpoint{0x0800, 0x0800, debug::WATCH_WRITE, true, 0x04});
+    nes.arm_breakpoints();
+
+    CPPUNIT_ASSERT(nes.run_frame());
+    CPPUNIT_ASSERT(breakpoints.get_stop().reason == debug::StopReason::BREAKPOINT);
+    CPPUNIT_ASSERT_EQUAL((uint16_t)0xC72D, breakpoints.get_stop().pc);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)0, nes.get_frame_count());
+
+    // Resuming does not stop again at the same pc
+    breakpoints.resume();
+    breakpoints.remove_breakpoint(0xC72D);
+    CPPUNIT_ASSERT(nes.run_frame());
+    const debug::Stop &stop = breakpoints.get_stop();
+    CPPUNIT_ASSERT(stop.reason == debug::StopReason::WATCHPOINT);
+    CPPUNIT_ASSERT_EQUAL(watchpoint, stop.watchpoint);
+    CPPUNIT_ASSERT_EQUAL((uint16_t)0x0000, stop.address);
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0x04, stop.value);
+    CPPUNIT_ASSERT(stop.write);
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0x04, nes.peek(0x0000));
+
+    // Without the breakpoints, the rest of the run matches the reference. nestest jams before the end of the
+    // first frame
+    breakpoints.resume();
+    nes.disarm_breakpoints();
+    nes.run_frame();
+    reference.run_frame();
+    for (uint16_t address = 0; address < 0x0800; address++)
+    {
+        CPPUNIT_ASSERT(nes.peek(address) == reference.peek(address));
+    }
+
+    std::cout << "Breakpoints and watchpoints stop nestest where expected" << std::endl;
+}
@@ -0,0 +1,150 @@
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "common/MappedFile.h"
+#include "debug/BusRecorder.h"
+#include "debug/TraceDiff.h"
+#include "nes/Nes.h"
+
+/// Records the bus accesses of nestest, checks the opcode fetches and their cycles against nestest.log and the
+/// accesses of a few instructions cycle by cycle, and checks the ring buffer and the exports
+
+class TestBusRecorder : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestBusRecorder);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestBusRecorder);
+
+/// Number of instructions of nestest.log
+static constexpr size_t MAX_INSTRUCTIONS = 8991;
+
+/// Number of accesses kept by the small recorder
+static constexpr size_t SMALL_CAPACITY = 1000;
+
+/// @brief Run nestest recording its bus accesses
+static std::unique_ptr<debug::BusRecorder> record_nestest(const size_t capacity)
+{
+    nes::Nes nes;
+    CPPUNIT_ASSERT(nes.insert_cartridge("roms/test/nestest/nestest.nes"));
+    nes.start_bus_recording(capacity);
+    nes.set_max_instructions(MAX_INSTRUCTIONS);
+    nes.override_reset_vector(0xC000);
+    nes.init();
+    std::unique_ptr<debug::BusRecorder> recorder = nes.stop_bus_recording();
+    CPPUNIT_ASSERT(recorder);
+    return recorder;
+}
+
+/// @brief Check an access
+static void check_access(const debug::BusCycle &access, const uint64_t cycle, const uint16_t address,
+                         const uint8_t data, const uint8_t flags)
+{
+    CPPUNIT_ASSERT_EQUAL(cycle, access.cycle);
+    CPPUNIT_ASSERT_EQUAL(address, access.address);
+    CPPUNIT_ASSERT_EQUAL(data, access.data);
+    CPPUNIT_ASSERT_EQUAL(flags, access.flags);
+}
+
+void TestBusRecorder::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    const std::unique_ptr<debug::BusRecorder> recorder = record_nestest(debug::BusRecorder::DEFAULT_CAPACITY);
+    const size_t size = recorder->get_size();
+    CPPUNIT_ASSERT_EQUAL((uint64_t)size, recorder->get_recorded_count());
+
+    // The opcode fetches match the pc and the cycle of every line of nestest.log, and no instruction makes more
+    // accesses than it has cycles
+    common::MappedFile log_file;
+    CPPUNIT_ASSERT(log_file.open("roms/test/nestest/nestest.log"));
+    const std::string_view log = log_file.get_text();
+    size_t offset = 0;
+    size_t fetches = 0;
+    for (size_t index = 0; index < size; index++)
+    {
+        const debug::BusCycle &access = recorder->get_cycle(index);
+        if (index > 0)
+        {
+            CPPUNIT_ASSERT(access.cycle > recorder->get_cycle(index - 1).cycle);
+        }
+        if (access.flags & debug::BUS_SYNC)
+        {
+            const std::string line(debug::TraceDiff::get_line(log, offset));
+            CPPUNIT_ASSERT_EQUAL((unsigned long)access.address, std::stoul(line.substr(0, 4), nullptr, 16));
+            CPPUNIT_ASSERT_EQUAL((unsigned long)access.data, std::stoul(line.substr(6, 2), nullptr, 16));
+            CPPUNIT_ASSERT_EQUAL((unsigned long long)access.cycle, std::stoull(line.substr(line.find("CYC:") + 4)));
+            offset = debug::TraceDiff::get_next_line(log, offset);
+            fetches++;
+        }
+    }
+    CPPUNIT_ASSERT_EQUAL(MAX_INSTRUCTIONS, fetches);
+
+    // JMP $C5F5 at the start, then the STA $0300 of line 1081 of nestest.log, which writes on its fourth cycle
+    check_access(recorder->get_cycle(0), 7, 0xC000, 0x4C, debug::BUS_SYNC);
+    check_access(recorder->get_cycle(1), 8, 0xC001, 0xF5, 0);
+    check_access(recorder->get_cycle(2), 9, 0xC002, 0xC5, 0);
+    check_access(recorder->get_cycle(3), 10, 0xC5F5, 0xA2, debug::BUS_SYNC);
+    size_t store = 0;
+    while (store < size && recorder->get_cycle(store).cycle != 2529)
+    {
+        store++;
+    }
+    CPPUNIT_ASSERT(store + 3 < size);
+    check_access(recorder->get_cycle(store), 2529, 0xCFCC, 0x8D, debug::BUS_SYNC);
+    check_access(recorder->get_cycle(store + 1), 2530, 0xCFCD, 0x00, 0);
+    check_access(recorder->get_cycle(store + 2), 2531, 0xCFCE, 0x03, 0);
+    check_access(recorder->get_cycle(store + 3), 2532, 0x0300, 0x5B, debug::BUS_WRITE);
+
+    // A small recorder keeps the last accesses
+    const std::unique_ptr<debug::BusRecorder> small_recorder = record_nestest(SMALL_CAPACITY);
+    CPPUNIT_ASSERT_EQUAL(SMALL_CAPACITY, small_recorder->get_size());
+    CPPUNIT_ASSERT_EQUAL((uint64_t)size, small_recorder->get_recorded_count());
+    for (size_t index = 0; index < SMALL_CAPACITY; index++)
+    {
+        const debug::BusCycle &expected = recorder->get_cycle(size - SMALL_CAPACITY + index);
+        check_access(small_recorder->get_cycle(index), expected.cycle, expected.address, expected.data,
+                     expected.flags);
+    }
+
+    // The binary export loads back as it was recorded
+    CPPUNIT_ASSERT(recorder->save_binary("nestest.bus"));
+    std::vector<debug::BusCycle> loaded;
+    CPPUNIT_ASSERT(debug::BusRecorder::load_binary("nestest.bus", loaded));
+    CPPUNIT_ASSERT_EQUAL(size, loaded.size());
+    for (size_t index = 0; index < size; index++)
+    {
+        const debug::BusCycle &expected = recorder->get_cycle(index);
+        check_access(loaded[index], expected.cycle, expected.address, expected.data, expected.flags);
+    }
+    std::filesystem::remove("nestest.bus");
+
+    // The waveform has a timestamp per access
+    CPPUNIT_ASSERT(small_recorder->save_vcd("nestest.vcd"));
+    common::MappedFile vcd_file;
+    CPPUNIT_ASSERT(vcd_file.open("nestest.vcd"));
+    const std::string_view vcd = vcd_file.get_text();
+    CPPUNIT_ASSERT(vcd.find("$enddefinitions $end\n") != std::string_view::npos);
+    size_t timestamps = 0;
+    for (size_t line = 0; line < vcd.size(); line = debug::TraceDiff::get_next_line(vcd, line))
+    {
+        timestamps += vcd[line] == '#';
+    }
+    CPPUNIT_ASSERT_EQUAL(SMALL_CAPACITY, timestamps);
+    std::filesystem::remove("nestest.vcd");
+
+    std::cout << "Recorded " << size << " accesses in " << recorder->get_cycle(size - 1).cycle + 1 << " cycles"
+              << std::endl;
+}
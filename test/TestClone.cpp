@@ -0,0 +1,65 @@
+#include <iostream>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "nes/Nes.h"
+
+/// Checks that a cloned NES runs exactly as the original and independently from it
+
+class TestClone : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestClone);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestClone);
+
+/// Size of the CPU RAM
+static constexpr uint16_t RAM_SIZE = 0x0800;
+
+/// @brief Return the number of bytes of CPU RAM that differ between two NES
+static size_t count_ram_differences(const nes::Nes &a, const nes::Nes &b)
+{
+    size_t differences = 0;
+    for (uint16_t address = 0; address < RAM_SIZE; address++)
+    {
+        differences += a.peek(address) != b.peek(address);
+    }
+    return differences;
+}
+
+void TestClone::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    // Stop nestest halfway through
+    nes::Nes nes;
+    CPPUNIT_ASSERT(nes.insert_cartridge("roms/test/nestest/nestest.nes"));
+    nes.override_reset_vector(0xC000);
+    nes.set_max_instructions(4000);
+    CPPUNIT_ASSERT(nes.init());
+
+    nes::Nes clone = nes.clone();
+    nes::Nes reference = nes.clone();
+    CPPUNIT_ASSERT_EQUAL((size_t)0, count_ram_differences(nes, clone));
+
+    // Running the original does not modify the clone. nestest ends by returning to an invalid address
+    // that jams the CPU, so the frame does not complete
+    nes.run_frame();
+    CPPUNIT_ASSERT(count_ram_differences(nes, clone) > 0);
+    CPPUNIT_ASSERT_EQUAL((size_t)0, count_ram_differences(clone, reference));
+
+    // Running the clone gets to the same state as the original
+    clone.run_frame();
+    CPPUNIT_ASSERT_EQUAL((size_t)0, count_ram_differences(nes, clone));
+    CPPUNIT_ASSERT_EQUAL(nes.get_frame_count(), clone.get_frame_count());
+
+    std::cout << "Cloned NES matches the original" << std::endl;
+}
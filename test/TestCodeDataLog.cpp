@@ -0,0 +1,65 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "cpu/CodeDataLogger.h"
+#include "nes/Nes.h"
+
+/// Checks the code/data log recorded while running nestest
+
+class TestCodeDataLog : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestCodeDataLog);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestCodeDataLog);
+
+/// Sizes of the nestest PRG ROM and CHR ROM
+static constexpr size_t PRG_ROM_SIZE = 0x4000;
+static constexpr size_t CHR_ROM_SIZE = 0x2000;
+
+void TestCodeDataLog::test(void)
+{
+#ifdef EMUNES_CDL
+    common::mute();
+    std::cout << std::endl;
+
+    const std::filesystem::path filename = std::filesystem::temp_directory_path() / "emunes_test.cdl";
+    std::filesystem::remove(filename);
+
+    nes::Nes nes;
+    CPPUNIT_ASSERT(nes.insert_cartridge("roms/test/nestest/nestest.nes"));
+    CPPUNIT_ASSERT(nes.set_code_data_log_filename(filename));
+    nes.override_reset_vector(0xC000);
+    nes.set_max_instructions(4000);
+    CPPUNIT_ASSERT(nes.init());
+    CPPUNIT_ASSERT(nes.save_code_data_log());
+
+    std::ifstream file(filename, std::ios_base::in | std::ios_base::binary);
+    std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::filesystem::remove(filename);
+    CPPUNIT_ASSERT_EQUAL(PRG_ROM_SIZE + CHR_ROM_SIZE, contents.size());
+
+    // The first instruction, at $C000, is code in the third 8 KB bank
+    CPPUNIT_ASSERT_EQUAL((int)(cpu::CDL_CODE | (2 << 2)), (int)contents[0]);
+    size_t code_size = 0;
+    for (size_t i = 0; i < contents.size(); i++)
+    {
+        CPPUNIT_ASSERT((contents[i] & cpu::CDL_OPCODE) == 0);
+        CPPUNIT_ASSERT(i < PRG_ROM_SIZE || contents[i] == 0);
+        code_size += contents[i] & cpu::CDL_CODE;
+    }
+    CPPUNIT_ASSERT(code_size > 0);
+    std::cout << "Code/data log marks " << code_size << " bytes of code" << std::endl;
+#endif
+}
@@ -0,0 +1,185 @@
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "common/Encoding.h"
+#include "common/Logging.h"
+#include "common/Socket.h"
+#include "nes/DebugServer.h"
+#include "nes/Nes.h"
+
+/// Runs a debug server on nestest in a child process, drives it through its socket and checks the replies against
+/// the same NES stepped in this process
+
+class TestDebugServer : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestDebugServer);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestDebugServer);
+
+/// Where the server listens
+static const std::string SOCKET_PATH = "debug_server_test.sock";
+
+/// First instruction of the automated mode of nestest, and one it reaches after 99 instructions
+static constexpr uint16_t START_PC = 0xC000;
+static constexpr uint16_t BREAKPOINT_PC = 0xC821;
+
+/// @brief A reply of the server
+struct Reply
+{
+    uint8_t status = 0;
+    std::vector<uint8_t> payload;
+};
+
+/// @brief Send a request and wait for its reply
+static Reply request(const int fd, const uint8_t command, const std::vector<uint8_t> &payload)
+{
+    std::vector<uint8_t> data(5 + payload.size());
+    data[0] = command;
+    common::put_le(data.data() + 1, payload.size(), 4);
+    std::copy(payload.begin(), payload.end(), data.begin() + 5);
+    CPPUNIT_ASSERT(common::write_all(fd, data.data(), data.size()));
+
+    uint8_t header[5];
+    CPPUNIT_ASSERT(common::read_all(fd, header, sizeof(header)));
+    Reply reply;
+    reply.status = header[0];
+    reply.payload.resize(common::get_le(header + 1, 4));
+    CPPUNIT_ASSERT(common::read_all(fd, reply.payload.data(), reply.payload.size()));
+    return reply;
+}
+
+/// @brief Return a little endian payload
+static std::vector<uint8_t> le(const uint64_t value, const size_t size)
+{
+    std::vector<uint8_t> data(size);
+    common::put_le(data.data(), value, size);
+    return data;
+}
+
+/// @brief Check the state replied by CONTINUE and STEP against the reference NES
+static void check_state(const Reply &reply, const nes::DebugStopReason reason, nes::Nes &reference)
+{
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0, reply.status);
+    CPPUNIT_ASSERT_EQUAL((size_t)27, reply.payload.size());
+    const uint8_t *data = reply.payload.data();
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint8_t>(reason), data[0]);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)reference.get_registers().pc, common::get_le(data + 1, 2));
+    CPPUNIT_ASSERT_EQUAL(reference.get_frame_count(), common::get_le(data + 11, 8));
+    CPPUNIT_ASSERT_EQUAL(reference.get_cycles(), common::get_le(data + 19, 8));
+}
+
+void TestDebugServer::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    nes::Nes reference;
+    CPPUNIT_ASSERT(reference.insert_cartridge("roms/test/nestest/nestest.nes"));
+    reference.override_reset_vector(START_PC);
+    reference.power_on();
+
+    const pid_t server = fork();
+    CPPUNIT_ASSERT(server >= 0);
+    if (server == 0)
+    {
+        _exit(nes::DebugServer(reference, SOCKET_PATH).serve() ? 0 : 1);
+    }
+    int fd = -1;
+    for (int attempt = 0; attempt < 500 && fd < 0; attempt++)
+    {
+        fd = common::connect_unix_socket(SOCKET_PATH);
+        if (fd < 0)
+        {
+            usleep(10000);
+        }
+    }
+    CPPUNIT_ASSERT(fd >= 0);
+
+    // Registers at power on
+    Reply reply = request(fd, static_cast<uint8_t>(nes::DebugCommand::GET_REGISTERS), {});
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0, reply.status);
+    CPPUNIT_ASSERT_EQUAL((size_t)23, reply.payload.size());
+    CPPUNIT_ASSERT_EQUAL((uint64_t)START_PC, common::get_le(reply.payload.data(), 2));
+    CPPUNIT_ASSERT_EQUAL(reference.get_cycles(), common::get_le(reply.payload.data() + 7, 8));
+
+    // Step
+    reply = request(fd, static_cast<uint8_t>(nes::DebugCommand::STEP), le(5, 4));
+    for (int i = 0; i < 5; i++)
+    {
+        CPPUNIT_ASSERT(reference.step());
+    }
+    check_state(reply, nes::DebugStopReason::DONE, reference);
+
+    // Write and read memory, the read covers the whole RAM
+    const std::vector<uint8_t> bytes = {0x12, 0x34, 0x56};
+    std::vector<uint8_t> write = le(0x0300, 2);
+    write.insert(write.end(), bytes.begin(), bytes.end());
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0, request(fd, static_cast<uint8_t>(nes::DebugCommand::WRITE_MEMORY), write).status);
+    reference.poke_range(0x0300, bytes.data(), bytes.size());
+    std::vector<uint8_t> read = le(0x0000, 2);
+    const std::vector<uint8_t> size = le(0x0800, 4);
+    read.insert(read.end(), size.begin(), size.end());
+    reply = request(fd, static_cast<uint8_t>(nes::DebugCommand::READ_MEMORY), read);
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0, reply.status);
+    std::vector<uint8_t> ram(0x0800);
+    reference.peek_range(0x0000, ram.data(), ram.size());
+    CPPUNIT_ASSERT(reply.payload == ram);
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0x34, reply.payload[0x0301]);
+
+    // Set a breakpoint and continue to it
+    reply = request(fd, static_cast<uint8_t>(nes::DebugCommand::ADD_BREAKPOINT), le(BREAKPOINT_PC, 2));
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0, reply.status);
+    reply = request(fd, static_cast<uint8_t>(nes::DebugCommand::CONTINUE), le(10, 4));
+    while (reference.get_registers().pc != BREAKPOINT_PC)
+    {
+        CPPUNIT_ASSERT(reference.step());
+    }
+    check_state(reply, nes::DebugStopReason::BREAKPOINT, reference);
+
+    // Unknown commands and malformed payloads get an error status and no payload, and the connection stays usable
+    reply = request(fd, 0x42, {0x01, 0x02});
+    CPPUNIT_ASSERT_EQUAL((uint8_t)1, reply.status);
+    CPPUNIT_ASSERT(reply.payload.empty());
+    reply = request(fd, static_cast<uint8_t>(nes::DebugCommand::STEP), {0x01});
+    CPPUNIT_ASSERT_EQUAL((uint8_t)1, reply.status);
+    reply = request(fd, static_cast<uint8_t>(nes::DebugCommand::GET_REGISTERS), {});
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0, reply.status);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)BREAKPOINT_PC, common::get_le(reply.payload.data(), 2));
+
+    // A client that stops reading fails the write of its reply, and the server goes on with the next client
+    shutdown(fd, SHUT_RD);
+    const std::vector<uint8_t> registers_request = {static_cast<uint8_t>(nes::DebugCommand::GET_REGISTERS), 0, 0, 0,
+                                                    0};
+    CPPUNIT_ASSERT(common::write_all(fd, registers_request.data(), registers_request.size()));
+    close(fd);
+    fd = common::connect_unix_socket(SOCKET_PATH);
+    CPPUNIT_ASSERT(fd >= 0);
+    reply = request(fd, static_cast<uint8_t>(nes::DebugCommand::GET_REGISTERS), {});
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0, reply.status);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)BREAKPOINT_PC, common::get_le(reply.payload.data(), 2));
+
+    close(fd);
+    // The server stops on SIGTERM and removes its socket
+    kill(server, SIGTERM);
+    int status = 0;
+    CPPUNIT_ASSERT_EQUAL(server, waitpid(server, &status, 0));
+    CPPUNIT_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CPPUNIT_ASSERT(!std::filesystem::exists(SOCKET_PATH));
+    std::cout << "Debug server replies match in-process execution" << std::endl;
+}
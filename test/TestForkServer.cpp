@@ -0,0 +1,131 @@
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "common/Encoding.h"
+#include "common/Logging.h"
+#include "common/Socket.h"
+#include "nes/ForkServer.h"
+#include "nes/Nes.h"
+
+/// Runs a fork server in a child process, sends it input sequences over its socket and checks the responses
+/// against clones of the booted NES run in this process
+
+class TestForkServer : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestForkServer);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestForkServer);
+
+/// Where the server listens
+static const std::string SOCKET_PATH = "fork_server_test.sock";
+
+/// Address of the byte returned as reward
+static constexpr uint16_t REWARD_ADDRESS = 0x0010;
+
+/// Number of frames the NES runs before serving
+static constexpr uint64_t BOOT_FRAMES = 2;
+
+/// @brief What the server answers
+struct Response
+{
+    uint64_t digest = 0;
+    uint64_t frame_count = 0;
+    uint8_t reward = 0;
+    uint8_t ok = 0;
+};
+
+/// @brief Connect to the server, waiting for it to listen, send a request and read the response
+/// @param num_frames Number of frames in the header of the request
+/// @param inputs The inputs sent after the header
+static Response send_request(const uint32_t num_frames, const std::vector<uint8_t> &inputs)
+{
+    int fd = -1;
+    for (int attempt = 0; attempt < 500 && fd < 0; attempt++)
+    {
+        fd = common::connect_unix_socket(SOCKET_PATH);
+        if (fd < 0)
+        {
+            usleep(10000);
+        }
+    }
+    CPPUNIT_ASSERT(fd >= 0);
+
+    uint8_t header[4];
+    common::put_le(header, num_frames, sizeof(header));
+    CPPUNIT_ASSERT(common::write_all(fd, header, sizeof(header)));
+    CPPUNIT_ASSERT(common::write_all(fd, inputs.data(), inputs.size()));
+    uint8_t data[18];
+    CPPUNIT_ASSERT(common::read_all(fd, data, sizeof(data)));
+    close(fd);
+
+    Response response;
+    response.digest = common::get_le(data, 8);
+    response.frame_count = common::get_le(data + 8, 8);
+    response.reward = data[16];
+    response.ok = data[17];
+    return response;
+}
+
+void TestForkServer::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    nes::Nes nes;
+    CPPUNIT_ASSERT(nes.insert_cartridge("roms/test/nestest/nestest.nes"));
+    nes.power_on();
+    for (uint64_t frame = 0; frame < BOOT_FRAMES; frame++)
+    {
+        CPPUNIT_ASSERT(nes.run_frame());
+    }
+
+    const pid_t server = fork();
+    CPPUNIT_ASSERT(server >= 0);
+    if (server == 0)
+    {
+        _exit(nes::ForkServer(nes, SOCKET_PATH, REWARD_ADDRESS).serve() ? 0 : 1);
+    }
+
+    // The same inputs run on a clone here
+    const std::vector<uint8_t> inputs = {0x01, 0x02, 0x04, 0x08, 0x00, 0x80};
+    const Response response = send_request(inputs.size(), inputs);
+    nes::Nes clone = nes.clone();
+    for (const uint8_t buttons : inputs)
+    {
+        clone.set_controller(buttons);
+        CPPUNIT_ASSERT(clone.run_frame());
+    }
+    CPPUNIT_ASSERT_EQUAL((uint8_t)1, response.ok);
+    CPPUNIT_ASSERT_EQUAL(nes::ForkServer::get_ram_digest(clone), response.digest);
+    CPPUNIT_ASSERT_EQUAL(BOOT_FRAMES + inputs.size(), response.frame_count);
+    CPPUNIT_ASSERT_EQUAL(clone.peek(REWARD_ADDRESS), response.reward);
+
+    // Every client starts from the booted state, and requests for too many frames are rejected without running
+    const Response rejected = send_request(nes::ForkServer::MAX_FRAMES + 1, {});
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0, rejected.ok);
+    CPPUNIT_ASSERT_EQUAL(nes::ForkServer::get_ram_digest(nes), rejected.digest);
+    CPPUNIT_ASSERT_EQUAL(BOOT_FRAMES, rejected.frame_count);
+
+    // The server stops on SIGTERM and removes its socket
+    kill(server, SIGTERM);
+    int status = 0;
+    CPPUNIT_ASSERT_EQUAL(server, waitpid(server, &status, 0));
+    CPPUNIT_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CPPUNIT_ASSERT(!std::filesystem::exists(SOCKET_PATH));
+    std::cout << "Fork server responses match in-process runs" << std::endl;
+}
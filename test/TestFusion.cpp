@@ -0,0 +1,182 @@
+#include <array>
+#include <iostream>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "common/Logging.h"
+#include "cpu/MOS6502.h"
+#include "mmio/Bus.h"
+
+/// Runs each pair of instructions the CPU fuses with and without fusion, and checks that both give the same
+/// registers, cycles, instruction count and bus accesses, also when the instruction limit splits a pair
+
+class TestFusion : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestFusion);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestFusion);
+
+/// Where the test programs are loaded
+static constexpr uint16_t PROGRAM_START = 0x0200;
+
+/// @brief An access of the CPU to the bus
+struct BusAccess
+{
+    uint16_t address;
+    uint8_t value;
+    bool write;
+
+    bool operator==(const BusAccess &other) const
+    {
+        return address == other.address && value == other.value && write == other.write;
+    }
+};
+
+/// @brief A flat memory that records every access
+class RecordingBus : public mmio::Bus
+{
+  public:
+    uint8_t get(const uint16_t address) override
+    {
+        accesses.push_back(BusAccess{address, memory[address], false});
+        return memory[address];
+    }
+
+    uint8_t peek(const uint16_t address) const override
+    {
+        return memory[address];
+    }
+
+    void set(const uint16_t address, const uint8_t value) override
+    {
+        accesses.push_back(BusAccess{address, value, true});
+        memory[address] = value;
+    }
+
+    uint32_t get_side_effect_reads() const override
+    {
+        return 0;
+    }
+
+    std::array<uint8_t, 0x10000> memory = {};
+    std::vector<BusAccess> accesses;
+};
+
+/// @brief The outcome of running a program
+struct Run
+{
+    cpu::Registers registers;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t steps;
+    std::vector<BusAccess> accesses;
+};
+
+/// @brief Step a program until the CPU jams or reaches the instruction limit
+/// @param program The program, loaded at PROGRAM_START
+/// @param instruction_fusion Whether pairs of instructions are fused
+/// @param max_instructions The instruction limit, 0 for none
+static Run run_program(const std::vector<uint8_t> &program, const bool instruction_fusion,
+                       const size_t max_instructions)
+{
+    RecordingBus bus;
+    // Operands of the zero page and absolute instructions, the longer programs overwrite the second one
+    bus.memory[0x0010] = 0x80;
+    bus.memory[0x0300] = 0x7F;
+    std::copy(program.begin(), program.end(), bus.memory.begin() + PROGRAM_START);
+    cpu::MOS6502<mmio::Bus> cpu(&bus);
+    cpu.set_registers(cpu::Registers{PROGRAM_START, 0x00, 0x00, 0x00, 0x24, 0xFD});
+    cpu.set_instruction_fusion(instruction_fusion);
+    cpu.set_max_instructions(max_instructions);
+    Run run = {};
+    while ((max_instructions == 0 || cpu.get_instructions() < max_instructions) && cpu.step())
+    {
+        run.steps++;
+    }
+    run.registers = cpu.get_registers();
+    run.cycles = cpu.get_cycles();
+    run.instructions = cpu.get_instructions();
+    run.accesses = bus.accesses;
+    return run;
+}
+
+/// @brief Run a program with and without fusion, up to its end and up to every instruction limit before it
+/// @return The number of steps that executed two instructions
+static uint64_t compare_program(const std::vector<uint8_t> &program)
+{
+    const Run reference = run_program(program, false, 0);
+    const Run fused = run_program(program, true, 0);
+    CPPUNIT_ASSERT_EQUAL(reference.instructions, reference.steps + 1);
+    for (size_t max_instructions = 1; max_instructions <= reference.instructions; max_instructions++)
+    {
+        const Run ref = run_program(program, false, max_instructions);
+        const Run out = run_program(program, true, max_instructions);
+        CPPUNIT_ASSERT(ref.registers.pc == out.registers.pc && ref.registers.acc == out.registers.acc &&
+                       ref.registers.xr == out.registers.xr && ref.registers.yr == out.registers.yr &&
+                       ref.registers.sr == out.registers.sr && ref.registers.sp == out.registers.sp);
+        CPPUNIT_ASSERT_EQUAL(ref.cycles, out.cycles);
+        CPPUNIT_ASSERT_EQUAL(max_instructions, out.instructions);
+        CPPUNIT_ASSERT(ref.accesses == out.accesses);
+    }
+    CPPUNIT_ASSERT(fused.accesses == reference.accesses);
+    return reference.steps - fused.steps;
+}
+
+void TestFusion::test(void)
+{
+    // Pairs are only fused when the debug log is muted
+    common::mute();
+    std::cout << std::endl;
+
+    // LDX #$03 / loop: DEX / BNE loop / KIL
+    CPPUNIT_ASSERT(compare_program({0xA2, 0x03, 0xCA, 0xD0, 0xFD, 0x02}) > 0);
+
+    // LDY #$03 / loop: DEY / BNE loop / DEY / BEQ +0 / KIL, the last DEY is not followed by BNE
+    CPPUNIT_ASSERT(compare_program({0xA0, 0x03, 0x88, 0xD0, 0xFD, 0x88, 0xF0, 0x00, 0x02}) > 0);
+
+    // LDX #$FD / loop: INX / BNE loop / KIL
+    CPPUNIT_ASSERT(compare_program({0xA2, 0xFD, 0xE8, 0xD0, 0xFD, 0x02}) > 0);
+
+    // LDY #$FD / loop: INY / BNE loop / KIL
+    CPPUNIT_ASSERT(compare_program({0xA0, 0xFD, 0xC8, 0xD0, 0xFD, 0x02}) > 0);
+
+    // LDA #$05 / CMP #$05 / BEQ +1 / KIL / CMP #$04 / BNE +1 / KIL / CMP #$06 / BNE +0 / KIL
+    CPPUNIT_ASSERT(compare_program({0xA9, 0x05, 0xC9, 0x05, 0xF0, 0x01, 0x02, 0xC9, 0x04, 0xD0, 0x01, 0x02, 0xC9,
+                                    0x06, 0xD0, 0x00, 0x02}) > 0);
+
+    // LDA #$42 / STA $11 / LDA $10 / STA $0301 / LDA $0300 / STA $12 / LDA $11 / TAX / KIL
+    CPPUNIT_ASSERT(compare_program({0xA9, 0x42, 0x85, 0x11, 0xA5, 0x10, 0x8D, 0x01, 0x03, 0xAD, 0x00, 0x03, 0x85,
+                                    0x12, 0xA5, 0x11, 0xAA, 0x02}) > 0);
+
+    // loop: INC $10 / BNE loop / KIL, from $80 to $00
+    CPPUNIT_ASSERT(compare_program({0xE6, 0x10, 0xD0, 0xFC, 0x02}) > 0);
+
+    // CLC / ADC #$10 / CLC / ADC $10 / CLC / ADC $0300 / CLC / ADC $10,X / KIL, with carries and overflows
+    CPPUNIT_ASSERT(compare_program({0x18, 0x69, 0x10, 0x18, 0x65, 0x10, 0x18, 0x6D, 0x00, 0x03, 0x18, 0x75, 0x10,
+                                    0x02}) > 0);
+
+    // LDX #$02 / JMP loop / ... / loop: NOP / DEX / BNE loop / KIL, the branch at $02FE crosses back from $0300
+    std::vector<uint8_t> page_crossing(0x103, 0xEA);
+    page_crossing[0x00] = 0xA2;
+    page_crossing[0x01] = 0x02;
+    page_crossing[0x02] = 0x4C;
+    page_crossing[0x03] = 0xFC;
+    page_crossing[0x04] = 0x02;
+    page_crossing[0xFC] = 0xEA;
+    page_crossing[0xFD] = 0xCA;
+    page_crossing[0xFE] = 0xD0;
+    page_crossing[0xFF] = 0xFC;
+    page_crossing[0x100] = 0x02;
+    CPPUNIT_ASSERT(compare_program(page_crossing) > 0);
+
+    std::cout << "Fused pairs match the instructions executed one by one" << std::endl;
+}
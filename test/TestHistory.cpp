@@ -0,0 +1,138 @@
+#include <iostream>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "nes/History.h"
+#include "nes/Nes.h"
+
+/// Checks that going back in the history of nestest restores exactly the state the forward run had, and that
+/// reverse-continue finds the previous hits of a breakpoint
+
+class TestHistory : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestHistory);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestHistory);
+
+/// Size of the CPU RAM
+static constexpr uint16_t RAM_SIZE = 0x0800;
+
+/// State of the NES after an instruction
+struct State
+{
+    cpu::Registers registers;
+    uint64_t cycles;
+    uint64_t ram_hash;
+};
+
+/// @brief Return the state of a NES
+static State get_state(nes::Nes &nes)
+{
+    uint8_t ram[RAM_SIZE];
+    nes.peek_range(0, ram, sizeof(ram));
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const uint8_t value : ram)
+    {
+        hash = (hash ^ value) * 0x100000001B3ULL;
+    }
+    return State{nes.get_registers(), nes.get_cycles(), hash};
+}
+
+/// @brief Check that a NES is in the recorded state
+static void check_state(nes::Nes &nes, const State &expected)
+{
+    const State state = get_state(nes);
+    CPPUNIT_ASSERT_EQUAL(expected.registers.pc, state.registers.pc);
+    CPPUNIT_ASSERT_EQUAL(expected.registers.acc, state.registers.acc);
+    CPPUNIT_ASSERT_EQUAL(expected.registers.xr, state.registers.xr);
+    CPPUNIT_ASSERT_EQUAL(expected.registers.yr, state.registers.yr);
+    CPPUNIT_ASSERT_EQUAL(expected.registers.sr, state.registers.sr);
+    CPPUNIT_ASSERT_EQUAL(expected.registers.sp, state.registers.sp);
+    CPPUNIT_ASSERT_EQUAL(expected.cycles, state.cycles);
+    CPPUNIT_ASSERT_EQUAL(expected.ram_hash, state.ram_hash);
+}
+
+void TestHistory::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    nes::Nes nes;
+    CPPUNIT_ASSERT(nes.insert_cartridge("roms/test/nestest/nestest.nes"));
+    nes.override_reset_vector(0xC000);
+    nes::Nes reference = nes.clone();
+    nes.power_on();
+    reference.power_on();
+
+    // A snapshot every 1000 cycles, only the last 8 are kept
+    nes::History history(nes, 1000, 8);
+    const uint64_t start = nes.get_instructions();
+    std::vector<State> states{get_state(nes)};
+    for (size_t instruction = 0; instruction < 5000; instruction++)
+    {
+        if (instruction == 4000)
+        {
+            history.set_controller(0x81);
+        }
+        CPPUNIT_ASSERT(history.step());
+        states.push_back(get_state(nes));
+    }
+    CPPUNIT_ASSERT_EQUAL((size_t)8, history.get_snapshot_count());
+    const uint64_t oldest = history.get_oldest_instruction();
+    CPPUNIT_ASSERT(oldest > start);
+
+    // Step back, then to an instruction right after the oldest snapshot
+    CPPUNIT_ASSERT(history.step_back());
+    check_state(nes, states[4999]);
+    CPPUNIT_ASSERT(history.seek(oldest + 10));
+    check_state(nes, states[oldest + 10 - start]);
+    CPPUNIT_ASSERT(!history.seek(oldest - 1));
+    CPPUNIT_ASSERT(!history.seek(oldest + 11));
+
+    // Run forward again, recording a new history
+    while (nes.get_instructions() < start + 5000)
+    {
+        CPPUNIT_ASSERT(history.step());
+    }
+    check_state(nes, states[5000]);
+
+    // The breakpoint at $F8D9 was hit in the last snapshots, twice
+    debug::Breakpoints &breakpoints = nes.get_breakpoints();
+    breakpoints.add_breakpoint(0xF8D9);
+    nes.arm_breakpoints();
+    for (size_t hit = 0; hit < 2; hit++)
+    {
+        size_t expected = nes.get_instructions() - start;
+        do
+        {
+            expected--;
+        } while (states[expected].registers.pc != 0xF8D9);
+
+        CPPUNIT_ASSERT(history.reverse_continue());
+        CPPUNIT_ASSERT(breakpoints.get_stop().reason == debug::StopReason::BREAKPOINT);
+        CPPUNIT_ASSERT_EQUAL((uint16_t)0xF8D9, breakpoints.get_stop().pc);
+        CPPUNIT_ASSERT_EQUAL(start + expected, nes.get_instructions());
+        check_state(nes, states[expected]);
+    }
+
+    // Resumed from there, nestest ends as if it never went back. It jams before the end of the first frame
+    breakpoints.resume();
+    nes.disarm_breakpoints();
+    nes.run_frame();
+    reference.run_frame();
+    for (uint16_t address = 0; address < RAM_SIZE; address++)
+    {
+        CPPUNIT_ASSERT(nes.peek(address) == reference.peek(address));
+    }
+
+    std::cout << "Went back up to " << start + 5000 - oldest << " instructions in nestest" << std::endl;
+}
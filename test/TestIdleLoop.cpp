@@ -0,0 +1,169 @@
+#include <iostream>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "common/Logging.h"
+#include "cpu/MOS6502.h"
+#include "mmio/FlatBus.h"
+#include "mmio/Mmio.h"
+
+/// Checks that fast-forwarding idle loops gives exactly the same state as executing every instruction
+
+class TestIdleLoop : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestIdleLoop);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestIdleLoop);
+
+/// Where the test programs are loaded
+static constexpr uint16_t PROGRAM_START = 0x0200;
+
+/// Cycle count the programs run until
+static constexpr uint64_t TARGET_CYCLE = 100003;
+
+/// @brief Run a program until the target cycle
+/// @param program The program, loaded at PROGRAM_START
+/// @param idle_loop_skipping Whether idle loops are fast-forwarded
+/// @param bus The bus, which keeps the final memory state
+/// @param target_cycle The cycle count to run until
+/// @param instruction_fusion Whether pairs of instructions are fused
+/// @return The CPU after running
+static cpu::MOS6502<mmio::FlatBus> run_program(const std::vector<uint8_t> &program, const bool idle_loop_skipping,
+                                               mmio::FlatBus &bus, const uint64_t target_cycle,
+                                               const bool instruction_fusion)
+{
+    for (size_t i = 0; i < program.size(); i++)
+    {
+        bus.set(PROGRAM_START + i, program[i]);
+    }
+    cpu::MOS6502<mmio::FlatBus> cpu(&bus);
+    cpu.set_registers(cpu::Registers{PROGRAM_START, 0x00, 0x00, 0x00, 0x24, 0xFD});
+    cpu.set_idle_loop_skipping(idle_loop_skipping);
+    cpu.set_instruction_fusion(instruction_fusion);
+    CPPUNIT_ASSERT(cpu.run_until(target_cycle));
+    return cpu;
+}
+
+/// @brief Run a program with and without fast-forward and compare the results
+/// @param program The program, loaded at PROGRAM_START
+/// @param target_cycle The cycle count to run until
+/// @param instruction_fusion Whether pairs of instructions are fused
+/// @return The number of instructions skipped by the fast-forward
+static uint64_t compare_program(const std::vector<uint8_t> &program, const uint64_t target_cycle = TARGET_CYCLE,
+                                const bool instruction_fusion = false)
+{
+    mmio::FlatBus reference_bus;
+    mmio::FlatBus bus;
+    cpu::MOS6502<mmio::FlatBus> reference =
+        run_program(program, false, reference_bus, target_cycle, instruction_fusion);
+    cpu::MOS6502<mmio::FlatBus> cpu = run_program(program, true, bus, target_cycle, instruction_fusion);
+
+    cpu::Registers ref = reference.get_registers();
+    cpu::Registers out = cpu.get_registers();
+    CPPUNIT_ASSERT(ref.pc == out.pc && ref.acc == out.acc && ref.xr == out.xr && ref.yr == out.yr &&
+                   ref.sr == out.sr && ref.sp == out.sp);
+    CPPUNIT_ASSERT_EQUAL(reference.get_cycles(), cpu.get_cycles());
+    CPPUNIT_ASSERT_EQUAL(reference.get_instructions(), cpu.get_instructions());
+    for (uint32_t address = 0; address < 0x10000; address++)
+    {
+        CPPUNIT_ASSERT(reference_bus.peek(address) == bus.peek(address));
+    }
+    CPPUNIT_ASSERT_EQUAL((uint64_t)0, reference.get_skipped_instructions());
+    return cpu.get_skipped_instructions();
+}
+
+/// @brief Run a program from the CPU RAM of the NES memory map until the target cycle
+/// @param program The program, loaded at PROGRAM_START
+/// @param idle_loop_skipping Whether idle loops are fast-forwarded
+/// @param mmio The memory map, which keeps the final memory state
+/// @return The CPU after running
+static cpu::MOS6502<mmio::Mmio> run_nes_program(const std::vector<uint8_t> &program, const bool idle_loop_skipping,
+                                                mmio::Mmio &mmio)
+{
+    mmio.poke_range(PROGRAM_START, program.data(), program.size());
+    cpu::MOS6502<mmio::Mmio> cpu(&mmio);
+    cpu.set_registers(cpu::Registers{PROGRAM_START, 0x00, 0x00, 0x00, 0x24, 0xFD});
+    cpu.set_idle_loop_skipping(idle_loop_skipping);
+    CPPUNIT_ASSERT(cpu.run_until(TARGET_CYCLE));
+    return cpu;
+}
+
+void TestIdleLoop::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    // loop: LDA $10 / BPL loop, polling a flag that never changes
+    CPPUNIT_ASSERT(compare_program({0xA5, 0x10, 0x10, 0xFC}) > 0);
+
+    // loop: JMP loop
+    CPPUNIT_ASSERT(compare_program({0x4C, 0x00, 0x02}) > 0);
+
+    // loop: BIT $10 / NOP / BVC loop, three instructions per iteration
+    CPPUNIT_ASSERT(compare_program({0x24, 0x10, 0xEA, 0x50, 0xFB}) > 0);
+
+    // loop: INC $10 / JMP loop writes to memory, so it is not idle
+    CPPUNIT_ASSERT_EQUAL((uint64_t)0, compare_program({0xE6, 0x10, 0x4C, 0x00, 0x02}));
+
+    // loop: INX / BNE loop, followed by JMP to itself: the state changes until X wraps around
+    CPPUNIT_ASSERT(compare_program({0xE8, 0xD0, 0xFD, 0x4C, 0x03, 0x02}) > 0);
+
+    // loop: 7 NOP / CMP #$01 / BNE +0 / JMP loop has too many instructions to be idle, even though the fused
+    // CMP and BNE take the count from 7 to 9 in one step
+    const std::vector<uint8_t> long_loop = {0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA,
+                                            0xC9, 0x01, 0xD0, 0x00, 0x4C, 0x00, 0x02};
+    CPPUNIT_ASSERT_EQUAL((uint64_t)0, compare_program(long_loop, TARGET_CYCLE, true));
+
+    // Targets that fall inside the first iteration, which runs normally to measure the loop
+    for (uint64_t target_cycle = 1; target_cycle < 20; target_cycle++)
+    {
+        compare_program({0x4C, 0x00, 0x02}, target_cycle);
+        compare_program({0x24, 0x10, 0xEA, 0x50, 0xFB}, target_cycle);
+    }
+
+    // loop: LDA $4016 / AND #1 / BEQ loop, then JMP to itself. Each read of the controller port shifts out the
+    // next button, so the loop is not idle and ends once the ones shifted in after the buttons reach bit 0
+    const std::vector<uint8_t> controller_loop = {0xAD, 0x16, 0x40, 0x29, 0x01, 0xF0, 0xF9, 0x4C, 0x07, 0x02};
+    mmio::Mmio reference_mmio;
+    mmio::Mmio mmio;
+    cpu::MOS6502<mmio::Mmio> reference = run_nes_program(controller_loop, false, reference_mmio);
+    cpu::MOS6502<mmio::Mmio> cpu = run_nes_program(controller_loop, true, mmio);
+    const cpu::Registers ref = reference.get_registers();
+    const cpu::Registers out = cpu.get_registers();
+    CPPUNIT_ASSERT_EQUAL((uint16_t)0x0207, ref.pc);
+    CPPUNIT_ASSERT_EQUAL((uint16_t)0x0207, out.pc);
+    CPPUNIT_ASSERT(ref.acc == out.acc && ref.xr == out.xr && ref.yr == out.yr && ref.sr == out.sr);
+    CPPUNIT_ASSERT_EQUAL(reference.get_cycles(), cpu.get_cycles());
+    CPPUNIT_ASSERT_EQUAL(reference.get_instructions(), cpu.get_instructions());
+    // Only the final JMP is fast-forwarded
+    CPPUNIT_ASSERT(cpu.get_skipped_instructions() > 0);
+
+    // loop: LDA $2002 / BPL loop, waiting for the vertical blank. The status register reads the same until the
+    // next event, so the wait is fast-forwarded, also through a mirror of the register: BIT $3FFA / BPL loop
+    for (const std::vector<uint8_t> &vblank_loop :
+         {std::vector<uint8_t>{0xAD, 0x02, 0x20, 0x10, 0xFB}, std::vector<uint8_t>{0x2C, 0xFA, 0x3F, 0x10, 0xFB}})
+    {
+        mmio::Mmio vblank_reference_mmio;
+        mmio::Mmio vblank_mmio;
+        cpu::MOS6502<mmio::Mmio> vblank_reference = run_nes_program(vblank_loop, false, vblank_reference_mmio);
+        cpu::MOS6502<mmio::Mmio> vblank_cpu = run_nes_program(vblank_loop, true, vblank_mmio);
+        const cpu::Registers vblank_ref = vblank_reference.get_registers();
+        const cpu::Registers vblank_out = vblank_cpu.get_registers();
+        CPPUNIT_ASSERT(vblank_ref.pc == vblank_out.pc && vblank_ref.acc == vblank_out.acc &&
+                       vblank_ref.sr == vblank_out.sr);
+        CPPUNIT_ASSERT_EQUAL(vblank_reference.get_cycles(), vblank_cpu.get_cycles());
+        CPPUNIT_ASSERT_EQUAL(vblank_reference.get_instructions(), vblank_cpu.get_instructions());
+        CPPUNIT_ASSERT(vblank_cpu.get_skipped_instructions() > 0);
+    }
+
+    std::cout << "Idle loop fast-forward matches full execution" << std::endl;
+}
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "common/Logging.h"
+#include "cpu/Lockstep.h"
+#include "cpu/MOS6502.h"
+
+/// Checks that every lane of the lockstep engine ends in exactly the same state as the scalar interpreter
+/// running the same program from the same initial state on its own
+
+class TestLockstep : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestLockstep);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestLockstep);
+
+/// Number of lanes tested
+static constexpr size_t LANES = 16;
+
+/// Size of the PRG ROM of the test programs
+static constexpr size_t PRG_ROM_SIZE = 0x4000;
+
+/// Cycle count the programs run until
+static constexpr uint64_t TARGET_CYCLE = 20000;
+
+/// @brief Run a ROM in all the lanes from random registers and RAM, and compare every lane with the interpreter
+/// @return The number of instructions executed by the vector path
+static uint64_t compare_rom(const std::vector<uint8_t> &prg_rom, const uint16_t start, const uint32_t seed)
+{
+    std::mt19937 random(seed);
+    cpu::Lockstep<LANES> lockstep(prg_rom);
+    std::vector<std::vector<uint8_t>> references_ram(LANES, std::vector<uint8_t>(0x0800));
+    std::vector<cpu::LockstepBus> references_bus;
+    std::vector<cpu::MOS6502<mmio::Bus>> references;
+    references_bus.reserve(LANES);
+    references.reserve(LANES);
+
+    for (size_t lane = 0; lane < LANES; lane++)
+    {
+        for (auto &byte : references_ram[lane])
+        {
+            byte = random() & 0xFF;
+        }
+        cpu::Registers registers{start,
+                                 (uint8_t)random(),
+                                 (uint8_t)random(),
+                                 (uint8_t)random(),
+                                 (uint8_t)(random() | 0x20),
+                                 (uint8_t)random()};
+        lockstep.set_lane(lane, registers, references_ram[lane].data());
+
+        references_bus.emplace_back(references_ram[lane].data(), 1, &prg_rom);
+        references.emplace_back(&references_bus[lane]);
+        references[lane].set_registers(registers);
+        references[lane].set_idle_loop_skipping(false);
+        references[lane].run_until(TARGET_CYCLE);
+    }
+
+    lockstep.run_until(TARGET_CYCLE);
+
+    for (size_t lane = 0; lane < LANES; lane++)
+    {
+        cpu::Registers ref = references[lane].get_registers();
+        cpu::Registers out = lockstep.get_registers(lane);
+        CPPUNIT_ASSERT(ref.pc == out.pc && ref.acc == out.acc && ref.xr == out.xr && ref.yr == out.yr &&
+                       ref.sr == out.sr && ref.sp == out.sp);
+        CPPUNIT_ASSERT_EQUAL(references[lane].get_cycles(), lockstep.get_cycles(lane));
+        CPPUNIT_ASSERT_EQUAL(references[lane].is_jammed(), lockstep.is_jammed(lane));
+        for (uint16_t address = 0; address < 0x0800; address++)
+        {
+            CPPUNIT_ASSERT(references_ram[lane][address] == lockstep.peek(lane, address));
+        }
+    }
+    return lockstep.get_vector_instructions();
+}
+
+void TestLockstep::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    // A loop whose branches depend on the data of every lane, with a subroutine that uses the stack
+    std::vector<uint8_t> prg_rom(PRG_ROM_SIZE, 0xEA);
+    const std::vector<uint8_t> program = {
+        0xA2, 0x00,       // $C000: LDX #$00
+        0xA5, 0x10,       // $C002: LDA $10
+        0x18,             // $C004: CLC
+        0x65, 0x11,       // $C005: ADC $11
+        0x85, 0x10,       // $C007: STA $10
+        0xC9, 0x80,       // $C009: CMP #$80
+        0x90, 0x02,       // $C00B: BCC $C00F
+        0xE6, 0x12,       // $C00D: INC $12
+        0x06, 0x13,       // $C00F: ASL $13
+        0x6A,             // $C011: ROR A
+        0x4D, 0x00, 0x03, // $C012: EOR $0300
+        0x8D, 0x00, 0x03, // $C015: STA $0300
+        0xCA,             // $C018: DEX
+        0xD0, 0xE7,       // $C019: BNE $C002
+        0xE9, 0x07,       // $C01B: SBC #$07
+        0x24, 0x14,       // $C01D: BIT $14
+        0x20, 0x30, 0xC0, // $C01F: JSR $C030
+        0x4C, 0x02, 0xC0, // $C022: JMP $C002
+    };
+    const std::vector<uint8_t> subroutine = {
+        0x48,       // $C030: PHA
+        0xA4, 0x15, // $C031: LDY $15
+        0x68,       // $C033: PLA
+        0x60,       // $C034: RTS
+    };
+    std::copy(program.begin(), program.end(), prg_rom.begin());
+    std::copy(subroutine.begin(), subroutine.end(), prg_rom.begin() + 0x30);
+    const uint64_t vector_instructions = compare_rom(prg_rom, 0xC000, 1);
+    CPPUNIT_ASSERT(vector_instructions > 0);
+    std::cout << "Lockstep loop: " << vector_instructions << " instructions executed by the vector path"
+              << std::endl;
+
+    // Random ROMs, where the lanes diverge and jam quickly
+    std::mt19937 random(2);
+    for (uint32_t seed = 0; seed < 8; seed++)
+    {
+        for (auto &byte : prg_rom)
+        {
+            byte = random() & 0xFF;
+        }
+        compare_rom(prg_rom, 0x8000 + (random() & 0x3FFF), seed);
+    }
+    std::cout << "Lockstep lanes match the interpreter" << std::endl;
+}
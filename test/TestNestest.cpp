@@ -4,6 +4,9 @@
 #include "cppunit/TestFixture.h"
 #include "cppunit/extensions/HelperMacros.h"
 
+#include "common/MappedFile.h"
+#include "cpu/TraceFormatter.h"
+#include "debug/TraceDiff.h"
 #include "nes/Nes.h"
 
 class TestNestest : public CppUnit::TestFixture
@@ -26,7 +29,7 @@ void TestNestest::test(void)
     std::string rom_filename = "roms/test/nestest/nestest.nes";
     std::string ref_filename = "roms/test/nestest/nestest.log";
     std::string out_filename = "nestest.output.log";
-    const size_t max_instructions = 5003;
+    const size_t max_instructions = 8991;
 
     // Create and configure all the elements in the emulator
     nes::Nes nes;
@@ -38,39 +41,23 @@ void TestNestest::test(void)
     // Run
     nes.init();
 
-    // Read both files, keeping only a fixed amount of characters per line
+    // Compare both files up to the stack pointer and from the cycle count, the emulator has no PPU position
     const size_t num_characters = 73;
-    std::ifstream ref_file(ref_filename);
-    std::ifstream out_file(out_filename);
-    std::string out_string, ref_string;
-    for (size_t i = 0; i < max_instructions; i++)
+    common::MappedFile ref_file, out_file;
+    CPPUNIT_ASSERT(ref_file.open(ref_filename));
+    CPPUNIT_ASSERT(out_file.open(out_filename));
+    const debug::TraceDiff diff({debug::ColumnRange{0, num_characters}, debug::ColumnRange{cpu::TRACE_CYCLES_OFFSET}});
+    const debug::TraceDiffResult result = diff.compare(ref_file.get_text(), out_file.get_text(), 1);
+    if (!result.divergences.empty())
     {
-        // Read a new line from reference and output file
-        if (!std::getline(ref_file, ref_string))
-        {
-            std::cout << "Test is supposed to run until instruction " << max_instructions << " but line " << i + 1
-                      << " was not found in the reference file" << std::endl;
-            CPPUNIT_ASSERT(false);
-            return;
-        }
-        if (!std::getline(out_file, out_string))
-        {
-            std::cout << "Line number " << i + 1 << " is found in reference file and not in output file" << std::endl;
-            CPPUNIT_ASSERT(false);
-            return;
-        }
-
-        // Cut the lines to the required width
-        out_string = out_string.substr(0, num_characters);
-        ref_string = ref_string.substr(0, num_characters);
-
-        if (ref_string != out_string)
-        {
-            std::cout << "Line number " << i + 1 << " does not match" << std::endl;
-            std::cout << "Ref line: " << ref_string << std::endl;
-            std::cout << "Out line: " << out_string << std::endl;
-            CPPUNIT_ASSERT(false);
-        }
+        const debug::TraceDivergence &divergence = result.divergences.front();
+        std::cout << "Line number " << divergence.line << " does not match" << std::endl;
+        std::cout << "Ref line: " << debug::TraceDiff::get_line(ref_file.get_text(), divergence.offsets[0])
+                  << std::endl;
+        std::cout << "Out line: " << debug::TraceDiff::get_line(out_file.get_text(), divergence.offsets[1])
+                  << std::endl;
+        CPPUNIT_ASSERT(false);
     }
+    CPPUNIT_ASSERT_EQUAL((uint64_t)max_instructions, result.lines);
     std::cout << "Tested " << max_instructions << " lines of nestest.log" << std::endl;
-}
\ No newline at end of file
+}
@@ -0,0 +1,144 @@
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "Cartridge.h"
+#include "common/MappedFile.h"
+#include "nes/Nes.h"
+
+/// Runs a small program that uses the PRG RAM of a cartridge, and checks that its battery save survives from one
+/// run to the next while copies of the NES leave it alone
+
+class TestPrgRam : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestPrgRam);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestPrgRam);
+
+/// LDA #$42, STA $6000, INC $7FFF, LDA $6800, STA $00 and an endless JMP, at $C000
+static const std::vector<uint8_t> PROGRAM = {0xA9, 0x42, 0x8D, 0x00, 0x60, 0xEE, 0xFF, 0x7F,
+                                             0xAD, 0x00, 0x68, 0x85, 0x00, 0x4C, 0x0D, 0xC0};
+
+/// Number of instructions of the program until it loops
+static constexpr size_t NUM_INSTRUCTIONS = 6;
+
+/// @brief Run the program on a NES
+static void run_program(nes::Nes &nes)
+{
+    nes.set_max_instructions(NUM_INSTRUCTIONS);
+    nes.override_reset_vector(0xC000);
+    nes.init();
+}
+
+/// @brief Return the contents of the save file
+static std::vector<uint8_t> read_save(const std::string &filename)
+{
+    common::MappedFile file;
+    CPPUNIT_ASSERT(file.open(filename));
+    return std::vector<uint8_t>(file.data(), file.data() + file.size());
+}
+
+void TestPrgRam::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    const std::string rom_filename = "battery.nes";
+    const std::string save_filename = "battery.sav";
+    std::filesystem::remove(save_filename);
+    test::write_cartridge(rom_filename, PROGRAM, 0x02);
+
+    // The first run creates the save, written when the NES is destroyed
+    {
+        nes::Nes nes;
+        CPPUNIT_ASSERT(nes.insert_cartridge(rom_filename));
+        CPPUNIT_ASSERT(nes.has_battery());
+        CPPUNIT_ASSERT(nes.set_save_filename(save_filename));
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x00, nes.peek(0x6000));
+        run_program(nes);
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x42, nes.peek(0x6000));
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x01, nes.peek(0x7FFF));
+        // 8 KB, so $6800 is not a mirror of $6000
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x00, nes.peek(0x0000));
+    }
+    std::vector<uint8_t> save = read_save(save_filename);
+    CPPUNIT_ASSERT_EQUAL((size_t)0x2000, save.size());
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0x42, save[0x0000]);
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0x01, save[0x1FFF]);
+
+    // Inserting another cartridge writes the save of the previous one before clearing its PRG RAM
+    std::filesystem::remove(save_filename);
+    {
+        nes::Nes nes;
+        CPPUNIT_ASSERT(nes.insert_cartridge(rom_filename));
+        CPPUNIT_ASSERT(nes.set_save_filename(save_filename));
+        run_program(nes);
+        CPPUNIT_ASSERT(nes.insert_cartridge("roms/test/nestest/nestest.nes"));
+        CPPUNIT_ASSERT(read_save(save_filename) == save);
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x00, nes.peek(0x6000));
+    }
+
+    // The second run starts from the save, and its copies do not write to it
+    {
+        nes::Nes nes;
+        CPPUNIT_ASSERT(nes.insert_cartridge(rom_filename));
+        CPPUNIT_ASSERT(nes.set_save_filename(save_filename));
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x42, nes.peek(0x6000));
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x01, nes.peek(0x7FFF));
+        {
+            nes::Nes copy = nes.clone();
+            run_program(copy);
+            CPPUNIT_ASSERT_EQUAL((uint8_t)0x02, copy.peek(0x7FFF));
+        }
+        CPPUNIT_ASSERT(read_save(save_filename) == save);
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x01, nes.peek(0x7FFF));
+
+        // A snapshot brings its own PRG RAM back, and the save follows it
+        nes::Machine state;
+        nes.save_state(state);
+        run_program(nes);
+        CPPUNIT_ASSERT(nes.flush_save_file());
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x02, read_save(save_filename)[0x1FFF]);
+        nes.load_state(state);
+        CPPUNIT_ASSERT(nes.flush_save_file());
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x01, read_save(save_filename)[0x1FFF]);
+    }
+
+    // A NES 2.0 cartridge with 2 KB of battery backed PRG RAM, mirrored over the 8 KB area
+    test::write_cartridge(rom_filename, PROGRAM, 0x02, 0x08, 0x50);
+    std::filesystem::remove(save_filename);
+    {
+        nes::Nes nes;
+        CPPUNIT_ASSERT(nes.insert_cartridge(rom_filename));
+        CPPUNIT_ASSERT(nes.set_save_filename(save_filename));
+        run_program(nes);
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x42, nes.peek(0x6800));
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x42, nes.peek(0x0000));
+        CPPUNIT_ASSERT_EQUAL((uint8_t)0x01, nes.peek(0x67FF));
+    }
+    save = read_save(save_filename);
+    CPPUNIT_ASSERT_EQUAL((size_t)0x0800, save.size());
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0x01, save[0x07FF]);
+
+    // Without a battery there is PRG RAM, but no save
+    nes::Nes nestest;
+    CPPUNIT_ASSERT(nestest.insert_cartridge("roms/test/nestest/nestest.nes"));
+    CPPUNIT_ASSERT(!nestest.has_battery());
+    CPPUNIT_ASSERT(!nestest.set_save_filename(save_filename));
+
+    std::filesystem::remove(rom_filename);
+    std::filesystem::remove(save_filename);
+
+    std::cout << "Battery save kept across runs" << std::endl;
+}
@@ -0,0 +1,78 @@
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "Cartridge.h"
+#include "common/Logging.h"
+#include "nes/Nes.h"
+#include "nes/RomCache.h"
+
+/// Checks that the instances that insert the same cartridge share one ROM image, and that the image is released
+/// with the last of them and loaded again by the next one
+
+class TestRomCache : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestRomCache);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestRomCache);
+
+/// The cartridge shared by the instances
+static const std::string NESTEST = "roms/test/nestest/nestest.nes";
+
+void TestRomCache::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    nes::RomCache &cache = nes::RomCache::get_instance();
+    const size_t initial_size = cache.size();
+    const std::string other_filename = "rom_cache.nes";
+    // A single NOP, so that it differs from nestest
+    test::write_cartridge(other_filename, {0xEA});
+
+    std::weak_ptr<const nes::RomImage> released;
+    {
+        nes::Nes first;
+        nes::Nes second;
+        nes::Nes other;
+        CPPUNIT_ASSERT(first.get_rom_image() == nullptr);
+        CPPUNIT_ASSERT(first.insert_cartridge(NESTEST));
+        CPPUNIT_ASSERT(second.insert_cartridge(NESTEST));
+        CPPUNIT_ASSERT(other.insert_cartridge(other_filename));
+
+        // Both instances that loaded nestest from the file hold the same image, and so does a clone
+        const nes::Nes clone = first.clone();
+        CPPUNIT_ASSERT(first.get_rom_image() == second.get_rom_image());
+        CPPUNIT_ASSERT(clone.get_rom_image() == first.get_rom_image());
+        CPPUNIT_ASSERT(other.get_rom_image() != first.get_rom_image());
+        CPPUNIT_ASSERT_EQUAL((long)4, first.get_rom_image().use_count());
+        CPPUNIT_ASSERT_EQUAL(initial_size + 2, cache.size());
+        released = first.get_rom_image();
+    }
+
+    // The last instance took the images with it
+    CPPUNIT_ASSERT(released.expired());
+    CPPUNIT_ASSERT_EQUAL(initial_size, cache.size());
+
+    // The next instance loads the image again
+    nes::Nes reloaded;
+    CPPUNIT_ASSERT(reloaded.insert_cartridge(NESTEST));
+    CPPUNIT_ASSERT(reloaded.get_rom_image() != nullptr);
+    CPPUNIT_ASSERT_EQUAL((long)2, reloaded.get_rom_image().use_count());
+    CPPUNIT_ASSERT_EQUAL((size_t)0x4000, reloaded.get_prg_rom_size());
+    CPPUNIT_ASSERT_EQUAL(initial_size + 1, cache.size());
+
+    std::filesystem::remove(other_filename);
+    std::cout << "ROM images shared and released" << std::endl;
+}
@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "common/Logging.h"
+#include "cpu/MOS6502.h"
+#include "mmio/Bus.h"
+
+/// Runs the single step test vectors in the ProcessorTests format (one JSON file per opcode, each one
+/// containing an array of tests with the initial state, the final state and the bus activity of every
+/// cycle). Every JSON file found under the test directory is run, so the complete suite can be dropped
+/// there, or a subset of it copied with ./emunesprocessortests; sample.json is a small hand checked sample.
+
+class TestSingleStep : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestSingleStep);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestSingleStep);
+
+/// @brief Minimal JSON value, enough for the test vectors (objects, arrays, strings and numbers)
+struct JsonValue
+{
+    enum class Type
+    {
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    Type type = Type::NUMBER;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    /// @brief Return the member of an object with the given key
+    const JsonValue &at(const std::string &key) const
+    {
+        for (const auto &member : object)
+        {
+            if (member.first == key)
+            {
+                return member.second;
+            }
+        }
+        throw std::out_of_range("JSON key not found: " + key);
+    }
+};
+
+/// @brief Recursive descent parser for JsonValue
+class JsonParser
+{
+  public:
+    JsonParser(const std::string &text) : text(text)
+    {
+    }
+
+    JsonValue parse()
+    {
+        skip_whitespace();
+        JsonValue result;
+        char c = text.at(position);
+        if (c == '{')
+        {
+            result.type = JsonValue::Type::OBJECT;
+            position++;
+            skip_whitespace();
+            while (text.at(position) != '}')
+            {
+                std::string key = parse().string;
+                skip_whitespace();
+                expect(':');
+                result.object.emplace_back(key, parse());
+                skip_separator('}');
+            }
+            position++;
+        }
+        else if (c == '[')
+        {
+            result.type = JsonValue::Type::ARRAY;
+            position++;
+            skip_whitespace();
+            while (text.at(position) != ']')
+            {
+                result.array.push_back(parse());
+                skip_separator(']');
+            }
+            position++;
+        }
+        else if (c == '"')
+        {
+            result.type = JsonValue::Type::STRING;
+            size_t end = text.find('"', position + 1);
+            result.string = text.substr(position + 1, end - position - 1);
+            position = end + 1;
+        }
+        else
+        {
+            result.type = JsonValue::Type::NUMBER;
+            size_t length = 0;
+            result.number = std::stod(text.substr(position, 32), &length);
+            position += length;
+        }
+        return result;
+    }
+
+  private:
+    const std::string &text;
+    size_t position = 0;
+
+    void skip_whitespace()
+    {
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position])))
+        {
+            position++;
+        }
+    }
+
+    void expect(const char c)
+    {
+        if (text.at(position) != c)
+        {
+            throw std::runtime_error(std::string("Malformed JSON, expected ") + c);
+        }
+        position++;
+    }
+
+    void skip_separator(const char closing)
+    {
+        skip_whitespace();
+        if (text.at(position) == ',')
+        {
+            position++;
+            skip_whitespace();
+        }
+        else if (text.at(position) != closing)
+        {
+            throw std::runtime_error(std::string("Malformed JSON, expected , or ") + closing);
+        }
+    }
+};
+
+/// @brief One cycle of bus activity
+struct BusCycle
+{
+    uint16_t address;
+    uint8_t value;
+    bool write;
+
+    bool operator==(const BusCycle &other) const
+    {
+        return address == other.address && value == other.value && write == other.write;
+    }
+};
+
+/// @brief Flat 64 KB memory that records every access, in place of the NES memory map
+class RecordingBus : public mmio::Bus
+{
+  public:
+    uint8_t get(const uint16_t address) override
+    {
+        cycles.push_back(BusCycle{address, memory[address], false});
+        return memory[address];
+    }
+
+    uint8_t peek(const uint16_t address) const override
+    {
+        return memory[address];
+    }
+
+    void set(const uint16_t address, const uint8_t value) override
+    {
+        cycles.push_back(BusCycle{address, value, true});
+        memory[address] = value;
+    }
+
+    uint32_t get_side_effect_reads() const override
+    {
+        return 0;
+    }
+
+    std::array<uint8_t, 0x10000> memory = {};
+    std::vector<BusCycle> cycles;
+};
+
+/// @brief Bits 4 and 5 of the status register do not exist in the chip, so they are not compared
+static constexpr uint8_t STATUS_MASK = 0xCF;
+
+/// @brief Format a cycle list for the failure messages
+static std::string print_cycles(const std::vector<BusCycle> &cycles)
+{
+    std::string result;
+    for (const auto &cycle : cycles)
+    {
+        result += common::print_hex(cycle.address, sizeof(cycle.address)) + ":" +
+                  common::print_hex(cycle.value, sizeof(cycle.value)) + (cycle.write ? "w " : "r ");
+    }
+    return result;
+}
+
+/// @brief Run one test vector
+/// @return An empty string if it passes, or the reason of the failure
+static std::string run_single_step(const JsonValue &test)
+{
+    const JsonValue &initial = test.at("initial");
+    const JsonValue &final = test.at("final");
+
+    auto bus = std::make_shared<RecordingBus>();
+    for (const auto &entry : initial.at("ram").array)
+    {
+        bus->memory[(uint16_t)entry.array[0].number] = (uint8_t)entry.array[1].number;
+    }
+
+    cpu::MOS6502<mmio::Bus> cpu(bus.get());
+    cpu.set_registers(cpu::Registers{(uint16_t)initial.at("pc").number, (uint8_t)initial.at("a").number,
+                                     (uint8_t)initial.at("x").number, (uint8_t)initial.at("y").number,
+                                     (uint8_t)initial.at("p").number, (uint8_t)initial.at("s").number});
+    cpu.step();
+
+    // Registers
+    cpu::Registers registers = cpu.get_registers();
+    std::stringstream failure;
+    if (registers.pc != (uint16_t)final.at("pc").number || registers.acc != (uint8_t)final.at("a").number ||
+        registers.xr != (uint8_t)final.at("x").number || registers.yr != (uint8_t)final.at("y").number ||
+        (registers.sr & STATUS_MASK) != ((uint8_t)final.at("p").number & STATUS_MASK) ||
+        registers.sp != (uint8_t)final.at("s").number)
+    {
+        failure << "registers PC:" << common::print_hex(registers.pc, sizeof(registers.pc))
+                << " A:" << common::print_hex(registers.acc, sizeof(registers.acc))
+                << " X:" << common::print_hex(registers.xr, sizeof(registers.xr))
+                << " Y:" << common::print_hex(registers.yr, sizeof(registers.yr))
+                << " P:" << common::print_hex(registers.sr, sizeof(registers.sr))
+                << " SP:" << common::print_hex(registers.sp, sizeof(registers.sp));
+        return failure.str();
+    }
+
+    // Memory
+    for (const auto &entry : final.at("ram").array)
+    {
+        uint16_t address = (uint16_t)entry.array[0].number;
+        if (bus->memory[address] != (uint8_t)entry.array[1].number)
+        {
+            failure << "memory at " << common::print_hex(address, sizeof(address));
+            return failure.str();
+        }
+    }
+
+    // Bus activity, cycle by cycle
+    std::vector<BusCycle> expected_cycles;
+    for (const auto &entry : test.at("cycles").array)
+    {
+        expected_cycles.push_back(BusCycle{(uint16_t)entry.array[0].number, (uint8_t)entry.array[1].number,
+                                           entry.array[2].string == "write"});
+    }
+    if (expected_cycles != bus->cycles)
+    {
+        failure << "bus cycles, expected " << print_cycles(expected_cycles) << "got " << print_cycles(bus->cycles);
+        return failure.str();
+    }
+
+    return "";
+}
+
+/// @brief Result of running all the vectors of one file
+struct FileResult
+{
+    std::string filename;
+    size_t num_tests = 0;
+    size_t num_failures = 0;
+    std::string first_failure;
+};
+
+/// @brief Run all the vectors in a file
+static FileResult run_file(const std::filesystem::path &filename)
+{
+    FileResult result;
+    result.filename = filename.string();
+
+    std::ifstream file(filename);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+    JsonValue tests = JsonParser(text).parse();
+
+    for (const auto &test : tests.array)
+    {
+        result.num_tests++;
+        std::string failure = run_single_step(test);
+        if (!failure.empty())
+        {
+            if (result.num_failures == 0)
+            {
+                result.first_failure = test.at("name").string + ": " + failure;
+            }
+            result.num_failures++;
+        }
+    }
+
+    return result;
+}
+
+void TestSingleStep::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    const std::filesystem::path test_directory = "roms/test/ProcessorTests";
+    std::vector<std::filesystem::path> filenames;
+    if (std::filesystem::is_directory(test_directory))
+    {
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(test_directory))
+        {
+            if (entry.path().extension() == ".json")
+            {
+                filenames.push_back(entry.path());
+            }
+        }
+    }
+    std::sort(filenames.begin(), filenames.end());
+    CPPUNIT_ASSERT(!filenames.empty());
+
+    // Every file (one opcode) is independent, so run them in parallel
+    const size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<FileResult> results;
+    for (size_t first = 0; first < filenames.size(); first += num_threads)
+    {
+        std::vector<std::future<FileResult>> futures;
+        for (size_t i = first; i < std::min(first + num_threads, filenames.size()); i++)
+        {
+            futures.push_back(std::async(std::launch::async, run_file, filenames[i]));
+        }
+        for (auto &future : futures)
+        {
+            results.push_back(future.get());
+        }
+    }
+
+    size_t num_tests = 0;
+    size_t num_failures = 0;
+    for (const auto &result : results)
+    {
+        num_tests += result.num_tests;
+        num_failures += result.num_failures;
+        if (result.num_failures > 0)
+        {
+            std::cout << result.filename << ": " << result.num_failures << " of " << result.num_tests
+                      << " failed, first one " << result.first_failure << std::endl;
+        }
+    }
+    std::cout << "Tested " << num_tests << " single step vectors in " << filenames.size() << " files" << std::endl;
+    CPPUNIT_ASSERT(num_failures == 0);
+}
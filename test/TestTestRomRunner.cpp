@@ -0,0 +1,107 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "Cartridge.h"
+#include "common/Logging.h"
+#include "nes/TestRomRunner.h"
+
+/// Runs small ROMs that report their result the way blargg's test ROMs do, in parallel, and checks what the runner
+/// makes of them
+
+class TestTestRomRunner : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestTestRomRunner);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestTestRomRunner);
+
+/// @brief Write a cartridge running a program at $C000 that counts its runs in $6010 and asks for a reset until it
+/// has been reset the provided number of times, then copies a text to $6004 and reports a result code
+/// @param filename Where the cartridge is written
+/// @param resets Number of resets asked for
+/// @param code Result code
+/// @param text Text of the result
+static void write_test_rom(const std::filesystem::path &filename, const uint8_t resets, const uint8_t code,
+                           const std::string &text)
+{
+    std::vector<uint8_t> program = {
+        0xEE, 0x10, 0x60,                                                             // INC $6010
+        0xA9, 0xDE, 0x8D, 0x01, 0x60, 0xA9, 0xB0, 0x8D, 0x02, 0x60, 0xA9, 0x61, 0x8D, // Signature in $6001-$6003
+        0x03, 0x60,                                                                   //
+        0xAD, 0x10, 0x60, 0xC9, static_cast<uint8_t>(resets + 1), 0xB0, 0x07,         // Enough resets? BCS $C020
+        0xA9, 0x81, 0x8D, 0x00, 0x60, 0xD0, 0xFE,                                     // Ask for a reset and wait
+        0xA9, 0x80, 0x8D, 0x00, 0x60,                                                 // $C020: running
+        0xA2, 0x00, 0xBD, 0x40, 0xC0, 0x9D, 0x04, 0x60, 0xF0, 0x04, 0xE8, 0x4C, 0x27, // Copy the text from $C040
+        0xC0,                                                                         //
+        0xA9, code, 0x8D, 0x00, 0x60, 0x4C, 0x38, 0xC0};                              // Report and loop
+    // The text follows at $C040
+    program.resize(0x40);
+    program.insert(program.end(), text.begin(), text.end());
+    test::write_cartridge(filename, program, 0x02);
+}
+
+void TestTestRomRunner::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    const std::filesystem::path directory = "test_roms";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "sub");
+    write_test_rom(directory / "1_pass.nes", 0, 0, "Passed\n");
+    write_test_rom(directory / "sub" / "2_fail.nes", 0, 3, "Failed #3\n");
+    write_test_rom(directory / "3_reset.nes", 2, 0, "Passed after reset\n");
+    write_test_rom(directory / "4_timeout.nes", 0xFE, 0, "");
+    std::ofstream(directory / "5_empty.nes").close();
+    std::ofstream(directory / "notes.txt").close();
+
+    const std::vector<std::filesystem::path> roms = nes::TestRomRunner::find_roms(directory);
+    CPPUNIT_ASSERT_EQUAL((size_t)5, roms.size());
+    CPPUNIT_ASSERT(roms[0] == directory / "1_pass.nes");
+    CPPUNIT_ASSERT(roms[4] == directory / "sub" / "2_fail.nes");
+
+    nes::TestRomRunner runner(4, 60);
+    const std::vector<nes::TestRomResult> results = runner.run_all(roms);
+    CPPUNIT_ASSERT_EQUAL((size_t)5, results.size());
+
+    CPPUNIT_ASSERT(results[0].status == nes::TestRomStatus::PASSED);
+    CPPUNIT_ASSERT_EQUAL((uint8_t)0, results[0].code);
+    CPPUNIT_ASSERT(results[0].text == "Passed\n");
+    CPPUNIT_ASSERT_EQUAL((uint64_t)1, results[0].frames);
+
+    // Each reset waits for 100 ms
+    CPPUNIT_ASSERT(results[1].status == nes::TestRomStatus::PASSED);
+    CPPUNIT_ASSERT(results[1].text == "Passed after reset\n");
+    CPPUNIT_ASSERT(results[1].frames > 12 && results[1].frames < 20);
+
+    CPPUNIT_ASSERT(results[2].status == nes::TestRomStatus::TIMEOUT);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)60, results[2].frames);
+
+    CPPUNIT_ASSERT(results[3].status == nes::TestRomStatus::ERROR);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)0, results[3].frames);
+
+    CPPUNIT_ASSERT(results[4].filename == roms[4]);
+    CPPUNIT_ASSERT(results[4].status == nes::TestRomStatus::FAILED);
+    CPPUNIT_ASSERT_EQUAL((uint8_t)3, results[4].code);
+    CPPUNIT_ASSERT(results[4].text == "Failed #3\n");
+
+    // nestest does not report anything in $6000
+    const nes::TestRomResult nestest = runner.run("roms/test/nestest/nestest.nes");
+    CPPUNIT_ASSERT(nestest.status == nes::TestRomStatus::NO_STATUS);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)60, nestest.frames);
+
+    std::filesystem::remove_all(directory);
+    std::cout << "Test ROM results read from $6000" << std::endl;
+}
@@ -0,0 +1,159 @@
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "common/MappedFile.h"
+#include "cpu/TraceFormatter.h"
+#include "debug/TraceDiff.h"
+#include "nes/Nes.h"
+
+/// Checks that the trace windows and filters keep exactly the lines of nestest.log they select
+
+class TestTraceControl : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestTraceControl);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestTraceControl);
+
+/// Number of characters of a line up to the stack pointer, the PPU position that follows is not traced
+static constexpr size_t NUM_CHARACTERS = 73;
+
+/// Number of instructions of nestest.log
+static constexpr size_t MAX_INSTRUCTIONS = 8991;
+
+/// A line of nestest.log, with the fields the windows look at
+struct ReferenceLine
+{
+    std::string text;
+    uint16_t pc;
+    uint64_t cycles;
+};
+
+/// @brief Read the lines of nestest.log
+static std::vector<ReferenceLine> read_reference()
+{
+    common::MappedFile file;
+    CPPUNIT_ASSERT(file.open("roms/test/nestest/nestest.log"));
+    const std::string_view text = file.get_text();
+    std::vector<ReferenceLine> lines;
+    for (size_t offset = 0; offset < text.size(); offset = debug::TraceDiff::get_next_line(text, offset))
+    {
+        const std::string line(debug::TraceDiff::get_line(text, offset));
+        const size_t cycles = line.find("CYC:");
+        CPPUNIT_ASSERT(cycles != std::string::npos);
+        const uint16_t pc = std::stoul(line.substr(0, 4), nullptr, 16);
+        const std::string text = line.substr(0, NUM_CHARACTERS) +
+                                 std::string(cpu::TRACE_CYCLES_OFFSET - NUM_CHARACTERS, ' ') + line.substr(cycles);
+        lines.push_back(ReferenceLine{text, pc, std::stoull(line.substr(cycles + 4))});
+    }
+    return lines;
+}
+
+/// @brief Run nestest with a trace control configured by the provided function, and return the trace
+static std::vector<std::string> run_trace(const std::function<void(nes::Nes &, debug::TraceControl &)> &configure)
+{
+    const std::string out_filename = "nestest.window.log";
+    nes::Nes nes;
+    nes.set_log_filename(out_filename);
+    CPPUNIT_ASSERT(nes.insert_cartridge("roms/test/nestest/nestest.nes"));
+    nes.set_max_instructions(MAX_INSTRUCTIONS);
+    nes.override_reset_vector(0xC000);
+    configure(nes, nes.get_trace_control());
+    nes.init();
+
+    common::MappedFile file;
+    CPPUNIT_ASSERT(file.open(out_filename));
+    const std::string_view text = file.get_text();
+    std::vector<std::string> lines;
+    for (size_t offset = 0; offset < text.size(); offset = debug::TraceDiff::get_next_line(text, offset))
+    {
+        lines.emplace_back(debug::TraceDiff::get_line(text, offset));
+    }
+    std::filesystem::remove(out_filename);
+    return lines;
+}
+
+/// @brief Check a trace against the lines of the reference selected by a predicate
+static void check_trace(const std::vector<std::string> &trace, const std::vector<ReferenceLine> &reference,
+                        const std::function<bool(size_t)> &selected)
+{
+    std::vector<std::string> expected;
+    for (size_t line = 0; line < reference.size(); line++)
+    {
+        if (selected(line))
+        {
+            expected.push_back(reference[line].text);
+        }
+    }
+    CPPUNIT_ASSERT(!expected.empty());
+    CPPUNIT_ASSERT_EQUAL(expected.size(), trace.size());
+    for (size_t line = 0; line < trace.size(); line++)
+    {
+        CPPUNIT_ASSERT(expected[line] == trace[line]);
+    }
+}
+
+void TestTraceControl::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+    const std::vector<ReferenceLine> reference = read_reference();
+    CPPUNIT_ASSERT_EQUAL(MAX_INSTRUCTIONS, reference.size());
+
+    // From a pc to the instruction that writes to $0300, the STA $0300 of line 1081
+    std::vector<std::string> trace = run_trace([](nes::Nes &, debug::TraceControl &trace_control) {
+        trace_control.set_window({debug::TraceEvent::PC, 0xCFC7}, {debug::TraceEvent::WRITE, 0x0300});
+    });
+    check_trace(trace, reference, [](size_t line) { return line >= 1078 && line < 1081; });
+
+    // A cycle window, the end is not included
+    trace = run_trace([](nes::Nes &, debug::TraceControl &trace_control) {
+        trace_control.set_window({debug::TraceEvent::CYCLE, 2479}, {debug::TraceEvent::CYCLE, 2535});
+    });
+    check_trace(trace, reference, [&reference](size_t line) {
+        return reference[line].cycles >= 2479 && reference[line].cycles < 2535;
+    });
+
+    // Every call of a routine, from its entry to its RTS
+    trace = run_trace([](nes::Nes &, debug::TraceControl &trace_control) {
+        trace_control.set_window({debug::TraceEvent::PC, 0xF931}, {debug::TraceEvent::PC, 0xF936}, true);
+    });
+    bool open = false;
+    std::vector<bool> in_routine;
+    for (const ReferenceLine &line : reference)
+    {
+        open = open || line.pc == 0xF931;
+        in_routine.push_back(open);
+        open = open && line.pc != 0xF936;
+    }
+    check_trace(trace, reference, [&in_routine](size_t line) { return in_routine[line]; });
+    std::cout << "Traced " << trace.size() << " lines in calls to $F931" << std::endl;
+
+    // Filters by pc range and by bank. The 16 KB of nestest are mirrored at $8000 and $C000, so they are bank 0,
+    // and the few instructions it runs from RAM are in no bank
+    trace = run_trace([](nes::Nes &, debug::TraceControl &trace_control) {
+        trace_control.add_pc_range(0xC000, 0xC7FF);
+    });
+    check_trace(trace, reference,
+                [&reference](size_t line) { return reference[line].pc >= 0xC000 && reference[line].pc <= 0xC7FF; });
+    trace = run_trace([](nes::Nes &nes, debug::TraceControl &trace_control) {
+        trace_control.add_bank(0, nes.get_prg_rom_size());
+    });
+    check_trace(trace, reference, [&reference](size_t line) { return reference[line].pc >= 0x8000; });
+    trace = run_trace([](nes::Nes &nes, debug::TraceControl &trace_control) {
+        trace_control.add_bank(1, nes.get_prg_rom_size());
+    });
+    CPPUNIT_ASSERT(trace.empty());
+}
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "debug/TraceDiff.h"
+
+/// Compares small traces and checks where the divergences are reported, with different line endings, traces of
+/// different lengths and the lines around a divergence
+
+class TestTraceDiff : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestTraceDiff);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestTraceDiff);
+
+void TestTraceDiff::test(void)
+{
+    std::cout << std::endl;
+
+    // The first divergence, and only it when asked for one
+    const std::string a = "C000 A:00 PPU:1\nC002 A:01 PPU:2\nC004 A:02 PPU:3\nC006 A:03 PPU:4\n";
+    const std::string b = "C000 A:00 PPU:1\nC002 A:01 PPU:2\nC004 A:FF PPU:3\nC006 A:03 PPU:9\n";
+    const debug::TraceDiff all_columns;
+    debug::TraceDiffResult result = all_columns.compare(a, b, 1);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, result.divergences.size());
+    CPPUNIT_ASSERT_EQUAL((uint64_t)3, result.divergences[0].line);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)3, result.lines);
+    CPPUNIT_ASSERT(debug::TraceDiff::get_line(a, result.divergences[0].offsets[0]) == "C004 A:02 PPU:3");
+    CPPUNIT_ASSERT(debug::TraceDiff::get_line(b, result.divergences[0].offsets[1]) == "C004 A:FF PPU:3");
+    result = all_columns.compare(a, b, 10);
+    CPPUNIT_ASSERT_EQUAL((size_t)2, result.divergences.size());
+    CPPUNIT_ASSERT_EQUAL((uint64_t)4, result.divergences[1].line);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)4, result.lines);
+
+    // Only the compared columns matter
+    const debug::TraceDiff registers({debug::ColumnRange{0, 9}});
+    result = registers.compare(a, b, 10);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, result.divergences.size());
+    CPPUNIT_ASSERT_EQUAL((uint64_t)3, result.divergences[0].line);
+    const debug::TraceDiff address({debug::ColumnRange{0, 4}});
+    CPPUNIT_ASSERT(address.compare(a, b, 10).divergences.empty());
+
+    // CRLF matches LF, with or without a line ending at the end of the trace
+    std::string crlf = "C000 A:00 PPU:1\r\nC002 A:01 PPU:2\r\nC004 A:02 PPU:3\r\nC006 A:03 PPU:4";
+    result = all_columns.compare(a, crlf, 10);
+    CPPUNIT_ASSERT(result.divergences.empty());
+    CPPUNIT_ASSERT_EQUAL((uint64_t)4, result.lines);
+    crlf += "\r\n";
+    CPPUNIT_ASSERT(all_columns.compare(crlf, a, 10).divergences.empty());
+
+    // A trace that ends first diverges at the line after its end, the offset of the ended one is its size
+    const std::string shorter = "C000 A:00 PPU:1\nC002 A:01 PPU:2\n";
+    result = all_columns.compare(a, shorter, 10);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, result.divergences.size());
+    CPPUNIT_ASSERT_EQUAL((uint64_t)3, result.divergences[0].line);
+    CPPUNIT_ASSERT(debug::TraceDiff::get_line(a, result.divergences[0].offsets[0]) == "C004 A:02 PPU:3");
+    CPPUNIT_ASSERT_EQUAL(shorter.size(), result.divergences[0].offsets[1]);
+    result = all_columns.compare("", a, 10);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)1, result.divergences[0].line);
+    CPPUNIT_ASSERT_EQUAL((size_t)0, result.divergences[0].offsets[0]);
+
+    // A line shorter than a range only matches an equally short one
+    const debug::TraceDiff long_range({debug::ColumnRange{0, 20}});
+    CPPUNIT_ASSERT(long_range.matches("C000 A:00", "C000 A:00"));
+    CPPUNIT_ASSERT(!long_range.matches("C000 A:00", "C000 A:00 PPU:1"));
+    CPPUNIT_ASSERT(debug::TraceDiff({debug::ColumnRange{20}}).matches("C000", "C002"));
+
+    // The lines before a divergence, walking back to the first one, with both line endings
+    for (const std::string_view trace : {std::string_view(a), std::string_view(crlf)})
+    {
+        result = all_columns.compare(trace, b, 1);
+        size_t offset = result.divergences[0].offsets[0];
+        offset = debug::TraceDiff::get_previous_line(trace, offset);
+        CPPUNIT_ASSERT(debug::TraceDiff::get_line(trace, offset) == "C002 A:01 PPU:2");
+        offset = debug::TraceDiff::get_previous_line(trace, offset);
+        CPPUNIT_ASSERT_EQUAL((size_t)0, offset);
+        CPPUNIT_ASSERT(debug::TraceDiff::get_line(trace, offset) == "C000 A:00 PPU:1");
+        CPPUNIT_ASSERT_EQUAL((size_t)0, debug::TraceDiff::get_previous_line(trace, offset));
+        // From the end of the trace, the previous line is the last one
+        offset = debug::TraceDiff::get_previous_line(trace, trace.size());
+        CPPUNIT_ASSERT(debug::TraceDiff::get_line(trace, offset) == "C006 A:03 PPU:4");
+    }
+
+    std::cout << "Trace divergences found and reported with their context" << std::endl;
+}
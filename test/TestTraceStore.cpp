@@ -0,0 +1,154 @@
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "common/MappedFile.h"
+#include "debug/TraceDiff.h"
+#include "debug/TraceStore.h"
+#include "nes/Nes.h"
+
+/// Records nestest in a trace store, checks its instructions against nestest.log, and checks that the queries
+/// return the same rows as a linear scan while decoding fewer blocks
+
+class TestTraceStore : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestTraceStore);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestTraceStore);
+
+/// Number of instructions of nestest.log
+static constexpr size_t MAX_INSTRUCTIONS = 8991;
+
+/// Small blocks, so that the index has something to rule out in a short trace
+static constexpr size_t BLOCK_ROWS = 256;
+
+/// @brief Return the rows of a query
+static std::vector<debug::TraceRow> run_query(const debug::TraceStoreReader &reader, const debug::TraceQuery &query,
+                                              debug::TraceQueryStats &stats)
+{
+    std::vector<debug::TraceRow> rows;
+    CPPUNIT_ASSERT(reader.query(
+        query,
+        [&rows](const debug::TraceRow &row) {
+            rows.push_back(row);
+            return true;
+        },
+        &stats));
+    CPPUNIT_ASSERT_EQUAL((uint64_t)rows.size(), stats.rows);
+    return rows;
+}
+
+/// @brief Check that a query returns the rows of a linear scan, and return how many blocks it decoded
+static size_t check_query(const debug::TraceStoreReader &reader, const std::vector<debug::TraceRow> &all_rows,
+                          const debug::TraceQuery &query)
+{
+    std::vector<debug::TraceRow> expected;
+    for (const debug::TraceRow &row : all_rows)
+    {
+        if (((query.kinds >> static_cast<uint8_t>(row.kind)) & 0x1) && row.pc >= query.first_pc &&
+            row.pc <= query.last_pc && row.address >= query.first_address && row.address <= query.last_address &&
+            row.cycle >= query.first_cycle && row.cycle <= query.last_cycle)
+        {
+            expected.push_back(row);
+        }
+    }
+    debug::TraceQueryStats stats;
+    const std::vector<debug::TraceRow> rows = run_query(reader, query, stats);
+    CPPUNIT_ASSERT(!expected.empty());
+    CPPUNIT_ASSERT_EQUAL(expected.size(), rows.size());
+    for (size_t row = 0; row < rows.size(); row++)
+    {
+        CPPUNIT_ASSERT_EQUAL(expected[row].cycle, rows[row].cycle);
+        CPPUNIT_ASSERT_EQUAL(expected[row].address, rows[row].address);
+        CPPUNIT_ASSERT(expected[row].kind == rows[row].kind);
+    }
+    return stats.blocks;
+}
+
+void TestTraceStore::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    const std::string store_filename = "nestest.ets";
+    nes::Nes nes;
+    CPPUNIT_ASSERT(nes.insert_cartridge("roms/test/nestest/nestest.nes"));
+    CPPUNIT_ASSERT(nes.set_trace_store_filename(store_filename, BLOCK_ROWS));
+    nes.set_max_instructions(MAX_INSTRUCTIONS);
+    nes.override_reset_vector(0xC000);
+    nes.init();
+    CPPUNIT_ASSERT(nes.close_trace_store());
+
+    debug::TraceStoreReader reader;
+    CPPUNIT_ASSERT(reader.open(store_filename));
+    debug::TraceQueryStats stats;
+    const std::vector<debug::TraceRow> all_rows = run_query(reader, debug::TraceQuery(), stats);
+    CPPUNIT_ASSERT_EQUAL(reader.get_row_count(), (uint64_t)all_rows.size());
+    CPPUNIT_ASSERT_EQUAL(reader.get_block_count(), stats.blocks);
+
+    // The instructions match nestest.log: pc, opcode and cycle
+    debug::TraceQuery instructions;
+    instructions.kinds = 1 << static_cast<uint8_t>(debug::AccessKind::EXECUTE);
+    const std::vector<debug::TraceRow> executed = run_query(reader, instructions, stats);
+    CPPUNIT_ASSERT_EQUAL(MAX_INSTRUCTIONS, executed.size());
+    common::MappedFile log_file;
+    CPPUNIT_ASSERT(log_file.open("roms/test/nestest/nestest.log"));
+    const std::string_view log = log_file.get_text();
+    size_t offset = 0;
+    for (const debug::TraceRow &row : executed)
+    {
+        const std::string line(debug::TraceDiff::get_line(log, offset));
+        CPPUNIT_ASSERT_EQUAL((unsigned long)row.pc, std::stoul(line.substr(0, 4), nullptr, 16));
+        CPPUNIT_ASSERT_EQUAL((unsigned long)row.opcode, std::stoul(line.substr(6, 2), nullptr, 16));
+        CPPUNIT_ASSERT_EQUAL((unsigned long long)row.cycle, std::stoull(line.substr(line.find("CYC:") + 4)));
+        offset = debug::TraceDiff::get_next_line(log, offset);
+    }
+
+    // Who wrote to $0300: the STA $0300 of line 1081 of nestest.log is among them
+    debug::TraceQuery writes;
+    writes.first_address = 0x0300;
+    writes.last_address = 0x0300;
+    writes.kinds = 1 << static_cast<uint8_t>(debug::AccessKind::WRITE);
+    const std::vector<debug::TraceRow> writers = run_query(reader, writes, stats);
+    bool found = false;
+    for (const debug::TraceRow &row : writers)
+    {
+        found = found || (row.pc == 0xCFCC && row.opcode == 0x8D && row.value == 0x5B && row.cycle == 2529);
+    }
+    CPPUNIT_ASSERT(found);
+    CPPUNIT_ASSERT(check_query(reader, all_rows, writes) < reader.get_block_count());
+
+    // Reads of a page, a routine and a cycle window
+    debug::TraceQuery reads;
+    reads.first_address = 0x0200;
+    reads.last_address = 0x02FF;
+    reads.kinds = 1 << static_cast<uint8_t>(debug::AccessKind::READ);
+    CPPUNIT_ASSERT(check_query(reader, all_rows, reads) < reader.get_block_count());
+    debug::TraceQuery routine;
+    routine.first_pc = 0xF931;
+    routine.last_pc = 0xF936;
+    check_query(reader, all_rows, routine);
+    debug::TraceQuery window;
+    window.first_cycle = 10000;
+    window.last_cycle = 12000;
+    CPPUNIT_ASSERT(check_query(reader, all_rows, window) < reader.get_block_count());
+
+    // The columns take much less than the rows they hold
+    const uint64_t raw_size = all_rows.size() * (8 + 2 + 2 + 1 + 1 + 1);
+    const uint64_t store_size = std::filesystem::file_size(store_filename);
+    CPPUNIT_ASSERT(store_size * 2 < raw_size);
+    std::filesystem::remove(store_filename);
+    std::cout << "Stored " << all_rows.size() << " rows in " << store_size << " bytes, " << writers.size()
+              << " writes to $0300" << std::endl;
+}
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cppunit/TestCase.h"
+#include "cppunit/TestFixture.h"
+#include "cppunit/extensions/HelperMacros.h"
+
+#include "Cartridge.h"
+#include "common/Logging.h"
+#include "nes/Nes.h"
+#include "nes/VecEnv.h"
+#include "nes/VecEnvC.h"
+
+/// Steps a vectorised environment on several threads through its C interface, and checks every observation,
+/// reward and done flag against NES instances run one by one with the same inputs
+
+class TestVecEnv : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestVecEnv);
+    CPPUNIT_TEST(test);
+    CPPUNIT_TEST_SUITE_END();
+
+  public:
+    void test(void);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestVecEnv);
+
+/// At $C000, in a loop: strobe the controller, jam the CPU if A is pressed, otherwise store B in $11 and
+/// increment the reward in $10
+static const std::vector<uint8_t> PROGRAM = {0xA9, 0x01, 0x8D, 0x16, 0x40, 0xA9, 0x00, 0x8D, 0x16, 0x40,
+                                             0xAD, 0x16, 0x40, 0x29, 0x01, 0xD0, 0x0A, 0xAD, 0x16, 0x40,
+                                             0x85, 0x11, 0xE6, 0x10, 0x4C, 0x00, 0xC0, 0x02};
+
+/// Address of the reward
+static constexpr uint16_t REWARD_ADDRESS = 0x0010;
+
+/// Number of instances and threads
+static constexpr size_t NUM_ENVS = 8;
+static constexpr size_t NUM_THREADS = 4;
+
+/// Number of steps run
+static constexpr size_t NUM_STEPS = 40;
+
+/// @brief Return the buttons of an instance at a step: B changes often, A is pressed now and then
+static uint8_t get_action(const size_t env, const size_t step)
+{
+    const bool a = (env + step) % 7 == 3;
+    const bool b = (env * 3 + step) % 2 == 1;
+    return (a ? 0x01 : 0x00) | (b ? 0x02 : 0x00);
+}
+
+void TestVecEnv::test(void)
+{
+    common::mute();
+    std::cout << std::endl;
+
+    const std::string rom_filename = "vec_env.nes";
+    test::write_cartridge(rom_filename, PROGRAM);
+
+    emunes_vec_env *vec_env = emunes_vec_env_create(rom_filename.c_str(), REWARD_ADDRESS, NUM_THREADS);
+    CPPUNIT_ASSERT(vec_env != nullptr);
+    CPPUNIT_ASSERT_EQUAL(nes::VecEnv::RAM_SIZE, emunes_vec_env_ram_size());
+    std::vector<uint8_t> ram(NUM_ENVS * nes::VecEnv::RAM_SIZE);
+    std::vector<uint8_t> rewards(NUM_ENVS);
+    std::vector<uint8_t> dones(NUM_ENVS);
+    emunes_vec_env_set_buffers(vec_env, ram.data(), rewards.data(), dones.data());
+    CPPUNIT_ASSERT_EQUAL(1, emunes_vec_env_reset(vec_env, NUM_ENVS));
+
+    // The reference instances, loaded on their own
+    nes::Nes initial;
+    CPPUNIT_ASSERT(initial.insert_cartridge(rom_filename));
+    initial.power_on();
+    std::vector<nes::Nes> references(NUM_ENVS, initial);
+
+    size_t num_dones = 0;
+    std::vector<uint8_t> actions(NUM_ENVS);
+    std::vector<uint8_t> expected_ram(nes::VecEnv::RAM_SIZE);
+    for (size_t step = 0; step <= NUM_STEPS; step++)
+    {
+        // Step 0 checks the observations of the reset
+        if (step > 0)
+        {
+            for (size_t env = 0; env < NUM_ENVS; env++)
+            {
+                actions[env] = get_action(env, step);
+            }
+            CPPUNIT_ASSERT_EQUAL(1, emunes_vec_env_step(vec_env, actions.data()));
+        }
+
+        for (size_t env = 0; env < NUM_ENVS; env++)
+        {
+            nes::Nes &reference = references[env];
+            bool done = false;
+            if (step > 0)
+            {
+                reference.set_controller(actions[env]);
+                done = !reference.run_frame();
+            }
+            reference.peek_range(0, expected_ram.data(), expected_ram.size());
+            CPPUNIT_ASSERT(std::equal(expected_ram.begin(), expected_ram.end(),
+                                      ram.begin() + env * nes::VecEnv::RAM_SIZE));
+            CPPUNIT_ASSERT_EQUAL(reference.peek(REWARD_ADDRESS), rewards[env]);
+            CPPUNIT_ASSERT_EQUAL((uint8_t)done, dones[env]);
+
+            // A finished instance reports its last state and starts again from the power on state
+            if (done)
+            {
+                reference = initial;
+                num_dones++;
+            }
+        }
+    }
+    CPPUNIT_ASSERT(num_dones > 0);
+    emunes_vec_env_destroy(vec_env);
+    std::filesystem::remove(rom_filename);
+
+    std::cout << "Stepped " << NUM_ENVS << " instances " << NUM_STEPS << " times, " << num_dones << " episodes ended"
+              << std::endl;
+}
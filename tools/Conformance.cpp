@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/Logging.h"
+#include "nes/TestRomRunner.h"
+
+/// Run test ROMs that report their result in $6000, such as blargg's instr_test, each on its own NES and several at
+/// the same time, and print whether each passed:
+/// ./emunesconformance [-j threads] [-f max_frames] [-s] [directory or ROM]...
+/// Directories are searched for .nes files, roms/test by default. ROMs that never report a status, such as
+/// nestest, only fail with -s. Returns 0 if every ROM passed, 1 if some did not and 2 on error
+
+static constexpr const char *USAGE =
+    "Usage: ./emunesconformance [-j threads] [-f max_frames] [-s] [directory or ROM]...";
+
+/// Default place of the test ROMs
+static constexpr const char *DEFAULT_DIRECTORY = "roms/test";
+
+/// Parse the arguments
+static bool parse_arguments(int argc, char *argv[], size_t &num_threads, uint64_t &max_frames, bool &strict,
+                            std::vector<std::filesystem::path> &paths)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        if (argument == "-s")
+        {
+            strict = true;
+        }
+        else if (argument == "-j" && i + 1 < argc)
+        {
+            num_threads = std::stoull(argv[++i]);
+        }
+        else if (argument == "-f" && i + 1 < argc)
+        {
+            max_frames = std::stoull(argv[++i]);
+        }
+        else if (!argument.empty() && argument[0] != '-')
+        {
+            paths.push_back(argument);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if (paths.empty())
+    {
+        paths.push_back(DEFAULT_DIRECTORY);
+    }
+    return max_frames > 0;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t num_threads = 0;
+    uint64_t max_frames = nes::TestRomRunner::DEFAULT_MAX_FRAMES;
+    bool strict = false;
+    std::vector<std::filesystem::path> paths;
+    try
+    {
+        if (!parse_arguments(argc, argv, num_threads, max_frames, strict, paths))
+        {
+            common::Log(common::LogLevel::ERROR, USAGE);
+            return 2;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        common::Log(common::LogLevel::ERROR, USAGE);
+        return 2;
+    }
+
+    std::vector<std::filesystem::path> roms;
+    for (const std::filesystem::path &path : paths)
+    {
+        if (std::filesystem::is_directory(path))
+        {
+            const std::vector<std::filesystem::path> found = nes::TestRomRunner::find_roms(path);
+            roms.insert(roms.end(), found.begin(), found.end());
+        }
+        else if (std::filesystem::is_regular_file(path))
+        {
+            roms.push_back(path);
+        }
+        else
+        {
+            common::Log(common::LogLevel::ERROR, "No test ROM at " + path.string());
+            return 2;
+        }
+    }
+    if (roms.empty())
+    {
+        common::Log(common::LogLevel::ERROR, "No test ROM found");
+        return 2;
+    }
+
+    // The ROMs that fail log their errors in the matrix rather than in between
+    const auto start = std::chrono::steady_clock::now();
+    nes::TestRomRunner runner(num_threads, max_frames);
+    common::mute();
+    const std::vector<nes::TestRomResult> results = runner.run_all(roms);
+    common::unmute();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // One line per ROM: result, code, frames, time and the first line of the text
+    size_t width = 3;
+    for (const nes::TestRomResult &result : results)
+    {
+        width = std::max(width, result.filename.string().size());
+    }
+    std::printf("%-*s  %-9s  %4s  %6s  %8s  %s\n", static_cast<int>(width), "ROM", "RESULT", "CODE", "FRAMES",
+                "TIME", "TEXT");
+    size_t counts[5] = {};
+    for (const nes::TestRomResult &result : results)
+    {
+        counts[static_cast<size_t>(result.status)]++;
+        const std::string code = result.status == nes::TestRomStatus::PASSED ||
+                                         result.status == nes::TestRomStatus::FAILED
+                                     ? std::to_string(result.code)
+                                     : "-";
+        const std::string text = result.text.substr(0, result.text.find('\n'));
+        std::printf("%-*s  %-9s  %4s  %6llu  %6.2f s  %s\n", static_cast<int>(width), result.filename.c_str(),
+                    nes::TestRomRunner::get_status_name(result.status), code.c_str(),
+                    static_cast<unsigned long long>(result.frames), result.seconds, text.c_str());
+    }
+
+    const size_t passed = counts[static_cast<size_t>(nes::TestRomStatus::PASSED)];
+    const size_t no_status = counts[static_cast<size_t>(nes::TestRomStatus::NO_STATUS)];
+    const size_t failed = results.size() - passed - no_status;
+    std::printf("%zu passed, %zu failed, %zu without status of %zu ROMs in %.2f s, %zu at a time\n", passed, failed,
+                no_status, results.size(), elapsed.count(), runner.get_num_threads());
+    return failed == 0 && (!strict || no_status == 0) ? 0 : 1;
+}
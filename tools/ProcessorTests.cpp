@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/Logging.h"
+#include "common/MappedFile.h"
+
+/// Copy the first vectors of every opcode file of the ProcessorTests suite, e.g. from a checkout of
+/// https://github.com/SingleStepTests/65x02 into the directory run by TestSingleStep:
+/// ./emunesprocessortests -n 20 65x02/nes6502/v1 roms/test/ProcessorTests/nes6502
+/// ./emunesprocessortests [-n vectors] <suite directory> <output directory>
+/// The vectors are copied as they are, so the subset keeps the exact bus activity recorded by the suite.
+/// Returns 0 on success and 1 on error
+
+static constexpr const char *USAGE = "Usage: ./emunesprocessortests [-n vectors] <suite directory> <output directory>";
+
+/// Number of vectors copied from each file by default
+static constexpr size_t DEFAULT_VECTORS = 10;
+
+/// @brief Split the top level array of a JSON file into the text of its elements, without parsing them
+/// @param text Contents of the file
+/// @param max_elements Number of elements to split, the following ones are ignored
+/// @param elements The text of each element
+/// @return Whether the text is an array of objects
+static bool split_array(const std::string_view text, const size_t max_elements, std::vector<std::string_view> &elements)
+{
+    size_t offset = text.find_first_not_of(" \t\r\n");
+    if (offset == std::string_view::npos || text[offset] != '[')
+    {
+        return false;
+    }
+    size_t depth = 0;
+    size_t start = 0;
+    bool in_string = false;
+    for (offset++; offset < text.size() && elements.size() < max_elements; offset++)
+    {
+        const char character = text[offset];
+        if (in_string)
+        {
+            // Skip the escaped character, which can be a quote
+            offset += character == '\\';
+            in_string = character != '"';
+        }
+        else if (character == '"')
+        {
+            in_string = true;
+        }
+        else if (character == '{' || character == '[')
+        {
+            start = depth == 0 ? offset : start;
+            depth++;
+        }
+        else if (character == '}' || character == ']')
+        {
+            if (depth == 0)
+            {
+                // End of the top level array
+                return true;
+            }
+            depth--;
+            if (depth == 0)
+            {
+                elements.push_back(text.substr(start, offset + 1 - start));
+            }
+        }
+    }
+    return depth == 0 && !in_string;
+}
+
+/// @brief Copy the first vectors of a file of the suite
+static bool copy_vectors(const std::filesystem::path &input, const std::filesystem::path &output,
+                         const size_t num_vectors)
+{
+    common::MappedFile file;
+    if (!file.open(input.string()))
+    {
+        return false;
+    }
+    std::vector<std::string_view> vectors;
+    if (!split_array(file.get_text(), num_vectors, vectors))
+    {
+        common::Log(common::LogLevel::ERROR, "Not an array of test vectors: " + input.string());
+        return false;
+    }
+    std::ofstream out(output, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    out << "[";
+    for (size_t index = 0; index < vectors.size(); index++)
+    {
+        out << (index == 0 ? "\n" : ",\n") << vectors[index];
+    }
+    out << "\n]\n";
+    if (!out)
+    {
+        common::Log(common::LogLevel::ERROR, "Could not write " + output.string());
+        return false;
+    }
+    return true;
+}
+
+/// Parse the arguments
+static bool parse_arguments(int argc, char *argv[], size_t &num_vectors, std::filesystem::path &input,
+                            std::filesystem::path &output)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        if (argument == "-n" && i + 1 < argc)
+        {
+            size_t parsed = 0;
+            const std::string value = argv[++i];
+            num_vectors = std::stoul(value, &parsed);
+            if (parsed != value.size() || num_vectors == 0)
+            {
+                return false;
+            }
+        }
+        else if (input.empty())
+        {
+            input = argument;
+        }
+        else if (output.empty())
+        {
+            output = argument;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return !output.empty();
+}
+
+int main(int argc, char *argv[])
+{
+    size_t num_vectors = DEFAULT_VECTORS;
+    std::filesystem::path input;
+    std::filesystem::path output;
+    try
+    {
+        if (!parse_arguments(argc, argv, num_vectors, input, output))
+        {
+            common::Log(common::LogLevel::ERROR, USAGE);
+            return 1;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        common::Log(common::LogLevel::ERROR, USAGE);
+        return 1;
+    }
+
+    // One file per opcode, named after it
+    std::vector<std::filesystem::path> filenames;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(input, error))
+    {
+        if (entry.path().extension() == ".json")
+        {
+            filenames.push_back(entry.path());
+        }
+    }
+    if (error || filenames.empty())
+    {
+        common::Log(common::LogLevel::ERROR, "No test vectors in " + input.string());
+        return 1;
+    }
+    std::sort(filenames.begin(), filenames.end());
+    std::filesystem::create_directories(output, error);
+    if (error)
+    {
+        common::Log(common::LogLevel::ERROR, "Could not create " + output.string());
+        return 1;
+    }
+
+    for (const std::filesystem::path &filename : filenames)
+    {
+        if (!copy_vectors(filename, output / filename.filename(), num_vectors))
+        {
+            return 1;
+        }
+    }
+    std::cout << "Copied the first " << num_vectors << " vectors of " << filenames.size() << " files" << std::endl;
+    return 0;
+}
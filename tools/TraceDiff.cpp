@@ -0,0 +1,172 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common/Logging.h"
+#include "common/MappedFile.h"
+#include "debug/TraceDiff.h"
+
+/// Compare two CPU traces, such as nestest.log and the trace of this or another emulator, and print the first
+/// lines that differ with some context
+/// ./emunestracediff [-c begin:end]... [-n max_divergences] [-C context_lines] <trace_a> <trace_b>
+/// The columns are ranges of characters of every line, the end can be omitted to go to the end of the line.
+/// Returns 0 if the traces match, 1 if they differ and 2 on error, like diff
+
+/// Number of divergences printed, if not provided
+static constexpr size_t DEFAULT_MAX_DIVERGENCES = 10;
+
+/// Number of lines printed before and after every divergence, if not provided
+static constexpr size_t DEFAULT_CONTEXT_LINES = 3;
+
+static constexpr const char *USAGE =
+    "Usage: ./emunestracediff [-c begin:end]... [-n max_divergences] [-C context_lines] <trace_a> <trace_b>";
+
+/// Parse a column range such as 0:73 or 86:
+static bool parse_column_range(const std::string &text, debug::ColumnRange &range)
+{
+    const size_t colon = text.find(':');
+    if (colon == std::string::npos || colon == 0)
+    {
+        return false;
+    }
+    range.begin = std::stoul(text.substr(0, colon));
+    if (colon + 1 < text.size())
+    {
+        range.end = std::stoul(text.substr(colon + 1));
+    }
+    return range.begin < range.end;
+}
+
+/// Print a line of a trace, with its name and line number
+static void print_line(const char *marker, const char *name, const uint64_t number, const std::string_view trace,
+                       const size_t offset)
+{
+    std::cout << marker << name << " " << number << ": ";
+    if (offset < trace.size())
+    {
+        std::cout << debug::TraceDiff::get_line(trace, offset);
+    }
+    else
+    {
+        std::cout << "(end of trace)";
+    }
+    std::cout << std::endl;
+}
+
+/// Print a divergence with the lines around it. Before it, the traces match, so only the first one is printed
+static void print_divergence(const debug::TraceDivergence &divergence, const std::string_view traces[2],
+                             const size_t context_lines)
+{
+    const char *names[2] = {"a", "b"};
+    std::cout << "Divergence at line " << divergence.line << std::endl;
+
+    std::vector<size_t> before;
+    size_t offset = divergence.offsets[0];
+    for (size_t line = 0; line < context_lines && line + 1 < divergence.line; line++)
+    {
+        offset = debug::TraceDiff::get_previous_line(traces[0], offset);
+        before.push_back(offset);
+    }
+    for (size_t line = before.size(); line > 0; line--)
+    {
+        print_line("  ", names[0], divergence.line - line, traces[0], before[line - 1]);
+    }
+
+    for (size_t trace = 0; trace < 2; trace++)
+    {
+        print_line("> ", names[trace], divergence.line, traces[trace], divergence.offsets[trace]);
+    }
+
+    for (size_t trace = 0; trace < 2; trace++)
+    {
+        offset = divergence.offsets[trace];
+        for (size_t line = 1; line <= context_lines && offset < traces[trace].size(); line++)
+        {
+            offset = debug::TraceDiff::get_next_line(traces[trace], offset);
+            if (offset < traces[trace].size())
+            {
+                print_line("  ", names[trace], divergence.line + line, traces[trace], offset);
+            }
+        }
+    }
+}
+
+/// Parse the arguments
+static bool parse_arguments(int argc, char *argv[], std::vector<debug::ColumnRange> &columns, size_t &max_divergences,
+                            size_t &context_lines, std::vector<std::string> &filenames)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (argument == "-c" && has_value)
+        {
+            debug::ColumnRange range;
+            if (!parse_column_range(argv[++i], range))
+            {
+                common::Log(common::LogLevel::ERROR, "Invalid column range: " + std::string(argv[i]));
+                return false;
+            }
+            columns.push_back(range);
+        }
+        else if (argument == "-n" && has_value)
+        {
+            max_divergences = std::stoul(argv[++i]);
+        }
+        else if (argument == "-C" && has_value)
+        {
+            context_lines = std::stoul(argv[++i]);
+        }
+        else
+        {
+            filenames.push_back(argument);
+        }
+    }
+    return filenames.size() == 2 && max_divergences > 0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<debug::ColumnRange> columns;
+    size_t max_divergences = DEFAULT_MAX_DIVERGENCES;
+    size_t context_lines = DEFAULT_CONTEXT_LINES;
+    std::vector<std::string> filenames;
+    try
+    {
+        if (!parse_arguments(argc, argv, columns, max_divergences, context_lines, filenames))
+        {
+            common::Log(common::LogLevel::ERROR, USAGE);
+            return 2;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        common::Log(common::LogLevel::ERROR, USAGE);
+        return 2;
+    }
+
+    common::MappedFile files[2];
+    for (size_t trace = 0; trace < 2; trace++)
+    {
+        if (!files[trace].open(filenames[trace]))
+        {
+            return 2;
+        }
+    }
+    const std::string_view traces[2] = {files[0].get_text(), files[1].get_text()};
+
+    const auto start = std::chrono::steady_clock::now();
+    const debug::TraceDiffResult result = debug::TraceDiff(columns).compare(traces[0], traces[1], max_divergences);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (const debug::TraceDivergence &divergence : result.divergences)
+    {
+        print_divergence(divergence, traces, context_lines);
+    }
+    std::cout << "Compared " << result.lines << " lines in " << elapsed.count() << " s, "
+              << result.divergences.size() << (result.divergences.size() < max_divergences ? "" : " or more")
+              << " divergences" << std::endl;
+    return result.divergences.empty() ? 0 : 1;
+}
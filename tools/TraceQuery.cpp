@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "common/Logging.h"
+#include "debug/TraceStore.h"
+#include "nes/Nes.h"
+
+/// Query a trace store recorded with ./emunes --trace-store, e.g. who wrote to $0300 between frames 1000 and 1200:
+/// ./emunestracequery -a 0300 -k w -f 1000:1200 trace.ets
+/// ./emunestracequery [-a first:last] [-p first:last] [-c first:last] [-f first:last] [-k rwx] [-n max_rows] <store>
+/// Addresses and pcs are hexadecimal, cycles and frames decimal, and every range includes both ends. A single
+/// value is a range of one. The kinds are r for reads, w for writes and x for executed instructions.
+/// Returns 0 if some row matched, 1 if none did and 2 on error, like grep
+
+static constexpr const char *USAGE = "Usage: ./emunestracequery [-a first:last] [-p first:last] [-c first:last] "
+                                     "[-f first:last] [-k rwx] [-n max_rows] <store>";
+
+/// Parse a range such as C000:C0FF, or a single value
+static bool parse_range(const std::string &text, const int base, uint64_t &first, uint64_t &last)
+{
+    const size_t colon = text.find(':');
+    size_t parsed = 0;
+    first = std::stoull(text.substr(0, colon), &parsed, base);
+    if (parsed != std::min(colon, text.size()))
+    {
+        return false;
+    }
+    last = first;
+    if (colon != std::string::npos)
+    {
+        last = std::stoull(text.substr(colon + 1), &parsed, base);
+        if (parsed != text.size() - colon - 1)
+        {
+            return false;
+        }
+    }
+    return first <= last;
+}
+
+/// Parse a range of addresses, which can start with a $
+static bool parse_address_range(std::string text, uint16_t &first, uint16_t &last)
+{
+    text.erase(std::remove(text.begin(), text.end(), '$'), text.end());
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    if (!parse_range(text, 16, begin, end) || end > 0xFFFF)
+    {
+        return false;
+    }
+    first = begin;
+    last = end;
+    return true;
+}
+
+/// Parse the kinds of rows, a combination of the letters r, w and x
+static bool parse_kinds(const std::string &text, uint8_t &kinds)
+{
+    kinds = 0;
+    for (const char letter : text)
+    {
+        const size_t kind = std::string("xrw").find(letter);
+        if (kind == std::string::npos)
+        {
+            return false;
+        }
+        kinds |= 1 << kind;
+    }
+    return kinds != 0;
+}
+
+/// Parse the arguments into a query
+static bool parse_arguments(int argc, char *argv[], debug::TraceQuery &query, uint64_t &max_rows,
+                            std::string &filename)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        if (argument.size() == 2 && argument[0] == '-' && i + 1 < argc)
+        {
+            const std::string value = argv[++i];
+            uint64_t first = 0;
+            uint64_t last = 0;
+            bool valid = true;
+            switch (argument[1])
+            {
+            case 'a':
+                valid = parse_address_range(value, query.first_address, query.last_address);
+                break;
+            case 'p':
+                valid = parse_address_range(value, query.first_pc, query.last_pc);
+                break;
+            case 'c':
+                valid = parse_range(value, 10, query.first_cycle, query.last_cycle);
+                break;
+            case 'f':
+                // The frames are converted to the cycles they span
+                valid = parse_range(value, 10, first, last);
+                query.first_cycle = nes::Nes::get_first_cycle_of_frame(first);
+                query.last_cycle = nes::Nes::get_first_cycle_of_frame(last + 1) - 1;
+                break;
+            case 'k':
+                valid = parse_kinds(value, query.kinds);
+                break;
+            case 'n':
+                max_rows = std::stoull(value);
+                break;
+            default:
+                valid = false;
+                break;
+            }
+            if (!valid)
+            {
+                common::Log(common::LogLevel::ERROR, "Invalid value for " + argument + ": " + value);
+                return false;
+            }
+        }
+        else if (filename.empty())
+        {
+            filename = argument;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return !filename.empty();
+}
+
+int main(int argc, char *argv[])
+{
+    debug::TraceQuery query;
+    uint64_t max_rows = 0;
+    std::string filename;
+    try
+    {
+        if (!parse_arguments(argc, argv, query, max_rows, filename))
+        {
+            common::Log(common::LogLevel::ERROR, USAGE);
+            return 2;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        common::Log(common::LogLevel::ERROR, USAGE);
+        return 2;
+    }
+
+    debug::TraceStoreReader reader;
+    if (!reader.open(filename))
+    {
+        return 2;
+    }
+
+    // One line per row: cycle, pc, opcode, kind, address and value
+    const auto start = std::chrono::steady_clock::now();
+    debug::TraceQueryStats stats;
+    uint64_t printed = 0;
+    const char kind_letters[] = {'X', 'R', 'W'};
+    const bool result = reader.query(
+        query,
+        [&](const debug::TraceRow &row) {
+            char line[64];
+            const int size = std::snprintf(line, sizeof(line), "%12llu  %04X  %02X  %c  %04X  %02X\n",
+                                           static_cast<unsigned long long>(row.cycle), row.pc, row.opcode,
+                                           kind_letters[static_cast<uint8_t>(row.kind)], row.address, row.value);
+            std::cout.write(line, size);
+            return max_rows == 0 || ++printed < max_rows;
+        },
+        &stats);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (!result)
+    {
+        return 2;
+    }
+
+    std::cout << stats.rows << " rows matched in " << elapsed.count() << " s, " << stats.blocks << " of "
+              << reader.get_block_count() << " blocks decoded" << std::endl;
+    return stats.rows > 0 ? 0 : 1;
+}